@@ -150,6 +150,46 @@ const cssColors = {
   yellowgreen: '#9acd32',
 };
 
+// op codes for the binary display list format.
+// these must match the OpType enum in canvex (canvas_display_list.h).
+const canvexBinaryOpCodes = {
+  save: 1,
+  restore: 2,
+  scale: 3,
+  rotate: 4,
+  translate: 5,
+  fillStyle: 6,
+  strokeStyle: 7,
+  lineWidth: 8,
+  lineJoin: 9,
+  globalAlpha: 10,
+  font: 11,
+  fill: 12,
+  stroke: 13,
+  clip: 14,
+  fillRect: 15,
+  strokeRect: 16,
+  rect: 17,
+  roundRect: 18,
+  fillText: 19,
+  fillText_emoji: 20,
+  strokeText: 21,
+  drawImage: 22,
+  beginPath: 23,
+  closePath: 24,
+  moveTo: 25,
+  lineTo: 26,
+  quadraticCurveTo: 27,
+  arcTo: 28,
+};
+
+const canvexBinaryVersion = 1;
+
+// arg type tags, match ArgType in canvex
+const ARG_NUMBER = 0;
+const ARG_STRING = 1;
+const ARG_ASSETREF = 2;
+
 export class CanvasDisplayListEncoder {
   constructor(w, h) {
     this.width = w;
@@ -169,6 +209,86 @@ export class CanvasDisplayListEncoder {
       commands: this.cmds,
     };
   }
+
+  // returns the display list in canvex's binary format as a Uint8Array.
+  // this is an alternative to passing the finalize() object as JSON;
+  // canvex tells the formats apart by the "CVXB" magic at the start.
+  finalizeBinary() {
+    const textEncoder = new TextEncoder();
+    let buf = new Uint8Array(1024);
+    let view = new DataView(buf.buffer);
+    let pos = 0;
+
+    function reserve(n) {
+      if (pos + n <= buf.length) return;
+      let newLen = buf.length * 2;
+      while (newLen < pos + n) newLen *= 2;
+      const newBuf = new Uint8Array(newLen);
+      newBuf.set(buf);
+      buf = newBuf;
+      view = new DataView(buf.buffer);
+    }
+    function writeU8(v) {
+      reserve(1);
+      view.setUint8(pos, v);
+      pos += 1;
+    }
+    function writeString(s) {
+      const bytes = textEncoder.encode(s);
+      reserve(4 + bytes.length);
+      view.setUint32(pos, bytes.length, true);
+      buf.set(bytes, pos + 4);
+      pos += 4 + bytes.length;
+    }
+    function writeArg(arg) {
+      if (typeof arg === 'number') {
+        writeU8(ARG_NUMBER);
+        reserve(8);
+        view.setFloat64(pos, arg, true);
+        pos += 8;
+      } else if (typeof arg === 'string') {
+        writeU8(ARG_STRING);
+        writeString(arg);
+      } else if (arg && typeof arg === 'object') {
+        writeU8(ARG_ASSETREF);
+        writeString(arg.type ? String(arg.type) : '');
+        writeString(arg.id !== undefined ? String(arg.id) : '');
+      } else {
+        throw new Error(
+          'Unsupported arg value for binary display list encoding: ' + arg
+        );
+      }
+    }
+
+    // header
+    reserve(20);
+    buf.set([0x43, 0x56, 0x58, 0x42], 0); // "CVXB"
+    view.setUint16(4, canvexBinaryVersion, true);
+    view.setUint16(6, 0, true);
+    view.setInt32(8, this.width, true);
+    view.setInt32(12, this.height, true);
+    view.setUint32(16, this.cmds.length, true);
+    pos = 20;
+
+    for (const [op, params] of this.cmds) {
+      const opCode = canvexBinaryOpCodes[op];
+      if (!opCode) {
+        throw new Error('Unknown op for binary display list encoding: ' + op);
+      }
+      let args;
+      if (params === undefined) args = [];
+      else if (Array.isArray(params)) args = params;
+      else args = [params];
+
+      writeU8(opCode);
+      writeU8(args.length);
+      for (const arg of args) {
+        writeArg(arg);
+      }
+    }
+
+    return buf.slice(0, pos);
+  }
 }
 
 // we don't want to encode named CSS colors because then those have to be parsed in canvex.
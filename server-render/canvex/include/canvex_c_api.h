@@ -19,14 +19,63 @@ typedef enum {
   CanvexRenderError_InvalidArgument_ImageOutput,
   CanvexRenderError_InvalidArgument_ResourceContext,
   CanvexRenderError_JSONParseFail,
+  CanvexRenderError_BinaryParseFail,
+  CanvexRenderError_InvalidArgument_DamageTracker,
   CanvexRenderError_GraphicsUnspecifiedError = 1024
 } CanvexRenderResult;
 
 typedef void *CanvexResourceCtx;
 
+typedef void *CanvexSharedResourceCache;
+
+// how a render handles an image that isn't decoded yet
+typedef enum {
+  CanvexImageLoad_Block = 0, // decode during the render call (default)
+  CanvexImageLoad_Skip, // decode in the background and leave the image out until it's ready
+  CanvexImageLoad_Placeholder // decode in the background and draw a translucent gray rect until it's ready
+} CanvexImageLoadPolicy;
+
+typedef void *CanvexDamageTracker;
+
+#define CANVEX_MAX_DAMAGE_RECTS 16
+
+typedef struct CanvexDamageRect {
+  int32_t x;
+  int32_t y;
+  int32_t w;
+  int32_t h;
+} CanvexDamageRect;
+
+typedef struct CanvexDamageRegion {
+  int32_t num_rects; // zero if nothing changed
+  CanvexDamageRect rects[CANVEX_MAX_DAMAGE_RECTS];
+} CanvexDamageRegion;
+
+// color matrix and range for YUV output
+typedef enum {
+  CanvexYuv_BT601_Limited = 0,
+  CanvexYuv_BT601_Full,
+  CanvexYuv_BT709_Limited,
+  CanvexYuv_BT709_Full
+} CanvexYuvColorMatrix;
+
+/*
+  Destination for YUV 4:2:0 output with alpha: I420 planes plus an alpha plane at luma resolution.
+  Row bytes of zero mean dense rows, i.e. w for luma and alpha and (w + 1) / 2 for chroma.
+*/
+typedef struct CanvexI420ABuffer {
+  uint8_t *y;
+  uint8_t *cb;
+  uint8_t *cr;
+  uint8_t *a;
+  uint32_t row_bytes_y;
+  uint32_t row_bytes_ch;
+  uint32_t row_bytes_a;
+} CanvexI420ABuffer;
+
 typedef struct CanvexExecutionStats {
   // -- high level operations --
-  int64_t json_parse_us;
+  int64_t json_parse_us; // also used for binary display list parse
   int64_t render_total_us;
   int64_t file_write_us; // not relevant unless writing to disk
 
@@ -37,11 +86,134 @@ typedef struct CanvexExecutionStats {
   int64_t render_detail_draw_text_us;
 
   // -- render operation stats --
-  int32_t num_image_cache_misses;
+  int32_t num_image_cache_misses; // includes images decoded again at a larger size
+  int32_t num_images_pending; // images left out or drawn as placeholders because they are still decoding
+  int32_t num_shm_images; // images drawn from shared memory, see CanvexResourceCtxHasNewShmFrames
   int32_t num_cmds;
   int32_t num_invalid_arg_errors;
+
+  // -- decoded image cache --
+  int32_t num_image_cache_evictions; // images dropped to stay within the memory budget (by any context using a shared cache)
+  int64_t image_cache_bytes; // decoded pixels held by the cache after this call, including a shared cache if attached
+
+  // -- retained save/restore group cache --
+  int32_t num_group_cache_hits; // groups replayed from a recorded picture or raster
+  int32_t num_group_cache_misses; // cacheable groups that had to be executed
+  int64_t group_cache_bytes; // approximate size of the cache after this call
+
+  // -- text caches --
+  int32_t num_text_blob_cache_hits; // shaped strings reused from earlier renders
+  int32_t num_text_blob_cache_misses;
+  int32_t num_font_cache_hits; // font variants resolved without a file name lookup
+  int32_t num_font_cache_misses;
+
+  // -- emoji sprite atlas --
+  int32_t num_emoji_sprite_hits; // emoji drawn as a blit of an existing sprite
+  int32_t num_emoji_sprite_misses; // emoji rendered into the atlas (or drawn as text if they didn't fit)
+  int32_t emoji_atlas_pages;
+  int32_t emoji_atlas_occupancy_pct; // share of the atlas pages' area used by sprites
+  int64_t emoji_atlas_bytes; // pages and their snapshots, including older ones still held by cached groups
+
+  // -- incremental rendering (only set by CanvexRenderDisplayListIncremental_*) --
+  int64_t damage_detect_us;
+  int32_t num_damage_rects;
+
+  // -- banded rasterization (only set if the render was split, see CanvexResourceCtxSetRasterBands) --
+  int64_t raster_band_record_us; // executing the display list into a recording, included in render_total_us
+  int32_t num_raster_bands;
+
+  // -- loads on the render thread, i.e. fonts and images that weren't preloaded or prefetched --
+  int64_t cold_load_us; // included in render_total_us
+  int32_t num_cold_font_loads;
+  int32_t num_cold_image_loads; // includes live images reloaded after a change
 } CanvexExecutionStats;
 
+// Skia's process-global caches, see CanvexGetSkiaCacheStats()
+typedef struct CanvexSkiaCacheStats {
+  // -- glyph strike cache --
+  int64_t font_cache_bytes_used;
+  int64_t font_cache_bytes_limit;
+  int32_t font_cache_count_used; // number of strikes (typeface, size and transform combinations)
+  int32_t font_cache_count_limit;
+
+  // -- resource cache (decoded and scaled images, and other intermediates) --
+  int64_t resource_cache_bytes_used;
+  int64_t resource_cache_bytes_limit;
+
+  // -- lookups in canvex's text caches by all contexts since the process started --
+  // Skia doesn't count hits in its own caches. a low text blob hit rate while the font cache is at its limit
+  // means that text is being shaped and rasterized over and over.
+  int64_t text_blob_cache_hits;
+  int64_t text_blob_cache_misses;
+  int64_t font_cache_hits;
+  int64_t font_cache_misses;
+
+  int64_t num_purges; // calls to CanvexPurgeSkiaCaches()
+} CanvexSkiaCacheStats;
+
+// resources to load ahead of a session, see CanvexResourceCtxPreload()
+typedef struct CanvexPreloadFont {
+  const char *family; // as used in display lists, e.g. "Roboto"
+  int32_t weight; // e.g. 400 or 700
+  int32_t italic; // nonzero for the italic variant
+} CanvexPreloadFont;
+
+typedef struct CanvexPreloadImage {
+  const char *asset_type; // "defaultAsset", "compositionAsset", "liveAsset" or "shmAsset"
+  const char *name;
+  uint32_t draw_w; // largest size the image will be drawn at in output pixels, or zero for full resolution
+  uint32_t draw_h;
+} CanvexPreloadImage;
+
+typedef struct CanvexPreloadStatus {
+  int32_t num_pending; // still loading or decoding
+  int32_t num_ready;
+  int32_t num_failed; // unknown font families or asset types, and files that couldn't be loaded
+} CanvexPreloadStatus;
+
+
+// memory held by a resource context, see CanvexResourceCtxGetMemoryStats()
+typedef struct CanvexMemoryStats {
+  // -- file-backed, shared with other processes that map the same files --
+  int64_t mapped_file_bytes; // fonts and assets mapped read-only (including files in an attached shared cache)
+  int32_t num_mapped_files;
+
+  // -- private to this process --
+  int64_t image_cache_bytes; // decoded images, including an attached shared cache
+  int64_t group_cache_bytes;
+  int64_t emoji_atlas_bytes; // pages and their snapshots, including older ones still held by cached groups
+
+  // -- whole process, from /proc/self/smaps_rollup (zero if not available) --
+  int64_t process_rss_bytes;
+  int64_t process_shared_bytes; // resident pages that another process also maps
+  int64_t process_private_bytes;
+} CanvexMemoryStats;
+
+// per-opcode profile of the last render, see CanvexResourceCtxSetOpProfiling()
+#define CANVEX_OP_PROFILE_MAX_OPS 64 // indexed by op code, as in the binary display list format
+#define CANVEX_OP_PROFILE_MAX_SLOWEST 16
+#define CANVEX_OP_PROFILE_ARGS_LEN 96
+
+typedef struct CanvexOpTotals {
+  int32_t count;
+  int64_t total_ns;
+} CanvexOpTotals;
+
+typedef struct CanvexSlowCommand {
+  int32_t cmd_index; // position in the display list
+  int32_t op; // op code, see CanvexGetOpName()
+  int64_t ns;
+  char args[CANVEX_OP_PROFILE_ARGS_LEN]; // arguments as JSON, truncated if too long
+} CanvexSlowCommand;
+
+typedef struct CanvexOpProfile {
+  int32_t num_ops; // number of op codes in use
+  CanvexOpTotals ops[CANVEX_OP_PROFILE_MAX_OPS];
+  CanvexOpTotals group_replays; // save/restore groups drawn from the group cache, whose commands weren't executed
+  int32_t num_slowest;
+  CanvexSlowCommand slowest[CANVEX_OP_PROFILE_MAX_SLOWEST]; // slowest first
+} CanvexOpProfile;
+
 
 /*
   A context must be created before rendering.
@@ -53,11 +225,222 @@ CanvexResourceCtx CanvexResourceCtxCreate(
   const char *resourceDir
 );
 
+/*
+  Like CanvexResourceCtxCreate, and also maps the files listed in the manifest into memory right away,
+  so that the first frames using them don't wait on disk reads.
+
+  The manifest has one path per line relative to the resource dir, with '#' comments.
+  A directory (e.g. "fonts") stands for all the files directly inside it.
+  res/preload-manifest.txt lists the standard fonts and test assets.
+*/
+CanvexResourceCtx CanvexResourceCtxCreateWithPreloadManifest(
+  const char *resourceDir,
+  const char *manifestPath
+);
+
 /*
   Releases memory used by the context.
 */
 void CanvexResourceCtxDestroy(CanvexResourceCtx);
 
+/*
+  Fills in the memory held by the context's caches and the process as a whole.
+  Fonts and non-live assets are mapped read-only, so their pages are shared by all the processes
+  that use the same files; mapped_file_bytes is the size of those mappings, not their resident size.
+  Returns 0 on success, or -1 if the arguments are invalid.
+*/
+int CanvexResourceCtxGetMemoryStats(
+  CanvexResourceCtx resourceCtx,
+  CanvexMemoryStats *stats
+);
+
+/*
+  Sets how images that aren't decoded yet are handled.
+
+  With the Skip and Placeholder policies, images are decoded on numDecodeThreads background threads
+  (0 for the default). The thread count only applies if the threads haven't been started yet.
+  A render that had to leave out images reports them in CanvexExecutionStats.num_images_pending,
+  and the caller should render the same display list again on a later frame to pick them up.
+*/
+void CanvexResourceCtxSetImageLoadPolicy(
+  CanvexResourceCtx resourceCtx,
+  CanvexImageLoadPolicy policy,
+  int32_t numDecodeThreads
+);
+
+/*
+  Sets the number of horizontal bands that renders into raw buffers are split into.
+
+  With more than one band, the display list is executed on the calling thread into a recording,
+  which is then rasterized into the bands in parallel on numBands - 1 worker threads and the calling thread.
+  The output is the same as with a single band. Bands are at least 64 rows high,
+  so small images or damage regions may use fewer bands than requested.
+
+  numBands of 0 or 1 renders directly on the calling thread (the default).
+*/
+void CanvexResourceCtxSetRasterBands(
+  CanvexResourceCtx resourceCtx,
+  int32_t numBands
+);
+
+/*
+  Fills and clips paths made of rects and rounded rects with Skia's shape primitives
+  instead of scan converting them as general paths (off by default).
+  This is faster for UI-style graphics, but antialiased edges may differ by a level or two
+  from the default rendering, so output isn't byte-for-byte identical.
+*/
+void CanvexResourceCtxSetAnalyticShapes(
+  CanvexResourceCtx resourceCtx,
+  int enabled
+);
+
+/*
+  Turns per-opcode profiling on or off (off by default).
+
+  While on, every command executed by a render with this context is timed with the CPU's cycle counter,
+  and the profile of the last render can be read with CanvexResourceCtxGetOpProfile.
+  With raster bands, the times are for executing the commands into the recording,
+  not for rasterizing the bands.
+*/
+void CanvexResourceCtxSetOpProfiling(
+  CanvexResourceCtx resourceCtx,
+  int enabled
+);
+
+/*
+  Fills in the per-opcode profile of the last render with this context.
+  Returns 0 on success, or -1 if the arguments are invalid or profiling is off.
+*/
+int CanvexResourceCtxGetOpProfile(
+  CanvexResourceCtx resourceCtx,
+  CanvexOpProfile *profile
+);
+
+/*
+  Images drawn from shared memory ("shmAsset") change without the display list changing.
+  After a render that reported num_shm_images > 0, this returns 1 when one of those sources
+  has published a new frame (or is due for its once-a-second check for a restarted producer),
+  and the caller should render the same display list again to show it. Returns 0 otherwise.
+*/
+int CanvexResourceCtxHasNewShmFrames(
+  CanvexResourceCtx resourceCtx
+);
+
+/*
+  Returns the name of an op code as used in JSON display lists (e.g. "fillRect"),
+  or "unknown" for a code that's not in use.
+*/
+const char* CanvexGetOpName(
+  int32_t op
+);
+
+/*
+  Creates a cache of fonts and decoded images that many resource contexts can share,
+  e.g. one per process for all the render sessions on a host, so that each session doesn't load
+  its own copy of every typeface and image. It's safe to render with contexts that share the cache
+  on different threads at the same time (each context itself must still be used from one thread at a time).
+
+  Fonts and images from the default and composition assets are shared.
+  Live assets are always cached by each context separately.
+
+  maxImageBytes is the budget for decoded images in the shared cache, or 0 for the default (256 MB).
+*/
+CanvexSharedResourceCache CanvexSharedResourceCacheCreate(
+  int64_t maxImageBytes
+);
+
+/*
+  Releases the caller's reference. Contexts that are attached to the cache keep it alive until
+  they're destroyed or detached.
+*/
+void CanvexSharedResourceCacheDestroy(CanvexSharedResourceCache);
+
+/*
+  Makes the context use the shared cache for fonts and default/composition asset images,
+  or its own caches again if sharedCache is null.
+  Images and fonts the context has already loaded are dropped, so this should be called before rendering.
+  Files the context mapped from its preload manifest are handed over to the shared cache,
+  so the shared fonts and image decodes use those mappings.
+*/
+void CanvexResourceCtxAttachSharedCache(
+  CanvexResourceCtx resourceCtx,
+  CanvexSharedResourceCache sharedCache
+);
+
+/*
+  Starts loading fonts and decoding images in the background, so that the first frames that use them
+  don't stall. Fonts are otherwise loaded by the first text draw that uses them, and images by their first draw.
+
+  Fonts are loaded on a separate thread, and images are decoded on the image decode threads
+  (see CanvexResourceCtxSetImageLoadPolicy). A render that needs a font or image before it's ready
+  loads it on the render thread as before, and reports the time in CanvexExecutionStats.cold_load_us.
+
+  Can be called several times; each call adds to the set reported by CanvexResourceCtxGetPreloadStatus.
+  Returns 0, or -1 if the arguments are invalid.
+*/
+int CanvexResourceCtxPreload(
+  CanvexResourceCtx resourceCtx,
+  const CanvexPreloadFont *fonts,
+  size_t numFonts,
+  const CanvexPreloadImage *images,
+  size_t numImages
+);
+
+/*
+  Reports how much of what was requested with CanvexResourceCtxPreload is ready.
+  Like the render calls, this must not be called while the context is rendering on another thread.
+  Returns 0, or -1 if the arguments are invalid.
+*/
+int CanvexResourceCtxGetPreloadStatus(
+  CanvexResourceCtx resourceCtx,
+  CanvexPreloadStatus *status
+);
+
+/*
+  Starts decoding an image in the background, so that it's ready by the time a display list draws it.
+
+  assetType is the asset type used in display lists ("defaultAsset", "compositionAsset" or "liveAsset").
+  drawW/drawH give the largest size in output pixels that the image will be drawn at,
+  or zero to decode at full resolution.
+
+  Returns 0 if the image is cached or being decoded, and -1 if the arguments are invalid
+  or the image failed to load very recently.
+*/
+int CanvexResourceCtxPrefetchImage(
+  CanvexResourceCtx resourceCtx,
+  const char *assetType,
+  const char *imageName,
+  uint32_t drawW,
+  uint32_t drawH
+);
+
+
+/*
+  Sets the byte limits of Skia's glyph cache and resource cache, and the maximum number of glyph strikes.
+  These caches are global to the process and shared by all contexts. A value of zero leaves that limit unchanged.
+  Lowering a limit purges the cache down to it right away.
+*/
+void CanvexSetSkiaCacheLimits(
+  int64_t fontCacheBytes,
+  int32_t fontCacheCount,
+  int64_t resourceCacheBytes
+);
+
+/*
+  Fills in the current usage and limits of Skia's caches. Can be called from any thread.
+  Returns 0, or -1 if stats is null.
+*/
+int CanvexGetSkiaCacheStats(
+  CanvexSkiaCacheStats *stats
+);
+
+/*
+  Drops all unused entries from Skia's caches, e.g. when a long-running process is idle
+  or after a session with many fonts has ended. Glyphs and images are recreated on demand,
+  so the next frames that use them are slower.
+*/
+void CanvexPurgeSkiaCaches(void);
+
 
 /*
   Renders the given JSON display list into the image buffer specified by the dstImage* args.
@@ -105,6 +488,157 @@ CanvexRenderResult CanvexRenderJSON_BGRA(
   CanvexExecutionStats* stats // optional stats
 );
 
+/*
+  Renders a display list given as a data buffer of known size.
+  The format is picked based on the header: if the data starts with the "CVXB" magic,
+  it's parsed as a binary display list (see canvas_display_list_binary.cpp), otherwise as JSON.
+  JSON data passed this way doesn't need to be null-terminated.
+
+  Otherwise same as CanvexRenderJSON_RGBA.
+*/
+CanvexRenderResult CanvexRenderDisplayList_RGBA(
+  CanvexResourceCtx resourceCtx,
+  const uint8_t *displayListData,
+  size_t displayListDataSize,
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes,
+  CanvexAlphaMode dstAlpha,
+  CanvexExecutionStats* stats // optional stats
+);
+
+/*
+  Same as CanvexRenderDisplayList_RGBA, but writes BGRA memory layout.
+*/
+CanvexRenderResult CanvexRenderDisplayList_BGRA(
+  CanvexResourceCtx resourceCtx,
+  const uint8_t *displayListData,
+  size_t displayListDataSize,
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes,
+  CanvexAlphaMode dstAlpha,
+  CanvexExecutionStats* stats // optional stats
+);
+
+/*
+  A damage tracker retains what was drawn by the previous incremental render call,
+  so that the next call can redraw only what changed.
+  One tracker should be used per destination buffer.
+*/
+CanvexDamageTracker CanvexDamageTrackerCreate(void);
+
+void CanvexDamageTrackerDestroy(CanvexDamageTracker);
+
+/*
+  Forces the next incremental render with this tracker to redraw the whole image.
+  Call this if the destination buffer was modified by something else.
+*/
+void CanvexDamageTrackerInvalidate(CanvexDamageTracker);
+
+/*
+  Incremental version of CanvexRenderDisplayList_RGBA.
+
+  dstImageData must still contain the image rendered by the previous call with the same tracker.
+  The display list is compared against the previous one, and only the regions
+  where draw calls changed are cleared and redrawn. The first call, or a call with
+  a different buffer, size or format, redraws everything.
+
+  The redrawn regions are written to dstDamage (optional), so the caller can limit
+  its own processing of the image to those rects. If dstDamage->num_rects is zero,
+  the image wasn't modified.
+*/
+CanvexRenderResult CanvexRenderDisplayListIncremental_RGBA(
+  CanvexResourceCtx resourceCtx,
+  CanvexDamageTracker damageTracker,
+  const uint8_t *displayListData,
+  size_t displayListDataSize,
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes,
+  CanvexAlphaMode dstAlpha,
+  CanvexDamageRegion* dstDamage, // optional
+  CanvexExecutionStats* stats // optional stats
+);
+
+/*
+  Same as CanvexRenderDisplayListIncremental_RGBA, but writes BGRA memory layout.
+*/
+CanvexRenderResult CanvexRenderDisplayListIncremental_BGRA(
+  CanvexResourceCtx resourceCtx,
+  CanvexDamageTracker damageTracker,
+  const uint8_t *displayListData,
+  size_t displayListDataSize,
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes,
+  CanvexAlphaMode dstAlpha,
+  CanvexDamageRegion* dstDamage, // optional
+  CanvexExecutionStats* stats // optional stats
+);
+
+/*
+  Renders the given JSON display list directly into YUV 4:2:0 planes with alpha.
+  Returns a CanvexRenderResult value (0 on success or an error id).
+
+  Each strip of the image is rasterized and converted in one pass, without a full-size RGBA intermediate.
+  The output is premultiplied: luma above the black level and chroma offset from 128 are scaled by alpha,
+  so a transparent pixel has black luma (16 in limited range), chroma 128 and alpha 0.
+  Compositing over a base image in the same color space is then:
+    Y = Yfg + (Ybase - black) * (1 - a)
+    C = Cfg + (Cbase - 128) * (1 - a)
+  where a is the alpha plane value / 255. Each chroma sample is the average of its 2x2 block.
+
+  An empty or null input json string will return CanvexRenderError_InvalidArgument_JSONInput.
+*/
+CanvexRenderResult CanvexRenderJSON_I420A(
+  CanvexResourceCtx resourceCtx,
+  const char *json,
+  const CanvexI420ABuffer *dstImage,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  CanvexYuvColorMatrix colorMatrix,
+  CanvexExecutionStats* stats // optional stats
+);
+
+/*
+  Same as CanvexRenderJSON_I420A, but takes a JSON or binary display list as a data buffer
+  like CanvexRenderDisplayList_RGBA.
+*/
+CanvexRenderResult CanvexRenderDisplayList_I420A(
+  CanvexResourceCtx resourceCtx,
+  const uint8_t *displayListData,
+  size_t displayListDataSize,
+  const CanvexI420ABuffer *dstImage,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  CanvexYuvColorMatrix colorMatrix,
+  CanvexExecutionStats* stats // optional stats
+);
+
+/*
+  Incremental version of CanvexRenderDisplayList_I420A, see CanvexRenderDisplayListIncremental_RGBA.
+
+  Only the damaged regions are rasterized and converted. The rects in dstDamage are expanded
+  to whole 2x2 chroma blocks. Changing the color matrix redraws everything.
+*/
+CanvexRenderResult CanvexRenderDisplayListIncremental_I420A(
+  CanvexResourceCtx resourceCtx,
+  CanvexDamageTracker damageTracker,
+  const uint8_t *displayListData,
+  size_t displayListDataSize,
+  const CanvexI420ABuffer *dstImage,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  CanvexYuvColorMatrix colorMatrix,
+  CanvexDamageRegion* dstDamage, // optional
+  CanvexExecutionStats* stats // optional stats
+);
+
 /*
   Utility for rendering rounded corner masks.
 
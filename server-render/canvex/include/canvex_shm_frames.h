@@ -0,0 +1,67 @@
+#ifndef __CANVEX_SHM_FRAMES_H__
+#define __CANVEX_SHM_FRAMES_H__ 1
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Memory layout for passing raw frames of a live image to canvex through POSIX shared memory.
+
+  A display list draws the latest frame with an asset ref of type "shmAsset",
+  where the name is the shm object name (e.g. "/vcs-webframe-0").
+  Pixels are premultiplied RGBA (byte order R, G, B, A), so canvex can draw them without a copy.
+
+  The object starts with this header, followed by num_slots frame slots.
+  Each source must have a single producer and a single canvex reader.
+
+  Producer, for each frame:
+    1. pick a slot that is neither the slot of latest_sequence nor reader_slot
+    2. store 0 in slot_sequence[slot] (seq_cst)
+    3. load reader_slot again, and if it's now the picked slot, go back to step 1
+    4. write pixels into the slot
+    5. store the new sequence number in slot_sequence[slot], then in latest_sequence (release)
+
+  Reader:
+    1. load latest_sequence (acquire) and find the slot whose slot_sequence matches
+    2. store that slot in reader_slot (seq_cst)
+    3. load slot_sequence[slot] again, and if it changed, go back to step 1
+    4. the slot's pixels stay valid until reader_slot is changed
+
+  Sequence numbers start at 1 and increase by one for each frame.
+  Fields shared between the processes must be accessed atomically.
+*/
+
+#define CANVEX_SHM_FRAMES_MAGIC 0x46585643 // "CVXF" in little-endian byte order
+#define CANVEX_SHM_FRAMES_VERSION 1
+#define CANVEX_SHM_FRAMES_MAX_SLOTS 4
+
+typedef struct CanvexShmFramesHeader {
+  // -- written once by the producer before any frames --
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t row_bytes;
+  uint32_t num_slots; // at least 3, so the producer always has a free slot
+  uint64_t slot_offset; // byte offset of the first slot from the start of the object
+  uint64_t slot_stride; // byte offset between slots
+
+  // -- updated by the producer --
+  uint64_t latest_sequence; // zero until the first frame is complete
+  uint64_t slot_sequence[CANVEX_SHM_FRAMES_MAX_SLOTS]; // zero while a slot is being written
+
+  // -- updated by the reader --
+  uint32_t reader_slot; // slot in use by the reader, or CANVEX_SHM_FRAMES_NO_SLOT
+  uint32_t _reserved;
+} CanvexShmFramesHeader;
+
+#define CANVEX_SHM_FRAMES_NO_SLOT 0xffffffffu
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,7 +1,9 @@
 #include "canvas_display_list.h"
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <unordered_map>
+#include "rapidjson/memorystream.h"
 #include "rapidjson/reader.h"
 
 namespace canvex {
@@ -265,7 +267,8 @@ class DisplayListJSONHandler {
     return true;
   }
 
-  const std::unordered_map<std::string, OpType> opsByName_ = {
+  // shared between parses, so the map isn't rebuilt for every display list
+  static inline const std::unordered_map<std::string, OpType> opsByName_ = {
     {"save", OpType::save},
     {"restore", OpType::restore},
     {"scale", OpType::scale},
@@ -320,15 +323,16 @@ std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListJSON(const std::string&
   return ParseVCSDisplayListJSON(jsonStr.c_str());
 }
 
-std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListJSON(const char* jsonStr)
+// if len is npos, the input is null-terminated
+template <typename InputStream>
+static std::unique_ptr<VCSCanvasDisplayList> parseDisplayListJSONStream(InputStream& is, const char* jsonStr, size_t len)
 {
   auto dl = std::make_unique<VCSCanvasDisplayList>();
 
   rapidjson::Reader reader;
-  rapidjson::StringStream ss(jsonStr);
   DisplayListJSONHandler jsonHandler(*dl);
 
-  auto result = reader.Parse(ss, jsonHandler);
+  auto result = reader.Parse(is, jsonHandler);
   if (!result) {
     std::stringstream ss;
     ss << "Display list can't be parsed, probably not valid JSON (error code ";
@@ -336,7 +340,9 @@ std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListJSON(const char* jsonSt
     ss << " at offset " << result.Offset() << ")";
 
     if (result.Code() == kParseErrorDocumentRootNotSingular) {
-      size_t len = strlen(jsonStr);
+      if (len == std::string::npos) {
+        len = strlen(jsonStr);
+      }
       ss << "; code = kParseErrorDocumentRootNotSingular; jsonStr len=" << len;
       if (result.Offset() < len) {
         ss << ", char code at error offset is: " << (uint32_t)(((uint8_t *)jsonStr)[result.Offset()]);
@@ -349,4 +355,38 @@ std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListJSON(const char* jsonSt
   return dl;
 }
 
+std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListJSON(const char* jsonStr)
+{
+  rapidjson::StringStream ss(jsonStr);
+  return parseDisplayListJSONStream(ss, jsonStr, std::string::npos);
+}
+
+std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListJSON(const char* data, size_t size)
+{
+  rapidjson::MemoryStream ms(data, size);
+  return parseDisplayListJSONStream(ms, data, size);
+}
+
+std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayList(const uint8_t* data, size_t size)
+{
+  if (IsVCSDisplayListBinary(data, size)) {
+    return ParseVCSDisplayListBinary(data, size);
+  }
+  return ParseVCSDisplayListJSON(reinterpret_cast<const char*>(data), size);
+}
+
+const char* GetOpTypeName(OpType op)
+{
+  // in OpType order
+  static const char* const names[numOpTypes] = {
+    "noop", "save", "restore", "scale", "rotate", "translate",
+    "fillStyle", "strokeStyle", "lineWidth", "lineJoin", "globalAlpha", "font",
+    "fill", "stroke", "clip", "fillRect", "strokeRect", "rect", "roundRect",
+    "fillText", "fillText_emoji", "strokeText", "drawImage",
+    "beginPath", "closePath", "moveTo", "lineTo", "quadraticCurveTo", "arcTo",
+  };
+  if (op < 0 || op >= numOpTypes) return "unknown";
+  return names[op];
+}
+
 } // namespace canvex
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
@@ -7,12 +9,15 @@
 
 /*
   Native command type representing a VCS canvas display list,
-  and a utility to parse the JSON format received from VCS JavaScript engine.
+  and utilities to parse the formats received from VCS JavaScript engine
+  (JSON, or the binary encoding described in canvas_display_list_binary.cpp).
 */
 
 namespace canvex {
 
-// if you add to this list, also make sure to update "opsByName" in the .cpp counterpart
+// if you add to this list, also make sure to update "opsByName" and GetOpTypeName() in the .cpp counterpart.
+// the numeric values are used as op codes in the binary display list format,
+// so only append new ops before numOpTypes (and update canvexBinaryOpCodes in canvas-display-list.js).
 enum OpType {
   noop = 0,
   save,
@@ -43,6 +48,8 @@ enum OpType {
   lineTo,
   quadraticCurveTo,
   arcTo,
+
+  numOpTypes  // not an op, must be last
 };
 
 enum ArgType {
@@ -77,8 +84,31 @@ struct VCSCanvasDisplayList {
   int height;
 };
 
+// the op's name as used in the JSON format, e.g. "fillRect"
+const char* GetOpTypeName(OpType op);
+
 // throws on parse error
 std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListJSON(const std::string& str);
 std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListJSON(const char* cstr);
+// this version doesn't require the data to be null-terminated
+std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListJSON(const char* data, size_t size);
+
+// -- binary format --
+
+// the binary format starts with these four bytes.
+// JSON can't start with this, so the magic is enough to tell the formats apart.
+constexpr uint8_t kDisplayListBinaryMagic[4] = {'C', 'V', 'X', 'B'};
+constexpr uint16_t kDisplayListBinaryVersion = 1;
+
+bool IsVCSDisplayListBinary(const uint8_t* data, size_t size);
+
+// throws on parse error
+std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListBinary(const uint8_t* data, size_t size);
+
+// produces the same encoding as CanvasDisplayListEncoder.finalizeBinary() on the JS side
+std::vector<uint8_t> EncodeVCSDisplayListBinary(const VCSCanvasDisplayList& dl);
+
+// picks the parser based on the magic header; throws on parse error
+std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayList(const uint8_t* data, size_t size);
 
 } // namespace canvex
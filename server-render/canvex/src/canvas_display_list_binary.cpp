@@ -0,0 +1,220 @@
+#include "canvas_display_list.h"
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+/*
+  Binary encoding of the VCS canvas display list.
+
+  This carries exactly the same command set as the JSON format,
+  but can be read straight from the caller's buffer without tokenizing
+  or looking up op names and keys as strings.
+
+  All values are little-endian and unaligned.
+
+  Header (20 bytes):
+    0   "CVXB" magic
+    4   u16 version (kDisplayListBinaryVersion)
+    6   u16 flags (reserved, must be zero)
+    8   i32 width
+    12  i32 height
+    16  u32 number of commands
+
+  Each command:
+    u8  op (OpType value)
+    u8  number of args
+    ... args
+
+  Each arg:
+    u8  type (ArgType value)
+    number:   f64
+    string:   u32 byte length + UTF-8 bytes
+    assetRef: u32 byte length + type string, u32 byte length + id string
+*/
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Binary display list reader assumes a little-endian host"
+#endif
+
+namespace canvex {
+
+constexpr size_t kHeaderSize = 20;
+
+class BinaryReader {
+ public:
+  BinaryReader(const uint8_t* data, size_t size) : p_(data), end_(data + size), begin_(data) {}
+
+  template <typename T>
+  T read() {
+    T v;
+    need(sizeof(T));
+    memcpy(&v, p_, sizeof(T));
+    p_ += sizeof(T);
+    return v;
+  }
+
+  std::string readString() {
+    const uint32_t len = read<uint32_t>();
+    need(len);
+    std::string s(reinterpret_cast<const char*>(p_), len);
+    p_ += len;
+    return s;
+  }
+
+  bool atEnd() const {
+    return p_ == end_;
+  }
+
+  [[noreturn]] void fail(const std::string& msg) const {
+    std::stringstream ss;
+    ss << "Binary display list parse error: " << msg << " (offset " << (p_ - begin_) << ")";
+    throw std::runtime_error(ss.str());
+  }
+
+ private:
+  const uint8_t* p_;
+  const uint8_t* end_;
+  const uint8_t* begin_;
+
+  void need(size_t n) {
+    if ((size_t)(end_ - p_) < n) {
+      fail("Unexpected end of data");
+    }
+  }
+};
+
+bool IsVCSDisplayListBinary(const uint8_t* data, size_t size) {
+  return data && size >= sizeof(kDisplayListBinaryMagic)
+    && memcmp(data, kDisplayListBinaryMagic, sizeof(kDisplayListBinaryMagic)) == 0;
+}
+
+std::unique_ptr<VCSCanvasDisplayList> ParseVCSDisplayListBinary(const uint8_t* data, size_t size) {
+  if (!IsVCSDisplayListBinary(data, size) || size < kHeaderSize) {
+    throw std::runtime_error("Binary display list parse error: missing header");
+  }
+  BinaryReader r(data + sizeof(kDisplayListBinaryMagic), size - sizeof(kDisplayListBinaryMagic));
+
+  const auto version = r.read<uint16_t>();
+  if (version != kDisplayListBinaryVersion) {
+    std::stringstream ss;
+    ss << "Unsupported version " << version;
+    r.fail(ss.str());
+  }
+  r.read<uint16_t>(); // flags, currently unused
+
+  auto dl = std::make_unique<VCSCanvasDisplayList>();
+  dl->width = r.read<int32_t>();
+  dl->height = r.read<int32_t>();
+
+  const auto numCmds = r.read<uint32_t>();
+  // every command takes at least two bytes, so this also sanity-checks the count
+  if (numCmds > (size - kHeaderSize) / 2) {
+    r.fail("Command count exceeds data size");
+  }
+  dl->cmds.resize(numCmds);
+
+  for (auto& cmd : dl->cmds) {
+    const auto op = r.read<uint8_t>();
+    if (op == noop || op >= numOpTypes) {
+      std::stringstream ss;
+      ss << "Unrecognized op value for command: " << (int)op;
+      r.fail(ss.str());
+    }
+    cmd.op = static_cast<OpType>(op);
+
+    const auto numArgs = r.read<uint8_t>();
+    cmd.args.reserve(numArgs);
+
+    for (uint8_t i = 0; i < numArgs; i++) {
+      const auto argType = r.read<uint8_t>();
+      switch (argType) {
+        case ArgType::number:
+          cmd.args.emplace_back(r.read<double>());
+          break;
+        case ArgType::string:
+          cmd.args.emplace_back(r.readString());
+          break;
+        case ArgType::assetRef: {
+          auto type = r.readString();
+          auto id = r.readString();
+          cmd.args.emplace_back(std::make_pair(std::move(type), std::move(id)));
+          break;
+        }
+        default: {
+          std::stringstream ss;
+          ss << "Unexpected arg type: " << (int)argType;
+          r.fail(ss.str());
+        }
+      }
+    }
+  }
+
+  if (!r.atEnd()) {
+    r.fail("Trailing data after last command");
+  }
+
+  return dl;
+}
+
+
+class BinaryWriter {
+ public:
+  template <typename T>
+  void write(T v) {
+    const auto n = buf_.size();
+    buf_.resize(n + sizeof(T));
+    memcpy(buf_.data() + n, &v, sizeof(T));
+  }
+
+  void writeString(const std::string& s) {
+    write<uint32_t>(s.size());
+    buf_.insert(buf_.end(), s.begin(), s.end());
+  }
+
+  std::vector<uint8_t>& data() {
+    return buf_;
+  }
+
+ private:
+  std::vector<uint8_t> buf_;
+};
+
+std::vector<uint8_t> EncodeVCSDisplayListBinary(const VCSCanvasDisplayList& dl) {
+  BinaryWriter w;
+  for (auto c : kDisplayListBinaryMagic) {
+    w.write<uint8_t>(c);
+  }
+  w.write<uint16_t>(kDisplayListBinaryVersion);
+  w.write<uint16_t>(0);
+  w.write<int32_t>(dl.width);
+  w.write<int32_t>(dl.height);
+  w.write<uint32_t>(dl.cmds.size());
+
+  for (const auto& cmd : dl.cmds) {
+    if (cmd.args.size() > UINT8_MAX) {
+      throw std::runtime_error("Binary display list encoding: too many args for command");
+    }
+    w.write<uint8_t>(cmd.op);
+    w.write<uint8_t>(cmd.args.size());
+
+    for (const auto& arg : cmd.args) {
+      w.write<uint8_t>(arg.type);
+      switch (arg.type) {
+        case ArgType::number:
+          w.write<double>(arg.numberValue);
+          break;
+        case ArgType::string:
+          w.writeString(arg.stringValue);
+          break;
+        case ArgType::assetRef:
+          w.writeString(arg.assetRefValue ? arg.assetRefValue->first : "");
+          w.writeString(arg.assetRefValue ? arg.assetRefValue->second : "");
+          break;
+      }
+    }
+  }
+
+  return std::move(w.data());
+}
+
+} // namespace canvex
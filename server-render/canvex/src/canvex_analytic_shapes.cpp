@@ -0,0 +1,191 @@
+#include "canvex_analytic_shapes.h"
+#include <algorithm>
+#include <cmath>
+
+namespace canvex {
+
+static bool samePoint(SkPoint a, SkPoint b) {
+  return a.fX == b.fX && a.fY == b.fY;
+}
+
+// true if b is on the axis-aligned segment from a to c
+static bool isOnSegment(SkPoint a, SkPoint b, SkPoint c) {
+  if (a.fX == b.fX && b.fX == c.fX) {
+    return b.fY >= std::min(a.fY, c.fY) && b.fY <= std::max(a.fY, c.fY);
+  }
+  if (a.fY == b.fY && b.fY == c.fY) {
+    return b.fX >= std::min(a.fX, c.fX) && b.fX <= std::max(a.fX, c.fX);
+  }
+  return false;
+}
+
+// true if the vectors point the same way along the same axis
+static bool isSameDirection(SkVector d, SkVector e) {
+  if (d.fX == 0 && e.fX == 0) return d.fY * e.fY > 0;
+  if (d.fY == 0 && e.fY == 0) return d.fX * e.fX > 0;
+  return false;
+}
+
+void AnalyticShapeTracker::reset() {
+  shapes_.clear();
+  contour_.clear();
+  analytic_ = true;
+}
+
+void AnalyticShapeTracker::addRect(const SkRect& rect) {
+  finishContour_();
+  shapes_.push_back(SkRRect::MakeRect(rect));
+}
+
+void AnalyticShapeTracker::addRRect(const SkRRect& rrect) {
+  finishContour_();
+  shapes_.push_back(rrect);
+}
+
+void AnalyticShapeTracker::moveTo(SkPoint p) {
+  finishContour_();
+  contour_.push_back({p});
+}
+
+void AnalyticShapeTracker::lineTo(SkPoint p) {
+  if (contour_.empty()) {
+    // Skia would start this segment from the last contour's start point
+    analytic_ = false;
+    return;
+  }
+  contour_.push_back({p});
+}
+
+void AnalyticShapeTracker::arcTo(SkPoint cp, SkPoint p, float radius) {
+  if (radius <= 0) {
+    // SkPath::arcTo() draws a line to the corner in this case
+    lineTo(cp);
+    return;
+  }
+  if (contour_.empty()) {
+    analytic_ = false;
+    return;
+  }
+  contour_.push_back({cp, radius, p});
+}
+
+void AnalyticShapeTracker::finishContour_() {
+  if (contour_.size() > 1 && analytic_) {
+    SkRRect rrect;
+    if (getContourShape_(rrect)) {
+      shapes_.push_back(rrect);
+    } else {
+      analytic_ = false;
+    }
+  }
+  contour_.clear();
+}
+
+bool AnalyticShapeTracker::getShapes(std::vector<SkRRect>& shapes) const {
+  if (!analytic_) return false;
+
+  shapes = shapes_;
+  if (contour_.size() > 1) {
+    SkRRect rrect;
+    if (!getContourShape_(rrect)) return false;
+    shapes.push_back(rrect);
+  }
+  return shapes.size() <= kMaxShapes;
+}
+
+bool AnalyticShapeTracker::getContourShape_(SkRRect& rrect) const {
+  // drop repeated points, including a last segment back to the start
+  std::vector<Vertex> v;
+  for (const auto& vert : contour_) {
+    if (!v.empty() && samePoint(v.back().p, vert.p)) {
+      if (vert.radius > 0 || v.back().radius > 0) return false;
+      continue;
+    }
+    v.push_back(vert);
+  }
+  while (v.size() > 1 && samePoint(v.back().p, v.front().p)) {
+    if (v.back().radius > 0) return false;
+    v.pop_back();
+  }
+
+  // remove points along the edges until only the corners are left
+  bool removed = true;
+  while (removed && v.size() > 4) {
+    removed = false;
+    for (size_t i = 0; i < v.size() && v.size() > 4; i++) {
+      const auto& prev = v[(i + v.size() - 1) % v.size()];
+      const auto& next = v[(i + 1) % v.size()];
+      if (v[i].radius == 0 && isOnSegment(prev.p, v[i].p, next.p)) {
+        v.erase(v.begin() + i);
+        removed = true;
+        i--;
+      }
+    }
+  }
+  if (v.size() != 4) return false;
+
+  // edges must alternate between horizontal and vertical
+  for (size_t i = 0; i < 4; i++) {
+    const auto a = v[i].p, b = v[(i + 1) % 4].p, c = v[(i + 2) % 4].p;
+    const bool horizontal = a.fY == b.fY && a.fX != b.fX;
+    const bool vertical = a.fX == b.fX && a.fY != b.fY;
+    const bool nextHorizontal = b.fY == c.fY && b.fX != c.fX;
+    if (horizontal == vertical || horizontal == nextHorizontal) return false;
+  }
+
+  float left = v[0].p.fX, top = v[0].p.fY, right = left, bottom = top;
+  for (const auto& corner : v) {
+    left = std::min(left, corner.p.fX);
+    top = std::min(top, corner.p.fY);
+    right = std::max(right, corner.p.fX);
+    bottom = std::max(bottom, corner.p.fY);
+  }
+  const auto rect = SkRect::MakeLTRB(left, top, right, bottom);
+
+  // in SkRRect corner order: upper left, upper right, lower right, lower left
+  float radii[4] = {0, 0, 0, 0};
+  for (size_t i = 0; i < 4; i++) {
+    const auto& corner = v[i];
+    if (corner.radius == 0) continue;
+
+    // the arc must turn towards the next corner
+    const auto next = v[(i + 1) % 4].p;
+    const SkVector arcDir = {corner.arcEnd.fX - corner.p.fX, corner.arcEnd.fY - corner.p.fY};
+    const SkVector edgeDir = {next.fX - corner.p.fX, next.fY - corner.p.fY};
+    if (!isSameDirection(arcDir, edgeDir)) return false;
+
+    const bool isLeft = corner.p.fX == left, isTop = corner.p.fY == top;
+    const int idx = isTop ? (isLeft ? 0 : 1) : (isLeft ? 3 : 2);
+    radii[idx] = corner.radius;
+  }
+
+  // radii that don't fit would give a different shape than SkRRect, which scales them down
+  const float w = right - left, h = bottom - top;
+  if (radii[0] + radii[1] > w || radii[3] + radii[2] > w ||
+      radii[0] + radii[3] > h || radii[1] + radii[2] > h) {
+    return false;
+  }
+
+  // a line ending inside a corner's arc would be a spike out of the rounded shape
+  for (const auto& vert : contour_) {
+    if (vert.radius > 0) continue;
+    for (size_t i = 0; i < 4; i++) {
+      const auto& corner = v[i];
+      if (corner.radius > 0 && std::fabs(vert.p.fX - corner.p.fX) < corner.radius
+          && std::fabs(vert.p.fY - corner.p.fY) < corner.radius) {
+        return false;
+      }
+    }
+  }
+
+  const SkVector radiiXY[4] = {
+    {radii[0], radii[0]},
+    {radii[1], radii[1]},
+    {radii[2], radii[2]},
+    {radii[3], radii[3]},
+  };
+  rrect.setRectRadii(rect, radiiXY);
+  return true;
+}
+
+} // namespace canvex
@@ -0,0 +1,61 @@
+#pragma once
+#include "skia_includes.h"
+#include <vector>
+
+namespace canvex {
+
+/*
+  Recognizes paths that are made of rects and rounded rects.
+
+  VCS components draw their boxes and clips as paths. Some are built with rect() or
+  roundRect(), while others come from the browser-style idiom of moveTo/lineTo
+  segments joined by a 90 degree arcTo at each corner. Skia only knows the shape of
+  paths made with addRect() and addRRect(), so the second kind would otherwise always
+  be scan converted as a general path, and so would paths of several shapes.
+
+  The tracker follows the path commands as they are issued, and getShapes() returns
+  the rects and rounded rects that make up the path. A contour that can't be
+  expressed exactly as one of those (a curve, a bend that isn't a corner,
+  a radius that doesn't fit its edges) makes the whole path non-analytic.
+*/
+
+class AnalyticShapeTracker {
+ public:
+  // more shapes than this are drawn as a path, the pairwise overlap tests wouldn't pay off
+  static constexpr size_t kMaxShapes = 8;
+
+  void reset();
+
+  // closed contours, as added by SkPath::addRect() and addRRect()
+  void addRect(const SkRect& rect);
+  void addRRect(const SkRRect& rrect);
+
+  void moveTo(SkPoint p);
+  void lineTo(SkPoint p);
+  void arcTo(SkPoint cp, SkPoint p, float radius);
+
+  // any other segment type
+  void addCurve() {
+    analytic_ = false;
+  }
+
+  // returns false if the path isn't made of rects and rounded rects only.
+  // an open contour is taken as implicitly closed, as it is for fill and clip.
+  bool getShapes(std::vector<SkRRect>& shapes) const;
+
+ private:
+  struct Vertex {
+    SkPoint p;
+    float radius = 0;  // for a corner from arcTo
+    SkPoint arcEnd = {0, 0};  // the arcTo end point, which only gives the direction of the next edge
+  };
+
+  std::vector<SkRRect> shapes_;
+  std::vector<Vertex> contour_;
+  bool analytic_ = true;
+
+  void finishContour_();
+  bool getContourShape_(SkRRect& rrect) const;
+};
+
+} // namespace canvex
@@ -0,0 +1,93 @@
+#include "canvex_bench_harness.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+namespace canvex {
+
+bool parseBenchArgs(int argc, char* argv[], const char* usage, BenchOptions& opts, const BenchArgFn& parseArg) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      std::cerr << "Usage: " << usage << std::endl;
+      return false;
+    } else if (arg == "-n" && i + 1 < argc) {
+      opts.numIters = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-s" && i + 1 < argc) {
+      if (sscanf(argv[++i], "%ux%u", &opts.w, &opts.h) != 2 || opts.w < 1 || opts.h < 1
+          || opts.w > 16384 || opts.h > 16384) {
+        std::cerr << "Invalid size: " << argv[i] << std::endl;
+        std::cerr << "Usage: " << usage << std::endl;
+        return false;
+      }
+    } else if (arg == "-r" && i + 1 < argc) {
+      opts.resourceDir = argv[++i];
+    } else if (parseArg && parseArg(arg, argc, argv, i)) {
+      continue;
+    } else if (!arg.empty() && arg[0] == '-') {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      std::cerr << "Usage: " << usage << std::endl;
+      return false;
+    } else {
+      opts.paths.push_back(arg);
+    }
+  }
+  return true;
+}
+
+std::vector<std::filesystem::path> listExampleDisplayLists() {
+  std::vector<std::filesystem::path> paths;
+  if (!std::filesystem::is_directory("example-data")) {
+    return paths;
+  }
+  for (auto const& entry : std::filesystem::directory_iterator{"example-data"}) {
+    if (entry.path().extension() == ".json") {
+      paths.push_back(entry.path());
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+CanvexExecutionStats renderBenchFrame(const VCSCanvasDisplayList& dl, BenchTarget& t,
+                                      CanvexSkiaResourceContext& resCtx) {
+  CanvexExecutionStats stats{};
+  if (t.clearGroupCache) resCtx.groupCache.clear();
+  RenderDisplayListToRawBuffer(dl, Rgba, t.buffer.data(), t.w, t.h, t.w * 4, CANVEX_PREMULTIPLIED,
+                               t.resourceDir, &resCtx, &stats);
+  return stats;
+}
+
+std::vector<CanvexExecutionStats> measureBenchRenders(int numIters, const VCSCanvasDisplayList& dl,
+                                                      BenchTarget& t, CanvexSkiaResourceContext& resCtx) {
+  for (int i = 0; i < t.numWarmupRenders; i++) {
+    renderBenchFrame(dl, t, resCtx);
+  }
+  std::vector<CanvexExecutionStats> stats;
+  for (int i = 0; i < numIters; i++) {
+    stats.push_back(renderBenchFrame(dl, t, resCtx));
+  }
+  return stats;
+}
+
+std::vector<double> renderTimesUs(const std::vector<CanvexExecutionStats>& stats) {
+  std::vector<double> times;
+  for (const auto& s : stats) {
+    times.push_back((double)s.render_total_us);
+  }
+  return times;
+}
+
+Percentiles computePercentiles(std::vector<double> v) {
+  if (v.empty()) {
+    return {};
+  }
+  std::sort(v.begin(), v.end());
+  auto at = [&v](double p) {
+    return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+  };
+  return {v.front(), at(0.5), at(0.9), at(0.99), v.back()};
+}
+
+} // namespace canvex
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include "canvas_display_list.h"
+#include "canvex_skia_executor.h"
+
+namespace canvex {
+
+/*
+  Shared setup for the display list render benchmarks (canvex_bench, canvex_raster_bench,
+  canvex_shapes_bench): the common command line options, rendering into a raw RGBA buffer
+  after a few warmup renders, and percentiles of the timings.
+*/
+
+// defaults, for the bench to change before parsing its arguments
+struct BenchOptions {
+  int numIters = 100;
+  uint32_t w = 1920;
+  uint32_t h = 1080;
+  std::filesystem::path resourceDir = std::filesystem::current_path() / "../../res";
+  std::vector<std::filesystem::path> paths;
+};
+
+// called with each argument that isn't a common option. returns false if it isn't one of the bench's
+// own options either, and may consume the arguments that follow by advancing i.
+using BenchArgFn = std::function<bool(const std::string& arg, int argc, char* argv[], int& i)>;
+
+// parses -n iterations, -s WxH, -r resource_dir and the input files into opts.
+// other arguments are taken as input files, unless they look like options.
+// prints the usage and returns false on an invalid or unknown option.
+bool parseBenchArgs(int argc, char* argv[], const char* usage, BenchOptions& opts,
+                    const BenchArgFn& parseArg = nullptr);
+
+// the JSON files in example-data, sorted by name
+std::vector<std::filesystem::path> listExampleDisplayLists();
+
+struct BenchTarget {
+  std::vector<uint8_t> buffer; // RGBA
+  uint32_t w;
+  uint32_t h;
+  std::filesystem::path resourceDir;
+
+  // cleared before every render by default, so the commands are executed each time
+  // as they are for changing content
+  bool clearGroupCache = true;
+  int numWarmupRenders = 3;
+
+  BenchTarget(uint32_t w, uint32_t h, const std::filesystem::path& resourceDir)
+    : buffer((size_t)w * h * 4), w(w), h(h), resourceDir(resourceDir) {}
+};
+
+CanvexExecutionStats renderBenchFrame(const VCSCanvasDisplayList& dl, BenchTarget& t,
+                                      CanvexSkiaResourceContext& resCtx);
+
+// stats of numIters renders, after the target's warmup renders
+std::vector<CanvexExecutionStats> measureBenchRenders(int numIters, const VCSCanvasDisplayList& dl,
+                                                      BenchTarget& t, CanvexSkiaResourceContext& resCtx);
+
+// render_total_us of each render
+std::vector<double> renderTimesUs(const std::vector<CanvexExecutionStats>& stats);
+
+struct Percentiles {
+  double min;
+  double p50;
+  double p90;
+  double p99;
+  double max;
+};
+
+Percentiles computePercentiles(std::vector<double> v);
+
+} // namespace canvex
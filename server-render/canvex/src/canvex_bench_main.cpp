@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "canvex_bench_harness.h"
+#include "file_util.h"
+
+/*
+  Display list execution benchmark.
+
+  Runs each example-data display list and a set of synthetic stress lists (many texts,
+  many images, deeply nested save/restore, nested rounded clips) for many iterations
+  on a warm resource context, and prints parse and raster time percentiles.
+
+  The group cache is cleared before every render by default, so the commands are executed
+  each time as they are for changing content. Pass -g to keep it and measure cached replay instead.
+
+  Per-opcode cost is measured by ablation: for each drawing op type in the list, the list is rendered
+  again with those commands replaced by noops, and the time saved is the op's marginal cost.
+  State, path and clip ops (save, translate, moveTo, clip, ...) can't be left out without changing
+  what's drawn, so their cost is only included in the remainder.
+
+  With -p, the executor's own opcode profiler is also turned on, and the per-op totals and slowest
+  commands of the last raster iteration are printed. These are direct timings, so they cover every op,
+  but not the work Skia defers past the command (e.g. clips applied when a later draw is rasterized).
+
+  Usage:
+    canvex_bench [-n iterations] [-s WxH] [-N synthetic_count] [-r resource_dir] [-g] [-p] [--no-ops]
+                 [--synthetic-only] [file.json ...]
+
+  The default output size is 1920x1080, and display lists are scaled to fill it.
+  With no files given, all JSON files in example-data are used.
+*/
+
+using namespace canvex;
+
+static const char* kUsage =
+  "canvex_bench [-n iterations] [-s WxH] [-N synthetic_count] [-r resource_dir] [-g] [-p] [--no-ops]\n"
+  "             [--synthetic-only] [file.json ...]";
+
+// ops that only draw, so they can be replaced with noops without changing what the other ops draw.
+// clip is left out: without it, the draws it bounded cover more pixels and cost more.
+constexpr OpType kAblatedOps[] = {
+  fill, stroke, fillRect, strokeRect, fillText, fillText_emoji, strokeText, drawImage,
+};
+
+static double elapsedUs(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+}
+
+struct BenchInput {
+  std::string name;
+  std::string json;
+};
+
+// -- synthetic stress lists --
+
+static void beginList(std::stringstream& ss) {
+  ss << "{\"width\":1920,\"height\":1080,\"commands\":[[\"save\"]";
+}
+
+static std::string endList(std::stringstream& ss) {
+  ss << ",[\"restore\"]]}";
+  return ss.str();
+}
+
+static BenchInput makeTextsList(int n) {
+  std::stringstream ss;
+  beginList(ss);
+  ss << ",[\"font\",[\"600\",\"\",24,\"Roboto\"]],[\"fillStyle\",\"rgba(255, 255, 255, 0.9)\"]";
+  for (int i = 0; i < n; i++) {
+    ss << ",[\"fillText\",[\"Participant " << i << "\"," << (i % 10) * 190 << "," << 30 + (i / 10 % 35) * 30 << "]]";
+  }
+  return {"synthetic-texts-" + std::to_string(n), endList(ss)};
+}
+
+static BenchInput makeImagesList(int n) {
+  std::stringstream ss;
+  beginList(ss);
+  for (int i = 0; i < n; i++) {
+    const int size = 40 + (i % 5) * 20;
+    ss << ",[\"drawImage\",[{\"type\":\"defaultAsset\",\"id\":\"test_square_320px.png\"},"
+       << (i * 97) % 1800 << "," << (i * 53) % 980 << "," << size << "," << size << "]]";
+  }
+  return {"synthetic-images-" + std::to_string(n), endList(ss)};
+}
+
+static BenchInput makeSaveRestoreList(int n) {
+  std::stringstream ss;
+  beginList(ss);
+  for (int i = 0; i < n; i++) {
+    ss << ",[\"save\"],[\"translate\",[3,2]],[\"globalAlpha\",0.99]"
+       << ",[\"fillStyle\",\"rgba(" << i % 256 << ", 120, 200, 0.5)\"],[\"fillRect\",[0,0,40,40]]";
+  }
+  for (int i = 0; i < n; i++) {
+    ss << ",[\"restore\"]";
+  }
+  return {"synthetic-save-restore-" + std::to_string(n), endList(ss)};
+}
+
+static BenchInput makeClipsList(int n) {
+  std::stringstream ss;
+  beginList(ss);
+  ss << ",[\"fillStyle\",\"rgba(40, 200, 120, 0.3)\"]";
+  for (int i = 0; i < n; i++) {
+    const double inset = (double)i * 500 / n;
+    ss << ",[\"save\"],[\"beginPath\"],[\"roundRect\",[" << inset << "," << inset / 2 << ","
+       << 1920 - 2 * inset << "," << 1080 - inset << ",30,30,30,30]],[\"clip\"]"
+       << ",[\"fillRect\",[0,0,1920,1080]]";
+  }
+  for (int i = 0; i < n; i++) {
+    ss << ",[\"restore\"]";
+  }
+  return {"synthetic-clips-" + std::to_string(n), endList(ss)};
+}
+
+// --
+
+static std::vector<double> measureRenders(int numIters, const VCSCanvasDisplayList& dl,
+                                          BenchTarget& t, CanvexSkiaResourceContext& resCtx) {
+  return renderTimesUs(measureBenchRenders(numIters, dl, t, resCtx));
+}
+
+static void printPercentiles(const char* label, const Percentiles& p) {
+  std::cout << "  " << std::left << std::setw(8) << label << std::right
+            << " p50 " << std::setw(9) << p.p50 << " us, p90 " << std::setw(9) << p.p90
+            << " us, p99 " << std::setw(9) << p.p99 << " us, max " << std::setw(9) << p.max << " us" << std::endl;
+}
+
+static void printOpProfile(const CanvexOpProfile& profile) {
+  std::cout << "    profiled:" << std::endl;
+  for (int op = 0; op < profile.num_ops; op++) {
+    const auto& totals = profile.ops[op];
+    if (totals.count == 0) continue;
+    std::cout << "    " << std::left << std::setw(16) << GetOpTypeName((OpType)op) << std::right
+              << std::setw(6) << totals.count << " cmds " << std::setw(9) << totals.total_ns / 1000.0
+              << " us total, " << std::setw(8) << totals.total_ns / 1000.0 / totals.count << " us/cmd" << std::endl;
+  }
+  if (profile.group_replays.count > 0) {
+    std::cout << "    " << std::left << std::setw(16) << "(group replay)" << std::right
+              << std::setw(6) << profile.group_replays.count << " grps " << std::setw(9)
+              << profile.group_replays.total_ns / 1000.0 << " us total" << std::endl;
+  }
+  std::cout << "    slowest:" << std::endl;
+  for (int i = 0; i < std::min(profile.num_slowest, 5); i++) {
+    const auto& slow = profile.slowest[i];
+    std::cout << "    #" << std::left << std::setw(6) << slow.cmd_index << std::setw(16) << GetOpTypeName((OpType)slow.op)
+              << std::right << std::setw(9) << slow.ns / 1000.0 << " us  " << slow.args << std::endl;
+  }
+}
+
+static void benchInput(const BenchInput& input, int numIters, bool measureOps,
+                       BenchTarget& t, CanvexSkiaResourceContext& resCtx) {
+  std::unique_ptr<VCSCanvasDisplayList> dl;
+  std::vector<double> parseTimes;
+  try {
+    for (int i = 0; i < numIters; i++) {
+      const auto t0 = std::chrono::steady_clock::now();
+      dl = ParseVCSDisplayListJSON(input.json);
+      parseTimes.push_back(elapsedUs(t0));
+    }
+  } catch (std::exception& e) {
+    std::cerr << "Skipping " << input.name << ": " << e.what() << std::endl;
+    return;
+  }
+
+  int opCounts[numOpTypes] = {};
+  for (const auto& cmd : dl->cmds) {
+    opCounts[cmd.op]++;
+  }
+
+  const auto rasterTimes = measureRenders(numIters, *dl, t, resCtx);
+  const auto rasterP = computePercentiles(rasterTimes);
+
+  std::cout << input.name << " (" << dl->cmds.size() << " cmds, " << input.json.size() << " bytes):" << std::endl;
+  printPercentiles("parse", computePercentiles(parseTimes));
+  printPercentiles("raster", rasterP);
+
+  if (resCtx.opProfilingEnabled) {
+    CanvexOpProfile profile;
+    resCtx.opProfiler.getProfile(profile);
+    printOpProfile(profile);
+  }
+
+  if (!measureOps) return;
+
+  double attributedUs = 0.0;
+  for (OpType op : kAblatedOps) {
+    if (opCounts[op] == 0) continue;
+
+    VCSCanvasDisplayList ablated = *dl;
+    for (auto& cmd : ablated.cmds) {
+      if (cmd.op == op) cmd.op = noop;
+    }
+    const double ablatedP50 = computePercentiles(measureRenders(numIters, ablated, t, resCtx)).p50;
+    const double costUs = std::max(0.0, rasterP.p50 - ablatedP50);
+    attributedUs += costUs;
+
+    std::cout << "    " << std::left << std::setw(16) << GetOpTypeName(op) << std::right
+              << std::setw(6) << opCounts[op] << " cmds " << std::setw(9) << costUs << " us total, "
+              << std::setw(8) << costUs / opCounts[op] << " us/cmd" << std::endl;
+  }
+  std::cout << "    " << std::left << std::setw(16) << "(remainder)" << std::right
+            << "            " << std::setw(9) << std::max(0.0, rasterP.p50 - attributedUs) << " us" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  BenchOptions opts;
+  int synthCount = 200;
+  bool keepGroupCache = false;
+  bool measureOps = true;
+  bool profileOps = false;
+  bool synthOnly = false;
+
+  auto parseArg = [&](const std::string& arg, int argc, char* argv[], int& i) {
+    if (arg == "-N" && i + 1 < argc) {
+      synthCount = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-g") {
+      keepGroupCache = true;
+    } else if (arg == "-p") {
+      profileOps = true;
+    } else if (arg == "--no-ops") {
+      measureOps = false;
+    } else if (arg == "--synthetic-only") {
+      synthOnly = true;
+    } else {
+      return false;
+    }
+    return true;
+  };
+  if (!parseBenchArgs(argc, argv, kUsage, opts, parseArg)) {
+    return 1;
+  }
+  if (opts.paths.empty() && !synthOnly) {
+    opts.paths = listExampleDisplayLists();
+  }
+
+  std::vector<BenchInput> inputs;
+  for (const auto& path : opts.paths) {
+    try {
+      inputs.push_back({path.filename().string(), readTextFile(path.string())});
+    } catch (std::exception& e) {
+      std::cerr << "Skipping " << path << ": " << e.what() << std::endl;
+    }
+  }
+  inputs.push_back(makeTextsList(synthCount));
+  inputs.push_back(makeImagesList(synthCount));
+  inputs.push_back(makeSaveRestoreList(synthCount));
+  inputs.push_back(makeClipsList(std::min(synthCount, 50)));
+
+  std::cout << "Display list execution benchmark, " << opts.w << "x" << opts.h << ", " << opts.numIters
+            << " iterations per list, group cache " << (keepGroupCache ? "kept" : "cleared") << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+
+  BenchTarget target(opts.w, opts.h, opts.resourceDir);
+  target.clearGroupCache = !keepGroupCache;
+
+  // shared by all lists, so fonts and images are loaded once and every list renders on a warm context
+  CanvexSkiaResourceContext resCtx;
+  resCtx.opProfilingEnabled = profileOps;
+
+  for (const auto& input : inputs) {
+    benchInput(input, opts.numIters, measureOps, target, resCtx);
+  }
+  return 0;
+}
@@ -2,6 +2,7 @@
 
 // internal C++ API
 #include "canvas_display_list.h"
+#include "canvex_skia_caches.h"
 #include "canvex_skia_executor.h"
 #include "canvex_skia_resource_context.h"
 #include "file_util.h"
@@ -9,6 +10,7 @@
 
 #include "skia_includes.h"
 
+#include <algorithm>
 #include <iostream>
 #include <string.h>
 
@@ -18,7 +20,7 @@ using namespace canvex;
 namespace canvex::c_api_internal {
 
 struct ResourceCtx {
-  ResourceCtx(const char* adir) {
+  ResourceCtx(const char* adir, const char* preloadManifest = nullptr) {
     if (adir && strlen(adir) > 0) {
       resourceDir = adir;
       std::cout << "ResourceCtx set up using given path: " << resourceDir << std::endl;
@@ -26,6 +28,10 @@ struct ResourceCtx {
       resourceDir = std::filesystem::current_path() / "../../res";
       std::cout << "ResourceCtx set up using default relative path: " << resourceDir << std::endl;
     }
+    if (preloadManifest && strlen(preloadManifest) > 0) {
+      const int n = skiaResourceCtx.preloadMappedFiles(preloadManifest, resourceDir);
+      std::cout << "ResourceCtx mapped " << n << " files from preload manifest: " << preloadManifest << std::endl;
+    }
   }
 
   std::filesystem::path resourceDir;
@@ -42,16 +48,308 @@ CanvexResourceCtx CanvexResourceCtxCreate(
   return static_cast<void*>(ctx);
 }
 
+CanvexResourceCtx CanvexResourceCtxCreateWithPreloadManifest(
+  const char *resourceDir,
+  const char *manifestPath
+) {
+  auto ctx = new canvex::c_api_internal::ResourceCtx(resourceDir, manifestPath);
+  return static_cast<void*>(ctx);
+}
+
 void CanvexResourceCtxDestroy(CanvexResourceCtx ctx_c) {
   auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
   delete ctx;
 }
 
+int CanvexResourceCtxGetMemoryStats(
+  CanvexResourceCtx ctx_c,
+  CanvexMemoryStats *stats
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx || !stats) return -1;
+
+  auto& skiaResCtx = ctx->skiaResourceCtx;
+  memset(stats, 0, sizeof(CanvexMemoryStats));
+
+  stats->mapped_file_bytes = skiaResCtx.mappedFiles.mappedBytes();
+  stats->num_mapped_files = skiaResCtx.mappedFiles.numFiles();
+  if (skiaResCtx.sharedCache) {
+    stats->mapped_file_bytes += skiaResCtx.sharedCache->mappedFileBytes();
+    stats->num_mapped_files += skiaResCtx.sharedCache->numMappedFiles();
+  }
+  stats->image_cache_bytes = skiaResCtx.imageCacheBytes();
+  stats->group_cache_bytes = skiaResCtx.groupCache.totalBytes();
+  stats->emoji_atlas_bytes = skiaResCtx.emojiAtlas.getStats().bytes;
+
+  const auto usage = GetProcessMemoryUsage();
+  stats->process_rss_bytes = usage.rssBytes;
+  stats->process_shared_bytes = usage.sharedBytes;
+  stats->process_private_bytes = usage.privateBytes;
+  return 0;
+}
+
+void CanvexResourceCtxSetImageLoadPolicy(
+  CanvexResourceCtx ctx_c,
+  CanvexImageLoadPolicy policy,
+  int32_t numDecodeThreads
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx) return;
+
+  auto& skiaResCtx = ctx->skiaResourceCtx;
+  switch (policy) {
+    case CanvexImageLoad_Block:
+      skiaResCtx.imageLoadPolicy = ImageLoadPolicy::Block;
+      break;
+    case CanvexImageLoad_Skip:
+      skiaResCtx.imageLoadPolicy = ImageLoadPolicy::Skip;
+      break;
+    case CanvexImageLoad_Placeholder:
+      skiaResCtx.imageLoadPolicy = ImageLoadPolicy::Placeholder;
+      break;
+  }
+  skiaResCtx.numImageDecodeThreads = (numDecodeThreads > 0) ? numDecodeThreads : ImageDecodePool::kDefaultNumThreads;
+}
+
+void CanvexResourceCtxSetRasterBands(
+  CanvexResourceCtx ctx_c,
+  int32_t numBands
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx) return;
+
+  ctx->skiaResourceCtx.numRasterBands = std::clamp(numBands, 1, kMaxRasterBands);
+}
+
+void CanvexResourceCtxSetAnalyticShapes(
+  CanvexResourceCtx ctx_c,
+  int enabled
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx) return;
+
+  ctx->skiaResourceCtx.useAnalyticShapes = enabled != 0;
+}
+
+void CanvexResourceCtxSetOpProfiling(
+  CanvexResourceCtx ctx_c,
+  int enabled
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx) return;
+
+  ctx->skiaResourceCtx.opProfilingEnabled = enabled != 0;
+  ctx->skiaResourceCtx.opProfiler.reset();
+}
+
+int CanvexResourceCtxGetOpProfile(
+  CanvexResourceCtx ctx_c,
+  CanvexOpProfile *profile
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx || !profile || !ctx->skiaResourceCtx.opProfilingEnabled) return -1;
+
+  ctx->skiaResourceCtx.opProfiler.getProfile(*profile);
+  return 0;
+}
+
+int CanvexResourceCtxHasNewShmFrames(
+  CanvexResourceCtx ctx_c
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx) return 0;
+
+  return ctx->skiaResourceCtx.hasNewShmFrames() ? 1 : 0;
+}
+
+const char* CanvexGetOpName(
+  int32_t op
+) {
+  return GetOpTypeName((OpType)op);
+}
+
+CanvexSharedResourceCache CanvexSharedResourceCacheCreate(
+  int64_t maxImageBytes
+) {
+  const size_t maxBytes = (maxImageBytes > 0) ? (size_t)maxImageBytes : ImageCache::kDefaultMaxBytes;
+  auto cache = new std::shared_ptr<SharedResourceCache>(std::make_shared<SharedResourceCache>(maxBytes));
+  return static_cast<void*>(cache);
+}
+
+void CanvexSharedResourceCacheDestroy(CanvexSharedResourceCache cache_c) {
+  auto cache = static_cast<std::shared_ptr<SharedResourceCache>*>(cache_c);
+  delete cache;
+}
+
+void CanvexResourceCtxAttachSharedCache(
+  CanvexResourceCtx ctx_c,
+  CanvexSharedResourceCache cache_c
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx) return;
+
+  auto cache = static_cast<std::shared_ptr<SharedResourceCache>*>(cache_c);
+  ctx->skiaResourceCtx.setSharedCache(cache ? *cache : nullptr);
+}
+
+int CanvexResourceCtxPrefetchImage(
+  CanvexResourceCtx ctx_c,
+  const char *assetType,
+  const char *imageName,
+  uint32_t drawW,
+  uint32_t drawH
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx || !assetType || !imageName || strlen(imageName) < 1) return -1;
+
+  auto type = ImageSourceTypeFromString(assetType);
+  if (!type) {
+    std::cerr << "** Unknown asset type for image prefetch: " << assetType << std::endl;
+    return -1;
+  }
+
+  ImageDrawSize drawSize{{(float)drawW, (float)drawH}, SkRect::MakeEmpty()};
+  if (drawW == 0 || drawH == 0) {
+    // no size given, so decode at full resolution
+    drawSize.devSize = {1.0e9f, 1.0e9f};
+  }
+
+  const bool ok = ctx->skiaResourceCtx.prefetchImage(ctx->resourceDir, *type, imageName, drawSize);
+  return ok ? 0 : -1;
+}
+
+int CanvexResourceCtxPreload(
+  CanvexResourceCtx ctx_c,
+  const CanvexPreloadFont *fonts,
+  size_t numFonts,
+  const CanvexPreloadImage *images,
+  size_t numImages
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx || (numFonts > 0 && !fonts) || (numImages > 0 && !images)) return -1;
+
+  std::vector<FontKey> fontKeys;
+  for (size_t i = 0; i < numFonts; i++) {
+    if (!fonts[i].family) return -1;
+    fontKeys.push_back({fonts[i].family, fonts[i].weight, fonts[i].italic != 0});
+  }
+
+  std::vector<PreloadImageRequest> imageRequests;
+  int numInvalidImages = 0;
+  for (size_t i = 0; i < numImages; i++) {
+    const auto& image = images[i];
+    if (!image.asset_type || !image.name || strlen(image.name) < 1) return -1;
+
+    auto type = ImageSourceTypeFromString(image.asset_type);
+    if (!type) {
+      std::cerr << "** Unknown asset type for image preload: " << image.asset_type << std::endl;
+      numInvalidImages++;
+      continue;
+    }
+    ImageDrawSize drawSize{{(float)image.draw_w, (float)image.draw_h}, SkRect::MakeEmpty()};
+    if (image.draw_w == 0 || image.draw_h == 0) {
+      drawSize.devSize = {1.0e9f, 1.0e9f};
+    }
+    imageRequests.push_back({*type, image.name, drawSize});
+  }
+
+  auto& skiaResCtx = ctx->skiaResourceCtx;
+  skiaResCtx.preload(fontKeys, imageRequests, ctx->resourceDir);
+  skiaResCtx.numFailedImagePreloads += numInvalidImages;
+  return 0;
+}
+
+int CanvexResourceCtxGetPreloadStatus(
+  CanvexResourceCtx ctx_c,
+  CanvexPreloadStatus *status
+) {
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx || !status) return -1;
+
+  const auto s = ctx->skiaResourceCtx.getPreloadStatus();
+  status->num_pending = s.numPending;
+  status->num_ready = s.numReady;
+  status->num_failed = s.numFailed;
+  return 0;
+}
+
+void CanvexSetSkiaCacheLimits(
+  int64_t fontCacheBytes,
+  int32_t fontCacheCount,
+  int64_t resourceCacheBytes
+) {
+  SetSkiaCacheLimits(std::max<int64_t>(fontCacheBytes, 0), std::max(fontCacheCount, 0),
+                     std::max<int64_t>(resourceCacheBytes, 0));
+}
+
+int CanvexGetSkiaCacheStats(
+  CanvexSkiaCacheStats *stats
+) {
+  if (!stats) return -1;
+
+  const auto s = GetSkiaCacheStats();
+  memset(stats, 0, sizeof(CanvexSkiaCacheStats));
+  stats->font_cache_bytes_used = s.fontCacheBytesUsed;
+  stats->font_cache_bytes_limit = s.fontCacheBytesLimit;
+  stats->font_cache_count_used = s.fontCacheCountUsed;
+  stats->font_cache_count_limit = s.fontCacheCountLimit;
+  stats->resource_cache_bytes_used = s.resourceCacheBytesUsed;
+  stats->resource_cache_bytes_limit = s.resourceCacheBytesLimit;
+  stats->text_blob_cache_hits = s.textBlobHits;
+  stats->text_blob_cache_misses = s.textBlobMisses;
+  stats->font_cache_hits = s.fontHits;
+  stats->font_cache_misses = s.fontMisses;
+  stats->num_purges = s.numPurges;
+  return 0;
+}
+
+void CanvexPurgeSkiaCaches(void) {
+  PurgeSkiaCaches();
+}
+
+
+// dataSize is zero for null-terminated JSON
+static CanvexRenderResult parseDisplayListData(
+  const uint8_t *data,
+  size_t dataSize,
+  std::unique_ptr<VCSCanvasDisplayList>& displayList
+) {
+  const bool isBinary = IsVCSDisplayListBinary(data, dataSize);
+  try {
+    if (isBinary) {
+      displayList = ParseVCSDisplayListBinary(data, dataSize);
+    } else if (dataSize == 0) {
+      displayList = ParseVCSDisplayListJSON(reinterpret_cast<const char*>(data));
+    } else {
+      displayList = ParseVCSDisplayListJSON(reinterpret_cast<const char*>(data), dataSize);
+    }
+  } catch (std::exception& e) {
+    if (isBinary) {
+      std::cerr << "Unable to parse canvex binary display list: "<< e.what() << std::endl;
+      return CanvexRenderError_BinaryParseFail;
+    }
+    std::cerr << "Unable to parse canvex display list JSON: "<< e.what() << std::endl;
+    return CanvexRenderError_JSONParseFail;
+  }
+  return CanvexRenderSuccess;
+}
+
+static bool isValidImageOutput(
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes
+) {
+  return dstImageData && dstImageW >= 1 && dstImageH >= 1
+    && (dstImageRowBytes == 0 || dstImageRowBytes >= dstImageW*4);
+}
 
-static CanvexRenderResult CanvexRenderJSON_Raw(
+// dataSize is zero for null-terminated JSON
+static CanvexRenderResult CanvexRenderDisplayList_Raw(
   CanvexResourceCtx ctx_c,
   canvex::RenderFormat format,
-  const char *json,
+  const uint8_t *data,
+  size_t dataSize,
   uint8_t *dstImageData,
   uint32_t dstImageW,
   uint32_t dstImageH,
@@ -59,12 +357,10 @@ static CanvexRenderResult CanvexRenderJSON_Raw(
   CanvexAlphaMode dstAlpha,
   CanvexExecutionStats* stats // optional stats
 ) {
-  if (!json) {
+  if (!data) {
     return CanvexRenderError_InvalidArgument_JSONInput;
   }
-  if (!dstImageData ||
-      dstImageW < 1 || dstImageH < 1 ||
-      (dstImageRowBytes != 0 && dstImageRowBytes < dstImageW*4)) {
+  if (!isValidImageOutput(dstImageData, dstImageW, dstImageH, dstImageRowBytes)) {
     return CanvexRenderError_InvalidArgument_ImageOutput;
   }
   if (dstImageRowBytes == 0) {
@@ -79,11 +375,9 @@ static CanvexRenderResult CanvexRenderJSON_Raw(
   double t0 = getMonotonicTime();
 
   std::unique_ptr<VCSCanvasDisplayList> displayList;
-  try {
-    displayList = ParseVCSDisplayListJSON(json);
-  } catch (std::exception& e) {
-    std::cerr << "Unable to parse canvex display list JSON: "<< e.what() << std::endl;
-    return CanvexRenderError_JSONParseFail;
+  auto parseResult = parseDisplayListData(data, dataSize, displayList);
+  if (parseResult != CanvexRenderSuccess) {
+    return parseResult;
   }
 
   double t1 = getMonotonicTime();
@@ -113,8 +407,8 @@ CanvexRenderResult CanvexRenderJSON_RGBA(
   CanvexAlphaMode dstAlpha,
   CanvexExecutionStats* stats // optional stats
 ) {
-  return CanvexRenderJSON_Raw(
-      ctx_c, canvex::RenderFormat::Rgba, json, dstImageData, dstImageW, dstImageH, dstImageRowBytes, dstAlpha, stats
+  return CanvexRenderDisplayList_Raw(
+      ctx_c, canvex::RenderFormat::Rgba, reinterpret_cast<const uint8_t*>(json), 0, dstImageData, dstImageW, dstImageH, dstImageRowBytes, dstAlpha, stats
   );
 }
 
@@ -128,8 +422,313 @@ CanvexRenderResult CanvexRenderJSON_BGRA(
   CanvexAlphaMode dstAlpha,
   CanvexExecutionStats* stats // optional stats
 ) {
-  return CanvexRenderJSON_Raw(
-      ctx_c, canvex::RenderFormat::Bgra, json, dstImageData, dstImageW, dstImageH, dstImageRowBytes, dstAlpha, stats
+  return CanvexRenderDisplayList_Raw(
+      ctx_c, canvex::RenderFormat::Bgra, reinterpret_cast<const uint8_t*>(json), 0, dstImageData, dstImageW, dstImageH, dstImageRowBytes, dstAlpha, stats
+  );
+}
+
+CanvexRenderResult CanvexRenderDisplayList_RGBA(
+  CanvexResourceCtx ctx_c,
+  const uint8_t *data,
+  size_t dataSize,
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes,
+  CanvexAlphaMode dstAlpha,
+  CanvexExecutionStats* stats // optional stats
+) {
+  if (dataSize == 0) {
+    return CanvexRenderError_InvalidArgument_JSONInput;
+  }
+  return CanvexRenderDisplayList_Raw(
+      ctx_c, canvex::RenderFormat::Rgba, data, dataSize, dstImageData, dstImageW, dstImageH, dstImageRowBytes, dstAlpha, stats
+  );
+}
+
+CanvexRenderResult CanvexRenderDisplayList_BGRA(
+  CanvexResourceCtx ctx_c,
+  const uint8_t *data,
+  size_t dataSize,
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes,
+  CanvexAlphaMode dstAlpha,
+  CanvexExecutionStats* stats // optional stats
+) {
+  if (dataSize == 0) {
+    return CanvexRenderError_InvalidArgument_JSONInput;
+  }
+  return CanvexRenderDisplayList_Raw(
+      ctx_c, canvex::RenderFormat::Bgra, data, dataSize, dstImageData, dstImageW, dstImageH, dstImageRowBytes, dstAlpha, stats
+  );
+}
+
+
+CanvexDamageTracker CanvexDamageTrackerCreate() {
+  auto tracker = new canvex::DamageTracker();
+  return static_cast<void*>(tracker);
+}
+
+void CanvexDamageTrackerDestroy(CanvexDamageTracker tracker_c) {
+  auto tracker = static_cast<canvex::DamageTracker*>(tracker_c);
+  delete tracker;
+}
+
+void CanvexDamageTrackerInvalidate(CanvexDamageTracker tracker_c) {
+  auto tracker = static_cast<canvex::DamageTracker*>(tracker_c);
+  if (tracker) {
+    tracker->invalidate();
+  }
+}
+
+static CanvexRenderResult CanvexRenderDisplayListIncremental_Raw(
+  CanvexResourceCtx ctx_c,
+  CanvexDamageTracker tracker_c,
+  canvex::RenderFormat format,
+  const uint8_t *data,
+  size_t dataSize,
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes,
+  CanvexAlphaMode dstAlpha,
+  CanvexDamageRegion* dstDamage, // optional
+  CanvexExecutionStats* stats // optional stats
+) {
+  if (!data || dataSize == 0) {
+    return CanvexRenderError_InvalidArgument_JSONInput;
+  }
+  if (!isValidImageOutput(dstImageData, dstImageW, dstImageH, dstImageRowBytes)) {
+    return CanvexRenderError_InvalidArgument_ImageOutput;
+  }
+  if (dstImageRowBytes == 0) {
+    dstImageRowBytes = dstImageW*4;
+  }
+
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx) {
+    return CanvexRenderError_InvalidArgument_ResourceContext;
+  }
+  auto tracker = static_cast<canvex::DamageTracker*>(tracker_c);
+  if (!tracker) {
+    return CanvexRenderError_InvalidArgument_DamageTracker;
+  }
+
+  double t0 = getMonotonicTime();
+
+  std::unique_ptr<VCSCanvasDisplayList> displayList;
+  auto parseResult = parseDisplayListData(data, dataSize, displayList);
+  if (parseResult != CanvexRenderSuccess) {
+    // the caller's buffer is in an unknown state if they go on to use it for something else
+    tracker->invalidate();
+    return parseResult;
+  }
+
+  double t1 = getMonotonicTime();
+  if (stats) {
+    memset(stats, 0, sizeof(CanvexExecutionStats));
+    stats->json_parse_us = (t1 - t0) * 1.0e6;
+  }
+
+  std::vector<SkIRect> damageRects;
+  if (!RenderDisplayListToRawBufferIncremental(*displayList, format,
+    dstImageData, dstImageW, dstImageH, dstImageRowBytes, dstAlpha,
+    ctx->resourceDir,
+    &ctx->skiaResourceCtx,
+    *tracker,
+    damageRects,
+    stats)) {
+    tracker->invalidate();
+    return CanvexRenderError_GraphicsUnspecifiedError;
+  }
+
+  if (dstDamage) {
+    dstDamage->num_rects = std::min(damageRects.size(), (size_t)CANVEX_MAX_DAMAGE_RECTS);
+    for (int i = 0; i < dstDamage->num_rects; i++) {
+      const auto& r = damageRects[i];
+      dstDamage->rects[i] = {r.x(), r.y(), r.width(), r.height()};
+    }
+  }
+
+  return CanvexRenderSuccess;
+}
+
+CanvexRenderResult CanvexRenderDisplayListIncremental_RGBA(
+  CanvexResourceCtx ctx_c,
+  CanvexDamageTracker tracker_c,
+  const uint8_t *data,
+  size_t dataSize,
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes,
+  CanvexAlphaMode dstAlpha,
+  CanvexDamageRegion* dstDamage, // optional
+  CanvexExecutionStats* stats // optional stats
+) {
+  return CanvexRenderDisplayListIncremental_Raw(
+      ctx_c, tracker_c, canvex::RenderFormat::Rgba, data, dataSize, dstImageData, dstImageW, dstImageH, dstImageRowBytes, dstAlpha, dstDamage, stats
+  );
+}
+
+CanvexRenderResult CanvexRenderDisplayListIncremental_BGRA(
+  CanvexResourceCtx ctx_c,
+  CanvexDamageTracker tracker_c,
+  const uint8_t *data,
+  size_t dataSize,
+  uint8_t *dstImageData,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  uint32_t dstImageRowBytes,
+  CanvexAlphaMode dstAlpha,
+  CanvexDamageRegion* dstDamage, // optional
+  CanvexExecutionStats* stats // optional stats
+) {
+  return CanvexRenderDisplayListIncremental_Raw(
+      ctx_c, tracker_c, canvex::RenderFormat::Bgra, data, dataSize, dstImageData, dstImageW, dstImageH, dstImageRowBytes, dstAlpha, dstDamage, stats
+  );
+}
+
+// Fills in default row bytes. Returns false if the buffer isn't usable for an image of the given size.
+static bool resolveI420AOutput(
+  const CanvexI420ABuffer *dstImage,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  CanvexI420ABuffer& resolved
+) {
+  if (!dstImage || !dstImage->y || !dstImage->cb || !dstImage->cr || !dstImage->a
+      || dstImageW < 1 || dstImageH < 1) {
+    return false;
+  }
+  resolved = *dstImage;
+  const uint32_t chromaW = (dstImageW + 1) / 2;
+  if (resolved.row_bytes_y == 0) resolved.row_bytes_y = dstImageW;
+  if (resolved.row_bytes_ch == 0) resolved.row_bytes_ch = chromaW;
+  if (resolved.row_bytes_a == 0) resolved.row_bytes_a = dstImageW;
+
+  return resolved.row_bytes_y >= dstImageW && resolved.row_bytes_ch >= chromaW
+    && resolved.row_bytes_a >= dstImageW;
+}
+
+// dataSize is zero for null-terminated JSON. tracker is optional.
+static CanvexRenderResult CanvexRenderDisplayList_YuvA(
+  CanvexResourceCtx ctx_c,
+  canvex::DamageTracker* tracker,
+  const uint8_t *data,
+  size_t dataSize,
+  const CanvexI420ABuffer *dstImage,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  CanvexYuvColorMatrix colorMatrix,
+  CanvexDamageRegion* dstDamage, // optional
+  CanvexExecutionStats* stats // optional stats
+) {
+  if (!data) {
+    return CanvexRenderError_InvalidArgument_JSONInput;
+  }
+  CanvexI420ABuffer dst;
+  if (!resolveI420AOutput(dstImage, dstImageW, dstImageH, dst)) {
+    return CanvexRenderError_InvalidArgument_ImageOutput;
+  }
+
+  auto ctx = static_cast<canvex::c_api_internal::ResourceCtx*>(ctx_c);
+  if (!ctx) {
+    return CanvexRenderError_InvalidArgument_ResourceContext;
+  }
+
+  double t0 = getMonotonicTime();
+
+  std::unique_ptr<VCSCanvasDisplayList> displayList;
+  auto parseResult = parseDisplayListData(data, dataSize, displayList);
+  if (parseResult != CanvexRenderSuccess) {
+    if (tracker) tracker->invalidate();
+    return parseResult;
+  }
+
+  double t1 = getMonotonicTime();
+  if (stats) {
+    memset(stats, 0, sizeof(CanvexExecutionStats));
+    stats->json_parse_us = (t1 - t0) * 1.0e6;
+  }
+
+  std::vector<SkIRect> damageRects;
+  if (!RenderDisplayListToI420A(*displayList,
+    dst, dstImageW, dstImageH, colorMatrix,
+    ctx->resourceDir,
+    &ctx->skiaResourceCtx,
+    tracker,
+    damageRects,
+    stats)) {
+    if (tracker) tracker->invalidate();
+    return CanvexRenderError_GraphicsUnspecifiedError;
+  }
+
+  if (dstDamage) {
+    dstDamage->num_rects = std::min(damageRects.size(), (size_t)CANVEX_MAX_DAMAGE_RECTS);
+    for (int i = 0; i < dstDamage->num_rects; i++) {
+      const auto& r = damageRects[i];
+      dstDamage->rects[i] = {r.x(), r.y(), r.width(), r.height()};
+    }
+  }
+
+  return CanvexRenderSuccess;
+}
+
+CanvexRenderResult CanvexRenderJSON_I420A(
+  CanvexResourceCtx ctx_c,
+  const char *json,
+  const CanvexI420ABuffer *dstImage,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  CanvexYuvColorMatrix colorMatrix,
+  CanvexExecutionStats* stats // optional stats
+) {
+  return CanvexRenderDisplayList_YuvA(
+      ctx_c, nullptr, reinterpret_cast<const uint8_t*>(json), 0, dstImage, dstImageW, dstImageH, colorMatrix, nullptr, stats
+  );
+}
+
+CanvexRenderResult CanvexRenderDisplayList_I420A(
+  CanvexResourceCtx ctx_c,
+  const uint8_t *data,
+  size_t dataSize,
+  const CanvexI420ABuffer *dstImage,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  CanvexYuvColorMatrix colorMatrix,
+  CanvexExecutionStats* stats // optional stats
+) {
+  if (dataSize == 0) {
+    return CanvexRenderError_InvalidArgument_JSONInput;
+  }
+  return CanvexRenderDisplayList_YuvA(
+      ctx_c, nullptr, data, dataSize, dstImage, dstImageW, dstImageH, colorMatrix, nullptr, stats
+  );
+}
+
+CanvexRenderResult CanvexRenderDisplayListIncremental_I420A(
+  CanvexResourceCtx ctx_c,
+  CanvexDamageTracker tracker_c,
+  const uint8_t *data,
+  size_t dataSize,
+  const CanvexI420ABuffer *dstImage,
+  uint32_t dstImageW,
+  uint32_t dstImageH,
+  CanvexYuvColorMatrix colorMatrix,
+  CanvexDamageRegion* dstDamage, // optional
+  CanvexExecutionStats* stats // optional stats
+) {
+  if (dataSize == 0) {
+    return CanvexRenderError_InvalidArgument_JSONInput;
+  }
+  auto tracker = static_cast<canvex::DamageTracker*>(tracker_c);
+  if (!tracker) {
+    return CanvexRenderError_InvalidArgument_DamageTracker;
+  }
+  return CanvexRenderDisplayList_YuvA(
+      ctx_c, tracker, data, dataSize, dstImage, dstImageW, dstImageH, colorMatrix, dstDamage, stats
   );
 }
 
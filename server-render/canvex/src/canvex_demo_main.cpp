@@ -104,6 +104,8 @@ int main() {
       std::cout << "Graphics detail: drawText " << execStats.render_detail_draw_text_us/1000.0 << "ms" << std::endl;
       std::cout << "Graphics detail: drawShapes " << execStats.render_detail_draw_shapes_us/1000.0 << "ms" << std::endl;
       std::cout << "Graphics image cache misses = " << execStats.num_image_cache_misses << std::endl;
+      std::cout << "Graphics image cache: " << execStats.image_cache_bytes / 1024 << " kB, "
+          << execStats.num_image_cache_evictions << " evictions" << std::endl;
     }
   }
 
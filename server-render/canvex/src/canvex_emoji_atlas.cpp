@@ -0,0 +1,229 @@
+#include "canvex_emoji_atlas.h"
+#include "hash_util.h"
+#include <algorithm>
+
+namespace canvex {
+
+// transparent border around each sprite so that filtered blits never pick up a neighbor
+constexpr int kSpritePadding = 1;
+
+size_t EmojiAtlas::SpriteKeyHash::operator()(const SpriteKey& k) const {
+  return Hasher().add(k.text).add(k.typefaceId).add(k.pxSize).value();
+}
+
+std::optional<EmojiSprite> EmojiAtlas::getSprite(const std::string& text, const sk_sp<SkTypeface>& typeface, int pxSize) {
+  if (!typeface || pxSize < 1 || pxSize > kMaxSpriteSize) {
+    return std::nullopt;
+  }
+
+  SpriteKey key{text, typeface->uniqueID(), pxSize};
+  auto it = sprites_.find(key);
+  if (it != sprites_.end()) {
+    spriteHits_++;
+    const auto& loc = it->second;
+    pages_[loc.page].lastUse = ++useCounter_;
+    if (loc.image) {
+      return EmojiSprite{loc.image, SkIRect::MakeXYWH(kSpritePadding, kSpritePadding, loc.srcRect.width(), loc.srcRect.height()),
+                         loc.glyphBounds};
+    }
+    return EmojiSprite{pages_[loc.page].image, loc.srcRect, loc.glyphBounds};
+  }
+  spriteMisses_++;
+
+  SkFont font(typeface, pxSize);
+  auto textBlob = SkTextBlob::MakeFromString(text.c_str(), font);
+  if (!textBlob) {
+    return std::nullopt;
+  }
+  const SkIRect glyphBounds = textBlob->bounds().roundOut();
+  if (glyphBounds.isEmpty()) {
+    return std::nullopt;
+  }
+
+  const int w = glyphBounds.width() + 2 * kSpritePadding;
+  const int h = glyphBounds.height() + 2 * kSpritePadding;
+  auto alloc = alloc_(w, h);
+  if (!alloc) {
+    return std::nullopt;
+  }
+  const int pageIdx = alloc->first;
+  const SkIPoint pos = alloc->second;
+  auto& page = pages_[pageIdx];
+
+  SkCanvas canvas(page.bitmap);
+  canvas.clipIRect(SkIRect::MakeXYWH(pos.x(), pos.y(), w, h));
+  canvas.clear(SK_ColorTRANSPARENT);
+
+  SkPaint paint;
+  paint.setAntiAlias(true);
+  canvas.drawTextBlob(textBlob,
+    pos.x() + kSpritePadding - glyphBounds.x(),
+    pos.y() + kSpritePadding - glyphBounds.y(),
+    paint);
+
+  // the page is only snapshotted at the next render, so this render draws the sprite from its own copy
+  const SkPixmap spritePixels(SkImageInfo::MakeN32Premul(w, h),
+                              static_cast<const uint8_t*>(page.bitmap.getPixels())
+                                + (size_t)pos.y() * page.bitmap.rowBytes() + (size_t)pos.x() * 4,
+                              page.bitmap.rowBytes());
+  SpriteLocation loc{
+    pageIdx,
+    SkIRect::MakeXYWH(pos.x() + kSpritePadding, pos.y() + kSpritePadding, glyphBounds.width(), glyphBounds.height()),
+    glyphBounds,
+    SkImage::MakeRasterCopy(spritePixels)
+  };
+  page.usedArea += (int64_t)w * h;
+  page.lastUse = ++useCounter_;
+  page.dirty = true;
+
+  EmojiSprite sprite{loc.image, SkIRect::MakeXYWH(kSpritePadding, kSpritePadding, glyphBounds.width(), glyphBounds.height()),
+                     glyphBounds};
+  sprites_.emplace(std::move(key), std::move(loc));
+  return sprite;
+}
+
+void EmojiAtlas::beginRender() {
+  bool anyDirty = false;
+  for (auto& page : pages_) {
+    if (page.dirty) {
+      retireImage_(std::move(page.image));
+      page.image = snapshotPage_(page);
+      page.dirty = false;
+      anyDirty = true;
+    }
+  }
+  // sprites are only added to dirty pages, so every sprite copy is now in a snapshot
+  if (anyDirty) {
+    for (auto& entry : sprites_) {
+      retireImage_(std::move(entry.second.image));
+    }
+  }
+
+  // drop the retired images that recorded pictures no longer use
+  retiredImages_.erase(std::remove_if(retiredImages_.begin(), retiredImages_.end(),
+                                      [](const sk_sp<SkImage>& image) { return image->unique(); }),
+                       retiredImages_.end());
+}
+
+EmojiAtlasStats EmojiAtlas::getStats() const {
+  EmojiAtlasStats stats;
+  stats.spriteHits = spriteHits_;
+  stats.spriteMisses = spriteMisses_;
+  stats.numPages = pages_.size();
+  stats.bytes = pages_.size() * (size_t)kPageSize * kPageSize * 4;
+  for (const auto& page : pages_) {
+    if (page.image) stats.bytes += imageBytes_(*page.image);
+  }
+  for (const auto& entry : sprites_) {
+    if (entry.second.image) stats.bytes += imageBytes_(*entry.second.image);
+  }
+  for (const auto& image : retiredImages_) {
+    stats.bytes += imageBytes_(*image);
+  }
+
+  int64_t usedArea = 0;
+  for (const auto& page : pages_) {
+    usedArea += page.usedArea;
+  }
+  if (!pages_.empty()) {
+    stats.occupancyPct = (usedArea * 100) / ((int64_t)pages_.size() * kPageSize * kPageSize);
+  }
+  return stats;
+}
+
+void EmojiAtlas::resetPage_(Page& page) {
+  // earlier snapshots are copies, so the bitmap can be reused
+  if (page.bitmap.width() == 0) {
+    page.bitmap.allocN32Pixels(kPageSize, kPageSize);
+  }
+  page.bitmap.eraseColor(SK_ColorTRANSPARENT);
+  retireImage_(std::move(page.image));
+  page.dirty = false;
+  page.shelves.clear();
+  page.nextShelfY = 0;
+  page.usedArea = 0;
+}
+
+void EmojiAtlas::retireImage_(sk_sp<SkImage> image) {
+  if (image && !image->unique()) {
+    retiredImages_.push_back(std::move(image));
+  }
+}
+
+sk_sp<SkImage> EmojiAtlas::snapshotPage_(const Page& page) {
+  // only the rows that shelves have reached hold sprites, and sprite rects are relative to the top
+  const SkPixmap used(SkImageInfo::MakeN32Premul(kPageSize, page.nextShelfY),
+                      page.bitmap.getPixels(), page.bitmap.rowBytes());
+  return SkImage::MakeRasterCopy(used);
+}
+
+size_t EmojiAtlas::imageBytes_(const SkImage& image) {
+  return (size_t)image.width() * image.height() * 4;
+}
+
+std::optional<SkIPoint> EmojiAtlas::allocInPage_(Page& page, int w, int h) {
+  // best fit among existing shelves that are tall enough
+  Shelf* best = nullptr;
+  for (auto& shelf : page.shelves) {
+    if (shelf.height >= h && shelf.nextX + w <= kPageSize
+        && (!best || shelf.height < best->height)) {
+      best = &shelf;
+    }
+  }
+  // don't waste a much taller shelf if a new one can be opened
+  if (best && best->height > h + h / 4 && page.nextShelfY + h <= kPageSize) {
+    best = nullptr;
+  }
+  if (!best) {
+    if (page.nextShelfY + h > kPageSize) {
+      return std::nullopt;
+    }
+    page.shelves.push_back({page.nextShelfY, h, 0});
+    page.nextShelfY += h;
+    best = &page.shelves.back();
+  }
+
+  SkIPoint pos = {best->nextX, best->y};
+  best->nextX += w;
+  return pos;
+}
+
+std::optional<std::pair<int, SkIPoint>> EmojiAtlas::alloc_(int w, int h) {
+  if (w > kPageSize || h > kPageSize) {
+    return std::nullopt;
+  }
+  for (size_t i = 0; i < pages_.size(); i++) {
+    if (auto pos = allocInPage_(pages_[i], w, h)) {
+      return std::make_pair((int)i, *pos);
+    }
+  }
+
+  int pageIdx;
+  if ((int)pages_.size() < kMaxPages) {
+    pages_.emplace_back();
+    pageIdx = pages_.size() - 1;
+  } else {
+    // all pages are full, so empty the least recently used one
+    pageIdx = 0;
+    for (size_t i = 1; i < pages_.size(); i++) {
+      if (pages_[i].lastUse < pages_[pageIdx].lastUse) pageIdx = i;
+    }
+    for (auto it = sprites_.begin(); it != sprites_.end(); ) {
+      if (it->second.page == pageIdx) {
+        retireImage_(std::move(it->second.image));
+        it = sprites_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  resetPage_(pages_[pageIdx]);
+
+  auto pos = allocInPage_(pages_[pageIdx], w, h);
+  if (!pos) {
+    return std::nullopt;
+  }
+  return std::make_pair(pageIdx, *pos);
+}
+
+} // namespace canvex
@@ -0,0 +1,116 @@
+#pragma once
+#include "skia_includes.h"
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace canvex {
+
+/*
+  Atlas of pre-rendered color emoji.
+
+  The emoji font contains embedded color bitmaps, and Skia has to rescale them
+  on every draw which is much slower than outline text. Instead each emoji string
+  is rendered once per pixel size into a shared atlas page, and then drawn as an image blit.
+
+  Pages are packed with simple shelves. Memory is bounded by a fixed number of pages:
+  when all pages are full, the least recently used page is emptied and reused.
+
+  Sprites are rendered into a mutable bitmap per page, and drawn from an immutable snapshot
+  of the page. Pages that changed are snapshotted once at the start of the next render (beginRender),
+  so a render with many misses doesn't copy the page for each of them. Until then, a new sprite
+  is drawn from a copy of just its own pixels.
+  Pictures that were recorded with an older snapshot keep it alive, so they stay valid
+  however the page changes later. The atlas holds on to those snapshots too while anything else does,
+  so that they're counted in its stats.
+*/
+
+struct EmojiSprite {
+  sk_sp<SkImage> image; // the atlas page, or the sprite alone if it was added during this render
+  SkIRect srcRect;      // in image pixels
+  SkIRect glyphBounds;  // relative to the text origin, in sprite pixels
+};
+
+struct EmojiAtlasStats {
+  int64_t spriteHits = 0;
+  int64_t spriteMisses = 0;
+  int numPages = 0;
+  size_t bytes = 0; // pages, their snapshots and older snapshots still held by recorded pictures
+  int occupancyPct = 0; // share of allocated page area that holds sprites
+};
+
+class EmojiAtlas {
+ public:
+  static constexpr int kPageSize = 1024;
+  static constexpr int kMaxPages = 4;
+  static constexpr int kMaxSpriteSize = 256;
+
+  // returns the sprite for the text rendered at the given pixel size, adding it to the atlas if needed.
+  // returns nullopt if the text renders empty or doesn't fit in a page.
+  std::optional<EmojiSprite> getSprite(const std::string& text, const sk_sp<SkTypeface>& typeface, int pxSize);
+
+  // snapshots the pages that sprites were added to since the last call.
+  // call at the start of each render, before any getSprite.
+  void beginRender();
+
+  EmojiAtlasStats getStats() const;
+
+ private:
+  struct SpriteKey {
+    std::string text;
+    uint32_t typefaceId;
+    int pxSize;
+
+    bool operator==(const SpriteKey& o) const {
+      return pxSize == o.pxSize && typefaceId == o.typefaceId && text == o.text;
+    }
+  };
+
+  struct SpriteKeyHash {
+    size_t operator()(const SpriteKey& k) const;
+  };
+
+  struct SpriteLocation {
+    int page;
+    SkIRect srcRect; // in page pixels
+    SkIRect glyphBounds;
+    // copy of the sprite's pixels with its padding, until the page snapshot includes it
+    sk_sp<SkImage> image;
+  };
+
+  struct Shelf {
+    int y;
+    int height;
+    int nextX;
+  };
+
+  struct Page {
+    SkBitmap bitmap;
+    // snapshot of the bitmap, taken by beginRender
+    sk_sp<SkImage> image;
+    bool dirty = false; // sprites were added since the snapshot
+    std::vector<Shelf> shelves;
+    int nextShelfY = 0;
+    int64_t usedArea = 0;
+    uint64_t lastUse = 0;
+  };
+
+  std::vector<Page> pages_;
+  std::unordered_map<SpriteKey, SpriteLocation, SpriteKeyHash> sprites_;
+  // replaced snapshots and sprite copies that were still referenced elsewhere when they were replaced
+  std::vector<sk_sp<SkImage>> retiredImages_;
+  uint64_t useCounter_ = 0;
+  int64_t spriteHits_ = 0;
+  int64_t spriteMisses_ = 0;
+
+  void resetPage_(Page& page);
+  void retireImage_(sk_sp<SkImage> image);
+  static sk_sp<SkImage> snapshotPage_(const Page& page);
+  static size_t imageBytes_(const SkImage& image);
+  static std::optional<SkIPoint> allocInPage_(Page& page, int w, int h);
+  std::optional<std::pair<int, SkIPoint>> alloc_(int w, int h);
+};
+
+} // namespace canvex
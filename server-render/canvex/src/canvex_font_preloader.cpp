@@ -0,0 +1,47 @@
+#include "canvex_font_preloader.h"
+#include "canvex_mapped_files.h"
+#include <iostream>
+
+namespace canvex {
+
+FontPreloader::FontPreloader(std::vector<Request> requests, std::shared_ptr<SharedResourceCache> sharedCache)
+  : requests_(std::move(requests)), sharedCache_(std::move(sharedCache)), numPending_(requests_.size()) {
+  thread_ = std::thread(&FontPreloader::load_, this);
+}
+
+FontPreloader::~FontPreloader() {
+  stopping_.store(true, std::memory_order_release);
+  thread_.join();
+}
+
+std::vector<FontPreloader::Result> FontPreloader::takeFinished() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Result> results;
+  results.swap(finished_);
+  return results;
+}
+
+void FontPreloader::load_() {
+  for (const auto& req : requests_) {
+    if (stopping_.load(std::memory_order_acquire)) return;
+
+    Result result{req.fileName, req.path, nullptr, nullptr};
+    if (sharedCache_) {
+      result.typeface = sharedCache_->getTypeface(req.path);
+    } else {
+      result.data = MapFileReadOnly(req.path, true);
+      if (result.data) {
+        result.typeface = SkTypeface::MakeFromData(result.data);
+      }
+    }
+    if (!result.typeface) {
+      std::cerr << "** Unable to preload font at: " << req.path << std::endl;
+    }
+    // counted down with the lock held, so a caller that has just taken the results sees a consistent count
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_.push_back(std::move(result));
+    numPending_.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+} // namespace canvex
@@ -0,0 +1,65 @@
+#pragma once
+#include "canvex_shared_resource_cache.h"
+#include "skia_includes.h"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace canvex {
+
+/*
+  Loads font files on a background thread ahead of a session.
+
+  Fonts are otherwise loaded by the first fillText that uses them, which stalls that frame.
+  The finished typefaces are handed back to the render thread through takeFinished(),
+  so the resource context's typeface caches stay single-threaded. With a shared resource cache,
+  the typefaces are loaded into it directly, since it can be used from any thread.
+*/
+
+class FontPreloader {
+ public:
+  struct Request {
+    std::string fileName;  // as returned by FontVariantMatcher
+    std::filesystem::path path;
+  };
+
+  struct Result {
+    std::string fileName;
+    std::filesystem::path path;
+    sk_sp<SkData> data;          // the mapped file, null if it's held by the shared cache
+    sk_sp<SkTypeface> typeface;  // null if the font couldn't be loaded
+  };
+
+  FontPreloader(std::vector<Request> requests, std::shared_ptr<SharedResourceCache> sharedCache);
+  ~FontPreloader();
+
+  FontPreloader(const FontPreloader&) = delete;
+  FontPreloader& operator=(const FontPreloader&) = delete;
+
+  // moves out the fonts loaded since the last call
+  std::vector<Result> takeFinished();
+
+  // number of requests not yet loaded (finished results that haven't been taken don't count)
+  size_t numPending() const {
+    return numPending_.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::vector<Request> requests_;
+  std::shared_ptr<SharedResourceCache> sharedCache_;
+  std::atomic<size_t> numPending_;
+  std::atomic<bool> stopping_{false};
+
+  std::mutex mutex_;
+  std::vector<Result> finished_;
+
+  std::thread thread_;
+
+  void load_();
+};
+
+} // namespace canvex
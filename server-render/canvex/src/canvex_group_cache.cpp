@@ -0,0 +1,39 @@
+#include "canvex_group_cache.h"
+
+namespace canvex {
+
+// rough size of an entry with nothing cached, so that groups seen only once also count against the budget
+constexpr size_t kEntryOverheadBytes = sizeof(CachedGroup) + 64;
+
+CachedGroup& GroupCache::touch(uint64_t key) {
+  if (auto group = lru_.get(key)) {
+    return *group;
+  }
+
+  CachedGroup group;
+  group.key = key;
+  group.bytes = kEntryOverheadBytes;
+  return lru_.put(key, std::move(group));
+}
+
+void GroupCache::updateSize(CachedGroup& group) {
+  size_t bytes = kEntryOverheadBytes;
+  if (group.picture) {
+    bytes += group.picture->approximateBytesUsed();
+  }
+  if (group.raster) {
+    bytes += group.raster->imageInfo().computeMinByteSize();
+  }
+
+  // an entry that can't fit at all only keeps its key, so it doesn't get recorded again
+  if (bytes > lru_.maxCost() / 2) {
+    group.picture = nullptr;
+    group.raster = nullptr;
+    bytes = kEntryOverheadBytes;
+  }
+
+  group.bytes = bytes;
+  lru_.updateCost(group.key);
+}
+
+} // namespace canvex
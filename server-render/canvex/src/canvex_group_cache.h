@@ -0,0 +1,71 @@
+#pragma once
+#include "lru_cache.h"
+#include "skia_includes.h"
+
+namespace canvex {
+
+/*
+  Cache of recorded save/restore groups from display lists.
+
+  VCS compositions are React trees, and each component usually renders
+  as one save/restore-bracketed group that stays identical from one update to the next.
+  Such groups are recorded once as an SkPicture and replayed from the cache,
+  and a group that keeps getting drawn with the same transform is also rasterized
+  so replay becomes a single image draw.
+
+  Entries are keyed by a hash of the group's commands and the style state they start with.
+  Memory use is bounded by evicting the least recently used entries.
+*/
+
+struct CachedGroup {
+  uint64_t key = 0;
+  int timesSeen = 0;
+
+  sk_sp<SkPicture> picture;
+
+  // device scale the picture was recorded for, if it contains images or emoji
+  // that were rasterized at that scale (0 otherwise)
+  float recordedScale = 0;
+
+  // device-space raster of the picture, valid when the transform differs
+  // from rasterMatrix only by an integer translation
+  sk_sp<SkImage> raster;
+  SkMatrix rasterMatrix;
+  SkIPoint rasterOrigin = {0, 0};
+
+  size_t bytes = 0;
+};
+
+class GroupCache {
+ public:
+  static constexpr size_t kDefaultMaxBytes = 32 * 1024 * 1024;
+  static constexpr size_t kDefaultMaxEntries = 4096;
+
+  GroupCache(size_t maxBytes = kDefaultMaxBytes, size_t maxEntries = kDefaultMaxEntries)
+    : lru_(maxEntries, maxBytes, [](const CachedGroup& group) { return group.bytes; }) {}
+
+  // returns the entry for the key, creating an empty one if needed, and marks it as most recently used.
+  // the reference stays valid until the next call to touch().
+  CachedGroup& touch(uint64_t key);
+
+  // call after changing the picture or raster of an entry returned by touch().
+  // evicts other entries if the cache is now over budget.
+  void updateSize(CachedGroup& group);
+
+  void clear() {
+    lru_.clear();
+  }
+
+  size_t totalBytes() const {
+    return lru_.totalCost();
+  }
+
+  size_t numEntries() const {
+    return lru_.size();
+  }
+
+ private:
+  LruCache<uint64_t, CachedGroup> lru_;
+};
+
+} // namespace canvex
@@ -0,0 +1,148 @@
+#include "canvex_image_cache.h"
+#include "hash_util.h"
+#include <algorithm>
+#include <cmath>
+
+namespace canvex {
+
+// smallest power-of-two downscale kept in the cache
+constexpr float kMinDecodeScale = 1.0f / 32;
+
+std::optional<ImageSourceType> ImageSourceTypeFromString(const std::string& s) {
+  if (s == "defaultAsset") return DefaultAsset;
+  if (s == "compositionAsset") return CompositionAsset;
+  if (s == "liveAsset") return LiveAsset;
+  if (s == "shmAsset") return SharedMemoryAsset;
+  return std::nullopt;
+}
+
+float ImageDrawSize::scaleFor(SkISize srcSize) const {
+  const SkRect src = srcRect.isEmpty() ? SkRect::Make(srcSize) : srcRect;
+  if (src.isEmpty()) {
+    return 1;
+  }
+  const float needed = std::max(devSize.width() / src.width(), devSize.height() / src.height());
+  return std::min(needed, 1.0f);
+}
+
+SkRect CachedImage::mapSrcRect(const SkRect& r) const {
+  if (!image || srcSize.isEmpty()) {
+    return r;
+  }
+  const float sx = image->width() / (float)srcSize.width();
+  const float sy = image->height() / (float)srcSize.height();
+  return SkRect::MakeLTRB(r.fLeft * sx, r.fTop * sy, r.fRight * sx, r.fBottom * sy);
+}
+
+// returns the smallest power-of-two scale that is at least the needed scale
+static float mipScaleFor(float needed) {
+  float scale = 1;
+  while (scale / 2 >= needed && scale / 2 >= kMinDecodeScale) {
+    scale /= 2;
+  }
+  return scale;
+}
+
+static SkISize scaledSize(SkISize size, float scale) {
+  return SkISize::Make(std::max(1, (int)std::ceil(size.width() * scale)),
+                       std::max(1, (int)std::ceil(size.height() * scale)));
+}
+
+// decodes with the codec's own downscaling, which may give a size larger than requested.
+// returns null if the codec can't be used directly.
+static sk_sp<SkImage> decodeWithCodec(SkCodec& codec, float scale, SkISize minSize) {
+  // the generic decoder applies EXIF orientation, the codec doesn't
+  if (codec.getOrigin() != kTopLeft_SkEncodedOrigin) {
+    return nullptr;
+  }
+
+  SkISize codecSize = codec.getScaledDimensions(scale);
+  if (codecSize.width() < minSize.width() || codecSize.height() < minSize.height()) {
+    codecSize = codec.dimensions();
+  }
+
+  SkBitmap bitmap;
+  if (!bitmap.tryAllocPixels(SkImageInfo::MakeN32Premul(codecSize))) {
+    return nullptr;
+  }
+  const auto result = codec.getPixels(bitmap.pixmap());
+  if (result != SkCodec::kSuccess && result != SkCodec::kIncompleteInput) {
+    return nullptr;
+  }
+  bitmap.setImmutable();
+  return bitmap.asImage();
+}
+
+static sk_sp<SkImage> resizeImage(const sk_sp<SkImage>& image, SkISize size) {
+  auto surface = SkSurface::MakeRasterN32Premul(size.width(), size.height());
+  if (!surface) {
+    return image;
+  }
+  auto canvas = surface->getCanvas();
+  canvas->clear(SK_ColorTRANSPARENT);
+  // mipmapped sampling so that large downscales don't alias
+  canvas->drawImageRect(image, SkRect::Make(size), SkSamplingOptions(SkFilterMode::kLinear, SkMipmapMode::kLinear));
+  return surface->makeImageSnapshot();
+}
+
+CachedImage decodeImageForDrawSize(const sk_sp<SkData>& data, const ImageDrawSize& drawSize, float minScale) {
+  CachedImage entry;
+
+  auto codec = SkCodec::MakeFromData(data);
+  if (!codec || codec->dimensions().isEmpty()) {
+    return entry;
+  }
+  entry.srcSize = codec->dimensions();
+  float scale = mipScaleFor(std::max(drawSize.scaleFor(entry.srcSize), minScale));
+
+  sk_sp<SkImage> image = decodeWithCodec(*codec, scale, scaledSize(entry.srcSize, scale));
+  if (!image) {
+    // rotated images and pixel formats the codec can't convert go through the generic decoder at full size
+    image = SkImage::MakeFromEncoded(data);
+    if (image) {
+      image = image->makeRasterImage();
+    }
+    if (!image) {
+      return entry;
+    }
+    entry.srcSize = image->dimensions();
+    scale = mipScaleFor(std::max(drawSize.scaleFor(entry.srcSize), minScale));
+  }
+
+  const SkISize dstSize = scaledSize(entry.srcSize, scale);
+  if (image->width() > dstSize.width() || image->height() > dstSize.height()) {
+    image = resizeImage(image, dstSize);
+  }
+
+  entry.image = image;
+  entry.scale = scale;
+  entry.bytes = image->imageInfo().computeMinByteSize();
+  return entry;
+}
+
+size_t ImageCache::KeyHash::operator()(const Key& k) const {
+  return Hasher().add(k.type).add(k.name).value();
+}
+
+ImageCache::ImageCache(size_t maxBytes)
+  : lru_(SIZE_MAX, maxBytes, [](const CachedImage& entry) { return entry.bytes; }) {
+  lru_.setEvictionHook([this](const Key&, CachedImage&) { numEvictions_++; });
+}
+
+CachedImage* ImageCache::get(ImageSourceType type, const std::string& name) {
+  return lru_.get(Key{type, name});
+}
+
+void ImageCache::put(ImageSourceType type, const std::string& name, CachedImage entry) {
+  lru_.put(Key{type, name}, std::move(entry));
+}
+
+void ImageCache::erase(ImageSourceType type, const std::string& name) {
+  lru_.erase(Key{type, name});
+}
+
+void ImageCache::clear() {
+  lru_.clear();
+}
+
+} // namespace canvex
@@ -0,0 +1,115 @@
+#pragma once
+#include "lru_cache.h"
+#include "skia_includes.h"
+#include <optional>
+#include <string>
+
+namespace canvex {
+
+/*
+  Cache of decoded images for all asset namespaces.
+
+  Images are decoded to raster at the largest size they have been drawn at,
+  rounded up to the next power-of-two downscale of the source ("one mip above"),
+  so a 4K slide drawn as a thumbnail only keeps thumbnail-sized pixels.
+  Where the codec supports scaled decoding (JPEG, WebP) the full-resolution
+  pixels are never materialized.
+
+  Memory use is bounded by a byte budget shared by all namespaces,
+  evicting the least recently used images.
+*/
+
+enum ImageSourceType {
+  DefaultAsset,
+  CompositionAsset,
+  LiveAsset,
+  SharedMemoryAsset, // raw frames from another process, not cached here (see ShmFrameSource)
+};
+
+// parses the asset type used in display lists, e.g. "compositionAsset"
+std::optional<ImageSourceType> ImageSourceTypeFromString(const std::string& s);
+
+// How large an image is drawn in device pixels.
+struct ImageDrawSize {
+  SkSize devSize;  // device-space size of the area the image is drawn into
+  SkRect srcRect;  // part of the source image drawn there in source pixels, or empty for the whole image
+
+  // fraction of the source resolution needed for this draw, at most 1
+  float scaleFor(SkISize srcSize) const;
+};
+
+struct CachedImage {
+  sk_sp<SkImage> image;
+  SkISize srcSize = {0, 0};  // dimensions of the encoded image, may be larger than the decoded one
+  float scale = 1;           // decoded size relative to srcSize
+  size_t bytes = 0;
+
+  // maps a rect in source pixels to the decoded image
+  SkRect mapSrcRect(const SkRect& r) const;
+};
+
+// Decodes the image at the smallest power-of-two downscale that satisfies drawSize,
+// and at least minScale (e.g. to keep the resolution of an earlier decode).
+// Returns an entry with a null image if the data can't be decoded.
+CachedImage decodeImageForDrawSize(const sk_sp<SkData>& data, const ImageDrawSize& drawSize, float minScale = 0);
+
+class ImageCache {
+ public:
+  static constexpr size_t kDefaultMaxBytes = 256 * 1024 * 1024;
+
+  explicit ImageCache(size_t maxBytes = kDefaultMaxBytes);
+
+  // the eviction counter is updated through a hook that refers to this object
+  ImageCache(const ImageCache&) = delete;
+  ImageCache& operator=(const ImageCache&) = delete;
+
+  // returns null if not found, otherwise marks the entry as most recently used.
+  // the pointer stays valid until the next call to put() or erase().
+  CachedImage* get(ImageSourceType type, const std::string& name);
+
+  // adds or replaces an entry, then evicts other entries if the cache is over budget.
+  void put(ImageSourceType type, const std::string& name, CachedImage entry);
+
+  void erase(ImageSourceType type, const std::string& name);
+
+  void clear();
+
+  size_t totalBytes() const {
+    return lru_.totalCost();
+  }
+
+  size_t numEntries() const {
+    return lru_.size();
+  }
+
+  int64_t numEvictions() const {
+    return numEvictions_;
+  }
+
+  size_t maxBytes() const {
+    return lru_.maxCost();
+  }
+
+  void setMaxBytes(size_t maxBytes) {
+    lru_.setMaxCost(maxBytes);
+  }
+
+ private:
+  struct Key {
+    ImageSourceType type;
+    std::string name;
+
+    bool operator==(const Key& o) const {
+      return type == o.type && name == o.name;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& k) const;
+  };
+
+  LruCache<Key, CachedImage, KeyHash> lru_;
+  int64_t numEvictions_ = 0;
+};
+
+} // namespace canvex
@@ -0,0 +1,156 @@
+#include "canvex_image_decode_pool.h"
+#include "canvex_mapped_files.h"
+#include "hash_util.h"
+#include "time_util.h"
+#include <iostream>
+
+namespace canvex {
+
+// a file that failed to load isn't retried more often than this
+constexpr double kFailedDecodeRetryIntervalSecs = 1.0;
+
+std::filesystem::path GetImageAssetPath(const std::filesystem::path& resDir, ImageSourceType type, const std::string& name) {
+  std::filesystem::path assetsPath;
+  switch (type) {
+    case CompositionAsset:
+      assetsPath = resDir / name;
+      break;
+    case DefaultAsset:
+      assetsPath = resDir / "test-assets" / name;
+      break;
+    case LiveAsset:
+      assetsPath = resDir / "live" / name;
+      break;
+    case SharedMemoryAsset:
+      assetsPath = name; // not a file
+      break;
+  }
+  return assetsPath;
+}
+
+ImageDecodeResult DecodeImageFile(const ImageDecodeRequest& req) {
+  ImageDecodeResult result{req.type, req.name, req.path, {}, {}};
+
+  std::error_code ec;
+  result.fileWriteTime = std::filesystem::last_write_time(req.path, ec);
+  if (ec) {
+    std::cerr << "drawImage: unable to load path " << req.path << " - last_write_time() returned " << ec << std::endl;
+    return result;
+  }
+  auto data = req.data;
+  if (!data) {
+    // live images are rewritten in place, so they're read into memory rather than mapped
+    data = (req.type == LiveAsset) ? SkData::MakeFromFileName(req.path.c_str()) : MapFileReadOnly(req.path);
+  }
+  if (!data) {
+    std::cerr << "drawImage: unable to load path " << req.path << std::endl;
+    return result;
+  }
+  result.image = decodeImageForDrawSize(data, req.drawSize, req.minScale);
+  if (!result.image.image) {
+    std::cerr << "drawImage: unable to decode image at path " << req.path << std::endl;
+  }
+  return result;
+}
+
+size_t ImageDecodePool::KeyHash::operator()(const Key& k) const {
+  return Hasher().add(k.type).add(k.name).value();
+}
+
+ImageDecodePool::ImageDecodePool(int numThreads) {
+  if (numThreads < 1) numThreads = 1;
+  for (int i = 0; i < numThreads; i++) {
+    threads_.emplace_back(&ImageDecodePool::workerLoop_, this);
+  }
+}
+
+ImageDecodePool::~ImageDecodePool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    // queued requests are dropped, so they're no longer pending.
+    // decodes in progress are finished by their workers, which clear their own entries.
+    for (const auto& req : queue_) {
+      pending_.erase(Key{req.type, req.name});
+    }
+    queue_.clear();
+  }
+  queueCond_.notify_all();
+  doneCond_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+bool ImageDecodePool::submit(ImageDecodeRequest req) {
+  Key key{req.type, req.name};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return false;
+    }
+    if (pending_.count(key) > 0) {
+      return true;
+    }
+    auto failed = failedAt_.find(key);
+    if (failed != failedAt_.end()) {
+      if (getMonotonicTime() - failed->second < kFailedDecodeRetryIntervalSecs) {
+        return false;
+      }
+      failedAt_.erase(failed);
+    }
+    pending_.insert(std::move(key));
+    queue_.push_back(std::move(req));
+  }
+  queueCond_.notify_one();
+  return true;
+}
+
+bool ImageDecodePool::isPending(ImageSourceType type, const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_.count(Key{type, name}) > 0;
+}
+
+void ImageDecodePool::wait(ImageSourceType type, const std::string& name) {
+  Key key{type, name};
+  std::unique_lock<std::mutex> lock(mutex_);
+  doneCond_.wait(lock, [&] { return pending_.count(key) == 0; });
+}
+
+std::vector<ImageDecodeResult> ImageDecodePool::takeFinished() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<ImageDecodeResult> results;
+  results.swap(finished_);
+  return results;
+}
+
+size_t ImageDecodePool::numPending() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_.size();
+}
+
+void ImageDecodePool::workerLoop_() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queueCond_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    if (stopping_) return;
+
+    auto req = std::move(queue_.front());
+    queue_.pop_front();
+
+    lock.unlock();
+    auto result = DecodeImageFile(req);
+    lock.lock();
+
+    Key key{req.type, req.name};
+    if (result.image.image) {
+      finished_.push_back(std::move(result));
+    } else {
+      failedAt_[key] = getMonotonicTime();
+    }
+    pending_.erase(key);
+    doneCond_.notify_all();
+  }
+}
+
+} // namespace canvex
@@ -0,0 +1,106 @@
+#pragma once
+#include "canvex_image_cache.h"
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace canvex {
+
+/*
+  Background threads that load and decode images.
+
+  Renders that can't wait for a large image to decode submit it here,
+  and the finished decodes are moved into the image cache by the render thread
+  on a later call. The pool doesn't touch the cache itself, so the cache and
+  the rest of the resource context stay single-threaded.
+*/
+
+// what to draw for an image that is still being decoded in the background
+enum class ImageLoadPolicy {
+  Block,        // decode on the render thread, like a synchronous load
+  Skip,         // leave the image out of the frame
+  Placeholder,  // draw a translucent gray rect in its place
+};
+
+struct ImageDecodeRequest {
+  ImageSourceType type;
+  std::string name;
+  std::filesystem::path path;
+  ImageDrawSize drawSize;
+  float minScale = 0;
+  sk_sp<SkData> data;  // file contents if they're already mapped, otherwise the file is loaded from path
+};
+
+struct ImageDecodeResult {
+  ImageSourceType type;
+  std::string name;
+  std::filesystem::path path;
+  CachedImage image;  // null image if the file couldn't be loaded
+  std::filesystem::file_time_type fileWriteTime;
+};
+
+// Path of an image asset under the resource dir.
+std::filesystem::path GetImageAssetPath(const std::filesystem::path& resDir, ImageSourceType type, const std::string& name);
+
+// Loads and decodes the file for the request. Errors are logged and return a null image.
+ImageDecodeResult DecodeImageFile(const ImageDecodeRequest& req);
+
+class ImageDecodePool {
+ public:
+  static constexpr int kDefaultNumThreads = 2;
+
+  explicit ImageDecodePool(int numThreads = kDefaultNumThreads);
+  ~ImageDecodePool();
+
+  ImageDecodePool(const ImageDecodePool&) = delete;
+  ImageDecodePool& operator=(const ImageDecodePool&) = delete;
+
+  // queues the request unless the same image is already queued or being decoded,
+  // or its last decode failed less than a second ago. returns true if the image is now pending.
+  bool submit(ImageDecodeRequest req);
+
+  bool isPending(ImageSourceType type, const std::string& name);
+
+  // blocks until the image is no longer pending
+  void wait(ImageSourceType type, const std::string& name);
+
+  // moves out the decodes finished since the last call
+  std::vector<ImageDecodeResult> takeFinished();
+
+  size_t numPending();
+
+ private:
+  struct Key {
+    ImageSourceType type;
+    std::string name;
+
+    bool operator==(const Key& o) const {
+      return type == o.type && name == o.name;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& k) const;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable queueCond_;
+  std::condition_variable doneCond_;
+  bool stopping_ = false;
+
+  std::deque<ImageDecodeRequest> queue_;
+  std::unordered_set<Key, KeyHash> pending_; // queued or in progress
+  std::unordered_map<Key, double, KeyHash> failedAt_;
+  std::vector<ImageDecodeResult> finished_;
+
+  std::vector<std::thread> threads_;
+
+  void workerLoop_();
+};
+
+} // namespace canvex
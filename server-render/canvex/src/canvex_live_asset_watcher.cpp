@@ -0,0 +1,119 @@
+#include "canvex_live_asset_watcher.h"
+#include <iostream>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace canvex {
+
+#if defined(__linux__)
+
+LiveAssetWatcher::LiveAssetWatcher(const std::filesystem::path& dir) {
+  inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd_ < 0) {
+    std::cerr << "** LiveAssetWatcher: inotify_init1 failed, errno " << errno << std::endl;
+    return;
+  }
+  // writers either close the file after writing or move a finished temp file into place
+  const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM
+                        | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+  if (inotify_add_watch(inotifyFd_, dir.c_str(), mask) < 0) {
+    // the directory doesn't necessarily exist before the first live asset is written
+    close(inotifyFd_);
+    inotifyFd_ = -1;
+    return;
+  }
+  wakeFd_ = eventfd(0, EFD_CLOEXEC);
+  if (wakeFd_ < 0) {
+    close(inotifyFd_);
+    inotifyFd_ = -1;
+    return;
+  }
+
+  watching_ = true;
+  thread_ = std::thread(&LiveAssetWatcher::threadLoop_, this);
+}
+
+LiveAssetWatcher::~LiveAssetWatcher() {
+  if (thread_.joinable()) {
+    uint64_t one = 1;
+    if (write(wakeFd_, &one, sizeof(one)) < 0) {
+      std::cerr << "** LiveAssetWatcher: unable to wake thread, errno " << errno << std::endl;
+    }
+    thread_.join();
+  }
+  if (wakeFd_ >= 0) close(wakeFd_);
+  if (inotifyFd_ >= 0) close(inotifyFd_);
+}
+
+void LiveAssetWatcher::threadLoop_() {
+  // aligned as required for struct inotify_event
+  alignas(struct inotify_event) char buf[16 * 1024];
+
+  while (watching_) {
+    struct pollfd fds[2] = {
+      {inotifyFd_, POLLIN, 0},
+      {wakeFd_, POLLIN, 0},
+    };
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "** LiveAssetWatcher: poll failed, errno " << errno << std::endl;
+      break;
+    }
+    if (fds[1].revents) break; // --
+
+    const ssize_t len = read(inotifyFd_, buf, sizeof(buf));
+    if (len <= 0) continue;
+
+    bool changed = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (ssize_t offset = 0; offset < len; ) {
+      const auto* ev = reinterpret_cast<const struct inotify_event*>(buf + offset);
+      offset += sizeof(struct inotify_event) + ev->len;
+
+      if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED | IN_Q_OVERFLOW)) {
+        // the watch is gone or events were lost, so callers need to poll again
+        watching_ = false;
+        changed = true;
+        continue;
+      }
+      if (ev->len == 0) continue;
+
+      removedByName_[ev->name] = (ev->mask & (IN_DELETE | IN_MOVED_FROM)) != 0;
+      changed = true;
+    }
+    if (changed) {
+      changeCount_.fetch_add(1, std::memory_order_release);
+    }
+  }
+  watching_ = false;
+}
+
+#else
+
+LiveAssetWatcher::LiveAssetWatcher(const std::filesystem::path&) {}
+
+LiveAssetWatcher::~LiveAssetWatcher() {}
+
+void LiveAssetWatcher::threadLoop_() {}
+
+#endif
+
+std::vector<LiveAssetChange> LiveAssetWatcher::takeChanges() {
+  takenCount_ = changeCount_.load(std::memory_order_acquire);
+
+  std::vector<LiveAssetChange> changes;
+  std::lock_guard<std::mutex> lock(mutex_);
+  changes.reserve(removedByName_.size());
+  for (auto& [name, removed] : removedByName_) {
+    changes.push_back({name, removed});
+  }
+  removedByName_.clear();
+  return changes;
+}
+
+} // namespace canvex
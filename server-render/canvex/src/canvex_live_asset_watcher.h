@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace canvex {
+
+/*
+  Watches the live assets directory for files being written or removed.
+
+  Live images are written by other processes (e.g. webframe snapshots) and are reloaded
+  when they change. A thread waits on inotify and collects the changed file names,
+  so the render path only needs to check an atomic counter instead of polling
+  each file's write time.
+
+  Only available on Linux. On other platforms, or if the directory can't be watched,
+  isWatching() returns false and callers should fall back to polling.
+*/
+
+struct LiveAssetChange {
+  std::string name;  // relative to the watched directory
+  bool removed;
+};
+
+class LiveAssetWatcher {
+ public:
+  explicit LiveAssetWatcher(const std::filesystem::path& dir);
+  ~LiveAssetWatcher();
+
+  LiveAssetWatcher(const LiveAssetWatcher&) = delete;
+  LiveAssetWatcher& operator=(const LiveAssetWatcher&) = delete;
+
+  // false if the watch couldn't be set up, or the directory was removed since
+  bool isWatching() const {
+    return watching_.load(std::memory_order_acquire);
+  }
+
+  // cheap check for the render thread
+  bool hasChanges() const {
+    return changeCount_.load(std::memory_order_acquire) != takenCount_;
+  }
+
+  // returns the files changed since the last call, at most one entry per file
+  std::vector<LiveAssetChange> takeChanges();
+
+ private:
+  int inotifyFd_ = -1;
+  int wakeFd_ = -1; // signals the thread to exit
+  std::thread thread_;
+
+  std::atomic<bool> watching_{false};
+  std::atomic<uint64_t> changeCount_{0};
+  uint64_t takenCount_ = 0; // only accessed by the render thread
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, bool> removedByName_;
+
+  void threadLoop_();
+};
+
+} // namespace canvex
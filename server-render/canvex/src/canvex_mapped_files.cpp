@@ -0,0 +1,122 @@
+#include "canvex_mapped_files.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace canvex {
+
+static void unmapFileData(const void* addr, void* context) {
+  munmap(const_cast<void*>(addr), reinterpret_cast<size_t>(context));
+}
+
+sk_sp<SkData> MapFileReadOnly(const std::filesystem::path& path, bool willNeed) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat sb{};
+  if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size < 1) {
+    close(fd);
+    return nullptr;
+  }
+  const size_t size = sb.st_size;
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the file open
+  if (addr == MAP_FAILED) {
+    std::cerr << "** Unable to map file " << path << ": " << strerror(errno) << std::endl;
+    return nullptr;
+  }
+  if (willNeed) {
+    madvise(addr, size, MADV_WILLNEED);
+  }
+  return SkData::MakeWithProc(addr, size, unmapFileData, reinterpret_cast<void*>(size));
+}
+
+sk_sp<SkData> MappedFileSet::get(const std::filesystem::path& path) const {
+  auto it = files_.find(path.string());
+  return (it != files_.end()) ? it->second : nullptr;
+}
+
+sk_sp<SkData> MappedFileSet::map(const std::filesystem::path& path, bool willNeed) {
+  auto key = path.string();
+  auto it = files_.find(key);
+  if (it != files_.end()) {
+    return it->second;
+  }
+  auto data = MapFileReadOnly(path, willNeed);
+  if (data) {
+    mappedBytes_ += data->size();
+    files_.emplace(std::move(key), data);
+  }
+  return data;
+}
+
+void MappedFileSet::add(const std::filesystem::path& path, sk_sp<SkData> data) {
+  if (!data) return;
+  if (files_.emplace(path.string(), data).second) {
+    mappedBytes_ += data->size();
+  }
+}
+
+std::vector<std::filesystem::path> ReadPreloadManifest(const std::filesystem::path& manifestPath,
+                                                       const std::filesystem::path& resDir) {
+  std::vector<std::filesystem::path> paths;
+  std::ifstream f(manifestPath);
+  if (!f) {
+    std::cerr << "** Unable to open preload manifest " << manifestPath << std::endl;
+    return paths;
+  }
+  std::string line;
+  while (std::getline(f, line)) {
+    // trim, and skip comments and empty lines
+    const auto start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') continue;
+    const auto end = line.find_last_not_of(" \t\r/");
+    auto path = resDir / line.substr(start, end + 1 - start);
+
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec)) {
+      std::vector<std::filesystem::path> dirFiles;
+      for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+        if (entry.is_regular_file(ec)) dirFiles.push_back(entry.path());
+      }
+      std::sort(dirFiles.begin(), dirFiles.end());
+      paths.insert(paths.end(), dirFiles.begin(), dirFiles.end());
+    } else if (std::filesystem::is_regular_file(path, ec)) {
+      paths.push_back(std::move(path));
+    } else {
+      std::cerr << "** Preload manifest entry not found: " << path << std::endl;
+    }
+  }
+  return paths;
+}
+
+ProcessMemoryUsage GetProcessMemoryUsage() {
+  ProcessMemoryUsage usage;
+  std::ifstream f("/proc/self/smaps_rollup");
+  std::string line;
+  while (std::getline(f, line)) {
+    std::istringstream ss(line);
+    std::string field;
+    int64_t kb = 0;
+    if (!(ss >> field >> kb)) continue;
+
+    if (field == "Rss:") {
+      usage.rssBytes = kb * 1024;
+    } else if (field == "Shared_Clean:" || field == "Shared_Dirty:") {
+      usage.sharedBytes += kb * 1024;
+    } else if (field == "Private_Clean:" || field == "Private_Dirty:") {
+      usage.privateBytes += kb * 1024;
+    }
+  }
+  return usage;
+}
+
+} // namespace canvex
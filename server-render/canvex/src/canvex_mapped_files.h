@@ -0,0 +1,76 @@
+#pragma once
+#include "skia_includes.h"
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace canvex {
+
+/*
+  Read-only memory mappings of font and asset files.
+
+  Data read with a plain read() lives in each process's private heap, so N renderer processes
+  on a host hold N copies of every font (NotoColorEmoji alone is ~10 MB). A read-only shared mapping
+  is backed by the kernel's page cache instead, and all processes mapping the same file use the same pages.
+
+  Only files that aren't rewritten while they're in use may be mapped: if a mapped file is truncated,
+  touching the missing pages raises SIGBUS. So this is used for fonts and for default and composition
+  assets, never for live assets.
+*/
+
+// Maps the whole file read-only. With willNeed, the kernel is asked to read the pages in ahead of use.
+// Returns null if the file can't be opened or mapped (e.g. it's empty).
+sk_sp<SkData> MapFileReadOnly(const std::filesystem::path& path, bool willNeed = false);
+
+// Files mapped by one resource context, kept mapped for its lifetime.
+class MappedFileSet {
+ public:
+  // returns the mapping if the file has been mapped already, otherwise null
+  sk_sp<SkData> get(const std::filesystem::path& path) const;
+
+  // returns the existing mapping, or maps the file now and keeps it
+  sk_sp<SkData> map(const std::filesystem::path& path, bool willNeed = false);
+
+  // keeps a mapping made elsewhere (e.g. on a preload thread), unless the file is already mapped
+  void add(const std::filesystem::path& path, sk_sp<SkData> data);
+
+  void clear() {
+    files_.clear();
+    mappedBytes_ = 0;
+  }
+
+  size_t mappedBytes() const {
+    return mappedBytes_;
+  }
+
+  size_t numFiles() const {
+    return files_.size();
+  }
+
+  // by path
+  const std::unordered_map<std::string, sk_sp<SkData>>& files() const {
+    return files_;
+  }
+
+ private:
+  std::unordered_map<std::string, sk_sp<SkData>> files_;
+  size_t mappedBytes_ = 0;
+};
+
+// Reads a preload manifest: one path per line relative to resDir, with '#' comments.
+// A directory stands for all the regular files directly inside it (e.g. "fonts").
+// Paths that don't exist are logged and left out.
+std::vector<std::filesystem::path> ReadPreloadManifest(const std::filesystem::path& manifestPath,
+                                                       const std::filesystem::path& resDir);
+
+// Process-wide memory use from /proc/self/smaps_rollup, all zero where it's not available.
+struct ProcessMemoryUsage {
+  int64_t rssBytes = 0;
+  int64_t sharedBytes = 0;   // resident pages also mapped by another process
+  int64_t privateBytes = 0;  // resident pages mapped only by this process
+};
+
+ProcessMemoryUsage GetProcessMemoryUsage();
+
+} // namespace canvex
@@ -0,0 +1,152 @@
+#include "canvex_op_profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+namespace canvex {
+
+static_assert(numOpTypes <= CANVEX_OP_PROFILE_MAX_OPS, "CanvexOpProfile.ops is too small for the op codes");
+
+static double calibrateTicksPerNs() {
+#if defined(__aarch64__)
+  // the counter's frequency is fixed and reported by the CPU
+  uint64_t freq;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+  return freq / 1.0e9;
+#elif defined(__x86_64__) || defined(__i386__)
+  // an invariant TSC runs at a constant rate, which is measured once over a short sleep
+  const auto t0 = std::chrono::steady_clock::now();
+  const uint64_t c0 = ReadCycleCounter();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  const uint64_t c1 = ReadCycleCounter();
+  const auto t1 = std::chrono::steady_clock::now();
+  const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+  return (ns > 0.0 && c1 > c0) ? (c1 - c0) / ns : 1.0;
+#else
+  return 1.0;
+#endif
+}
+
+double CycleCounterTicksPerNs() {
+  static const double ticksPerNs = calibrateTicksPerNs();
+  return ticksPerNs;
+}
+
+static void writeJSONString(std::stringstream& ss, const std::string& s) {
+  ss << '"';
+  for (unsigned char c : s) {
+    switch (c) {
+      case '"': ss << "\\\""; break;
+      case '\\': ss << "\\\\"; break;
+      case '\n': ss << "\\n"; break;
+      case '\r': ss << "\\r"; break;
+      case '\t': ss << "\\t"; break;
+      default:
+        if (c < 0x20) {
+          static const char* kDigits = "0123456789abcdef";
+          ss << "\\u00" << kDigits[c >> 4] << kDigits[c & 0xf];
+        } else {
+          ss << c;
+        }
+    }
+  }
+  ss << '"';
+}
+
+static std::string formatArgs(const Command& cmd) {
+  std::stringstream ss;
+  ss << "[";
+  for (size_t i = 0; i < cmd.args.size(); i++) {
+    const auto& arg = cmd.args[i];
+    if (i > 0) ss << ",";
+    switch (arg.type) {
+      case ArgType::number:
+        // JSON has no NaN or infinity
+        if (std::isfinite(arg.numberValue)) {
+          ss << arg.numberValue;
+        } else {
+          ss << "null";
+        }
+        break;
+      case ArgType::string:
+        writeJSONString(ss, arg.stringValue);
+        break;
+      case ArgType::assetRef:
+        if (arg.assetRefValue) {
+          ss << "{\"type\":";
+          writeJSONString(ss, arg.assetRefValue->first);
+          ss << ",\"id\":";
+          writeJSONString(ss, arg.assetRefValue->second);
+          ss << "}";
+        } else {
+          ss << "null";
+        }
+        break;
+    }
+  }
+  ss << "]";
+  return ss.str();
+}
+
+void OpProfiler::reset() {
+  for (auto& totals : opTotals_) {
+    totals = {};
+  }
+  groupReplays_ = {};
+  slowest_.clear();
+}
+
+void OpProfiler::addCommand(size_t cmdIndex, const Command& cmd, uint64_t ticks) {
+  if (cmd.op < 0 || cmd.op >= numOpTypes) return;
+
+  auto& totals = opTotals_[cmd.op];
+  totals.count++;
+  totals.ticks += ticks;
+
+  if (slowest_.size() == CANVEX_OP_PROFILE_MAX_SLOWEST && ticks <= slowest_.back().ticks) {
+    return;
+  }
+  // the arguments are only formatted for commands that make it into the list
+  SlowCommand slow{cmdIndex, cmd.op, ticks, formatArgs(cmd)};
+  auto it = std::upper_bound(slowest_.begin(), slowest_.end(), ticks,
+                             [](uint64_t t, const SlowCommand& c) { return t > c.ticks; });
+  slowest_.insert(it, std::move(slow));
+  if (slowest_.size() > CANVEX_OP_PROFILE_MAX_SLOWEST) {
+    slowest_.pop_back();
+  }
+}
+
+void OpProfiler::addGroupReplay(uint64_t ticks) {
+  groupReplays_.count++;
+  groupReplays_.ticks += ticks;
+}
+
+void OpProfiler::getProfile(CanvexOpProfile& profile) const {
+  memset(&profile, 0, sizeof(CanvexOpProfile));
+
+  const double ticksPerNs = CycleCounterTicksPerNs();
+  auto toNs = [ticksPerNs](uint64_t ticks) {
+    return (int64_t)(ticks / ticksPerNs);
+  };
+
+  profile.num_ops = numOpTypes;
+  for (int op = 0; op < numOpTypes; op++) {
+    profile.ops[op].count = opTotals_[op].count;
+    profile.ops[op].total_ns = toNs(opTotals_[op].ticks);
+  }
+  profile.group_replays.count = groupReplays_.count;
+  profile.group_replays.total_ns = toNs(groupReplays_.ticks);
+
+  profile.num_slowest = slowest_.size();
+  for (size_t i = 0; i < slowest_.size(); i++) {
+    auto& dst = profile.slowest[i];
+    dst.cmd_index = slowest_[i].cmdIndex;
+    dst.op = slowest_[i].op;
+    dst.ns = toNs(slowest_[i].ticks);
+    strncpy(dst.args, slowest_[i].args.c_str(), CANVEX_OP_PROFILE_ARGS_LEN - 1);
+  }
+}
+
+} // namespace canvex
@@ -0,0 +1,75 @@
+#pragma once
+#include "../include/canvex_c_api.h"
+#include "canvas_display_list.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+ #include <x86intrin.h>
+#endif
+
+namespace canvex {
+
+/*
+  Opt-in per-opcode profiling of display list execution.
+
+  Every executed command is timed with the CPU's cycle counter (the TSC on x86, the virtual counter
+  on ARM), which is read without a system call and costs a few nanoseconds. Times are accumulated
+  per op type, and the slowest individual commands are kept with their index and arguments
+  so a slow overlay can be traced back to the command that causes it.
+
+  Ticks are converted to nanoseconds only when the profile is read out. On other architectures
+  the steady clock is used instead.
+*/
+
+static inline uint64_t ReadCycleCounter() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t v;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+  return v;
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// cycle counter ticks per nanosecond, calibrated against the steady clock on first use
+double CycleCounterTicksPerNs();
+
+class OpProfiler {
+ public:
+  // clears the profile for a new render
+  void reset();
+
+  void addCommand(size_t cmdIndex, const Command& cmd, uint64_t ticks);
+
+  // a save/restore group drawn from the group cache instead of executing its commands
+  void addGroupReplay(uint64_t ticks);
+
+  void getProfile(CanvexOpProfile& profile) const;
+
+ private:
+  struct OpTotals {
+    int64_t count = 0;
+    uint64_t ticks = 0;
+  };
+
+  struct SlowCommand {
+    size_t cmdIndex;
+    OpType op;
+    uint64_t ticks;
+    std::string args;
+  };
+
+  OpTotals opTotals_[numOpTypes];
+  OpTotals groupReplays_;
+
+  // sorted by descending time, at most CANVEX_OP_PROFILE_MAX_SLOWEST
+  std::vector<SlowCommand> slowest_;
+};
+
+} // namespace canvex
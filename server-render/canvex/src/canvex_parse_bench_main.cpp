@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "canvas_display_list.h"
+#include "file_util.h"
+#include "time_util.h"
+
+/*
+  Throughput benchmark comparing display list parsing from JSON vs. the binary format.
+
+  Each input JSON is converted to the binary encoding once up front,
+  then both forms are parsed repeatedly.
+
+  Usage:
+    canvex_parse_bench [-n iterations] [file.json ...]
+
+  With no files given, all JSON files in example-data are used.
+*/
+
+using namespace canvex;
+
+struct ParseTimings {
+  double median_s;
+  double min_s;
+};
+
+// getMonotonicTime() has microsecond resolution which is too coarse for single parses,
+// so each sample is the average over a batch of parses.
+template <typename ParseFn>
+static ParseTimings measureParse(int numIters, ParseFn parseFn) {
+  const int numBatches = 9;
+  const int batchSize = std::max(1, numIters / numBatches);
+  std::vector<double> times;
+
+  for (int b = 0; b < numBatches; b++) {
+    const double t0 = getMonotonicTime();
+    for (int i = 0; i < batchSize; i++) {
+      auto dl = parseFn();
+      if (!dl || dl->cmds.empty()) {
+        throw std::runtime_error("Parse produced an empty display list");
+      }
+    }
+    times.push_back((getMonotonicTime() - t0) / batchSize);
+  }
+  std::sort(times.begin(), times.end());
+  return {times[times.size() / 2], times[0]};
+}
+
+static double mbPerSec(size_t bytes, double s) {
+  return (s > 0.0) ? (bytes / s) / 1.0e6 : 0.0;
+}
+
+int main(int argc, char* argv[]) {
+  int numIters = 2000;
+  std::vector<std::filesystem::path> paths;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-n" && i + 1 < argc) {
+      numIters = std::max(1, atoi(argv[++i]));
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    for (auto const& entry : std::filesystem::directory_iterator{"example-data"}) {
+      if (entry.path().extension() == ".json") {
+        paths.push_back(entry.path());
+      }
+    }
+    std::sort(paths.begin(), paths.end());
+  }
+  if (paths.empty()) {
+    std::cerr << "No input files (run from the canvex dir, or pass JSON paths as arguments)" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Display list parse benchmark, " << numIters << " iterations per file" << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+
+  size_t totalJsonBytes = 0, totalBinBytes = 0;
+  double totalJson_s = 0.0, totalBin_s = 0.0;
+
+  for (const auto& path : paths) {
+    std::string json;
+    std::vector<uint8_t> bin;
+    try {
+      json = readTextFile(path.string());
+      bin = EncodeVCSDisplayListBinary(*ParseVCSDisplayListJSON(json));
+    } catch (std::exception& e) {
+      std::cerr << "Skipping " << path << ": " << e.what() << std::endl;
+      continue;
+    }
+
+    auto jsonT = measureParse(numIters, [&json] {
+      return ParseVCSDisplayListJSON(json.data(), json.size());
+    });
+    auto binT = measureParse(numIters, [&bin] {
+      return ParseVCSDisplayListBinary(bin.data(), bin.size());
+    });
+
+    totalJsonBytes += json.size();
+    totalBinBytes += bin.size();
+    totalJson_s += jsonT.median_s;
+    totalBin_s += binT.median_s;
+
+    std::cout << path.filename().string() << ":" << std::endl;
+    std::cout << "  json   " << std::setw(7) << json.size() << " bytes, median "
+              << jsonT.median_s * 1.0e6 << " us, min " << jsonT.min_s * 1.0e6 << " us, "
+              << mbPerSec(json.size(), jsonT.median_s) << " MB/s" << std::endl;
+    std::cout << "  binary " << std::setw(7) << bin.size() << " bytes, median "
+              << binT.median_s * 1.0e6 << " us, min " << binT.min_s * 1.0e6 << " us, "
+              << mbPerSec(bin.size(), binT.median_s) << " MB/s" << std::endl;
+    std::cout << "  speedup " << (binT.median_s > 0.0 ? jsonT.median_s / binT.median_s : 0.0) << "x" << std::endl;
+  }
+
+  if (totalJson_s > 0.0 && totalBin_s > 0.0) {
+    std::cout << "\nTotal: json " << totalJsonBytes << " bytes in " << totalJson_s * 1.0e6 << " us, "
+              << "binary " << totalBinBytes << " bytes in " << totalBin_s * 1.0e6 << " us, "
+              << "speedup " << totalJson_s / totalBin_s << "x" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include "canvex_raster_bands.h"
+#include <algorithm>
+
+namespace canvex {
+
+std::vector<SkIRect> MakeRasterBands(const SkIRect& area, int numBands) {
+  const int h = area.height();
+  numBands = std::max(1, std::min(numBands, h / kMinRasterBandHeight));
+
+  std::vector<SkIRect> bands;
+  bands.reserve(numBands);
+  for (int i = 0; i < numBands; i++) {
+    const int top = area.top() + (int)((int64_t)h * i / numBands);
+    const int bottom = area.top() + (int)((int64_t)h * (i + 1) / numBands);
+    bands.push_back(SkIRect::MakeLTRB(area.left(), top, area.right(), bottom));
+  }
+  return bands;
+}
+
+RasterBandPool::RasterBandPool(int numBands) : numBands_(std::max(1, numBands)) {
+  for (int i = 1; i < numBands_; i++) {
+    threads_.emplace_back(&RasterBandPool::workerLoop_, this);
+  }
+}
+
+RasterBandPool::~RasterBandPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  workCond_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+void RasterBandPool::run(int numTasks, const std::function<void(int)>& fn) {
+  if (numTasks < 1) return;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_ = &fn;
+  numTasks_ = numTasks;
+  nextTask_ = 0;
+  numTasksDone_ = 0;
+  workCond_.notify_all();
+
+  runTasks_(lock);
+
+  doneCond_.wait(lock, [this] { return numTasksDone_ == numTasks_; });
+  job_ = nullptr;
+}
+
+// takes tasks until none are left. called and returns with the lock held.
+void RasterBandPool::runTasks_(std::unique_lock<std::mutex>& lock) {
+  while (job_ && nextTask_ < numTasks_) {
+    const int task = nextTask_++;
+    const auto* fn = job_;
+
+    lock.unlock();
+    (*fn)(task);
+    lock.lock();
+
+    if (++numTasksDone_ == numTasks_) {
+      doneCond_.notify_all();
+    }
+  }
+}
+
+void RasterBandPool::workerLoop_() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    workCond_.wait(lock, [this] { return stopping_ || (job_ && nextTask_ < numTasks_); });
+    if (stopping_) return;
+
+    runTasks_(lock);
+  }
+}
+
+} // namespace canvex
@@ -0,0 +1,65 @@
+#pragma once
+#include "skia_includes.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace canvex {
+
+/*
+  Parallel rasterization of one display list into horizontal bands.
+
+  The display list is executed once on the render thread into an SkPicture,
+  so all resource context access (image decoding, text shaping, caches) stays single-threaded.
+  The picture is then played back by several threads, each into its own band of
+  the destination buffer. Every band canvas covers the whole buffer and is only clipped
+  to its rows, so device coordinates and therefore pixels are the same as in a serial render.
+*/
+
+// bands shorter than this aren't worth a thread
+constexpr int kMinRasterBandHeight = 64;
+
+constexpr int kMaxRasterBands = 64;
+
+// Splits the area into at most numBands full-width row ranges of nearly equal height.
+std::vector<SkIRect> MakeRasterBands(const SkIRect& area, int numBands);
+
+class RasterBandPool {
+ public:
+  // the thread calling run() also executes tasks, so it uses one thread less than numBands
+  explicit RasterBandPool(int numBands);
+  ~RasterBandPool();
+
+  RasterBandPool(const RasterBandPool&) = delete;
+  RasterBandPool& operator=(const RasterBandPool&) = delete;
+
+  int numBands() const {
+    return numBands_;
+  }
+
+  // calls fn(i) for each i in [0, numTasks) on the pool and the calling thread.
+  // returns when all calls have finished.
+  void run(int numTasks, const std::function<void(int)>& fn);
+
+ private:
+  const int numBands_;
+
+  std::mutex mutex_;
+  std::condition_variable workCond_;
+  std::condition_variable doneCond_;
+  bool stopping_ = false;
+
+  const std::function<void(int)>* job_ = nullptr;
+  int numTasks_ = 0;
+  int nextTask_ = 0;
+  int numTasksDone_ = 0;
+
+  std::vector<std::thread> threads_;
+
+  void workerLoop_();
+  void runTasks_(std::unique_lock<std::mutex>& lock);
+};
+
+} // namespace canvex
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "canvex_bench_harness.h"
+#include "file_util.h"
+
+/*
+  Benchmark for banded parallel rasterization.
+
+  Each display list is rendered into a raw RGBA buffer, first directly on one thread
+  and then split into each of the given band counts. Every banded result is compared
+  against the single-threaded one, and any difference is reported as a failure.
+
+  Usage:
+    canvex_raster_bench [-n iterations] [-s WxH] [-b 2,4,8] [-r resource_dir] [file.json ...]
+
+  The default output size is 3840x2160, and display lists are scaled to fill it.
+  With no files given, all JSON files in example-data are used.
+*/
+
+using namespace canvex;
+
+// enough renders for the group cache to reach its steady state of replaying rasterized groups
+constexpr int kNumWarmupRenders = 6;
+
+struct RenderTimings {
+  double median_s;
+  double min_s;
+  double record_median_s;
+};
+
+static RenderTimings measureRender(int numIters, const VCSCanvasDisplayList& dl,
+                                   BenchTarget& t, CanvexSkiaResourceContext& resCtx) {
+  const auto stats = measureBenchRenders(numIters, dl, t, resCtx);
+  std::vector<double> recordTimes;
+  for (const auto& s : stats) {
+    recordTimes.push_back((double)s.raster_band_record_us);
+  }
+  const auto times = computePercentiles(renderTimesUs(stats));
+  return {times.p50 / 1.0e6, times.min / 1.0e6, computePercentiles(recordTimes).p50 / 1.0e6};
+}
+
+static int64_t countDifferingPixels(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+  int64_t n = 0;
+  for (size_t i = 0; i + 4 <= a.size(); i += 4) {
+    if (memcmp(&a[i], &b[i], 4) != 0) n++;
+  }
+  return n;
+}
+
+static std::vector<int> parseBandCounts(const std::string& s) {
+  std::vector<int> counts;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    const int n = atoi(item.c_str());
+    if (n > 1) counts.push_back(n);
+  }
+  return counts;
+}
+
+int main(int argc, char* argv[]) {
+  BenchOptions opts;
+  opts.numIters = 20;
+  opts.w = 3840;
+  opts.h = 2160;
+  std::vector<int> bandCounts = {2, 4, 8};
+
+  auto parseArg = [&bandCounts](const std::string& arg, int argc, char* argv[], int& i) {
+    if (arg == "-b" && i + 1 < argc) {
+      bandCounts = parseBandCounts(argv[++i]);
+      return true;
+    }
+    return false;
+  };
+  if (!parseBenchArgs(argc, argv, "canvex_raster_bench [-n iterations] [-s WxH] [-b 2,4,8] [-r resource_dir] [file.json ...]",
+                      opts, parseArg)) {
+    return 1;
+  }
+  if (opts.paths.empty()) {
+    opts.paths = listExampleDisplayLists();
+  }
+  if (opts.paths.empty()) {
+    std::cerr << "No input files (run from the canvex dir, or pass JSON paths as arguments)" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Banded raster benchmark, " << opts.w << "x" << opts.h << ", "
+            << opts.numIters << " iterations per configuration" << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+
+  std::vector<double> totalBanded_s(bandCounts.size(), 0.0);
+  double totalSerial_s = 0.0;
+  int numMismatches = 0;
+
+  for (const auto& path : opts.paths) {
+    std::unique_ptr<VCSCanvasDisplayList> dl;
+    try {
+      dl = ParseVCSDisplayListJSON(readTextFile(path.string()));
+    } catch (std::exception& e) {
+      std::cerr << "Skipping " << path << ": " << e.what() << std::endl;
+      continue;
+    }
+
+    BenchTarget target(opts.w, opts.h, opts.resourceDir);
+    target.clearGroupCache = false;
+    target.numWarmupRenders = kNumWarmupRenders;
+    auto& buffer = target.buffer;
+
+    // one resource context per file, so that the configurations render with the same cached state
+    CanvexSkiaResourceContext resCtx;
+
+    resCtx.numRasterBands = 1;
+    auto serialT = measureRender(opts.numIters, *dl, target, resCtx);
+    const std::vector<uint8_t> reference = buffer;
+    totalSerial_s += serialT.median_s;
+
+    std::cout << path.filename().string() << " (" << dl->cmds.size() << " cmds):" << std::endl;
+    std::cout << "  serial    median " << serialT.median_s * 1.0e3 << " ms, min "
+              << serialT.min_s * 1.0e3 << " ms" << std::endl;
+
+    for (size_t i = 0; i < bandCounts.size(); i++) {
+      resCtx.numRasterBands = bandCounts[i];
+      std::fill(buffer.begin(), buffer.end(), 0);
+      auto bandedT = measureRender(opts.numIters, *dl, target, resCtx);
+      totalBanded_s[i] += bandedT.median_s;
+
+      const int64_t numDiffering = countDifferingPixels(reference, buffer);
+      if (numDiffering > 0) numMismatches++;
+
+      std::cout << "  " << std::setw(2) << bandCounts[i] << " bands  median " << bandedT.median_s * 1.0e3
+                << " ms (record " << bandedT.record_median_s * 1.0e3 << " ms), min "
+                << bandedT.min_s * 1.0e3 << " ms, speedup "
+                << (bandedT.median_s > 0.0 ? serialT.median_s / bandedT.median_s : 0.0) << "x";
+      if (numDiffering > 0) {
+        std::cout << ", ** " << numDiffering << " pixels differ from serial";
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  if (totalSerial_s > 0.0) {
+    std::cout << "\nTotal: serial " << totalSerial_s * 1.0e3 << " ms";
+    for (size_t i = 0; i < bandCounts.size(); i++) {
+      std::cout << ", " << bandCounts[i] << " bands " << totalBanded_s[i] * 1.0e3 << " ms ("
+                << (totalBanded_s[i] > 0.0 ? totalSerial_s / totalBanded_s[i] : 0.0) << "x)";
+    }
+    std::cout << std::endl;
+  }
+
+  if (numMismatches > 0) {
+    std::cerr << "** " << numMismatches << " banded renders differ from the serial output" << std::endl;
+    return 2;
+  }
+  return 0;
+}
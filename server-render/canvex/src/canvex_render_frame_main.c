@@ -1,7 +1,10 @@
+#define _POSIX_C_SOURCE 200809L
 #include "../include/canvex_c_api.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -14,15 +17,44 @@
   Takes an image size + a JSON and produces a PNG.
 
   This program is useful for automated tests.
+
+  Batch mode renders many display lists in one process:
+
+    canvex_render_frame --batch <manifest|-> [-r renderThreads] [-j encodeThreads] [-z pngLevel] [-b rasterBands]
+
+  Each line of the manifest (or stdin with "-") is a job in the same form as the single-frame arguments:
+    <width> <height> <input JSON path> <output PNG path>
+  Paths can't contain whitespace. Empty lines and lines starting with '#' are skipped.
+
+  The main thread reads jobs and hands them to a pool of render threads. Each render thread has
+  its own resource context, and the contexts share one SharedResourceCache, so fonts and images
+  are still loaded once. Rendered frames go on to a pool of PNG encode threads.
+  Jobs finish out of order: when a job is done, a line "ok <output>" or "error <code> <output>"
+  is written to stdout, so a driver process can keep the renderer running and feed it jobs through stdin.
+  Throughput is reported on stderr at the end.
 */
 
+// jobs waiting for a thread, per thread, before the stage feeding them waits
+#define QUEUE_DEPTH_PER_THREAD 2
+#define MAX_ENCODE_THREADS 64
+#define MAX_RENDER_THREADS 64
+#define MAX_IMAGE_DIM 32768
 
+
+static double getMonotonicTime(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+// compressionLevel is zlib's 0-9, or -1 for the libpng default
 static int writePNG_RGBA(
   const char *filename,
   int w,
   int h,
   const uint8_t *data,
-  size_t rowBytes
+  size_t rowBytes,
+  int compressionLevel
 ) {
   if (w < 1 || h < 1) return 1;
 
@@ -30,12 +62,24 @@ static int writePNG_RGBA(
   if(!fp) return 2;
 
   png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-  png_infop info = png_create_info_struct(png);
-  if (!png || !info) return 3;
-  if (setjmp(png_jmpbuf(png))) return 3;
+  png_infop info = png ? png_create_info_struct(png) : NULL;
+  if (!png || !info) {
+    png_destroy_write_struct(&png, &info);
+    fclose(fp);
+    return 3;
+  }
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    fclose(fp);
+    return 3;
+  }
 
   png_init_io(png, fp);
 
+  if (compressionLevel >= 0) {
+    png_set_compression_level(png, compressionLevel);
+  }
+
   png_set_IHDR(
     png, info,
     w, h, 8,
@@ -46,11 +90,9 @@ static int writePNG_RGBA(
   );
   png_write_info(png, info);
 
-  png_bytep rowPointers[h];
   for (int i = 0; i < h; i++) {
-    rowPointers[i] = (png_bytep)(data + i * rowBytes);
+    png_write_row(png, (png_const_bytep)(data + i * rowBytes));
   }
-  png_write_image(png, rowPointers);
   png_write_end(png, NULL);
   png_destroy_write_struct(&png, &info);
 
@@ -79,15 +121,377 @@ static int testWrite() {
     }
   }
 
-  return writePNG_RGBA("testwrite.png", w, h, buf, rowBytes);
+  return writePNG_RGBA("testwrite.png", w, h, buf, rowBytes, -1);
 }
 */
 
+// returns a null-terminated copy of the file, or NULL on error
+static char *readTextFile(const char *path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return NULL;
+
+  struct stat sb;
+  if (fstat(fileno(f), &sb) != 0) {
+    fclose(f);
+    return NULL;
+  }
+
+  char *text = malloc(sb.st_size + 1);
+  text[sb.st_size] = 0;
+  if (sb.st_size > 0 && 1 != fread(text, sb.st_size, 1, f)) {
+    free(text);
+    text = NULL;
+  }
+  fclose(f);
+  return text;
+}
+
+
+// -- batch mode --
+
+typedef struct RenderJob {
+  int w;
+  int h;
+  char *jsonPath;
+  char *pngPath;
+  uint8_t *buf; // rendered RGBA, owned by the job
+} RenderJob;
+
+// ring buffer of jobs, used under BatchState.mutex
+typedef struct JobQueue {
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+
+  RenderJob *jobs;
+  int capacity;
+  int start;
+  int count;
+  int finishedAdding;
+} JobQueue;
+
+typedef struct BatchState {
+  pthread_mutex_t mutex;
+
+  JobQueue renderQueue; // parsed jobs waiting for a render thread
+  JobQueue encodeQueue; // rendered jobs waiting for an encode thread
+
+  int compressionLevel;
+
+  // counters, updated under the mutex
+  long numOk;
+  long numFailed;
+  double encodeTotal_s;
+} BatchState;
+
+static void freeJob(RenderJob *job) {
+  free(job->jsonPath);
+  free(job->pngPath);
+  free(job->buf);
+  memset(job, 0, sizeof(*job));
+}
+
+// called with the mutex held
+static void reportJobResult(BatchState *state, const RenderJob *job, int err) {
+  if (err == 0) {
+    state->numOk++;
+    printf("ok %s\n", job->pngPath);
+  } else {
+    state->numFailed++;
+    printf("error %d %s\n", err, job->pngPath);
+  }
+  fflush(stdout);
+}
+
+static void initQueue(JobQueue *q, int capacity) {
+  memset(q, 0, sizeof(*q));
+  pthread_cond_init(&q->notEmpty, NULL);
+  pthread_cond_init(&q->notFull, NULL);
+  q->capacity = capacity;
+  q->jobs = calloc(capacity, sizeof(RenderJob));
+}
+
+static void destroyQueue(JobQueue *q) {
+  free(q->jobs);
+  pthread_cond_destroy(&q->notFull);
+  pthread_cond_destroy(&q->notEmpty);
+}
+
+// called with the mutex held. waits while the queue is full.
+static void pushJob(BatchState *state, JobQueue *q, RenderJob job) {
+  while (q->count == q->capacity) {
+    pthread_cond_wait(&q->notFull, &state->mutex);
+  }
+  q->jobs[(q->start + q->count) % q->capacity] = job;
+  q->count++;
+  pthread_cond_signal(&q->notEmpty);
+}
+
+// called with the mutex held. waits for a job, and returns 0 once the queue is finished and empty.
+static int popJob(BatchState *state, JobQueue *q, RenderJob *job) {
+  while (q->count == 0 && !q->finishedAdding) {
+    pthread_cond_wait(&q->notEmpty, &state->mutex);
+  }
+  if (q->count == 0) return 0;
+
+  *job = q->jobs[q->start];
+  q->start = (q->start + 1) % q->capacity;
+  q->count--;
+  pthread_cond_signal(&q->notFull);
+  return 1;
+}
+
+static void finishQueue(BatchState *state, JobQueue *q) {
+  pthread_mutex_lock(&state->mutex);
+  q->finishedAdding = 1;
+  pthread_cond_broadcast(&q->notEmpty);
+  pthread_mutex_unlock(&state->mutex);
+}
+
+typedef struct RenderWorker {
+  BatchState *state;
+  CanvexResourceCtx ctx;
+  pthread_t thread;
+  double renderTotal_s;
+} RenderWorker;
+
+static int renderJob(CanvexResourceCtx ctx, RenderJob *job) {
+  char *json = readTextFile(job->jsonPath);
+  if (!json) {
+    fprintf(stderr, "** Unable to read %s\n", job->jsonPath);
+    return CanvexRenderError_InvalidArgument_JSONInput;
+  }
+  job->buf = malloc((size_t)job->w * 4 * job->h);
+  const int err = CanvexRenderJSON_RGBA(
+    ctx,
+    json,
+    job->buf, job->w, job->h, job->w * 4, CANVEX_PREMULTIPLIED, NULL
+  );
+  free(json);
+  return err;
+}
+
+static void *renderThreadMain(void *arg) {
+  RenderWorker *worker = arg;
+  BatchState *state = worker->state;
+
+  RenderJob job;
+  pthread_mutex_lock(&state->mutex);
+  while (popJob(state, &state->renderQueue, &job)) {
+    pthread_mutex_unlock(&state->mutex);
+
+    const double t0 = getMonotonicTime();
+    const int err = renderJob(worker->ctx, &job);
+    worker->renderTotal_s += getMonotonicTime() - t0;
+
+    pthread_mutex_lock(&state->mutex);
+    if (err != CanvexRenderSuccess) {
+      reportJobResult(state, &job, err);
+      freeJob(&job);
+    } else {
+      pushJob(state, &state->encodeQueue, job);
+    }
+  }
+  pthread_mutex_unlock(&state->mutex);
+  return NULL;
+}
+
+static void *encodeThreadMain(void *arg) {
+  BatchState *state = arg;
+
+  RenderJob job;
+  pthread_mutex_lock(&state->mutex);
+  while (popJob(state, &state->encodeQueue, &job)) {
+    pthread_mutex_unlock(&state->mutex);
+
+    const double t0 = getMonotonicTime();
+    const int err = writePNG_RGBA(job.pngPath, job.w, job.h, job.buf, job.w * 4, state->compressionLevel);
+    const double t1 = getMonotonicTime();
+
+    pthread_mutex_lock(&state->mutex);
+    state->encodeTotal_s += t1 - t0;
+    reportJobResult(state, &job, err ? -1 : 0); // -1 for PNG write errors
+    freeJob(&job);
+  }
+  pthread_mutex_unlock(&state->mutex);
+  return NULL;
+}
+
+// parses "<w> <h> <json> <png>" into job. returns 0 if the line is empty or a comment, -1 if invalid.
+static int parseJobLine(char *line, RenderJob *job) {
+  char *savePtr = NULL;
+  char *tokens[4];
+  int n = 0;
+  for (char *tok = strtok_r(line, " \t\r\n", &savePtr); tok && n < 4; tok = strtok_r(NULL, " \t\r\n", &savePtr)) {
+    tokens[n++] = tok;
+  }
+  if (n == 0 || tokens[0][0] == '#') return 0;
+  if (n < 4) return -1;
+
+  job->w = strtol(tokens[0], NULL, 10);
+  job->h = strtol(tokens[1], NULL, 10);
+  if (job->w < 1 || job->h < 1 || job->w > MAX_IMAGE_DIM || job->h > MAX_IMAGE_DIM) return -1;
+
+  job->jsonPath = strdup(tokens[2]);
+  job->pngPath = strdup(tokens[3]);
+  return 1;
+}
+
+static int runBatch(const char *manifestPath, int numRenderThreads, int numEncodeThreads,
+                    int compressionLevel, int numRasterBands) {
+  FILE *input = stdin;
+  if (strcmp(manifestPath, "-") != 0) {
+    input = fopen(manifestPath, "r");
+    if (!input) {
+      fprintf(stderr, "** Unable to open manifest %s\n", manifestPath);
+      return 1;
+    }
+  }
+
+  BatchState state;
+  memset(&state, 0, sizeof(state));
+  pthread_mutex_init(&state.mutex, NULL);
+  initQueue(&state.renderQueue, numRenderThreads * QUEUE_DEPTH_PER_THREAD);
+  initQueue(&state.encodeQueue, numEncodeThreads * QUEUE_DEPTH_PER_THREAD);
+  state.compressionLevel = compressionLevel;
+
+  pthread_t encodeThreads[MAX_ENCODE_THREADS];
+  for (int i = 0; i < numEncodeThreads; i++) {
+    pthread_create(&encodeThreads[i], NULL, encodeThreadMain, &state);
+  }
+
+  // the contexts keep the shared cache alive, so the local reference is released right away
+  CanvexSharedResourceCache sharedCache = CanvexSharedResourceCacheCreate(0);
+  RenderWorker workers[MAX_RENDER_THREADS];
+  for (int i = 0; i < numRenderThreads; i++) {
+    RenderWorker *worker = &workers[i];
+    memset(worker, 0, sizeof(*worker));
+    worker->state = &state;
+    worker->ctx = CanvexResourceCtxCreate(NULL);
+    CanvexResourceCtxAttachSharedCache(worker->ctx, sharedCache);
+    if (numRasterBands > 1) {
+      CanvexResourceCtxSetRasterBands(worker->ctx, numRasterBands);
+    }
+    pthread_create(&worker->thread, NULL, renderThreadMain, worker);
+  }
+  CanvexSharedResourceCacheDestroy(sharedCache); sharedCache = NULL;
+
+  const double t0 = getMonotonicTime();
+  long lineNo = 0;
+
+  char *line = NULL;
+  size_t lineCap = 0;
+  while (getline(&line, &lineCap, input) > 0) {
+    lineNo++;
+
+    RenderJob job;
+    memset(&job, 0, sizeof(job));
+    const int parsed = parseJobLine(line, &job);
+    if (parsed == 0) continue;
+    if (parsed < 0) {
+      fprintf(stderr, "** Invalid job on line %ld, expected: width height input.json output.png\n", lineNo);
+      pthread_mutex_lock(&state.mutex);
+      state.numFailed++;
+      pthread_mutex_unlock(&state.mutex);
+      freeJob(&job);
+      continue;
+    }
+
+    pthread_mutex_lock(&state.mutex);
+    pushJob(&state, &state.renderQueue, job);
+    pthread_mutex_unlock(&state.mutex);
+  }
+  free(line);
+  if (input != stdin) fclose(input);
+
+  // the render threads finish before the encode queue is closed, since they still add to it
+  finishQueue(&state, &state.renderQueue);
+  double renderTotal_s = 0;
+  for (int i = 0; i < numRenderThreads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    renderTotal_s += workers[i].renderTotal_s;
+    CanvexResourceCtxDestroy(workers[i].ctx); workers[i].ctx = NULL;
+  }
+
+  finishQueue(&state, &state.encodeQueue);
+  for (int i = 0; i < numEncodeThreads; i++) {
+    pthread_join(encodeThreads[i], NULL);
+  }
+  const double elapsed_s = getMonotonicTime() - t0;
+
+  const long numFrames = state.numOk + state.numFailed;
+  fprintf(stderr, "Batch done: %ld frames (%ld failed) in %.3f s, %.2f fps\n",
+          numFrames, state.numFailed, elapsed_s, (elapsed_s > 0) ? state.numOk / elapsed_s : 0.0);
+  if (state.numOk > 0) {
+    fprintf(stderr, "  render %.2f ms/frame on %d threads, PNG encode %.2f ms/frame on %d threads\n",
+            renderTotal_s * 1000.0 / numFrames, numRenderThreads,
+            state.encodeTotal_s * 1000.0 / state.numOk, numEncodeThreads);
+  }
+
+  destroyQueue(&state.encodeQueue);
+  destroyQueue(&state.renderQueue);
+  pthread_mutex_destroy(&state.mutex);
+
+  return (state.numFailed > 0) ? 2 : 0;
+}
+
+static int batchMain(int argc, char *argv[]) {
+  const char *manifestPath = NULL;
+  long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (numCpus < 1) numCpus = 1;
+  if (numCpus > MAX_RENDER_THREADS + MAX_ENCODE_THREADS) numCpus = MAX_RENDER_THREADS + MAX_ENCODE_THREADS;
+  // by default the cores are split evenly, since rendering and encoding a frame take similar time
+  int numRenderThreads = (numCpus + 1) / 2;
+  int numEncodeThreads = (numCpus > 1) ? (int)numCpus / 2 : 1;
+  int compressionLevel = -1;
+  int numRasterBands = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      manifestPath = argv[++i];
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      numRenderThreads = strtol(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      numEncodeThreads = strtol(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+      compressionLevel = strtol(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      numRasterBands = strtol(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "** Unknown argument: %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (!manifestPath) {
+    fprintf(stderr, "** --batch expects a manifest path, or - for stdin\n");
+    return 1;
+  }
+  if (numRenderThreads < 1 || numRenderThreads > MAX_RENDER_THREADS) {
+    fprintf(stderr, "** Invalid number of render threads %d\n", numRenderThreads);
+    return 1;
+  }
+  if (numEncodeThreads < 1 || numEncodeThreads > MAX_ENCODE_THREADS) {
+    fprintf(stderr, "** Invalid number of encode threads %d\n", numEncodeThreads);
+    return 1;
+  }
+  if (compressionLevel > 9) {
+    fprintf(stderr, "** Invalid PNG compression level %d, expected 0-9\n", compressionLevel);
+    return 1;
+  }
+
+  return runBatch(manifestPath, numRenderThreads, numEncodeThreads, compressionLevel, numRasterBands);
+}
+
+
 int main(int argc, char *argv[]) {
   // return testWrite();
 
+  if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+    return batchMain(argc, argv);
+  }
+
   if (argc < 5) {
     printf("Expected arguments: 1) image width, 2) image height, 3) input JSON path, 4) output PNG path.\n");
+    printf("Or for batch mode: --batch <manifest path, or - for stdin> [-r renderThreads] [-j encodeThreads] [-z pngLevel] [-b rasterBands]\n");
     return 1;
   }
   int w = strtol(argv[1], NULL, 10);
@@ -95,28 +499,17 @@ int main(int argc, char *argv[]) {
   const char *jsonPath = argv[3];
   const char *pngPath = argv[4];
 
-  if (w < 0 || h < 0 || w > 32768 || h > 32768) {
+  if (w < 0 || h < 0 || w > MAX_IMAGE_DIM || h > MAX_IMAGE_DIM) {
     printf("** Invalid image size specified (%d * %d).\n", w, h);
     return 1;
   }
 
-  FILE* f = fopen(jsonPath, "r");
-  if (!f) {
-    printf("** Unable to open %s\n", jsonPath);
+  char *json = readTextFile(jsonPath);
+  if (!json) {
+    printf("** Unable to read %s\n", jsonPath);
     return CanvexRenderError_InvalidArgument_JSONInput;
   }
 
-  struct stat sb;
-  stat(jsonPath, &sb);
-
-  char *json = malloc(sb.st_size + 1);
-  json[sb.st_size] = 0;
-  if (1 != fread(json, sb.st_size, 1, f)) {
-    printf("Reading JSON file failed (fread)\n");
-    return CanvexRenderError_InvalidArgument_JSONInput;
-  }
-  fclose(f); f = NULL;
-
   int rowBytes = w * 4;
   uint8_t *buf = malloc(rowBytes * h);
 
@@ -136,8 +529,7 @@ int main(int argc, char *argv[]) {
     return renderRes;
   }
 
-  writePNG_RGBA(pngPath, w, h, buf, rowBytes);
+  writePNG_RGBA(pngPath, w, h, buf, rowBytes, -1);
 
   return 0;
 }
-
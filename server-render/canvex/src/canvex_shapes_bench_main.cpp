@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "canvex_bench_harness.h"
+#include "file_util.h"
+
+/*
+  Benchmark for the analytic rect and rounded rect paths.
+
+  Each display list is rendered into a raw RGBA buffer with paths drawn as general paths,
+  and then with rect and rounded rect paths drawn as Skia shapes. The group cache is cleared
+  before every render, so the commands are executed each time as they are for changing content.
+
+  The outputs aren't expected to be bit-identical: Skia can antialias a shape's edges slightly
+  differently from the same outline as a path. The number of differing pixels and the largest
+  channel difference are printed for checking that the differences stay at the edges.
+
+  Usage:
+    canvex_shapes_bench [-n iterations] [-s WxH] [-r resource_dir] [file.json ...]
+
+  The default output size is 1920x1080, and display lists are scaled to fill it.
+  With no files given, the example-data display lists that clip and fill rounded rects are used.
+*/
+
+using namespace canvex;
+
+static double measureMedian(int numIters, const VCSCanvasDisplayList& dl,
+                            BenchTarget& t, CanvexSkiaResourceContext& resCtx) {
+  return computePercentiles(renderTimesUs(measureBenchRenders(numIters, dl, t, resCtx))).p50 / 1.0e6;
+}
+
+int main(int argc, char* argv[]) {
+  BenchOptions opts;
+  opts.numIters = 50;
+  if (!parseBenchArgs(argc, argv, "canvex_shapes_bench [-n iterations] [-s WxH] [-r resource_dir] [file.json ...]", opts)) {
+    return 1;
+  }
+  if (opts.paths.empty()) {
+    opts.paths = {"example-data/rounded-sidebar.json", "example-data/background-clip.json"};
+  }
+
+  std::cout << "Analytic shapes benchmark, " << opts.w << "x" << opts.h << ", "
+            << opts.numIters << " iterations per configuration" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+
+  double totalPath_s = 0.0, totalShapes_s = 0.0;
+
+  for (const auto& path : opts.paths) {
+    std::unique_ptr<VCSCanvasDisplayList> dl;
+    try {
+      dl = ParseVCSDisplayListJSON(readTextFile(path.string()));
+    } catch (std::exception& e) {
+      std::cerr << "Skipping " << path << ": " << e.what() << std::endl;
+      continue;
+    }
+
+    BenchTarget target(opts.w, opts.h, opts.resourceDir);
+    const auto& buffer = target.buffer;
+    CanvexSkiaResourceContext resCtx;
+
+    resCtx.useAnalyticShapes = false;
+    const double path_s = measureMedian(opts.numIters, *dl, target, resCtx);
+    const std::vector<uint8_t> reference = buffer;
+
+    resCtx.useAnalyticShapes = true;
+    const double shapes_s = measureMedian(opts.numIters, *dl, target, resCtx);
+
+    int64_t numDiffering = 0;
+    int maxDiff = 0;
+    for (size_t i = 0; i + 4 <= buffer.size(); i += 4) {
+      int pixelDiff = 0;
+      for (size_t c = 0; c < 4; c++) {
+        pixelDiff = std::max(pixelDiff, std::abs((int)buffer[i + c] - (int)reference[i + c]));
+      }
+      if (pixelDiff > 0) numDiffering++;
+      maxDiff = std::max(maxDiff, pixelDiff);
+    }
+
+    totalPath_s += path_s;
+    totalShapes_s += shapes_s;
+
+    std::cout << path.filename().string() << " (" << dl->cmds.size() << " cmds):" << std::endl;
+    std::cout << "  paths   median " << path_s * 1.0e3 << " ms" << std::endl;
+    std::cout << "  shapes  median " << shapes_s * 1.0e3 << " ms, speedup "
+              << (shapes_s > 0.0 ? path_s / shapes_s : 0.0) << "x, "
+              << numDiffering << " pixels differ (max " << maxDiff << ")" << std::endl;
+  }
+
+  if (totalShapes_s > 0.0) {
+    std::cout << "\nTotal: paths " << totalPath_s * 1.0e3 << " ms, shapes " << totalShapes_s * 1.0e3
+              << " ms (" << totalPath_s / totalShapes_s << "x)" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include "canvex_shared_resource_cache.h"
+#include "hash_util.h"
+
+namespace canvex {
+
+SharedResourceCache::SharedResourceCache(size_t maxImageBytes) : images_(maxImageBytes) {}
+
+size_t SharedResourceCache::stripeIndex_(const std::string& key) {
+  return Hasher().add(key).value() % kNumStripes;
+}
+
+sk_sp<SkTypeface> SharedResourceCache::getTypeface(const std::filesystem::path& fontPath) {
+  const std::string key = fontPath.string();
+  auto& stripe = typefaceStripes_[stripeIndex_(key)];
+  {
+    std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+    auto it = stripe.typefaces.find(key);
+    if (it != stripe.typefaces.end()) {
+      return it->second;
+    }
+  }
+
+  // loaded while holding the stripe exclusively, so that sessions starting at the same time
+  // don't all load the same file
+  std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+  auto it = stripe.typefaces.find(key);
+  if (it != stripe.typefaces.end()) {
+    return it->second;
+  }
+  auto data = mapFile(fontPath);
+  auto typeface = data ? SkTypeface::MakeFromData(data) : nullptr;
+  if (typeface) {
+    stripe.typefaces.emplace(key, typeface);
+  }
+  return typeface;
+}
+
+std::optional<CachedImage> SharedResourceCache::getImage(ImageSourceType type, const std::filesystem::path& path) {
+  std::lock_guard<std::mutex> lock(imagesMutex_);
+  if (auto cached = images_.get(type, path.string())) {
+    return *cached;
+  }
+  return std::nullopt;
+}
+
+void SharedResourceCache::putImage(ImageSourceType type, const std::filesystem::path& path, CachedImage entry) {
+  const std::string key = path.string();
+
+  std::lock_guard<std::mutex> lock(imagesMutex_);
+  if (auto cached = images_.get(type, key)) {
+    if (cached->image && cached->scale > entry.scale) {
+      return;
+    }
+  }
+  images_.put(type, key, std::move(entry));
+}
+
+void SharedResourceCache::setMaxImageBytes(size_t maxBytes) {
+  std::lock_guard<std::mutex> lock(imagesMutex_);
+  images_.setMaxBytes(maxBytes);
+}
+
+size_t SharedResourceCache::imageBytes() {
+  std::lock_guard<std::mutex> lock(imagesMutex_);
+  return images_.totalBytes();
+}
+
+int64_t SharedResourceCache::numImageEvictions() {
+  std::lock_guard<std::mutex> lock(imagesMutex_);
+  return images_.numEvictions();
+}
+
+size_t SharedResourceCache::numTypefaces() {
+  size_t n = 0;
+  for (auto& stripe : typefaceStripes_) {
+    std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+    n += stripe.typefaces.size();
+  }
+  return n;
+}
+
+sk_sp<SkData> SharedResourceCache::mapFile(const std::filesystem::path& path, bool willNeed) {
+  std::lock_guard<std::mutex> lock(mappedFilesMutex_);
+  return mappedFiles_.map(path, willNeed);
+}
+
+sk_sp<SkData> SharedResourceCache::getMappedFile(const std::filesystem::path& path) {
+  std::lock_guard<std::mutex> lock(mappedFilesMutex_);
+  return mappedFiles_.get(path);
+}
+
+void SharedResourceCache::addMappedFile(const std::filesystem::path& path, sk_sp<SkData> data) {
+  std::lock_guard<std::mutex> lock(mappedFilesMutex_);
+  mappedFiles_.add(path, std::move(data));
+}
+
+size_t SharedResourceCache::mappedFileBytes() {
+  std::lock_guard<std::mutex> lock(mappedFilesMutex_);
+  return mappedFiles_.mappedBytes();
+}
+
+size_t SharedResourceCache::numMappedFiles() {
+  std::lock_guard<std::mutex> lock(mappedFilesMutex_);
+  return mappedFiles_.numFiles();
+}
+
+} // namespace canvex
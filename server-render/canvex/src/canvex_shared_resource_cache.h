@@ -0,0 +1,102 @@
+#pragma once
+#include "canvex_image_cache.h"
+#include "canvex_mapped_files.h"
+#include "skia_includes.h"
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace canvex {
+
+/*
+  Typefaces and decoded images shared by many resource contexts, e.g. all the render sessions
+  in one process, so that each session doesn't hold its own copy of every font and image.
+
+  Unlike the rest of the resource context, this is safe to use from many render threads at once:
+    - typefaces are read-mostly and loaded once, so they're spread over a fixed number of stripes by key,
+      each with a shared lock for lookups, and renders that look up different fonts rarely wait on each other;
+    - images are in one ImageCache behind one lock, so the whole byte budget applies to all of them
+      and a few large images can't evict each other while the cache is far under budget.
+      Lookups only hold the lock for a hash lookup and an LRU update; decoding happens outside it.
+
+  Only resources that don't change while a render server is running are shared: fonts, and images
+  from the default and composition assets. Both are keyed by their file path, so contexts with
+  different resource dirs don't see each other's files. Live assets and shared memory frames stay
+  in each context's own namespace, since they're reloaded whenever their writer updates them.
+
+  Files are mapped read-only (see MapFileReadOnly), so their pages are also shared with other processes.
+  The cache keeps one set of mappings for all its contexts: fonts it loads are mapped into it,
+  and a context's own mappings (e.g. from its preload manifest) are handed over when it's attached,
+  so a file is mapped once and every lookup sees the preloaded mapping.
+
+  Skia typefaces and raster images are immutable and can be drawn from several threads,
+  so lookups simply return a new reference to the shared object.
+*/
+
+class SharedResourceCache {
+ public:
+  static constexpr int kNumStripes = 16;
+
+  explicit SharedResourceCache(size_t maxImageBytes = ImageCache::kDefaultMaxBytes);
+
+  SharedResourceCache(const SharedResourceCache&) = delete;
+  SharedResourceCache& operator=(const SharedResourceCache&) = delete;
+
+  static bool isShareable(ImageSourceType type) {
+    return type == DefaultAsset || type == CompositionAsset;
+  }
+
+  // returns the typeface for a font file, loading it on first use.
+  // returns null if the file can't be loaded; failures aren't cached, so it's tried again on the next call.
+  sk_sp<SkTypeface> getTypeface(const std::filesystem::path& fontPath);
+
+  // returns a copy of the cached entry (which shares the decoded pixels), or nothing if not found
+  std::optional<CachedImage> getImage(ImageSourceType type, const std::filesystem::path& path);
+
+  // adds or replaces an entry. if another context decoded the same image at a higher resolution
+  // in the meantime, that entry is kept instead.
+  void putImage(ImageSourceType type, const std::filesystem::path& path, CachedImage entry);
+
+  void setMaxImageBytes(size_t maxBytes);
+
+  size_t imageBytes();
+  int64_t numImageEvictions();
+  size_t numTypefaces();
+
+  // returns the existing mapping of a font or asset file, or maps the file now and keeps it.
+  // returns null if the file can't be mapped.
+  sk_sp<SkData> mapFile(const std::filesystem::path& path, bool willNeed = false);
+
+  // returns the mapping if the file has been mapped already, otherwise null
+  sk_sp<SkData> getMappedFile(const std::filesystem::path& path);
+
+  // keeps a mapping made elsewhere, unless the file is already mapped
+  void addMappedFile(const std::filesystem::path& path, sk_sp<SkData> data);
+
+  size_t mappedFileBytes();
+  size_t numMappedFiles();
+
+ private:
+  struct TypefaceStripe {
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, sk_sp<SkTypeface>> typefaces;
+  };
+
+  std::array<TypefaceStripe, kNumStripes> typefaceStripes_;
+
+  std::mutex imagesMutex_;
+  ImageCache images_;
+
+  // files are only mapped when a font or image is first loaded, so one lock is enough
+  std::mutex mappedFilesMutex_;
+  MappedFileSet mappedFiles_;
+
+  static size_t stripeIndex_(const std::string& key);
+};
+
+} // namespace canvex
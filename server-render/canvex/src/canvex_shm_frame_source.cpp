@@ -0,0 +1,179 @@
+#include "canvex_shm_frame_source.h"
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace canvex {
+
+// the header is shared with another process, so its fields are accessed with atomic builtins
+template <typename T>
+static inline T atomicLoad(const T* p, int order = __ATOMIC_ACQUIRE) {
+  return __atomic_load_n(p, order);
+}
+
+template <typename T>
+static inline void atomicStore(T* p, T v, int order = __ATOMIC_RELEASE) {
+  __atomic_store_n(p, v, order);
+}
+
+constexpr uint32_t kMaxFrameSize = 16384;
+
+struct ShmFrameSource::Mapping {
+  void* addr;
+  size_t size;
+
+  ~Mapping() {
+    munmap(addr, size);
+  }
+};
+
+static bool isValidHeader(const CanvexShmFramesHeader& h, size_t mappedSize) {
+  if (h.magic != CANVEX_SHM_FRAMES_MAGIC || h.version != CANVEX_SHM_FRAMES_VERSION) {
+    return false;
+  }
+  if (h.width < 1 || h.height < 1 || h.width > kMaxFrameSize || h.height > kMaxFrameSize
+      || h.row_bytes < h.width * 4 || h.row_bytes % 4 != 0) {
+    return false;
+  }
+  if (h.num_slots < 3 || h.num_slots > CANVEX_SHM_FRAMES_MAX_SLOTS) {
+    return false;
+  }
+  const uint64_t frameBytes = (uint64_t)h.row_bytes * h.height;
+  return h.slot_offset >= sizeof(CanvexShmFramesHeader)
+      && h.slot_offset % 4 == 0 && h.slot_stride % 4 == 0
+      && h.slot_stride >= frameBytes
+      && h.slot_offset + (uint64_t)(h.num_slots - 1) * h.slot_stride + frameBytes <= mappedSize;
+}
+
+std::unique_ptr<ShmFrameSource> ShmFrameSource::Open(const std::string& name) {
+  const std::string shmName = (!name.empty() && name[0] == '/') ? name : "/" + name;
+
+  // the reader writes its slot index into the header
+  int fd = shm_open(shmName.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(CanvexShmFramesHeader)) {
+    close(fd);
+    return nullptr;
+  }
+  const size_t size = sb.st_size;
+  void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "** ShmFrameSource: mmap failed for " << shmName << ", errno " << errno << std::endl;
+    return nullptr;
+  }
+  auto mapping = std::make_shared<Mapping>(Mapping{addr, size});
+
+  // validated and used as a copy, so the producer can't change it in between
+  CanvexShmFramesHeader hdr;
+  memcpy(&hdr, addr, sizeof(hdr));
+  if (!isValidHeader(hdr, size)) {
+    std::cerr << "** ShmFrameSource: invalid frame header in " << shmName << std::endl;
+    return nullptr;
+  }
+  const Geometry geometry{hdr.width, hdr.height, hdr.row_bytes, hdr.num_slots, hdr.slot_offset, hdr.slot_stride};
+
+  return std::unique_ptr<ShmFrameSource>(
+    new ShmFrameSource(shmName, std::move(mapping), geometry, sb.st_dev, sb.st_ino));
+}
+
+ShmFrameSource::ShmFrameSource(const std::string& name, std::shared_ptr<Mapping> mapping, const Geometry& geometry,
+                               uint64_t dev, uint64_t ino)
+  : name_(name), mapping_(std::move(mapping)), geometry_(geometry), dev_(dev), ino_(ino)
+{
+  header_ = static_cast<CanvexShmFramesHeader*>(mapping_->addr);
+  atomicStore(&header_->reader_slot, CANVEX_SHM_FRAMES_NO_SLOT, __ATOMIC_SEQ_CST);
+}
+
+ShmFrameSource::~ShmFrameSource() {
+  atomicStore(&header_->reader_slot, CANVEX_SHM_FRAMES_NO_SLOT, __ATOMIC_SEQ_CST);
+}
+
+sk_sp<SkImage> ShmFrameSource::getLatestFrame() {
+  // a producer that keeps publishing faster than this loop runs can't starve the reader for long,
+  // but give up eventually and keep the current frame
+  for (int attempt = 0; attempt < 16; attempt++) {
+    const uint64_t seq = atomicLoad(&header_->latest_sequence);
+    if (seq == 0 || seq == currentSeq_) {
+      return currentImage_;
+    }
+
+    uint32_t slot = CANVEX_SHM_FRAMES_NO_SLOT;
+    for (uint32_t i = 0; i < geometry_.numSlots; i++) {
+      if (atomicLoad(&header_->slot_sequence[i]) == seq) {
+        slot = i;
+        break;
+      }
+    }
+    if (slot == CANVEX_SHM_FRAMES_NO_SLOT) {
+      continue; // the producer has already moved on
+    }
+
+    // claim the slot, then check that the producer didn't start overwriting it before seeing the claim
+    atomicStore(&header_->reader_slot, slot, __ATOMIC_SEQ_CST);
+    if (atomicLoad(&header_->slot_sequence[slot], __ATOMIC_SEQ_CST) != seq) {
+      continue;
+    }
+
+    auto image = wrapSlot_(slot);
+    if (!image) break;
+
+    currentSeq_ = seq;
+    currentSlot_ = slot;
+    currentImage_ = std::move(image);
+    return currentImage_;
+  }
+
+  // go back to holding the current frame, if it's still intact
+  atomicStore(&header_->reader_slot, currentSlot_, __ATOMIC_SEQ_CST);
+  if (currentSlot_ != CANVEX_SHM_FRAMES_NO_SLOT
+      && atomicLoad(&header_->slot_sequence[currentSlot_], __ATOMIC_SEQ_CST) != currentSeq_) {
+    currentSeq_ = 0;
+    currentSlot_ = CANVEX_SHM_FRAMES_NO_SLOT;
+    currentImage_ = nullptr;
+  }
+  return currentImage_;
+}
+
+sk_sp<SkImage> ShmFrameSource::wrapSlot_(uint32_t slot) {
+  if (slot >= geometry_.numSlots) {
+    return nullptr;
+  }
+  auto pixels = static_cast<uint8_t*>(mapping_->addr) + geometry_.slotOffset + slot * geometry_.slotStride;
+  SkPixmap pixmap(
+    SkImageInfo::Make(geometry_.w, geometry_.h, kRGBA_8888_SkColorType, kPremul_SkAlphaType),
+    pixels, geometry_.rowBytes);
+
+  // images keep the mapping alive, so they're safe to hold after the source is closed
+  auto releaseCtx = new std::shared_ptr<Mapping>(mapping_);
+  return SkImage::MakeFromRaster(pixmap,
+    [](const void*, void* ctx) {
+      delete static_cast<std::shared_ptr<Mapping>*>(ctx);
+    },
+    releaseCtx);
+}
+
+bool ShmFrameSource::hasNewFrame() const {
+  const uint64_t seq = atomicLoad(&header_->latest_sequence);
+  return seq != 0 && seq != currentSeq_;
+}
+
+bool ShmFrameSource::isStale() const {
+  int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return true;
+  }
+  struct stat sb;
+  const bool same = fstat(fd, &sb) == 0 && (uint64_t)sb.st_dev == dev_ && (uint64_t)sb.st_ino == ino_;
+  close(fd);
+  return !same;
+}
+
+} // namespace canvex
@@ -0,0 +1,81 @@
+#pragma once
+#include "../include/canvex_shm_frames.h"
+#include "skia_includes.h"
+#include <memory>
+#include <string>
+
+namespace canvex {
+
+/*
+  Reader for a live image whose frames are written into POSIX shared memory
+  by another process, using the layout in canvex_shm_frames.h.
+
+  Frames are wrapped as SkImages without copying. An image stays valid while it's
+  the latest one returned: the producer doesn't write into the slot that the reader holds.
+  After a newer frame has been returned, older images may show newer pixels,
+  so they shouldn't be retained (e.g. in recorded pictures).
+
+  The producer can still write the header after Open has validated it, so the frame geometry
+  is copied out once and only the copy is used, to keep a misbehaving producer
+  from directing reads outside the mapping.
+*/
+class ShmFrameSource {
+ public:
+  // returns null if the object doesn't exist or doesn't contain a valid header
+  static std::unique_ptr<ShmFrameSource> Open(const std::string& name);
+
+  ~ShmFrameSource();
+
+  ShmFrameSource(const ShmFrameSource&) = delete;
+  ShmFrameSource& operator=(const ShmFrameSource&) = delete;
+
+  // returns the latest complete frame, or null if the producer hasn't written one yet.
+  // returns the same image until a new frame is published.
+  sk_sp<SkImage> getLatestFrame();
+
+  // true if the producer has published a frame that getLatestFrame hasn't returned yet
+  bool hasNewFrame() const;
+
+  // true if the name was unlinked or now refers to a different object,
+  // e.g. because the producer restarted with another frame size
+  bool isStale() const;
+
+  int width() const {
+    return geometry_.w;
+  }
+
+  int height() const {
+    return geometry_.h;
+  }
+
+ private:
+  struct Mapping;
+
+  // the header's geometry, validated when the source is opened
+  struct Geometry {
+    uint32_t w;
+    uint32_t h;
+    uint32_t rowBytes;
+    uint32_t numSlots;
+    uint64_t slotOffset;
+    uint64_t slotStride;
+  };
+
+  ShmFrameSource(const std::string& name, std::shared_ptr<Mapping> mapping, const Geometry& geometry,
+                 uint64_t dev, uint64_t ino);
+
+  std::string name_;
+  std::shared_ptr<Mapping> mapping_;
+  CanvexShmFramesHeader* header_;
+  const Geometry geometry_;
+  uint64_t dev_;
+  uint64_t ino_;
+
+  uint64_t currentSeq_ = 0;
+  uint32_t currentSlot_ = CANVEX_SHM_FRAMES_NO_SLOT;
+  sk_sp<SkImage> currentImage_;
+
+  sk_sp<SkImage> wrapSlot_(uint32_t slot);
+};
+
+} // namespace canvex
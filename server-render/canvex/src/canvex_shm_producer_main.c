@@ -0,0 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../include/canvex_shm_frames.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+  Test producer for "shmAsset" live images.
+
+  Creates a POSIX shared memory object in the layout described in canvex_shm_frames.h
+  and writes an animated test pattern into it at the given frame rate.
+  A display list can then draw it with an asset ref like ["shmAsset", "/canvex-test"].
+
+  The object is unlinked on exit (including Ctrl-C).
+*/
+
+#define NUM_SLOTS 3
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void onSignal(int sig) {
+  (void)sig;
+  s_stop = 1;
+}
+
+static uint8_t premul(uint8_t c, uint8_t a) {
+  return (uint8_t)((c * a + 127) / 255);
+}
+
+// scrolling color bars with a translucent box bouncing over them
+static void drawTestPattern(uint8_t *dst, int w, int h, size_t rowBytes, uint64_t frameIdx) {
+  static const uint8_t bars[8][3] = {
+    {255, 255, 255}, {255, 255, 0}, {0, 255, 255}, {0, 255, 0},
+    {255, 0, 255}, {255, 0, 0}, {0, 0, 255}, {0, 0, 0},
+  };
+  const int barW = (w + 7) / 8;
+  const int scroll = (int)(frameIdx * 4 % (uint64_t)w);
+
+  const int boxSize = h / 4;
+  const int travelX = (w > boxSize) ? w - boxSize : 1;
+  const int travelY = (h > boxSize) ? h - boxSize : 1;
+  int boxX = (int)(frameIdx * 7 % (uint64_t)(2 * travelX));
+  int boxY = (int)(frameIdx * 5 % (uint64_t)(2 * travelY));
+  if (boxX >= travelX) boxX = 2 * travelX - boxX;
+  if (boxY >= travelY) boxY = 2 * travelY - boxY;
+
+  for (int y = 0; y < h; y++) {
+    uint8_t *px = dst + y * rowBytes;
+    const int inBoxY = y >= boxY && y < boxY + boxSize;
+    for (int x = 0; x < w; x++) {
+      const uint8_t *c = bars[((x + scroll) % w) / barW];
+      if (inBoxY && x >= boxX && x < boxX + boxSize) {
+        // 50% black over the bars, then the whole pixel at 80% alpha
+        px[0] = premul(c[0] / 2, 204);
+        px[1] = premul(c[1] / 2, 204);
+        px[2] = premul(c[2] / 2, 204);
+        px[3] = 204;
+      } else {
+        px[0] = c[0];
+        px[1] = c[1];
+        px[2] = c[2];
+        px[3] = 255;
+      }
+      px += 4;
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 5) {
+    printf("Expected arguments: 1) shm name (e.g. /canvex-test), 2) width, 3) height, 4) fps, 5) number of frames (optional, default is until interrupted).\n");
+    return 1;
+  }
+  const char *name = argv[1];
+  const int w = strtol(argv[2], NULL, 10);
+  const int h = strtol(argv[3], NULL, 10);
+  const double fps = strtod(argv[4], NULL);
+  const long numFrames = (argc > 5) ? strtol(argv[5], NULL, 10) : 0;
+
+  if (name[0] != '/' || strchr(name + 1, '/')) {
+    printf("** Invalid shm name '%s', must start with a slash and not contain others.\n", name);
+    return 1;
+  }
+  if (w < 1 || h < 1 || w > 16384 || h > 16384) {
+    printf("** Invalid image size specified (%d * %d).\n", w, h);
+    return 1;
+  }
+  if (fps <= 0) {
+    printf("** Invalid fps %f.\n", fps);
+    return 1;
+  }
+
+  const size_t rowBytes = (size_t)w * 4;
+  const size_t pageSize = sysconf(_SC_PAGESIZE);
+  const size_t slotOffset = (sizeof(CanvexShmFramesHeader) + pageSize - 1) / pageSize * pageSize;
+  const size_t slotStride = (rowBytes * h + pageSize - 1) / pageSize * pageSize;
+  const size_t totalSize = slotOffset + NUM_SLOTS * slotStride;
+
+  // replace any object left over from an earlier run, so readers see a new inode
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    perror("shm_open");
+    return 2;
+  }
+  if (ftruncate(fd, totalSize) != 0) {
+    perror("ftruncate");
+    shm_unlink(name);
+    return 2;
+  }
+  uint8_t *base = mmap(NULL, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("mmap");
+    shm_unlink(name);
+    return 2;
+  }
+
+  CanvexShmFramesHeader *hdr = (CanvexShmFramesHeader *)base;
+  memset(hdr, 0, sizeof(*hdr));
+  hdr->width = w;
+  hdr->height = h;
+  hdr->row_bytes = rowBytes;
+  hdr->num_slots = NUM_SLOTS;
+  hdr->slot_offset = slotOffset;
+  hdr->slot_stride = slotStride;
+  hdr->reader_slot = CANVEX_SHM_FRAMES_NO_SLOT;
+  hdr->version = CANVEX_SHM_FRAMES_VERSION;
+  // the magic number goes last, so a reader never sees a partial header as valid
+  __atomic_store_n(&hdr->magic, CANVEX_SHM_FRAMES_MAGIC, __ATOMIC_RELEASE);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  printf("Writing %d * %d frames at %.1f fps to %s\n", w, h, fps, name);
+
+  const long frameIntv_ns = (long)(1.0e9 / fps);
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  uint32_t latestSlot = CANVEX_SHM_FRAMES_NO_SLOT;
+  for (uint64_t seq = 1; !s_stop && (numFrames <= 0 || seq <= (uint64_t)numFrames); seq++) {
+    // find a slot that neither holds the latest frame nor is held by the reader
+    uint32_t slot;
+    for (;;) {
+      const uint32_t readerSlot = __atomic_load_n(&hdr->reader_slot, __ATOMIC_SEQ_CST);
+      for (slot = 0; slot < NUM_SLOTS; slot++) {
+        if (slot != latestSlot && slot != readerSlot) break;
+      }
+      __atomic_store_n(&hdr->slot_sequence[slot], 0, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&hdr->reader_slot, __ATOMIC_SEQ_CST) != slot) break;
+    }
+
+    drawTestPattern(base + slotOffset + slot * slotStride, w, h, rowBytes, seq);
+
+    __atomic_store_n(&hdr->slot_sequence[slot], seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->latest_sequence, seq, __ATOMIC_RELEASE);
+    latestSlot = slot;
+
+    next.tv_nsec += frameIntv_ns;
+    while (next.tv_nsec >= 1000000000L) {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+
+  munmap(base, totalSize);
+  shm_unlink(name);
+  printf("Done, removed %s\n", name);
+  return 0;
+}
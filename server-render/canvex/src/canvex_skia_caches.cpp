@@ -0,0 +1,53 @@
+#include "canvex_skia_caches.h"
+#include <atomic>
+
+namespace canvex {
+
+static std::atomic<int64_t> s_textBlobHits{0};
+static std::atomic<int64_t> s_textBlobMisses{0};
+static std::atomic<int64_t> s_fontHits{0};
+static std::atomic<int64_t> s_fontMisses{0};
+static std::atomic<int64_t> s_numPurges{0};
+
+void SetSkiaCacheLimits(size_t fontCacheBytes, int fontCacheCount, size_t resourceCacheBytes) {
+  if (fontCacheBytes > 0) {
+    SkGraphics::SetFontCacheLimit(fontCacheBytes);
+  }
+  if (fontCacheCount > 0) {
+    SkGraphics::SetFontCacheCountLimit(fontCacheCount);
+  }
+  if (resourceCacheBytes > 0) {
+    SkGraphics::SetResourceCacheTotalByteLimit(resourceCacheBytes);
+  }
+}
+
+SkiaCacheStats GetSkiaCacheStats() {
+  SkiaCacheStats stats;
+  stats.fontCacheBytesUsed = SkGraphics::GetFontCacheUsed();
+  stats.fontCacheBytesLimit = SkGraphics::GetFontCacheLimit();
+  stats.fontCacheCountUsed = SkGraphics::GetFontCacheCountUsed();
+  stats.fontCacheCountLimit = SkGraphics::GetFontCacheCountLimit();
+  stats.resourceCacheBytesUsed = SkGraphics::GetResourceCacheTotalBytesUsed();
+  stats.resourceCacheBytesLimit = SkGraphics::GetResourceCacheTotalByteLimit();
+
+  stats.textBlobHits = s_textBlobHits.load(std::memory_order_relaxed);
+  stats.textBlobMisses = s_textBlobMisses.load(std::memory_order_relaxed);
+  stats.fontHits = s_fontHits.load(std::memory_order_relaxed);
+  stats.fontMisses = s_fontMisses.load(std::memory_order_relaxed);
+  stats.numPurges = s_numPurges.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void PurgeSkiaCaches() {
+  SkGraphics::PurgeAllCaches();
+  s_numPurges.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AddTextCacheLookups(int64_t textBlobHits, int64_t textBlobMisses, int64_t fontHits, int64_t fontMisses) {
+  s_textBlobHits.fetch_add(textBlobHits, std::memory_order_relaxed);
+  s_textBlobMisses.fetch_add(textBlobMisses, std::memory_order_relaxed);
+  s_fontHits.fetch_add(fontHits, std::memory_order_relaxed);
+  s_fontMisses.fetch_add(fontMisses, std::memory_order_relaxed);
+}
+
+} // namespace canvex
@@ -0,0 +1,45 @@
+#pragma once
+#include "skia_includes.h"
+#include <cstdint>
+
+namespace canvex {
+
+/*
+  Configuration and reporting for Skia's process-global caches:
+    - the font cache of glyph strikes (rasterized glyphs and their metrics, by typeface, size and matrix);
+    - the resource cache of decoded and scaled images, and other intermediates.
+
+  Both are shared by every resource context in the process, so they're set and read here
+  rather than per context. Skia doesn't count its own cache hits, so the hit counts reported
+  are those of canvex's text caches, summed over all contexts: a low text blob hit rate
+  with a full font cache means text is being shaped and rasterized over and over.
+*/
+
+struct SkiaCacheStats {
+  int64_t fontCacheBytesUsed = 0;
+  int64_t fontCacheBytesLimit = 0;
+  int32_t fontCacheCountUsed = 0; // number of strikes
+  int32_t fontCacheCountLimit = 0;
+  int64_t resourceCacheBytesUsed = 0;
+  int64_t resourceCacheBytesLimit = 0;
+
+  // totals over all contexts since the process started
+  int64_t textBlobHits = 0;
+  int64_t textBlobMisses = 0;
+  int64_t fontHits = 0;
+  int64_t fontMisses = 0;
+  int64_t numPurges = 0; // calls to PurgeSkiaCaches()
+};
+
+// zero leaves a limit unchanged
+void SetSkiaCacheLimits(size_t fontCacheBytes, int fontCacheCount, size_t resourceCacheBytes);
+
+SkiaCacheStats GetSkiaCacheStats();
+
+// drops everything that isn't in use from both caches
+void PurgeSkiaCaches();
+
+// adds one render's text cache lookups to the process totals
+void AddTextCacheLookups(int64_t textBlobHits, int64_t textBlobMisses, int64_t fontHits, int64_t fontMisses);
+
+} // namespace canvex
@@ -1,6 +1,7 @@
 #include "canvex_skia_context.h"
 #include "style_util.h"
 #include "time_util.h"
+#include <algorithm>
 
 namespace canvex {
 
@@ -94,14 +95,22 @@ void CanvexContext::setFont(const std::string& weight, const std::string& style,
 }
 
 void CanvexContext::fillRect(double x, double y, double w, double h) {
-  canvas_->drawRect(SkRect::MakeXYWH(x, y, w, h), getFillPaint());
+  const auto rect = SkRect::MakeXYWH(x, y, w, h);
+  canvas_->drawRect(rect, getFillPaint());
+
+  if (drawRecords_) {
+    recordDraw_(getStateHasher_().add(OpType::fillRect).add(rect), rect, 0);
+  }
 }
 
 void CanvexContext::rect(double x, double y, double w, double h) {
   if (!path_) {
     path_ = std::make_unique<SkPath>();
   }
-  path_->addRect(SkRect::MakeXYWH(x, y, w, h));
+  const auto rect = SkRect::MakeXYWH(x, y, w, h);
+  path_->addRect(rect);
+  pathShapes_.addRect(rect);
+  addToPathHash_(OpType::rect, x, y, w, h);
 }
 
 void CanvexContext::roundRect(double x, double y, double w, double h, float tl, float tr, float br, float bl) {
@@ -110,18 +119,27 @@ void CanvexContext::roundRect(double x, double y, double w, double h, float tl,
   }
 
   // Skia roundrect API expects radius pairs (for each corner, x/y radius explicitly defined)
-  const SkScalar radii[8] = {
-    tl, tl,
-    tr, tr,
-    br, br,
-    bl, bl
+  const SkVector radii[4] = {
+    {tl, tl},
+    {tr, tr},
+    {br, br},
+    {bl, bl}
   };
 
-  path_->addRoundRect(SkRect::MakeXYWH(x, y, w, h), radii);
+  SkRRect rrect;
+  rrect.setRectRadii(SkRect::MakeXYWH(x, y, w, h), radii);
+  path_->addRRect(rrect);
+  pathShapes_.addRRect(rrect);
+  addToPathHash_(OpType::roundRect, x, y, w, h, tl, tr, br, bl);
 }
 
 void CanvexContext::strokeRect(double x, double y, double w, double h) {
-  canvas_->drawRect(SkRect::MakeXYWH(x, y, w, h), getStrokePaint());
+  const auto rect = SkRect::MakeXYWH(x, y, w, h);
+  canvas_->drawRect(rect, getStrokePaint());
+
+  if (drawRecords_) {
+    recordDraw_(getStateHasher_().add(OpType::strokeRect).add(rect), rect, getStrokeOutset_());
+  }
 }
 
 void CanvexContext::fillText(const std::string& text, double x, double y) {
@@ -136,124 +154,222 @@ void CanvexContext::strokeText(const std::string& text, double x, double y) {
   drawTextWithPaint_(text, x, y, getStrokePaint());
 }
 
-void CanvexContext::drawEmojiWithPaint_(const std::string& text, double x, double y, double h, const SkPaint& paint) {
-  std::string fontFamily = "_emoji";
-  
-  auto fontFileNameOpt = skiaResCtx_.getFontFileName(fontFamily, 400, false);
+sk_sp<SkTypeface> CanvexContext::getTypeface_(const std::string& fontFamily, int fontWeight, bool italic) {
+  FontKey fontKey{fontFamily, fontWeight, italic};
+  auto& counters = skiaResCtx_.textCacheCounters;
+
+  auto resolvedIt = skiaResCtx_.typefacesByFont.find(fontKey);
+  if (resolvedIt != skiaResCtx_.typefacesByFont.end()) {
+    counters.fontHits++;
+    return resolvedIt->second;
+  }
+  counters.fontMisses++;
+
+  auto fontFileNameOpt = skiaResCtx_.getFontFileName(fontFamily, fontWeight, italic);
   if (!fontFileNameOpt.has_value()) {
     std::cerr << "** Unable to match font name: " << fontFamily << std::endl;
-    return; // --
+    return nullptr; // --
   }
   std::string fontFileName = fontFileNameOpt.value();
 
   sk_sp<SkTypeface> typeface = skiaResCtx_.typefaceCache[fontFileName];
-  if (!typeface) {
+  if (!typeface && !skiaResCtx_.fontPreloaders.empty()) {
+    skiaResCtx_.collectPreloadedFonts();
+    typeface = skiaResCtx_.typefaceCache[fontFileName];
+  }
+  const double tLoadStart = getMonotonicTime();
+  const bool isColdLoad = !typeface;
+
+  if (!typeface && skiaResCtx_.sharedCache && !resPath_.empty()) {
+    // loaded once for all the contexts sharing the cache
+    auto fontPath = resPath_ / "fonts" / fontFileName;
+    typeface = skiaResCtx_.sharedCache->getTypeface(fontPath);
+    if (!typeface) {
+      std::cerr << "** Unable to load font at: " << fontPath << std::endl;
+    }
+  } else if (!typeface) {
     // the font look-up call is somewhat expensive, so we cache the typeface objects
     if (resPath_.empty()) {
       std::cerr << "Warning: fontResPath is empty, can't load fonts" << std::endl;
     } else {
       // FIXME: hardcoded subpath expects to find all fonts in one dir
       auto fontPath = resPath_ / "fonts" / fontFileName;
-      std::cerr << "Loading emoji font at: " << fontPath << std::endl;
-      typeface = SkTypeface::MakeFromFile(fontPath.c_str());
+      // mapped rather than read, so that renderer processes on the same host share the font data
+      auto fontData = skiaResCtx_.mappedFiles.map(fontPath);
+      if (fontData) {
+        typeface = SkTypeface::MakeFromData(fontData);
+      }
       if (!typeface) {
-        std::cerr << "** Unable to load emoji font at: " << fontPath << std::endl;
+        std::cerr << "** Unable to load font at: " << fontPath << std::endl;
       } else {
-        std::cerr << "Emoji font loaded successfully" << std::endl;
         skiaResCtx_.typefaceCache[fontFileName] = typeface;
       }
     }
+    /*
+    // example of loading a font through the OS font manager API instead.
+    // this is unpredictably slow and dependent on fonts being installed, so prefer to use our own embedded fonts.
+    typeface = SkTypeface::MakeFromName(
+                    "Helvetica",
+                    {sf.fontWeight, SkFontStyle::kNormal_Width, SkFontStyle::kUpright_Slant});
+    */
   }
 
+  if (isColdLoad) {
+    skiaResCtx_.coldLoadCounters.fontLoads++;
+    skiaResCtx_.coldLoadCounters.time_s += getMonotonicTime() - tLoadStart;
+  }
+
+  // failures aren't cached, so a font that appears later can still be loaded
+  if (typeface) {
+    skiaResCtx_.typefacesByFont.emplace(std::move(fontKey), typeface);
+  }
+  return typeface;
+}
+
+sk_sp<SkTextBlob> CanvexContext::getTextBlob_(const std::string& text, const sk_sp<SkTypeface>& typeface, float size) {
+  TextBlobKey key{text, typeface->uniqueID(), size};
+  auto& counters = skiaResCtx_.textCacheCounters;
+
+  if (auto cached = skiaResCtx_.textBlobCache.get(key)) {
+    counters.textBlobHits++;
+    return *cached;
+  }
+  counters.textBlobMisses++;
+
+  SkFont font(typeface, size);
+  auto textBlob = SkTextBlob::MakeFromString(text.c_str(), font);
+  if (textBlob) {
+    skiaResCtx_.textBlobCache.put(key, textBlob);
+  }
+  return textBlob;
+}
+
+bool CanvexContext::drawEmojiFromAtlas_(const std::string& text, const sk_sp<SkTypeface>& typeface,
+                                        double x, double y, double h, const SkPaint& paint) {
+  // sprites are rendered at the device pixel size, which needs an axis-aligned transform
+  const SkMatrix m = getDeviceMatrix_();
+  if (!m.isScaleTranslate()) {
+    return false;
+  }
+  const double deviceScale = std::max(std::abs(m.getScaleX()), std::abs(m.getScaleY()));
+  const int pxSize = lround(h * deviceScale);
+
+  auto sprite = skiaResCtx_.emojiAtlas.getSprite(text, typeface, pxSize);
+  if (!sprite) {
+    return false;
+  }
+
+  // local units per sprite pixel
+  const double k = h / pxSize;
+  const auto& b = sprite->glyphBounds;
+  const auto dstRect = SkRect::MakeXYWH(x + b.x() * k, y + b.y() * k, b.width() * k, b.height() * k);
+
+  // color glyphs ignore the paint color but are modulated by its alpha
+  SkPaint blitPaint;
+  blitPaint.setAlpha(paint.getAlpha());
+
+  canvas_->drawImageRect(sprite->image, SkRect::Make(sprite->srcRect), dstRect,
+                         SkSamplingOptions(SkFilterMode::kLinear), &blitPaint, SkCanvas::kStrict_SrcRectConstraint);
+
+  if (drawRecords_) {
+    recordDraw_(getStateHasher_().add(OpType::fillText_emoji).add(text).add(x).add(y).add(h), dstRect, 0);
+  }
+  return true;
+}
+
+void CanvexContext::drawEmojiWithPaint_(const std::string& text, double x, double y, double h, const SkPaint& paint) {
   // on macOS, the Apple font is available via lookup:
   //auto typeface = SkTypeface::MakeFromName("Apple Color Emoji", {200, SkFontStyle::kNormal_Width, SkFontStyle::kUpright_Slant});
 
+  auto typeface = getTypeface_("_emoji", 400, false);
   if (!typeface) {
     std::cerr << "** Skipping emoji render, no typeface available for: " << text << std::endl;
     return;
   }
 
-  SkFont font(typeface, h);
-  auto textBlob = SkTextBlob::MakeFromString(text.c_str(), font);
+  if (drawEmojiFromAtlas_(text, typeface, x, y, h, paint)) {
+    return;
+  }
+  // otherwise draw as text, e.g. if the emoji is too large for the atlas
+
+  auto textBlob = getTextBlob_(text, typeface, h);
   if (!textBlob) {
     std::cerr << "** Failed to create text blob for emoji: " << text << std::endl;
     return;
   }
 
   canvas_->drawTextBlob(textBlob, x, y, paint);
+
+  if (drawRecords_) {
+    recordDraw_(getStateHasher_().add(OpType::fillText_emoji).add(text).add(x).add(y).add(h),
+                textBlob->bounds().makeOffset(x, y), 0);
+  }
 }
 
 void CanvexContext::drawTextWithPaint_(const std::string& text, double x, double y, const SkPaint& paint) {
   auto& sf = stateStack_.back();
 
   std::string fontFamily = (sf.fontName.empty()) ? "Roboto" : sf.fontName;
-  auto fontFileNameOpt = skiaResCtx_.getFontFileName(fontFamily, sf.fontWeight, sf.fontIsItalic);
-  if (!fontFileNameOpt.has_value()) {
-    std::cerr << "** Unable to match font name: " << fontFamily << std::endl;
-    return; // --
-  }
-  std::string fontFileName = fontFileNameOpt.value();
-
-  sk_sp<SkTypeface> typeface = skiaResCtx_.typefaceCache[fontFileName];
-  if (!typeface) {
-    // the font look-up call is somewhat expensive, so we cache the typeface objects
-    if (resPath_.empty()) {
-      std::cerr << "Warning: fontResPath is empty, can't load fonts" << std::endl;
-    } else {
-      // FIXME: hardcoded subpath expects to find all fonts in one dir
-      auto fontPath = resPath_ / "fonts" / fontFileName;
-      typeface = SkTypeface::MakeFromFile(fontPath.c_str());
-      if (!typeface) {
-        std::cerr << "** Unable to load font at: " << fontPath << std::endl;
-      } else {
-        skiaResCtx_.typefaceCache[fontFileName] = typeface;
-      }
-    }
-    /*
-    // example of loading a font through the OS font manager API instead.
-    // this is unpredictably slow and dependent on fonts being installed, so prefer to use our own embedded fonts.
-    typeface = SkTypeface::MakeFromName(
-                    "Helvetica",
-                    {sf.fontWeight, SkFontStyle::kNormal_Width, SkFontStyle::kUpright_Slant});
-    */
-  }
-
+  auto typeface = getTypeface_(fontFamily, sf.fontWeight, sf.fontIsItalic);
   if (!typeface) {
     std::cerr << "** Skipping text render, no typeface available for: " << fontFamily << std::endl;
     return;
   }
 
-  SkFont font(typeface, sf.fontSize);
-  auto textBlob = SkTextBlob::MakeFromString(text.c_str(), font);
+  auto textBlob = getTextBlob_(text, typeface, sf.fontSize);
   if (!textBlob) {
     std::cerr << "** Failed to create text blob for text: " << text << std::endl;
     return;
   }
 
   canvas_->drawTextBlob(textBlob, x, y, paint);
+
+  if (drawRecords_) {
+    const bool isStroke = paint.getStyle() != SkPaint::kFill_Style;
+    recordDraw_(getStateHasher_().add(isStroke ? OpType::strokeText : OpType::fillText).add(text).add(x).add(y),
+                textBlob->bounds().makeOffset(x, y), isStroke ? getStrokeOutset_() : 0);
+  }
 }
 
-sk_sp<SkImage> CanvexContext::getImage(ImageSourceType type, const std::string& imageName, DrawImageStats* stats) {
-  if (imageName.empty()) return nullptr; // --
+CachedImage CanvexContext::getImage(ImageSourceType type, const std::string& imageName, const ImageDrawSize& drawSize,
+                                   DrawImageStats* stats) {
+  if (imageName.empty()) return {}; // --
 
   double tNow = getMonotonicTime();
 
-  canvex::ImageCache* cache;
-  switch (type) {
-    case CompositionAsset:
-        cache = &skiaResCtx_.imageCache_compositionNamespace;
-        break;
-      case DefaultAsset:
-        cache = &skiaResCtx_.imageCache_defaultNamespace;
-        break;
-      case LiveAsset:
-        cache = &skiaResCtx_.imageCache_liveNamespace;
-        break;
+  if (type == SharedMemoryAsset) {
+    // drawn directly from the shared memory slot, so there's nothing to load or cache
+    CachedImage frame;
+    frame.image = skiaResCtx_.getShmFrame(imageName);
+    if (frame.image) {
+      frame.srcSize = frame.image->dimensions();
+    }
+    if (stats) {
+      stats->timeSpent_imageLoad_s = getMonotonicTime() - tNow;
+    }
+    return frame;
+  }
+
+  skiaResCtx_.collectDecodedImages();
+
+  // live images are reloaded when the watcher reports a change, or if it's not available, by polling write times
+  bool pollLiveImage = false;
+  if (type == LiveAsset) {
+    pollLiveImage = !skiaResCtx_.watchLiveAssets(resPath_ / "live")
+                    || imageName.find('/') != std::string::npos; // only the top level is watched
+    skiaResCtx_.collectLiveAssetChanges();
   }
 
-  sk_sp<SkImage> image = (*cache)[imageName];
+  const auto imagePath = getImagePath(type, imageName);
+  std::optional<CachedImage> cached = skiaResCtx_.getCachedImage(type, imageName, imagePath);
+  bool needsLoad = !cached;
 
-  if (image && type == LiveAsset) {
+  const bool isStale = type == LiveAsset && skiaResCtx_.staleLiveImages.count(imageName) > 0;
+  if (cached && isStale) {
+    needsLoad = true;
+  }
+
+  if (cached && pollLiveImage) {
     auto& imageTs = skiaResCtx_.liveImageTimestampsByName[imageName];
     const double timeSinceLastPoll = tNow - imageTs.lastPollT;
     const double pollIntv = 1.0 / 4.0;
@@ -261,76 +377,100 @@ sk_sp<SkImage> CanvexContext::getImage(ImageSourceType type, const std::string&
       imageTs.lastPollT = tNow;
       
       // check the latest write time on the file to see if it had an update
-      auto assetsPath = getImagePath(type, imageName);
       std::error_code ec;
-      auto fileWriteTime = std::filesystem::last_write_time(assetsPath, ec);
+      auto fileWriteTime = std::filesystem::last_write_time(imagePath, ec);
       if (ec) {
         // this happens when the image is changing its size/source (e.g. webframe URL)
         // and has been temporarily deleted by the writer.
         // clear out cached image at this point because it's out of date.
-        std::cerr << "drawImage: clearing cache on poll for " << assetsPath << ", last_write_time() returned " << ec << std::endl;
-        (*cache)[imageName] = nullptr;
-        return nullptr;
+        std::cerr << "drawImage: clearing cache on poll for " << imagePath << ", last_write_time() returned " << ec << std::endl;
+        skiaResCtx_.imageCache.erase(type, imageName);
+        return {};
       } else {
         if (fileWriteTime > imageTs.lastReadFst) {
           // write time on disk is newer, so reload now
-          image = nullptr;
-          //std::cout << "drawImage: reloading changed file at " << assetsPath << std::endl;
+          needsLoad = true;
+          //std::cout << "drawImage: reloading changed file at " << imagePath << std::endl;
         } else {
-          //std::cout << "drawImage: no need to reload " << assetsPath << ", hasn't changed" << std::endl;
+          //std::cout << "drawImage: no need to reload " << imagePath << ", hasn't changed" << std::endl;
         }
       }
     }
   }
 
-  if (!image) {
-    if (stats) stats->wasCacheMiss = true;
-
-    auto assetsPath = getImagePath(type, imageName);
-    std::error_code ec;
-    auto fileWriteTime = std::filesystem::last_write_time(assetsPath, ec);
-    if (ec) {
-      std::cerr << "drawImage: unable to load path " << assetsPath << " - last_write_time() returned " << ec << std::endl;
-      return image;
+  // the image was decoded smaller than this draw needs
+  if (cached && !needsLoad && drawSize.scaleFor(cached->srcSize) > cached->scale) {
+    needsLoad = true;
+  }
+
+  if (!needsLoad) {
+    if (stats) {
+      stats->timeSpent_imageLoad_s = getMonotonicTime() - tNow;
     }
-    auto data = SkData::MakeFromFileName(assetsPath.c_str());
-    if (!data) {
-      std::cerr << "drawImage: MakeFromFileName was unable to load path " << assetsPath << std::endl;
-      return image;
+    return *cached;
+  }
+
+  if (stats) stats->wasCacheMiss = true;
+
+  // keep the resolution needed by earlier draws of the same image
+  ImageDecodeRequest req{type, imageName, imagePath, drawSize, cached ? cached->scale : 0,
+                         skiaResCtx_.getMappedFile(imagePath)};
+
+  if (skiaResCtx_.imageLoadPolicy != ImageLoadPolicy::Block) {
+    auto& pool = skiaResCtx_.getImageDecodePool();
+    // a decode already in flight may have read the file before it changed, so stay stale until it's done
+    if (isStale && !pool.isPending(type, imageName)) {
+      skiaResCtx_.staleLiveImages.erase(imageName);
     }
-    image = SkImage::MakeFromEncoded(data);
-    if (!image) {
-      std::cerr << "drawImage: unable to decode image at path " << assetsPath << std::endl;
-      return image;
+    const bool pending = pool.submit(std::move(req));
+    if (stats) {
+      stats->wasPending = pending;
+      stats->timeSpent_imageLoad_s = getMonotonicTime() - tNow;
     }
-    (*cache)[imageName] = image;
+    // a changed or upscaled image keeps showing the earlier decode meanwhile
+    return cached ? *cached : CachedImage{};
+  }
 
-    if (type == LiveAsset) {
-      skiaResCtx_.liveImageTimestampsByName[imageName] = {tNow, fileWriteTime};
+  // from here on the image is loaded on the render thread
+  const double tLoadStart = getMonotonicTime();
+  auto& coldLoads = skiaResCtx_.coldLoadCounters;
+  coldLoads.imageLoads++;
+
+  auto& pool = skiaResCtx_.imageDecodePool;
+  if (pool && pool->isPending(type, imageName)) {
+    // already being decoded (e.g. prefetched), so wait for that instead of decoding twice
+    pool->wait(type, imageName);
+    skiaResCtx_.collectDecodedImages();
+    cached = skiaResCtx_.getCachedImage(type, imageName, imagePath);
+    if (cached && !isStale && drawSize.scaleFor(cached->srcSize) <= cached->scale) {
+      coldLoads.time_s += getMonotonicTime() - tLoadStart;
+      if (stats) {
+        stats->timeSpent_imageLoad_s = getMonotonicTime() - tNow;
+      }
+      return *cached;
     }
   }
 
+  if (isStale) {
+    skiaResCtx_.staleLiveImages.erase(imageName);
+  }
+  auto result = DecodeImageFile(req);
+  coldLoads.time_s += getMonotonicTime() - tLoadStart;
+  if (!result.image.image) {
+    return {};
+  }
+  CachedImage entry = result.image;
+  skiaResCtx_.addDecodedImage(std::move(result));
+
   if (stats) {
     stats->timeSpent_imageLoad_s = getMonotonicTime() - tNow;
   }
 
-  return image;
+  return entry;
 }
 
 std::filesystem::path CanvexContext::getImagePath(ImageSourceType type, const std::string& imageName) {
-  std::filesystem::path assetsPath;
-  switch (type) {
-    case CompositionAsset:
-      assetsPath = resPath_ / imageName;
-      break;
-    case DefaultAsset:
-      assetsPath = resPath_ / "test-assets" / imageName;
-      break;
-    case LiveAsset:
-      assetsPath = resPath_ / "live" / imageName;
-      break;
-  }
-  return assetsPath;
+  return GetImageAssetPath(resPath_, type, imageName);
 }
 
 void CanvexContext::drawImage(ImageSourceType type, const std::string& imageName,
@@ -340,12 +480,25 @@ void CanvexContext::drawImage(ImageSourceType type, const std::string& imageName
 
   if (sf.globalAlpha <= 0.0) return; // --
 
-  sk_sp<SkImage> image = getImage(type, imageName, stats);
-  if (!image) return; // --
+  SkRect rect{(SkScalar)x, (SkScalar)y, (SkScalar)(x + w), (SkScalar)(y + h)};
+
+  const SkRect devRect = getDeviceMatrix_().mapRect(rect);
+  const ImageDrawSize drawSize{{devRect.width(), devRect.height()}, SkRect::MakeEmpty()};
+
+  DrawImageStats localStats{};
+  if (!stats) stats = &localStats;
+
+  const CachedImage cached = getImage(type, imageName, drawSize, stats);
+  const sk_sp<SkImage>& image = cached.image;
+  if (!image) {
+    if (stats->wasPending) {
+      drawPendingImage_(imageName, rect);
+    }
+    return; // --
+  }
 
   double ts = getMonotonicTime();
 
-  SkRect rect{(SkScalar)x, (SkScalar)y, (SkScalar)(x + w), (SkScalar)(y + h)};
   SkSamplingOptions sampleOptions(SkFilterMode::kLinear);
 
   SkPaint paint;
@@ -353,8 +506,11 @@ void CanvexContext::drawImage(ImageSourceType type, const std::string& imageName
 
   canvas_->drawImageRect(image, rect, sampleOptions, &paint);
 
-  if (stats) {
-    stats->timeSpent_skiaDraw_s = getMonotonicTime() - ts;
+  stats->timeSpent_skiaDraw_s = getMonotonicTime() - ts;
+
+  if (drawRecords_) {
+    recordDraw_(getStateHasher_().add(OpType::drawImage).add(image->uniqueID()).add(rect),
+                rect, 0, stats->wasCacheMiss);
   }
 }
 
@@ -366,27 +522,58 @@ void CanvexContext::drawImageWithSrcCoords(ImageSourceType type, const std::stri
 
   if (sf.globalAlpha <= 0.0) return; // --
 
-  sk_sp<SkImage> image = getImage(type, imageName, stats);
-  if (!image) return; // --
-
-  double ts = getMonotonicTime();
-
   SkRect srcRect{(SkScalar)srcX, (SkScalar)srcY, (SkScalar)(srcX + srcW), (SkScalar)(srcY + srcH)};
   SkRect dstRect{(SkScalar)dstX, (SkScalar)dstY, (SkScalar)(dstX + dstW), (SkScalar)(dstY + dstH)};
+
+  const SkRect devRect = getDeviceMatrix_().mapRect(dstRect);
+  const ImageDrawSize drawSize{{devRect.width(), devRect.height()}, srcRect};
+
+  DrawImageStats localStats{};
+  if (!stats) stats = &localStats;
+
+  const CachedImage cached = getImage(type, imageName, drawSize, stats);
+  const sk_sp<SkImage>& image = cached.image;
+  if (!image) {
+    if (stats->wasPending) {
+      drawPendingImage_(imageName, dstRect);
+    }
+    return; // --
+  }
+
+  double ts = getMonotonicTime();
   SkSamplingOptions sampleOptions(SkFilterMode::kLinear);
 
   SkPaint paint;
   paint.setAlpha(sf.globalAlpha * 255);
 
-  canvas_->drawImageRect(image, srcRect, dstRect, sampleOptions, &paint, SkCanvas::kFast_SrcRectConstraint);
+  // the source rect is given in pixels of the encoded image, which may have been decoded smaller
+  canvas_->drawImageRect(image, cached.mapSrcRect(srcRect), dstRect, sampleOptions, &paint, SkCanvas::kFast_SrcRectConstraint);
 
-  if (stats) {
-    stats->timeSpent_skiaDraw_s = getMonotonicTime() - ts;
+  stats->timeSpent_skiaDraw_s = getMonotonicTime() - ts;
+
+  if (drawRecords_) {
+    recordDraw_(getStateHasher_().add(OpType::drawImage).add(image->uniqueID()).add(srcRect).add(dstRect),
+                dstRect, 0, stats->wasCacheMiss);
+  }
+}
+
+void CanvexContext::drawPendingImage_(const std::string& imageName, const SkRect& dstRect) {
+  if (skiaResCtx_.imageLoadPolicy == ImageLoadPolicy::Placeholder) {
+    SkPaint paint;
+    paint.setColor(SkColorSetARGB(getGlobalAlpha() * 64, 128, 128, 128));
+    canvas_->drawRect(dstRect, paint);
+  }
+
+  // the area is damaged again when the decoded image replaces this
+  if (drawRecords_) {
+    recordDraw_(getStateHasher_().add(OpType::drawImage).add(imageName).add(dstRect), dstRect, 0);
   }
 }
 
 void CanvexContext::beginPath() {
   path_ = std::make_unique<SkPath>();
+  pathShapes_.reset();
+  pathHash_ = 0;
 }
 
 void CanvexContext::closePath() {
@@ -398,6 +585,8 @@ void CanvexContext::moveTo(double x, double y) {
     path_ = std::make_unique<SkPath>();
   }
   path_->moveTo(x, y);
+  pathShapes_.moveTo(SkPoint::Make(x, y));
+  addToPathHash_(OpType::moveTo, x, y);
 }
 
 void CanvexContext::lineTo(double x, double y) {
@@ -405,6 +594,8 @@ void CanvexContext::lineTo(double x, double y) {
     path_ = std::make_unique<SkPath>();
   }
   path_->lineTo(x, y);
+  pathShapes_.lineTo(SkPoint::Make(x, y));
+  addToPathHash_(OpType::lineTo, x, y);
 }
 
 void CanvexContext::quadraticCurveTo(double cp_x, double cp_y, double x, double y) {
@@ -412,6 +603,8 @@ void CanvexContext::quadraticCurveTo(double cp_x, double cp_y, double x, double
     path_ = std::make_unique<SkPath>();
   }
   path_->quadTo(cp_x, cp_y, x, y);
+  pathShapes_.addCurve();
+  addToPathHash_(OpType::quadraticCurveTo, cp_x, cp_y, x, y);
 }
 
 void CanvexContext::arcTo(double cp_x, double cp_y, double x, double y, double radius) {
@@ -419,6 +612,8 @@ void CanvexContext::arcTo(double cp_x, double cp_y, double x, double y, double r
     path_ = std::make_unique<SkPath>();
   }
   path_->arcTo(cp_x, cp_y, x, y, radius);
+  pathShapes_.arcTo(SkPoint::Make(cp_x, cp_y), SkPoint::Make(x, y), radius);
+  addToPathHash_(OpType::arcTo, cp_x, cp_y, x, y, radius);
 }
 
 void CanvexContext::clip(FillRuleType fillRule) {
@@ -428,19 +623,141 @@ void CanvexContext::clip(FillRuleType fillRule) {
 
     path_->setFillType(skFill);
 
-    canvas_->clipPath(*path_, antialias);
+    if (!clipPathShapes_(skFill, antialias)) {
+      canvas_->clipPath(*path_, antialias);
+    }
+
+    if (drawRecords_) {
+      auto& sf = stateStack_.back();
+      sf.clipHash = getStateHasher_().add(OpType::clip).add(pathHash_).add(fillRule).value();
+    }
   }
 }
 
 void CanvexContext::fill() {
   if (path_) {
-    canvas_->drawPath(*path_, getFillPaint());
+    const auto paint = getFillPaint();
+    if (!fillPathShapes_(paint)) {
+      canvas_->drawPath(*path_, paint);
+    }
+
+    if (drawRecords_) {
+      recordDraw_(getStateHasher_().add(OpType::fill).add(pathHash_), path_->getBounds(), 0);
+    }
   }
 }
 
 void CanvexContext::stroke() {
   if (path_) {
     canvas_->drawPath(*path_, getStrokePaint());
+
+    if (drawRecords_) {
+      recordDraw_(getStateHasher_().add(OpType::stroke).add(pathHash_), path_->getBounds(), getStrokeOutset_());
+    }
+  }
+}
+
+bool CanvexContext::fillPathShapes_(const SkPaint& paint) {
+  std::vector<SkRRect> shapes;
+  if (!skiaResCtx_.useAnalyticShapes || !pathShapes_.getShapes(shapes) || shapes.empty()
+      || !areDisjointOnDevice_(shapes)) {
+    return false;
+  }
+  for (const auto& shape : shapes) {
+    if (shape.isRect()) {
+      canvas_->drawRect(shape.rect(), paint);
+    } else {
+      canvas_->drawRRect(shape, paint);
+    }
+  }
+  return true;
+}
+
+bool CanvexContext::clipPathShapes_(SkPathFillType fillType, bool antialias) {
+  std::vector<SkRRect> shapes;
+  if (!skiaResCtx_.useAnalyticShapes || !pathShapes_.getShapes(shapes) || shapes.empty()) {
+    return false;
+  }
+  if (shapes.size() == 1) {
+    if (shapes[0].isRect()) {
+      canvas_->clipRect(shapes[0].rect(), antialias);
+    } else {
+      canvas_->clipRRect(shapes[0], antialias);
+    }
+    return true;
+  }
+
+  // even-odd clips of several shapes are usually a frame with holes cut out of it.
+  // that's the outer shape minus each hole, as long as the holes don't overlap.
+  // (with non-zero winding the holes depend on the contour directions, so that's left to Skia.)
+  if (fillType != SkPathFillType::kEvenOdd) return false;
+
+  auto outerIt = std::max_element(shapes.begin(), shapes.end(), [](const SkRRect& a, const SkRRect& b) {
+    return a.rect().width() * a.rect().height() < b.rect().width() * b.rect().height();
+  });
+  const SkRRect outer = *outerIt;
+  shapes.erase(outerIt);
+  for (const auto& hole : shapes) {
+    if (!outer.contains(hole.rect())) return false;
+  }
+  if (!areDisjointOnDevice_(shapes)) return false;
+
+  if (outer.isRect()) {
+    canvas_->clipRect(outer.rect(), antialias);
+  } else {
+    canvas_->clipRRect(outer, antialias);
+  }
+  for (const auto& hole : shapes) {
+    canvas_->clipRRect(hole, SkClipOp::kDifference, antialias);
+  }
+  return true;
+}
+
+bool CanvexContext::areDisjointOnDevice_(const std::vector<SkRRect>& shapes) {
+  if (shapes.size() < 2) return true;
+
+  // antialiased edges that share a pixel would blend twice, so compare whole pixels
+  const auto& m = canvas_->getTotalMatrix();
+  std::vector<SkIRect> deviceBounds;
+  for (const auto& shape : shapes) {
+    deviceBounds.push_back(m.mapRect(shape.getBounds()).roundOut());
+  }
+  for (size_t i = 0; i < deviceBounds.size(); i++) {
+    for (size_t j = i + 1; j < deviceBounds.size(); j++) {
+      if (SkIRect::Intersects(deviceBounds[i], deviceBounds[j])) return false;
+    }
+  }
+  return true;
+}
+
+void CanvexContext::addStyleStateToHash(Hasher& h) const {
+  const auto& sf = stateStack_.back();
+  h.add(sf.globalAlpha).add(sf.fillColor).add(sf.strokeColor);
+  h.add(sf.strokeWidth_px).add(sf.strokeJoin);
+  h.add(sf.fontSize).add(sf.fontWeight).add(sf.fontName).add(sf.fontIsItalic);
+}
+
+Hasher CanvexContext::getStateHasher_() {
+  const auto& sf = stateStack_.back();
+  SkScalar matrix[9];
+  canvas_->getTotalMatrix().get9(matrix);
+
+  Hasher h;
+  h.add(matrix).add(sf.clipHash);
+  addStyleStateToHash(h);
+  return h;
+}
+
+void CanvexContext::recordDraw_(const Hasher& h, const SkRect& localBounds, SkScalar outset, bool forceDamage) {
+  const auto r = localBounds.makeOutset(outset, outset);
+  auto devBounds = canvas_->getTotalMatrix().mapRect(r).roundOut();
+
+  // one extra pixel for antialiasing
+  devBounds.outset(1, 1);
+
+  if (!devBounds.intersect(canvas_->getDeviceClipBounds())) {
+    devBounds.setEmpty();
   }
+  drawRecords_->push_back({h.value(), devBounds, forceDamage});
 }
 } // namespace canvex
@@ -3,7 +3,10 @@
 #include <filesystem>
 #include <iostream>
 #include <unordered_map>
+#include "canvas_display_list.h"
+#include "canvex_analytic_shapes.h"
 #include "canvex_skia_resource_context.h"
+#include "hash_util.h"
 
 /*
  Implements a basic HTML-style canvas 2D context around Skia.
@@ -22,14 +25,17 @@ enum FillRuleType {
   EVENODD = 1,  // same as SkPathFillType::kEvenOdd
 };
 
-enum ImageSourceType {
-  DefaultAsset,
-  CompositionAsset,
-  LiveAsset,
+// Device-space bounds and content hash of a single draw call.
+// Comparing two lists of these tells which pixels changed between two display lists.
+struct DrawRecord {
+  uint64_t hash;
+  SkIRect bounds;
+  bool forceDamage;  // content may have changed even though the hash didn't (e.g. image was reloaded)
 };
 
 struct DrawImageStats {
   bool wasCacheMiss;
+  bool wasPending;  // not drawn because the image is still decoding in the background
   double timeSpent_imageLoad_s;
   double timeSpent_skiaDraw_s;
 };
@@ -48,7 +54,9 @@ struct CanvexContextStateFrame {
   double fontSize = 12;
   int fontWeight = 400;
   std::string fontName;
-  bool fontIsItalic;  // only supported value for fontStyle
+  bool fontIsItalic = false;  // only supported value for fontStyle
+
+  uint64_t clipHash = 0;  // identifies the clip state, for DrawRecord hashes
 };
 
 class CanvexContext {
@@ -100,23 +108,102 @@ class CanvexContext {
   void fill();
   void stroke();
 
+  // if set, every draw call appends a DrawRecord to the given list
+  void setDrawRecorder(std::vector<DrawRecord>* records) {
+    drawRecords_ = records;
+  }
+
+  // access to the current state frame, so that a separate context (e.g. one that records
+  // into an SkPicture) can continue from the same styles
+  const CanvexContextStateFrame& getState() const {
+    return stateStack_.back();
+  }
+  void setState(const CanvexContextStateFrame& sf) {
+    stateStack_.back() = sf;
+  }
+
+  // adds the styles of the current state (colors, stroke, font) but not transform or clip
+  void addStyleStateToHash(Hasher& h) const;
+
+  // transform that the canvas contents will be drawn with, for a context that records
+  // into an SkPicture. images and emoji are rasterized for the resulting device scale.
+  void setBaseMatrix(const SkMatrix& m) {
+    baseMatrix_ = m;
+  }
+
  private:
   // external rendering target and configuration
   std::shared_ptr<SkCanvas> canvas_;
   std::filesystem::path resPath_;
 
+  SkMatrix baseMatrix_ = SkMatrix::I();
+
   // internal state
   std::unique_ptr<SkPath> path_;
   std::vector<CanvexContextStateFrame> stateStack_;
 
+  // rects and rounded rects in path_, drawn and clipped with Skia's analytic primitives when possible
+  AnalyticShapeTracker pathShapes_;
+
   // cached resources
   CanvexSkiaResourceContext& skiaResCtx_;
 
-  // returns null if image can't be loaded, or cached image if already present in skiaResCtx
-  sk_sp<SkImage> getImage(ImageSourceType type, const std::string& imageName, DrawImageStats* stats);
+  // damage tracking
+  std::vector<DrawRecord>* drawRecords_ = nullptr;
+  uint64_t pathHash_ = 0;
+
+  template <typename... Ts>
+  void addToPathHash_(Ts... vals) {
+    if (!drawRecords_) return;
+    Hasher h(pathHash_);
+    (h.add(vals), ...);
+    pathHash_ = h.value();
+  }
+
+  // transform from the current local coordinates to output pixels
+  SkMatrix getDeviceMatrix_() const {
+    return SkMatrix::Concat(baseMatrix_, canvas_->getTotalMatrix());
+  }
+
+  // hash of the current transform, clip and style state
+  Hasher getStateHasher_();
+
+  void recordDraw_(const Hasher& h, const SkRect& localBounds, SkScalar outset, bool forceDamage = false);
+
+  // conservative outset for stroked geometry (covers miter joins at the default limit)
+  SkScalar getStrokeOutset_() {
+    return stateStack_.back().strokeWidth_px * 2;
+  }
+
+  // fill and clip the current path as its rect and rounded rect shapes.
+  // return false if the path must be drawn as a path.
+  bool fillPathShapes_(const SkPaint& paint);
+  bool clipPathShapes_(SkPathFillType fillType, bool antialias);
+
+  // true if no device pixel is touched by more than one of the shapes,
+  // so drawing them one by one blends the same as drawing them as one path
+  bool areDisjointOnDevice_(const std::vector<SkRRect>& shapes);
+
+  // returns a cached typeface for the font variant, or null if it can't be loaded
+  sk_sp<SkTypeface> getTypeface_(const std::string& fontFamily, int fontWeight, bool italic);
+
+  // returns a cached text blob, or null if the text can't be shaped
+  sk_sp<SkTextBlob> getTextBlob_(const std::string& text, const sk_sp<SkTypeface>& typeface, float size);
+
+  // draws the emoji as a blit from the emoji atlas. returns false if the atlas can't be used
+  bool drawEmojiFromAtlas_(const std::string& text, const sk_sp<SkTypeface>& typeface,
+                           double x, double y, double h, const SkPaint& paint);
+
+  // returns an entry with a null image if the image can't be loaded.
+  // the cached image is decoded again if drawSize needs a higher resolution than it has.
+  CachedImage getImage(ImageSourceType type, const std::string& imageName, const ImageDrawSize& drawSize,
+                       DrawImageStats* stats);
 
   std::filesystem::path getImagePath(ImageSourceType type, const std::string& imageName);
 
+  // stands in for an image that is still decoding, according to the resource context's load policy
+  void drawPendingImage_(const std::string& imageName, const SkRect& dstRect);
+
   // utils to access current state
   float getGlobalAlpha() {
     const auto& sf = stateStack_.back();
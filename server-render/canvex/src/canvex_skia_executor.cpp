@@ -1,9 +1,15 @@
 #include "../include/canvex_c_api.h"
 #include "canvex_skia_executor.h"
 #include "canvex_skia_context.h"
+#include "canvex_op_profiler.h"
+#include "canvex_skia_caches.h"
+#include "canvex_yuv_output.h"
 #include "skia_includes.h"
 #include "time_util.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <optional>
 #include <cstdio>
 
 namespace canvex {
@@ -36,469 +42,806 @@ static void debugPrintArgs(const Command& cmd, std::ostream& os) {
 }
 
 
-static void renderDisplayListInSkCanvas(
-    const VCSCanvasDisplayList& dl,
-    std::shared_ptr<SkCanvas> canvas,
-    const std::filesystem::path& resourceDir,
-    CanvexSkiaResourceContext* skiaResCtxPtr,
-    CanvexExecutionStats* stats // optional stats
-  ) {
-  // accumulated stats
+// accumulated stats for one render call
+struct RenderCounters {
   double timeSpent_imageLoading_s = 0.0;
   double timeSpent_drawImage_s = 0.0;
   double timeSpent_drawShapes_s = 0.0;
   double timeSpent_drawText_s = 0.0;
   int numImageCacheMisses = 0;
-
-  canvas->clear(SK_ColorTRANSPARENT);
-
-  const auto canvasSize = canvas->getBaseLayerSize();
-
-  // check display list's encoded w/h and scale Skia context accordingly so that rendering fills given buffer.
-  // if dl's size is zero, assume caller doesn't want this output scaling.
-  if (dl.width > 0 && dl.height > 0
-    && (dl.width != (int)canvasSize.width() || dl.width != (int)canvasSize.height())) {
-    double scaleX = canvasSize.width() / (double)dl.width;
-    double scaleY = canvasSize.height() / (double)dl.height;
-    canvas->scale(scaleX, scaleY);
-  }
-
-  std::unique_ptr<CanvexSkiaResourceContext> tempResCtxPtr;
-  if (!skiaResCtxPtr) {
-    // if a cached resource context wasn't passed in, create one now for this call
-    tempResCtxPtr = std::make_unique<CanvexSkiaResourceContext>();
-    std::cout << __func__
-        << ": No Skia resource context from caller (this prevents resource reuse between calls)" << std::endl;
-  }
-
-  CanvexContext ctx(canvas, resourceDir, (skiaResCtxPtr) ? *skiaResCtxPtr : *tempResCtxPtr);
-
-  // basic status tracking
+  int numImagesPending = 0;
+  int numShmImages = 0;
   int numInvalidArgErrors = 0;
   int numCmds = 0;
+  int numGroupCacheHits = 0;
+  int numGroupCacheMisses = 0;
+  OpProfiler* opProfiler = nullptr; // only set when profiling is on
+};
 
-  for (const auto& cmd : dl.cmds) {
-    switch (cmd.op) {
-      default:
-        std::cout << "Warning: unhandled canvas op: " << cmd.op << std::endl;
-        break;
+static void executeCommand(const Command& cmd, CanvexContext& ctx, RenderCounters& counters) {
+  switch (cmd.op) {
+    default:
+      std::cout << "Warning: unhandled canvas op: " << cmd.op << std::endl;
+      break;
 
-      case save: {
-        PRINTCMD_NOARGS("save")
-        ctx.save();
-        numCmds++;
-        break;
-      }
-      case restore: {
-        PRINTCMD_NOARGS("restore")
-        ctx.restore();
-        numCmds++;
-        break;
-      }
-      case scale: {
-        PRINTCMD_ARGS("scale")
-        if (cmd.args.size() != 2
-           || cmd.args[0].type != ArgType::number || cmd.args[1].type != ArgType::number) {
-          std::cout << "Invalid args for scale: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.scale(cmd.args[0].numberValue, cmd.args[1].numberValue);
-          numCmds++;
-        }
-        break;
+    case save: {
+      PRINTCMD_NOARGS("save")
+      ctx.save();
+      counters.numCmds++;
+      break;
+    }
+    case restore: {
+      PRINTCMD_NOARGS("restore")
+      ctx.restore();
+      counters.numCmds++;
+      break;
+    }
+    case scale: {
+      PRINTCMD_ARGS("scale")
+      if (cmd.args.size() != 2
+         || cmd.args[0].type != ArgType::number || cmd.args[1].type != ArgType::number) {
+        std::cout << "Invalid args for scale: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.scale(cmd.args[0].numberValue, cmd.args[1].numberValue);
+        counters.numCmds++;
       }
-      case rotate: {
-        PRINTCMD_ARGS("rotate")
-        if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::number) {
-          std::cout << "Invalid arg for rotate: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.rotate(cmd.args[0].numberValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case rotate: {
+      PRINTCMD_ARGS("rotate")
+      if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::number) {
+        std::cout << "Invalid arg for rotate: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.rotate(cmd.args[0].numberValue);
+        counters.numCmds++;
       }
-      case translate: {
-        PRINTCMD_ARGS("translate")
-        if (cmd.args.size() != 2
-           || cmd.args[0].type != ArgType::number || cmd.args[1].type != ArgType::number) {
-          std::cout << "Invalid args for translate: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.translate(cmd.args[0].numberValue, cmd.args[1].numberValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case translate: {
+      PRINTCMD_ARGS("translate")
+      if (cmd.args.size() != 2
+         || cmd.args[0].type != ArgType::number || cmd.args[1].type != ArgType::number) {
+        std::cout << "Invalid args for translate: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.translate(cmd.args[0].numberValue, cmd.args[1].numberValue);
+        counters.numCmds++;
       }
-      case fillStyle: {
-        PRINTCMD_ARGS("fillStyle")
-        if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::string) {
-          std::cout << "Invalid arg for fillStyle: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.setFillStyle(cmd.args[0].stringValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case fillStyle: {
+      PRINTCMD_ARGS("fillStyle")
+      if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::string) {
+        std::cout << "Invalid arg for fillStyle: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.setFillStyle(cmd.args[0].stringValue);
+        counters.numCmds++;
       }
-      case strokeStyle: {
-        PRINTCMD_ARGS("strokeStyle")
-        if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::string) {
-          std::cout << "Invalid arg for strokeStyle: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.setStrokeStyle(cmd.args[0].stringValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case strokeStyle: {
+      PRINTCMD_ARGS("strokeStyle")
+      if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::string) {
+        std::cout << "Invalid arg for strokeStyle: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.setStrokeStyle(cmd.args[0].stringValue);
+        counters.numCmds++;
       }
-      case lineWidth: {
-        PRINTCMD_ARGS("lineWidth")
-        if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::number) {
-          std::cout << "Invalid args for lineWidth: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.setLineWidth(cmd.args[0].numberValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case lineWidth: {
+      PRINTCMD_ARGS("lineWidth")
+      if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::number) {
+        std::cout << "Invalid args for lineWidth: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.setLineWidth(cmd.args[0].numberValue);
+        counters.numCmds++;
       }
-      case lineJoin: {
-        PRINTCMD_ARGS("lineJoin")
-        if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::string) {
-          std::cout << "Invalid args for lineJoin: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          auto& str = cmd.args[0].stringValue;
-          JoinType join = MITER;
-          if (str == "bevel") join = BEVEL;
-          else if (str == "round") join = ROUND;
-          //std::cout << "Setting join " << (int)join << " from " << str << std::endl;
-          ctx.setLineJoin(join);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case lineJoin: {
+      PRINTCMD_ARGS("lineJoin")
+      if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::string) {
+        std::cout << "Invalid args for lineJoin: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        auto& str = cmd.args[0].stringValue;
+        JoinType join = MITER;
+        if (str == "bevel") join = BEVEL;
+        else if (str == "round") join = ROUND;
+        //std::cout << "Setting join " << (int)join << " from " << str << std::endl;
+        ctx.setLineJoin(join);
+        counters.numCmds++;
       }
-      case globalAlpha: {
-        PRINTCMD_ARGS("globalAlpha")
-        if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::number) {
-          std::cout << "Invalid args for globalAlpha: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.setGlobalAlpha(cmd.args[0].numberValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case globalAlpha: {
+      PRINTCMD_ARGS("globalAlpha")
+      if (cmd.args.size() != 1 || cmd.args[0].type != ArgType::number) {
+        std::cout << "Invalid args for globalAlpha: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.setGlobalAlpha(cmd.args[0].numberValue);
+        counters.numCmds++;
       }
-      case font: {
-        PRINTCMD_ARGS("font")
-        if (cmd.args.size() != 4
-           || (cmd.args[0].type != ArgType::string && cmd.args[0].type != ArgType::number)
-           || cmd.args[1].type != ArgType::string
-           || cmd.args[2].type != ArgType::number
-           || cmd.args[3].type != ArgType::string) {
-          std::cout << "Invalid args for font: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.setFont(cmd.args[0].stringValue, cmd.args[1].stringValue, cmd.args[2].numberValue, cmd.args[3].stringValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case font: {
+      PRINTCMD_ARGS("font")
+      if (cmd.args.size() != 4
+         || (cmd.args[0].type != ArgType::string && cmd.args[0].type != ArgType::number)
+         || cmd.args[1].type != ArgType::string
+         || cmd.args[2].type != ArgType::number
+         || cmd.args[3].type != ArgType::string) {
+        std::cout << "Invalid args for font: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.setFont(cmd.args[0].stringValue, cmd.args[1].stringValue, cmd.args[2].numberValue, cmd.args[3].stringValue);
+        counters.numCmds++;
       }
-      case beginPath: {
-        PRINTCMD_ARGS("beginPath")
-        ctx.beginPath();
-        numCmds++;
-        break;
+      break;
+    }
+    case beginPath: {
+      PRINTCMD_ARGS("beginPath")
+      ctx.beginPath();
+      counters.numCmds++;
+      break;
+    }
+    case closePath: {
+      PRINTCMD_ARGS("closePath")
+      ctx.closePath();
+      counters.numCmds++;
+      break;
+    }
+    case moveTo: {
+      PRINTCMD_ARGS("moveTo")
+      if (cmd.args.size() != 2 || cmd.args[0].type != ArgType::number
+         || cmd.args[1].type != ArgType::number) {
+        std::cout << "Invalid args for moveTo: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.moveTo(cmd.args[0].numberValue, cmd.args[1].numberValue);
+        counters.numCmds++;
       }
-      case closePath: {
-        PRINTCMD_ARGS("closePath")
-        ctx.closePath();
-        numCmds++;
-        break;
+      break;
+    }
+    case lineTo: {
+      PRINTCMD_ARGS("lineTo")
+      if (cmd.args.size() != 2 || cmd.args[0].type != ArgType::number
+         || cmd.args[1].type != ArgType::number) {
+        std::cout << "Invalid args for lineTo: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.lineTo(cmd.args[0].numberValue, cmd.args[1].numberValue);
+        counters.numCmds++;
       }
-      case moveTo: {
-        PRINTCMD_ARGS("moveTo")
-        if (cmd.args.size() != 2 || cmd.args[0].type != ArgType::number
-           || cmd.args[1].type != ArgType::number) {
-          std::cout << "Invalid args for moveTo: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.moveTo(cmd.args[0].numberValue, cmd.args[1].numberValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case quadraticCurveTo: {
+      PRINTCMD_ARGS("quadraticCurveTo")
+      if (cmd.args.size() != 4 || cmd.args[0].type != ArgType::number
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
+         || cmd.args[3].type != ArgType::number) {
+        std::cout << "Invalid args for quadraticCurveTo: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.quadraticCurveTo(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue);
+        counters.numCmds++;
       }
-      case lineTo: {
-        PRINTCMD_ARGS("lineTo")
-        if (cmd.args.size() != 2 || cmd.args[0].type != ArgType::number
-           || cmd.args[1].type != ArgType::number) {
-          std::cout << "Invalid args for lineTo: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.lineTo(cmd.args[0].numberValue, cmd.args[1].numberValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case arcTo: {
+      PRINTCMD_ARGS("arcTo")
+      if (cmd.args.size() != 5 || cmd.args[0].type != ArgType::number
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
+         || cmd.args[3].type != ArgType::number || cmd.args[4].type != ArgType::number) {
+        std::cout << "Invalid args for arcTo: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        ctx.arcTo(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue,
+                  cmd.args[3].numberValue, cmd.args[4].numberValue);
+        counters.numCmds++;
       }
-      case quadraticCurveTo: {
-        PRINTCMD_ARGS("quadraticCurveTo")
-        if (cmd.args.size() != 4 || cmd.args[0].type != ArgType::number
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
-           || cmd.args[3].type != ArgType::number) {
-          std::cout << "Invalid args for quadraticCurveTo: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.quadraticCurveTo(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue);
-          numCmds++;
-        }
-        break;
+      break;
+    }
+    case clip: {
+      PRINTCMD_ARGS("clip")
+      if (cmd.args.size() > 1 ||
+        (cmd.args.size() == 1 && cmd.args[0].type != ArgType::string)) {
+        std::cout << "Invalid args for clip: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
       }
-      case arcTo: {
-        PRINTCMD_ARGS("arcTo")
-        if (cmd.args.size() != 5 || cmd.args[0].type != ArgType::number
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
-           || cmd.args[3].type != ArgType::number || cmd.args[4].type != ArgType::number) {
-          std::cout << "Invalid args for arcTo: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          ctx.arcTo(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue,
-                    cmd.args[3].numberValue, cmd.args[4].numberValue);
-          numCmds++;
+      auto fillRule = FillRuleType::NONZERO;
+      if (cmd.args.size() == 1) {
+        if (cmd.args[0].stringValue == "evenodd") {
+          fillRule = FillRuleType::EVENODD;
         }
-        break;
       }
-      case clip: {
-        PRINTCMD_ARGS("clip")
-        if (cmd.args.size() > 1 ||
-          (cmd.args.size() == 1 && cmd.args[0].type != ArgType::string)) {
-          std::cout << "Invalid args for clip: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        }
-        auto fillRule = FillRuleType::NONZERO;
-        if (cmd.args.size() == 1) {
-          if (cmd.args[0].stringValue == "evenodd") {
-            fillRule = FillRuleType::EVENODD;
-          }
-        }
-        ctx.clip(fillRule);
-        numCmds++;
-        break;
+      ctx.clip(fillRule);
+      counters.numCmds++;
+      break;
+    }
+    case fill: {
+      PRINTCMD_ARGS("fill")
+      double ts = getMonotonicTime();
+
+      ctx.fill();
+
+      counters.timeSpent_drawShapes_s += getMonotonicTime() - ts;
+      counters.numCmds++;
+      break;
+    }
+    case stroke: {
+      PRINTCMD_ARGS("stroke")
+      double ts = getMonotonicTime();
+
+      ctx.stroke();
+
+      counters.timeSpent_drawShapes_s += getMonotonicTime() - ts;
+      counters.numCmds++;
+      break;
+    }
+    case fillRect: {
+      PRINTCMD_ARGS("fillRect")
+      if (cmd.args.size() != 4 || cmd.args[0].type != ArgType::number
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
+         || cmd.args[3].type != ArgType::number) {
+        std::cout << "Invalid args for fillRect: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        double ts = getMonotonicTime();
+
+        ctx.fillRect(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue);
+
+        counters.timeSpent_drawShapes_s += getMonotonicTime() - ts;
+        counters.numCmds++;
       }
-      case fill: {
-        PRINTCMD_ARGS("fill")
+      break;
+    }
+    case strokeRect: {
+      PRINTCMD_ARGS("strokeRect")
+      if (cmd.args.size() != 4 || cmd.args[0].type != ArgType::number
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
+         || cmd.args[3].type != ArgType::number) {
+        std::cout << "Invalid args for strokeRect: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
         double ts = getMonotonicTime();
 
-        ctx.fill();
+        ctx.strokeRect(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue);
 
-        timeSpent_drawShapes_s += getMonotonicTime() - ts;
-        numCmds++;
-        break;
+        counters.timeSpent_drawShapes_s += getMonotonicTime() - ts;
+        counters.numCmds++;
       }
-      case stroke: {
-        PRINTCMD_ARGS("stroke")
+      break;
+    }
+    case rect: {
+      PRINTCMD_ARGS("rect")
+      if (cmd.args.size() != 4 || cmd.args[0].type != ArgType::number
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
+         || cmd.args[3].type != ArgType::number) {
+        std::cout << "Invalid args for rect: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
         double ts = getMonotonicTime();
 
-        ctx.stroke();
+        ctx.rect(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue);
 
-        timeSpent_drawShapes_s += getMonotonicTime() - ts;
-        numCmds++;
-        break;
+        counters.timeSpent_drawShapes_s += getMonotonicTime() - ts;
+        counters.numCmds++;
       }
-      case fillRect: {
-        PRINTCMD_ARGS("fillRect")
-        if (cmd.args.size() != 4 || cmd.args[0].type != ArgType::number
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
-           || cmd.args[3].type != ArgType::number) {
-          std::cout << "Invalid args for fillRect: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          double ts = getMonotonicTime();
+      break;
+    }
+    case roundRect: {
+      PRINTCMD_ARGS("roundRect")
+      if (cmd.args.size() != 8 || cmd.args[0].type != ArgType::number
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
+         || cmd.args[3].type != ArgType::number || cmd.args[4].type != ArgType::number
+         || cmd.args[5].type != ArgType::number || cmd.args[6].type != ArgType::number
+         || cmd.args[7].type != ArgType::number) {
+        std::cout << "Invalid args for roundRect: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        double ts = getMonotonicTime();
 
-          ctx.fillRect(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue);
+        ctx.roundRect(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue,
+                      cmd.args[4].numberValue, cmd.args[5].numberValue, cmd.args[6].numberValue, cmd.args[7].numberValue);
 
-          timeSpent_drawShapes_s += getMonotonicTime() - ts;
-          numCmds++;
-        }
-        break;
+        counters.timeSpent_drawShapes_s += getMonotonicTime() - ts;
+        counters.numCmds++;
       }
-      case strokeRect: {
-        PRINTCMD_ARGS("strokeRect")
-        if (cmd.args.size() != 4 || cmd.args[0].type != ArgType::number
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
-           || cmd.args[3].type != ArgType::number) {
-          std::cout << "Invalid args for strokeRect: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          double ts = getMonotonicTime();
+      break;
+    }
+    case fillText: {
+      PRINTCMD_ARGS("fillText")
+      if (cmd.args.size() != 3 || cmd.args[0].type != ArgType::string
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number) {
+        std::cout << "Invalid args for fillText: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        double ts = getMonotonicTime();
 
-          ctx.strokeRect(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue);
+        ctx.fillText(cmd.args[0].stringValue, cmd.args[1].numberValue, cmd.args[2].numberValue);
 
-          timeSpent_drawShapes_s += getMonotonicTime() - ts;
-          numCmds++;
-        }
-        break;
+        counters.timeSpent_drawText_s += getMonotonicTime() - ts;
+        counters.numCmds++;
       }
-      case rect: {
-        PRINTCMD_ARGS("rect")
-        if (cmd.args.size() != 4 || cmd.args[0].type != ArgType::number
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
-           || cmd.args[3].type != ArgType::number) {
-          std::cout << "Invalid args for rect: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          double ts = getMonotonicTime();
+      break;
+    }
+    case fillText_emoji: {
+      PRINTCMD_ARGS("fillText_emoji")
+      if (cmd.args.size() != 5 || cmd.args[0].type != ArgType::string
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
+         || cmd.args[3].type != ArgType::number || cmd.args[4].type != ArgType::number) {
+        std::cout << "Invalid args for fillText_emoji: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        double ts = getMonotonicTime();
 
-          ctx.rect(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue);
+        ctx.fillText_emoji(cmd.args[0].stringValue,
+                           cmd.args[1].numberValue, cmd.args[2].numberValue,
+                           cmd.args[3].numberValue, cmd.args[4].numberValue);
 
-          timeSpent_drawShapes_s += getMonotonicTime() - ts;
-          numCmds++;
-        }
-        break;
+        counters.timeSpent_drawText_s += getMonotonicTime() - ts;
+
+        //std::cout << "Time spent on draw emoji: " << counters.timeSpent_drawText_s << std::endl;
+
+        counters.numCmds++;
       }
-      case roundRect: {
-        PRINTCMD_ARGS("roundRect")
-        if (cmd.args.size() != 8 || cmd.args[0].type != ArgType::number
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
-           || cmd.args[3].type != ArgType::number || cmd.args[4].type != ArgType::number
-           || cmd.args[5].type != ArgType::number || cmd.args[6].type != ArgType::number
-           || cmd.args[7].type != ArgType::number) {
-          std::cout << "Invalid args for roundRect: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          double ts = getMonotonicTime();
+      break;
+    }
+    case strokeText: {
+      PRINTCMD_ARGS("strokeText")
+      if (cmd.args.size() != 3 || cmd.args[0].type != ArgType::string
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number) {
+        std::cout << "Invalid args for strokeText: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else {
+        double ts = getMonotonicTime();
 
-          ctx.roundRect(cmd.args[0].numberValue, cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue,
-                        cmd.args[4].numberValue, cmd.args[5].numberValue, cmd.args[6].numberValue, cmd.args[7].numberValue);
+        ctx.strokeText(cmd.args[0].stringValue, cmd.args[1].numberValue, cmd.args[2].numberValue);
 
-          timeSpent_drawShapes_s += getMonotonicTime() - ts;
-          numCmds++;
-        }
-        break;
+        counters.timeSpent_drawText_s += getMonotonicTime() - ts;
+        counters.numCmds++;
       }
-      case fillText: {
-        PRINTCMD_ARGS("fillText")
-        if (cmd.args.size() != 3 || cmd.args[0].type != ArgType::string
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number) {
-          std::cout << "Invalid args for fillText: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
+      break;
+    }
+    case drawImage: {
+      PRINTCMD_ARGS("drawImage")
+      if (cmd.args.size() < 5 || cmd.args[0].type != ArgType::assetRef
+         || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
+         || cmd.args[3].type != ArgType::number || cmd.args[4].type != ArgType::number) {
+        std::cout << "Invalid args for drawImage: "; debugPrintArgs(cmd, std::cout);
+        counters.numInvalidArgErrors++;
+      } else if (!cmd.args[0].assetRefValue || cmd.args[0].assetRefValue->second.empty()) {
+        std::cout << "Invalid assetRef for drawImage, has_value=" << cmd.args[0].assetRefValue.has_value() << std::endl;
+        counters.numInvalidArgErrors++;
+      } else {
+        auto& imgTypeStr = cmd.args[0].assetRefValue->first;
+        std::string imgName = cmd.args[0].assetRefValue->second;
+
+        ImageSourceType srcType;
+        if (auto parsedType = ImageSourceTypeFromString(imgTypeStr)) {
+          srcType = *parsedType;
         } else {
-          double ts = getMonotonicTime();
-
-          ctx.fillText(cmd.args[0].stringValue, cmd.args[1].numberValue, cmd.args[2].numberValue);
+          std::cout << "Unknown type string for drawImage: " << imgTypeStr << std::endl;
+          // default to composition asset
+          srcType = ImageSourceType::CompositionAsset;
+        }
+        if (srcType == ImageSourceType::LiveAsset || srcType == ImageSourceType::SharedMemoryAsset) {
+          // the imgName argument may have an extra hash value to force an update on the React side.
+          // remove anything after the # sign.
+          auto hashIdx = imgName.find_last_of('#');
+          if (hashIdx != std::string::npos) {
+            imgName = imgName.substr(0, hashIdx);
+          }
+        }
 
-          timeSpent_drawText_s += getMonotonicTime() - ts;
-          numCmds++;
+        DrawImageStats drawImageStats{};
+        
+        // drawImage has two argument formats that we support:
+        // - 5-argument version with srcDrawable + 4 dstRect coords
+        // - 9-argument version with srcDrawable + 4 srcRect coords + 4 dstRect coords
+        if (cmd.args.size() < 9) {
+          ctx.drawImage(srcType, imgName,
+            cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue, cmd.args[4].numberValue,
+            &drawImageStats);
+        } else {
+          ctx.drawImageWithSrcCoords(srcType, imgName,
+            cmd.args[5].numberValue, cmd.args[6].numberValue, cmd.args[7].numberValue, cmd.args[8].numberValue,
+            cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue, cmd.args[4].numberValue,
+            &drawImageStats);
         }
-        break;
+
+        counters.timeSpent_drawImage_s += drawImageStats.timeSpent_skiaDraw_s;
+        counters.timeSpent_imageLoading_s += drawImageStats.timeSpent_imageLoad_s;
+        if (drawImageStats.wasCacheMiss) counters.numImageCacheMisses++;
+        if (drawImageStats.wasPending) counters.numImagesPending++;
+        if (srcType == ImageSourceType::SharedMemoryAsset) counters.numShmImages++;
+
+        counters.numCmds++;
       }
-      case fillText_emoji: {
-        PRINTCMD_ARGS("fillText_emoji")
-        if (cmd.args.size() != 5 || cmd.args[0].type != ArgType::string
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
-           || cmd.args[3].type != ArgType::number || cmd.args[4].type != ArgType::number) {
-          std::cout << "Invalid args for fillText_emoji: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          double ts = getMonotonicTime();
 
-          ctx.fillText_emoji(cmd.args[0].stringValue,
-                             cmd.args[1].numberValue, cmd.args[2].numberValue,
-                             cmd.args[3].numberValue, cmd.args[4].numberValue);
+      break;
+    }
+  }
+}
+
+// executes the command at index i, timing it if profiling is on
+static void executeCommandAt(const VCSCanvasDisplayList& dl, size_t i, CanvexContext& ctx, RenderCounters& counters) {
+  if (!counters.opProfiler) {
+    executeCommand(dl.cmds[i], ctx, counters);
+    return;
+  }
+  const uint64_t t0 = ReadCycleCounter();
+  executeCommand(dl.cmds[i], ctx, counters);
+  counters.opProfiler->addCommand(i, dl.cmds[i], ReadCycleCounter() - t0);
+}
 
-          timeSpent_drawText_s += getMonotonicTime() - ts;
+// groups shorter than this aren't worth the overhead of recording a picture
+constexpr size_t kMinCachedGroupCmds = 8;
 
-          //std::cout << "Time spent on draw emoji: " << timeSpent_drawText_s << std::endl;
+// a cached group that was replayed this many times is also rasterized
+constexpr int kRasterizeGroupAfterUses = 4;
+constexpr int64_t kMaxGroupRasterPixels = 1024 * 1024;
 
-          numCmds++;
-        }
-        break;
+static bool isPathOp(OpType op) {
+  switch (op) {
+    case beginPath: case closePath: case moveTo: case lineTo: case quadraticCurveTo: case arcTo:
+    case rect: case roundRect: case fill: case stroke: case clip:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Save/restore structure of a display list, computed once per render for the group cache.
+struct GroupStructure {
+  // for each save, index of the matching restore (or -1)
+  std::vector<int32_t> groupEnd;
+
+  // for each command, whether the current path is discarded before it's used again after this command.
+  // the canvas path isn't part of save/restore state, so a group that leaves a path behind
+  // for later commands can't be replaced by a picture.
+  std::vector<bool> pathDeadAfter;
+
+  explicit GroupStructure(const VCSCanvasDisplayList& dl) {
+    const size_t n = dl.cmds.size();
+    groupEnd.assign(n, -1);
+    pathDeadAfter.assign(n, true);
+
+    std::vector<size_t> saveStack;
+    for (size_t i = 0; i < n; i++) {
+      if (dl.cmds[i].op == save) {
+        saveStack.push_back(i);
+      } else if (dl.cmds[i].op == restore && !saveStack.empty()) {
+        groupEnd[saveStack.back()] = i;
+        saveStack.pop_back();
       }
-      case strokeText: {
-        PRINTCMD_ARGS("strokeText")
-        if (cmd.args.size() != 3 || cmd.args[0].type != ArgType::string
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number) {
-          std::cout << "Invalid args for strokeText: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else {
-          double ts = getMonotonicTime();
+    }
 
-          ctx.strokeText(cmd.args[0].stringValue, cmd.args[1].numberValue, cmd.args[2].numberValue);
+    bool dead = true;
+    for (size_t i = n; i-- > 0; ) {
+      pathDeadAfter[i] = dead;
+      if (isPathOp(dl.cmds[i].op)) {
+        dead = dl.cmds[i].op == beginPath;
+      }
+    }
+  }
+};
 
-          timeSpent_drawText_s += getMonotonicTime() - ts;
-          numCmds++;
-        }
+static void addCommandToHash(Hasher& h, const Command& cmd) {
+  h.add(cmd.op).add(cmd.args.size());
+  for (const auto& arg : cmd.args) {
+    h.add(arg.type);
+    switch (arg.type) {
+      case ArgType::number:
+        h.add(arg.numberValue);
         break;
-      }
-      case drawImage: {
-        PRINTCMD_ARGS("drawImage")
-        if (cmd.args.size() < 5 || cmd.args[0].type != ArgType::assetRef
-           || cmd.args[1].type != ArgType::number || cmd.args[2].type != ArgType::number
-           || cmd.args[3].type != ArgType::number || cmd.args[4].type != ArgType::number) {
-          std::cout << "Invalid args for drawImage: "; debugPrintArgs(cmd, std::cout);
-          numInvalidArgErrors++;
-        } else if (!cmd.args[0].assetRefValue || cmd.args[0].assetRefValue->second.empty()) {
-          std::cout << "Invalid assetRef for drawImage, has_value=" << cmd.args[0].assetRefValue.has_value() << std::endl;
-          numInvalidArgErrors++;
-        } else {
-          auto& imgTypeStr = cmd.args[0].assetRefValue->first;
-          std::string imgName = cmd.args[0].assetRefValue->second;
-
-          ImageSourceType srcType;
-          if (imgTypeStr == "defaultAsset") {
-            srcType = ImageSourceType::DefaultAsset;
-          } else if (imgTypeStr == "compositionAsset") {
-            srcType = ImageSourceType::CompositionAsset;
-          } else if (imgTypeStr == "liveAsset") {
-            // the imgName argument may have an extra hash value to force an update on the React side.
-            // remove anything after the # sign.
-            auto hashIdx = imgName.find_last_of('#');
-            if (hashIdx != std::string::npos) {
-              imgName = imgName.substr(0, hashIdx);
-            }
-            srcType = ImageSourceType::LiveAsset;
-          } else {
-            std::cout << "Unknown type string for drawImage: " << imgTypeStr << std::endl;
-            // default to composition asset
-            srcType = ImageSourceType::CompositionAsset;
-          }
+      case ArgType::string:
+        h.add(arg.stringValue);
+        break;
+      case ArgType::assetRef:
+        h.add(arg.assetRefValue ? arg.assetRefValue->first : "");
+        h.add(arg.assetRefValue ? arg.assetRefValue->second : "");
+        break;
+    }
+  }
+}
 
-          DrawImageStats drawImageStats{};
-          
-          // drawImage has two argument formats that we support:
-          // - 5-argument version with srcDrawable + 4 dstRect coords
-          // - 9-argument version with srcDrawable + 4 srcRect coords + 4 dstRect coords
-          if (cmd.args.size() < 9) {
-            ctx.drawImage(srcType, imgName,
-              cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue, cmd.args[4].numberValue,
-              &drawImageStats);
-          } else {
-            ctx.drawImageWithSrcCoords(srcType, imgName,
-              cmd.args[5].numberValue, cmd.args[6].numberValue, cmd.args[7].numberValue, cmd.args[8].numberValue,
-              cmd.args[1].numberValue, cmd.args[2].numberValue, cmd.args[3].numberValue, cmd.args[4].numberValue,
-              &drawImageStats);
-          }
+// Content hash of the commands in [begin, end], or nullopt if the group can't be cached.
+static std::optional<uint64_t> hashCacheableGroup(
+  const VCSCanvasDisplayList& dl, const GroupStructure& structure, size_t begin, size_t end
+) {
+  if (!structure.pathDeadAfter[end]) {
+    return std::nullopt;
+  }
+  Hasher h;
+  bool seenPathOp = false;
+  for (size_t i = begin; i <= end; i++) {
+    const auto& cmd = dl.cmds[i];
+    if (isPathOp(cmd.op) && !seenPathOp) {
+      // a path started before the group isn't available when recording
+      if (cmd.op != beginPath) return std::nullopt;
+      seenPathOp = true;
+    }
+    if (cmd.op == drawImage && !cmd.args.empty() && cmd.args[0].assetRefValue
+        && (cmd.args[0].assetRefValue->first == "liveAsset" || cmd.args[0].assetRefValue->first == "shmAsset")) {
+      // live images can change without the display list changing
+      return std::nullopt;
+    }
+    addCommandToHash(h, cmd);
+  }
+  return h.value();
+}
+
+// Checks whether m equals ref up to an integer translation, which is then returned in dx/dy.
+static bool matrixDiffersByIntegerTranslate(const SkMatrix& m, const SkMatrix& ref, int& dx, int& dy) {
+  if (m.getScaleX() != ref.getScaleX() || m.getScaleY() != ref.getScaleY()
+      || m.getSkewX() != ref.getSkewX() || m.getSkewY() != ref.getSkewY()
+      || m.hasPerspective() || ref.hasPerspective()) {
+    return false;
+  }
+  const SkScalar tx = m.getTranslateX() - ref.getTranslateX();
+  const SkScalar ty = m.getTranslateY() - ref.getTranslateY();
+  if (tx != std::floor(tx) || ty != std::floor(ty)) {
+    return false;
+  }
+  dx = (int)tx;
+  dy = (int)ty;
+  return true;
+}
 
-          timeSpent_drawImage_s += drawImageStats.timeSpent_skiaDraw_s;
-          timeSpent_imageLoading_s += drawImageStats.timeSpent_imageLoad_s;
-          if (drawImageStats.wasCacheMiss) numImageCacheMisses++;
+static void rasterizeGroup(SkCanvas& canvas, CachedGroup& group) {
+  const SkMatrix& m = canvas.getTotalMatrix();
+  if (!m.rectStaysRect()) return;
 
-          numCmds++;
-        }
+  const SkIRect devBounds = m.mapRect(group.picture->cullRect()).roundOut();
+  if (devBounds.isEmpty() || (int64_t)devBounds.width() * devBounds.height() > kMaxGroupRasterPixels) {
+    return;
+  }
 
-        break;
+  auto surface = SkSurface::MakeRasterN32Premul(devBounds.width(), devBounds.height());
+  if (!surface) return;
+
+  auto rasterCanvas = surface->getCanvas();
+  rasterCanvas->clear(SK_ColorTRANSPARENT);
+  rasterCanvas->translate(-devBounds.x(), -devBounds.y());
+  rasterCanvas->concat(m);
+  rasterCanvas->drawPicture(group.picture);
+
+  group.raster = surface->makeImageSnapshot();
+  group.rasterMatrix = m;
+  group.rasterOrigin = {devBounds.x(), devBounds.y()};
+}
+
+static void drawCachedGroup(SkCanvas& canvas, CachedGroup& group, GroupCache& cache) {
+  int dx = 0, dy = 0;
+  if (group.raster && matrixDiffersByIntegerTranslate(canvas.getTotalMatrix(), group.rasterMatrix, dx, dy)) {
+    canvas.save();
+    canvas.resetMatrix();
+    canvas.drawImage(group.raster, group.rasterOrigin.x() + dx, group.rasterOrigin.y() + dy);
+    canvas.restore();
+    return;
+  }
+
+  canvas.drawPicture(group.picture);
+
+  if (!group.raster && group.timesSeen >= kRasterizeGroupAfterUses) {
+    rasterizeGroup(canvas, group);
+    if (group.raster) cache.updateSize(group);
+  }
+}
+
+// Draws the save/restore group [begin, end] using the group cache.
+// Returns false if the group isn't cacheable or hasn't been seen before,
+// in which case the caller should execute its commands normally.
+static bool renderGroupWithCache(
+  const VCSCanvasDisplayList& dl,
+  const GroupStructure& structure,
+  size_t begin,
+  size_t end,
+  SkCanvas& canvas,
+  CanvexContext& ctx,
+  const std::filesystem::path& resourceDir,
+  CanvexSkiaResourceContext& skiaResCtx,
+  RenderCounters& counters
+) {
+  auto contentHash = hashCacheableGroup(dl, structure, begin, end);
+  if (!contentHash) return false;
+
+  // the group inherits styles from the enclosing state, while transform and clip are applied at replay
+  Hasher h(*contentHash);
+  ctx.addStyleStateToHash(h);
+
+  auto& cache = skiaResCtx.groupCache;
+  auto& group = cache.touch(h.value());
+  group.timesSeen++;
+
+  const float deviceScale = canvas.getTotalMatrix().getMaxScale();
+  if (group.picture && group.recordedScale > 0 && deviceScale > group.recordedScale) {
+    // the group's images or emoji would be upscaled, so record it again at the new scale
+    group.picture = nullptr;
+    group.raster = nullptr;
+    cache.updateSize(group);
+  }
+
+  if (group.picture) {
+    drawCachedGroup(canvas, group, cache);
+    counters.numGroupCacheHits++;
+    counters.numCmds += end - begin + 1;
+    return true;
+  }
+
+  counters.numGroupCacheMisses++;
+
+  // only record groups that stayed unchanged between two renders
+  if (group.timesSeen < 2) return false;
+
+  SkRTreeFactory bbhFactory;
+  SkPictureRecorder recorder;
+  // the recorder owns its canvas
+  std::shared_ptr<SkCanvas> recordingCanvas(
+    recorder.beginRecording(SkRect::MakeLargest(), &bbhFactory), [](SkCanvas*) {});
+
+  CanvexContext recordingCtx(recordingCanvas, resourceDir, skiaResCtx);
+  recordingCtx.setState(ctx.getState());
+  recordingCtx.setBaseMatrix(canvas.getTotalMatrix());
+
+  bool hasScaledContent = false;
+  for (size_t i = begin; i <= end; i++) {
+    const auto op = dl.cmds[i].op;
+    if (op == OpType::drawImage || op == OpType::fillText_emoji) {
+      hasScaledContent = true;
+      break;
+    }
+  }
+  group.recordedScale = hasScaledContent ? deviceScale : 0;
+
+  const int pendingBefore = counters.numImagesPending;
+  for (size_t i = begin; i <= end; i++) {
+    executeCommandAt(dl, i, recordingCtx, counters);
+  }
+
+  // updateSize() may drop a picture that's too large to keep, so draw from a local ref
+  auto picture = recorder.finishRecordingAsPicture();
+
+  // a group with images still decoding is recorded again on its next use
+  if (counters.numImagesPending == pendingBefore) {
+    group.picture = picture;
+    cache.updateSize(group);
+  }
+
+  canvas.drawPicture(picture);
+  return true;
+}
+
+static void renderDisplayListInSkCanvas(
+    const VCSCanvasDisplayList& dl,
+    std::shared_ptr<SkCanvas> canvas,
+    const std::filesystem::path& resourceDir,
+    CanvexSkiaResourceContext* skiaResCtxPtr,
+    const SkRegion* damageClip, // optional, only this region is cleared and redrawn
+    std::vector<DrawRecord>* drawRecords, // optional, receives a record for each draw call
+    CanvexExecutionStats* stats // optional stats
+  ) {
+  if (damageClip) {
+    // the clip is in device space and stays in place for the whole display list
+    canvas->clipRegion(*damageClip);
+  }
+  canvas->clear(SK_ColorTRANSPARENT);
+
+  const auto canvasSize = canvas->getBaseLayerSize();
+
+  // check display list's encoded w/h and scale Skia context accordingly so that rendering fills given buffer.
+  // if dl's size is zero, assume caller doesn't want this output scaling.
+  if (dl.width > 0 && dl.height > 0
+    && (dl.width != (int)canvasSize.width() || dl.width != (int)canvasSize.height())) {
+    double scaleX = canvasSize.width() / (double)dl.width;
+    double scaleY = canvasSize.height() / (double)dl.height;
+    canvas->scale(scaleX, scaleY);
+  }
+
+  std::unique_ptr<CanvexSkiaResourceContext> tempResCtxPtr;
+  if (!skiaResCtxPtr) {
+    // if a cached resource context wasn't passed in, create one now for this call
+    tempResCtxPtr = std::make_unique<CanvexSkiaResourceContext>();
+    std::cout << __func__
+        << ": No Skia resource context from caller (this prevents resource reuse between calls)" << std::endl;
+  }
+
+  auto& skiaResCtx = (skiaResCtxPtr) ? *skiaResCtxPtr : *tempResCtxPtr;
+
+  CanvexContext ctx(canvas, resourceDir, skiaResCtx);
+  ctx.setDrawRecorder(drawRecords);
+
+  RenderCounters counters;
+  // the bounds pass of an incremental render (with draw records) isn't profiled, only the render itself
+  if (skiaResCtx.opProfilingEnabled && !drawRecords) {
+    skiaResCtx.opProfiler.reset();
+    counters.opProfiler = &skiaResCtx.opProfiler;
+  }
+  const TextCacheCounters textCountersAtStart = skiaResCtx.textCacheCounters;
+  const ColdLoadCounters coldLoadsAtStart = skiaResCtx.coldLoadCounters;
+  const EmojiAtlasStats emojiStatsAtStart = skiaResCtx.emojiAtlas.getStats();
+  const int64_t imageEvictionsAtStart = skiaResCtx.numImageCacheEvictions();
+  skiaResCtx.beginShmFrameRender();
+  // the bounds pass is followed by the render, which takes the emoji page snapshots
+  if (!drawRecords) {
+    skiaResCtx.emojiAtlas.beginRender();
+  }
+
+  // cached groups are only useful with a retained resource context.
+  // they're also skipped when collecting draw records, since a replayed picture doesn't produce any.
+  std::optional<GroupStructure> groupStructure;
+  if (skiaResCtxPtr && !drawRecords) {
+    groupStructure.emplace(dl);
+  }
+
+  for (size_t i = 0; i < dl.cmds.size(); i++) {
+    if (groupStructure) {
+      const int32_t groupEnd = groupStructure->groupEnd[i];
+      const int hitsBefore = counters.numGroupCacheHits;
+      const uint64_t t0 = counters.opProfiler ? ReadCycleCounter() : 0;
+      if (groupEnd >= 0 && (size_t)groupEnd + 1 - i >= kMinCachedGroupCmds
+          && renderGroupWithCache(dl, *groupStructure, i, groupEnd, *canvas, ctx, resourceDir, skiaResCtx, counters)) {
+        // a group that was recorded now has its commands profiled individually
+        if (counters.opProfiler && counters.numGroupCacheHits > hitsBefore) {
+          counters.opProfiler->addGroupReplay(ReadCycleCounter() - t0);
+        }
+        i = groupEnd;
+        continue;
       }
     }
+    executeCommandAt(dl, i, ctx, counters);
+  }
+
+  const auto& textCounters = skiaResCtx.textCacheCounters;
+  // the bounds pass looks up the same text as the render that follows it, so only the render is counted
+  if (!drawRecords) {
+    AddTextCacheLookups(textCounters.textBlobHits - textCountersAtStart.textBlobHits,
+                        textCounters.textBlobMisses - textCountersAtStart.textBlobMisses,
+                        textCounters.fontHits - textCountersAtStart.fontHits,
+                        textCounters.fontMisses - textCountersAtStart.fontMisses);
   }
 
   if (stats) {
-    stats->render_detail_image_loading_us = timeSpent_imageLoading_s * 1.0e6;
-    stats->render_detail_draw_image_us = timeSpent_drawImage_s * 1.0e6;
-    stats->render_detail_draw_shapes_us = timeSpent_drawShapes_s * 1.0e6;
-    stats->render_detail_draw_text_us = timeSpent_drawText_s * 1.0e6;
-    stats->num_cmds = numCmds;
-    stats->num_invalid_arg_errors = numInvalidArgErrors;
-    stats->num_image_cache_misses = numImageCacheMisses;
+    stats->render_detail_image_loading_us = counters.timeSpent_imageLoading_s * 1.0e6;
+    stats->render_detail_draw_image_us = counters.timeSpent_drawImage_s * 1.0e6;
+    stats->render_detail_draw_shapes_us = counters.timeSpent_drawShapes_s * 1.0e6;
+    stats->render_detail_draw_text_us = counters.timeSpent_drawText_s * 1.0e6;
+    stats->num_cmds = counters.numCmds;
+    stats->num_invalid_arg_errors = counters.numInvalidArgErrors;
+    stats->num_image_cache_misses = counters.numImageCacheMisses;
+    stats->num_images_pending = counters.numImagesPending;
+    stats->num_shm_images = counters.numShmImages;
+    stats->num_image_cache_evictions = skiaResCtx.numImageCacheEvictions() - imageEvictionsAtStart;
+    stats->image_cache_bytes = skiaResCtx.imageCacheBytes();
+    stats->num_group_cache_hits = counters.numGroupCacheHits;
+    stats->num_group_cache_misses = counters.numGroupCacheMisses;
+    stats->group_cache_bytes = skiaResCtx.groupCache.totalBytes();
+
+    stats->num_text_blob_cache_hits = textCounters.textBlobHits - textCountersAtStart.textBlobHits;
+    stats->num_text_blob_cache_misses = textCounters.textBlobMisses - textCountersAtStart.textBlobMisses;
+    stats->num_font_cache_hits = textCounters.fontHits - textCountersAtStart.fontHits;
+    stats->num_font_cache_misses = textCounters.fontMisses - textCountersAtStart.fontMisses;
+
+    const auto emojiStats = skiaResCtx.emojiAtlas.getStats();
+    stats->num_emoji_sprite_hits = emojiStats.spriteHits - emojiStatsAtStart.spriteHits;
+    stats->num_emoji_sprite_misses = emojiStats.spriteMisses - emojiStatsAtStart.spriteMisses;
+    stats->emoji_atlas_pages = emojiStats.numPages;
+    stats->emoji_atlas_occupancy_pct = emojiStats.occupancyPct;
+    stats->emoji_atlas_bytes = emojiStats.bytes;
+
+    const auto& coldLoads = skiaResCtx.coldLoadCounters;
+    stats->cold_load_us = (coldLoads.time_s - coldLoadsAtStart.time_s) * 1.0e6;
+    stats->num_cold_font_loads = coldLoads.fontLoads - coldLoadsAtStart.fontLoads;
+    stats->num_cold_image_loads = coldLoads.imageLoads - coldLoadsAtStart.imageLoads;
   }
 }
 
@@ -550,7 +893,7 @@ bool RenderDisplayListToPNG(
 
   double t1 = getMonotonicTime();
 
-  renderDisplayListInSkCanvas(dl, canvas, resourceDir, skiaResCtx, stats);
+  renderDisplayListInSkCanvas(dl, canvas, resourceDir, skiaResCtx, nullptr, nullptr, stats);
 
   double t2 = getMonotonicTime();
 
@@ -567,17 +910,13 @@ bool RenderDisplayListToPNG(
   return ok;
 }
 
-bool RenderDisplayListToRawBuffer(
-  const VCSCanvasDisplayList& dl,
+static std::shared_ptr<SkCanvas> makeRasterCanvas(
   const RenderFormat format,
   uint8_t *imageBuffer,
   uint32_t w,
   uint32_t h,
   uint32_t rowBytes,
-  CanvexAlphaMode alphaMode,
-  const std::filesystem::path& resourceDir,
-  CanvexSkiaResourceContext* skiaResCtx, // optional cache between calls
-  CanvexExecutionStats* stats // optional stats
+  CanvexAlphaMode alphaMode
 ) {
   SkColorType skFormat;
   SkImageInfo imageInfo;
@@ -603,15 +942,363 @@ bool RenderDisplayListToRawBuffer(
       break;
   }
 
-  std::shared_ptr<SkCanvas> canvas = SkCanvas::MakeRasterDirect(imageInfo, imageBuffer, rowBytes);
+  return SkCanvas::MakeRasterDirect(imageInfo, imageBuffer, rowBytes);
+}
+
+// Records the display list on the calling thread,
+// then plays the recording back into horizontal bands of the buffer in parallel.
+static void renderDisplayListInBands(
+  const VCSCanvasDisplayList& dl,
+  const RenderFormat format,
+  uint8_t *imageBuffer,
+  uint32_t w,
+  uint32_t h,
+  uint32_t rowBytes,
+  CanvexAlphaMode alphaMode,
+  const std::filesystem::path& resourceDir,
+  CanvexSkiaResourceContext& skiaResCtx,
+  const std::vector<SkIRect>& bands,
+  const SkRegion* damageClip, // optional
+  CanvexExecutionStats* stats // optional stats
+) {
+  double t0 = getMonotonicTime();
+
+  // the recording has the buffer's size, so the display list gets the same output scaling as in a direct render.
+  // the damage clip and the initial clear are part of the recording.
+  SkRTreeFactory bbhFactory;
+  SkPictureRecorder recorder;
+  // the recorder owns its canvas
+  std::shared_ptr<SkCanvas> recordingCanvas(
+    recorder.beginRecording(SkRect::MakeIWH(w, h), &bbhFactory), [](SkCanvas*) {});
+
+  renderDisplayListInSkCanvas(dl, recordingCanvas, resourceDir, &skiaResCtx, damageClip, nullptr, stats);
+
+  auto picture = recorder.finishRecordingAsPicture();
 
   double t1 = getMonotonicTime();
 
-  renderDisplayListInSkCanvas(dl, canvas, resourceDir, skiaResCtx, stats);
+  skiaResCtx.getRasterBandPool().run(bands.size(), [&](int i) {
+    auto canvas = makeRasterCanvas(format, imageBuffer, w, h, rowBytes, alphaMode);
+    canvas->clipIRect(bands[i]);
+    canvas->drawPicture(picture);
+  });
+
+  if (stats) {
+    stats->raster_band_record_us = (t1 - t0) * 1.0e6;
+    stats->num_raster_bands = bands.size();
+  }
+}
+
+// Renders into the buffer, split into bands if the resource context is configured for it.
+static void renderDisplayListToRaster(
+  const VCSCanvasDisplayList& dl,
+  const RenderFormat format,
+  uint8_t *imageBuffer,
+  uint32_t w,
+  uint32_t h,
+  uint32_t rowBytes,
+  CanvexAlphaMode alphaMode,
+  const std::filesystem::path& resourceDir,
+  CanvexSkiaResourceContext* skiaResCtx, // optional cache between calls
+  const SkRegion* damageClip, // optional, only this region is cleared and redrawn
+  CanvexExecutionStats* stats // optional stats
+) {
+  if (skiaResCtx && skiaResCtx->numRasterBands > 1) {
+    const SkIRect area = damageClip ? damageClip->getBounds() : SkIRect::MakeWH(w, h);
+    auto bands = MakeRasterBands(area, skiaResCtx->numRasterBands);
+    if (bands.size() > 1) {
+      renderDisplayListInBands(dl, format, imageBuffer, w, h, rowBytes, alphaMode, resourceDir, *skiaResCtx,
+                               bands, damageClip, stats);
+      return;
+    }
+  }
+
+  std::shared_ptr<SkCanvas> canvas = makeRasterCanvas(format, imageBuffer, w, h, rowBytes, alphaMode);
+
+  renderDisplayListInSkCanvas(dl, canvas, resourceDir, skiaResCtx, damageClip, nullptr, stats);
+}
+
+bool RenderDisplayListToRawBuffer(
+  const VCSCanvasDisplayList& dl,
+  const RenderFormat format,
+  uint8_t *imageBuffer,
+  uint32_t w,
+  uint32_t h,
+  uint32_t rowBytes,
+  CanvexAlphaMode alphaMode,
+  const std::filesystem::path& resourceDir,
+  CanvexSkiaResourceContext* skiaResCtx, // optional cache between calls
+  CanvexExecutionStats* stats // optional stats
+) {
+  double t1 = getMonotonicTime();
+
+  renderDisplayListToRaster(dl, format, imageBuffer, w, h, rowBytes, alphaMode, resourceDir, skiaResCtx, nullptr, stats);
+
+  double t2 = getMonotonicTime();
+  if (stats) {
+    stats->render_total_us = (t2 - t1) * 1.0e6;
+  }
+
+  return true;
+}
+
+
+static bool drawRecordsMatch(const DrawRecord& a, const DrawRecord& b) {
+  return a.hash == b.hash && a.bounds == b.bounds && !a.forceDamage && !b.forceDamage;
+}
+
+static int64_t rectArea(const SkIRect& r) {
+  return (int64_t)r.width() * r.height();
+}
+
+// Compares two draw record lists and collects the device-space bounds of everything that differs.
+// Display lists from the same scene usually change in one place (a ticking clock, a new chat line),
+// so a common prefix and suffix are matched and only the records in between are considered changed.
+static void collectDamage(
+  const std::vector<DrawRecord>& prev,
+  const std::vector<DrawRecord>& next,
+  std::vector<SkIRect>& rects
+) {
+  const size_t minN = std::min(prev.size(), next.size());
+  size_t prefix = 0;
+  while (prefix < minN && drawRecordsMatch(prev[prefix], next[prefix])) {
+    prefix++;
+  }
+  size_t suffix = 0;
+  while (suffix < minN - prefix
+         && drawRecordsMatch(prev[prev.size() - 1 - suffix], next[next.size() - 1 - suffix])) {
+    suffix++;
+  }
+
+  // old content that went away must be erased, new content must be drawn
+  for (size_t i = prefix; i < prev.size() - suffix; i++) {
+    if (!prev[i].bounds.isEmpty()) rects.push_back(prev[i].bounds);
+  }
+  for (size_t i = prefix; i < next.size() - suffix; i++) {
+    if (!next[i].bounds.isEmpty()) rects.push_back(next[i].bounds);
+  }
+}
+
+// Reduces the damage to at most maxRects rectangles.
+// Greedily merges the pair whose union adds the least extra area.
+static void mergeDamageRects(std::vector<SkIRect>& rects, size_t maxRects) {
+  // pairwise merging is quadratic, so collapse large sets to their bounding box first
+  if (rects.size() > maxRects * 8) {
+    SkIRect u = SkIRect::MakeEmpty();
+    for (const auto& r : rects) u.join(r);
+    rects.assign(1, u);
+    return;
+  }
+
+  while (rects.size() > 1) {
+    size_t bestA = 0, bestB = 0;
+    int64_t bestCost = INT64_MAX;
+    for (size_t a = 0; a < rects.size(); a++) {
+      for (size_t b = a + 1; b < rects.size(); b++) {
+        SkIRect u = rects[a];
+        u.join(rects[b]);
+        const int64_t cost = rectArea(u) - rectArea(rects[a]) - rectArea(rects[b]);
+        if (cost < bestCost) {
+          bestCost = cost;
+          bestA = a;
+          bestB = b;
+        }
+      }
+    }
+    // overlapping or touching rects are always merged, otherwise only while over the limit
+    if (bestCost > 0 && rects.size() <= maxRects) break;
+
+    rects[bestA].join(rects[bestB]);
+    rects.erase(rects.begin() + bestB);
+  }
+}
+
+// Bounds pass: runs the display list without rasterizing anything to get its draw records.
+static std::vector<DrawRecord> collectDrawRecords(
+  const VCSCanvasDisplayList& dl,
+  uint32_t w,
+  uint32_t h,
+  const std::filesystem::path& resourceDir,
+  CanvexSkiaResourceContext* skiaResCtx,
+  size_t expectedCount
+) {
+  std::vector<DrawRecord> records;
+  records.reserve(expectedCount);
+
+  auto boundsCanvas = std::make_shared<SkNoDrawCanvas>((int)w, (int)h);
+  renderDisplayListInSkCanvas(dl, boundsCanvas, resourceDir, skiaResCtx, nullptr, &records, nullptr);
+  return records;
+}
+
+bool RenderDisplayListToRawBufferIncremental(
+  const VCSCanvasDisplayList& dl,
+  const RenderFormat format,
+  uint8_t *imageBuffer,
+  uint32_t w,
+  uint32_t h,
+  uint32_t rowBytes,
+  CanvexAlphaMode alphaMode,
+  const std::filesystem::path& resourceDir,
+  CanvexSkiaResourceContext* skiaResCtx, // optional cache between calls
+  DamageTracker& tracker,
+  std::vector<SkIRect>& damageRects, // out
+  CanvexExecutionStats* stats // optional stats
+) {
+  damageRects.clear();
+
+  double t0 = getMonotonicTime();
+
+  auto records = collectDrawRecords(dl, w, h, resourceDir, skiaResCtx, tracker.prevRecords.size());
+
+  const bool canReuse = tracker.valid
+    && tracker.imageBuffer == imageBuffer
+    && tracker.w == w && tracker.h == h && tracker.rowBytes == rowBytes
+    && tracker.format == format && tracker.alphaMode == alphaMode;
+
+  if (canReuse) {
+    collectDamage(tracker.prevRecords, records, damageRects);
+    mergeDamageRects(damageRects, kMaxDamageRects);
+  } else {
+    damageRects.push_back(SkIRect::MakeWH(w, h));
+  }
+
+  double t1 = getMonotonicTime();
+
+  if (!damageRects.empty()) {
+    SkRegion damageClip;
+    for (const auto& r : damageRects) {
+      damageClip.op(r, SkRegion::kUnion_Op);
+    }
+
+    renderDisplayListToRaster(dl, format, imageBuffer, w, h, rowBytes, alphaMode, resourceDir, skiaResCtx, &damageClip, stats);
+  }
+
+  double t2 = getMonotonicTime();
+
+  tracker.prevRecords = std::move(records);
+  tracker.imageBuffer = imageBuffer;
+  tracker.w = w;
+  tracker.h = h;
+  tracker.rowBytes = rowBytes;
+  tracker.format = format;
+  tracker.alphaMode = alphaMode;
+  tracker.valid = true;
+
+  if (stats) {
+    stats->render_total_us = (t2 - t1) * 1.0e6;
+    stats->damage_detect_us = (t1 - t0) * 1.0e6;
+    stats->num_damage_rects = damageRects.size();
+  }
+
+  return true;
+}
+
+// Expands the rect to whole 2x2 chroma blocks, clamped to the image.
+static SkIRect alignToChromaBlocks(const SkIRect& r, uint32_t w, uint32_t h) {
+  return SkIRect::MakeLTRB(
+    std::max(0, r.left()) & ~1,
+    std::max(0, r.top()) & ~1,
+    std::min((int)w, (r.right() + 1) & ~1),
+    std::min((int)h, (r.bottom() + 1) & ~1));
+}
+
+// true if the buffers are the same memory with the same layout, so one still holds what was drawn into the other
+static bool isSameI420ABuffer(const CanvexI420ABuffer& a, const CanvexI420ABuffer& b) {
+  return a.y == b.y && a.cb == b.cb && a.cr == b.cr && a.a == b.a
+    && a.row_bytes_y == b.row_bytes_y && a.row_bytes_ch == b.row_bytes_ch && a.row_bytes_a == b.row_bytes_a;
+}
+
+bool RenderDisplayListToI420A(
+  const VCSCanvasDisplayList& dl,
+  const CanvexI420ABuffer& dst,
+  uint32_t w,
+  uint32_t h,
+  CanvexYuvColorMatrix colorMatrix,
+  const std::filesystem::path& resourceDir,
+  CanvexSkiaResourceContext* skiaResCtx, // optional cache between calls
+  DamageTracker* tracker, // optional
+  std::vector<SkIRect>& damageRects, // out
+  CanvexExecutionStats* stats // optional stats
+) {
+  damageRects.clear();
+
+  double t0 = getMonotonicTime();
+
+  std::vector<DrawRecord> records;
+  bool canReuse = false;
+  if (tracker) {
+    records = collectDrawRecords(dl, w, h, resourceDir, skiaResCtx, tracker->prevRecords.size());
+
+    canReuse = tracker->valid
+      && isSameI420ABuffer(tracker->yuvPlanes, dst)
+      && tracker->w == w && tracker->h == h
+      && tracker->format == I420A && tracker->yuvColorMatrix == colorMatrix;
+  }
+
+  if (canReuse) {
+    collectDamage(tracker->prevRecords, records, damageRects);
+    mergeDamageRects(damageRects, kMaxDamageRects);
+    // a chroma sample covers 2x2 pixels, so the whole block has to be drawn to convert it
+    for (auto& r : damageRects) {
+      r = alignToChromaBlocks(r, w, h);
+    }
+    damageRects.erase(std::remove_if(damageRects.begin(), damageRects.end(),
+                                     [](const SkIRect& r) { return r.isEmpty(); }),
+                      damageRects.end());
+  } else {
+    damageRects.push_back(SkIRect::MakeWH(w, h));
+  }
+
+  double t1 = getMonotonicTime();
+
+  if (!damageRects.empty()) {
+    std::optional<SkRegion> damageClip;
+    if (canReuse) {
+      damageClip.emplace();
+      for (const auto& r : damageRects) {
+        damageClip->op(r, SkRegion::kUnion_Op);
+      }
+    }
+
+    // the display list is executed once, then played back into each strip of the damaged area
+    SkRTreeFactory bbhFactory;
+    SkPictureRecorder recorder;
+    // the recorder owns its canvas
+    std::shared_ptr<SkCanvas> recordingCanvas(
+      recorder.beginRecording(SkRect::MakeIWH(w, h), &bbhFactory), [](SkCanvas*) {});
+
+    renderDisplayListInSkCanvas(dl, recordingCanvas, resourceDir, skiaResCtx,
+                                damageClip ? &*damageClip : nullptr, nullptr, stats);
+
+    auto picture = recorder.finishRecordingAsPicture();
+
+    const auto coeffs = GetYuvCoefficients(colorMatrix);
+    for (const auto& r : damageRects) {
+      RasterizePictureToI420A(picture, r, dst, coeffs);
+    }
+  }
 
   double t2 = getMonotonicTime();
+
+  if (tracker) {
+    tracker->prevRecords = std::move(records);
+    tracker->imageBuffer = dst.y;
+    tracker->w = w;
+    tracker->h = h;
+    tracker->rowBytes = dst.row_bytes_y;
+    tracker->format = I420A;
+    tracker->alphaMode = CANVEX_PREMULTIPLIED;
+    tracker->yuvColorMatrix = colorMatrix;
+    tracker->yuvPlanes = dst;
+    tracker->valid = true;
+  }
+
   if (stats) {
     stats->render_total_us = (t2 - t1) * 1.0e6;
+    if (tracker) {
+      stats->damage_detect_us = (t1 - t0) * 1.0e6;
+      stats->num_damage_rects = damageRects.size();
+    }
   }
 
   return true;
@@ -1,14 +1,17 @@
 #pragma once
 #include "../include/canvex_c_api.h"
 #include "canvas_display_list.h"
+#include "canvex_skia_context.h"
 #include "canvex_skia_resource_context.h"
 #include <filesystem>
+#include <vector>
 
 namespace canvex {
 
 enum RenderFormat {
   Rgba,
   Bgra,
+  I420A, // only used by RenderDisplayListToI420A
 };
 
 bool RenderDisplayListToPNG(
@@ -32,4 +35,72 @@ bool RenderDisplayListToRawBuffer(
   CanvexExecutionStats* stats // optional stats
 );
 
+// damage is reported as at most this many rects
+constexpr size_t kMaxDamageRects = CANVEX_MAX_DAMAGE_RECTS;
+
+// Retained state for incremental rendering into the same buffer.
+// Holds the draw records of the last display list rendered through it.
+struct DamageTracker {
+  std::vector<DrawRecord> prevRecords;
+  const uint8_t *imageBuffer = nullptr;
+  uint32_t w = 0;
+  uint32_t h = 0;
+  uint32_t rowBytes = 0;
+  RenderFormat format = Rgba;
+  CanvexAlphaMode alphaMode = CANVEX_PREMULTIPLIED;
+  CanvexYuvColorMatrix yuvColorMatrix = CanvexYuv_BT601_Limited;
+  CanvexI420ABuffer yuvPlanes = {}; // for I420A, all the planes the previous frame is in
+  bool valid = false;
+
+  // forces the next render to redraw everything
+  void invalidate() {
+    valid = false;
+    prevRecords.clear();
+  }
+};
+
+/*
+  Same as RenderDisplayListToRawBuffer, but expects imageBuffer to still contain
+  the previous frame rendered with the same tracker. The new display list is compared
+  against the previous one, and only the changed regions are cleared and redrawn.
+
+  The device-space rects that were redrawn are returned in damageRects.
+  If nothing changed, damageRects is empty and the buffer isn't touched.
+  A change of buffer, size or format redraws the whole image.
+*/
+bool RenderDisplayListToRawBufferIncremental(
+  const VCSCanvasDisplayList& dl,
+  RenderFormat format,
+  uint8_t *imageBuffer,
+  uint32_t w,
+  uint32_t h,
+  uint32_t rowBytes,
+  CanvexAlphaMode alphaMode,
+  const std::filesystem::path& resourceDir,
+  CanvexSkiaResourceContext* skiaResCtx, // optional cache between calls
+  DamageTracker& tracker,
+  std::vector<SkIRect>& damageRects, // out
+  CanvexExecutionStats* stats // optional stats
+);
+
+/*
+  Renders into YUV 4:2:0 planes with alpha, see CanvexRenderJSON_I420A. Row bytes in dst must be set.
+
+  With a tracker, only what changed since the previous render into the same planes is redrawn,
+  as in RenderDisplayListToRawBufferIncremental. Damage rects are expanded to 2x2 chroma blocks.
+  Without a tracker, the whole image is drawn and returned as a single damage rect.
+*/
+bool RenderDisplayListToI420A(
+  const VCSCanvasDisplayList& dl,
+  const CanvexI420ABuffer& dst,
+  uint32_t w,
+  uint32_t h,
+  CanvexYuvColorMatrix colorMatrix,
+  const std::filesystem::path& resourceDir,
+  CanvexSkiaResourceContext* skiaResCtx, // optional cache between calls
+  DamageTracker* tracker, // optional
+  std::vector<SkIRect>& damageRects, // out
+  CanvexExecutionStats* stats // optional stats
+);
+
 } // namespace canvex
@@ -1,4 +1,6 @@
 #include "canvex_skia_resource_context.h"
+#include "time_util.h"
+#include <iostream>
 
 namespace canvex {
 
@@ -100,4 +102,271 @@ std::optional<std::string> CanvexSkiaResourceContext::getFontFileName(const std:
   return std::nullopt;
 }
 
-} // namespace canvex
\ No newline at end of file
+ImageDecodePool& CanvexSkiaResourceContext::getImageDecodePool() {
+  if (!imageDecodePool) {
+    imageDecodePool = std::make_unique<ImageDecodePool>(numImageDecodeThreads);
+  }
+  return *imageDecodePool;
+}
+
+RasterBandPool& CanvexSkiaResourceContext::getRasterBandPool() {
+  if (!rasterBandPool || rasterBandPool->numBands() != numRasterBands) {
+    rasterBandPool = std::make_unique<RasterBandPool>(numRasterBands);
+  }
+  return *rasterBandPool;
+}
+
+void CanvexSkiaResourceContext::collectDecodedImages() {
+  if (!imageDecodePool) return;
+
+  for (auto& result : imageDecodePool->takeFinished()) {
+    addDecodedImage(std::move(result));
+  }
+}
+
+void CanvexSkiaResourceContext::addDecodedImage(ImageDecodeResult&& result) {
+  if (result.type == LiveAsset) {
+    liveImageTimestampsByName[result.name] = {getMonotonicTime(), result.fileWriteTime};
+  }
+  putCachedImage(result.type, result.name, result.path, std::move(result.image));
+}
+
+void CanvexSkiaResourceContext::setSharedCache(std::shared_ptr<SharedResourceCache> cache) {
+  if (cache == sharedCache) return;
+
+  sharedCache = std::move(cache);
+
+  // fonts are now loaded through the shared cache, so it takes over the preloaded mappings
+  if (sharedCache) {
+    for (const auto& [path, data] : mappedFiles.files()) {
+      sharedCache->addMappedFile(path, data);
+    }
+    mappedFiles.clear();
+  }
+
+  // typefaces resolved from the old cache would otherwise stay in use
+  typefaceCache.clear();
+  typefacesByFont.clear();
+  textBlobCache.clear();
+  groupCache.clear();
+
+  // from now on only live images are cached here, and they're simply reloaded on the next draw
+  imageCache.clear();
+  liveImageTimestampsByName.clear();
+  staleLiveImages.clear();
+}
+
+std::optional<CachedImage> CanvexSkiaResourceContext::getCachedImage(ImageSourceType type, const std::string& name,
+                                                                     const std::filesystem::path& path) {
+  if (sharedCache && SharedResourceCache::isShareable(type)) {
+    return sharedCache->getImage(type, path);
+  }
+  if (auto cached = imageCache.get(type, name)) {
+    return *cached;
+  }
+  return std::nullopt;
+}
+
+void CanvexSkiaResourceContext::putCachedImage(ImageSourceType type, const std::string& name,
+                                               const std::filesystem::path& path, CachedImage entry) {
+  if (sharedCache && SharedResourceCache::isShareable(type)) {
+    sharedCache->putImage(type, path, std::move(entry));
+  } else {
+    imageCache.put(type, name, std::move(entry));
+  }
+}
+
+int CanvexSkiaResourceContext::preloadMappedFiles(const std::filesystem::path& manifestPath,
+                                                  const std::filesystem::path& resDir) {
+  int n = 0;
+  for (const auto& path : ReadPreloadManifest(manifestPath, resDir)) {
+    auto data = sharedCache ? sharedCache->mapFile(path, true) : mappedFiles.map(path, true);
+    if (data) n++;
+  }
+  return n;
+}
+
+sk_sp<SkData> CanvexSkiaResourceContext::getMappedFile(const std::filesystem::path& path) {
+  return sharedCache ? sharedCache->getMappedFile(path) : mappedFiles.get(path);
+}
+
+size_t CanvexSkiaResourceContext::imageCacheBytes() const {
+  return imageCache.totalBytes() + (sharedCache ? sharedCache->imageBytes() : 0);
+}
+
+int64_t CanvexSkiaResourceContext::numImageCacheEvictions() const {
+  return imageCache.numEvictions() + (sharedCache ? sharedCache->numImageEvictions() : 0);
+}
+
+bool CanvexSkiaResourceContext::prefetchImage(const std::filesystem::path& resDir, ImageSourceType type,
+                                              const std::string& name, const ImageDrawSize& drawSize) {
+  if (type == SharedMemoryAsset) {
+    // raw frames don't need decoding
+    return getShmFrame(name) != nullptr;
+  }
+  collectDecodedImages();
+
+  const auto path = GetImageAssetPath(resDir, type, name);
+  float minScale = 0;
+  if (auto cached = getCachedImage(type, name, path)) {
+    if (drawSize.scaleFor(cached->srcSize) <= cached->scale) {
+      return true;
+    }
+    minScale = cached->scale;
+  }
+  return getImageDecodePool().submit({type, name, path, drawSize, minScale, getMappedFile(path)});
+}
+
+void CanvexSkiaResourceContext::preload(const std::vector<FontKey>& fonts,
+                                        const std::vector<PreloadImageRequest>& images,
+                                        const std::filesystem::path& resDir) {
+  std::vector<FontPreloader::Request> fontRequests;
+  std::unordered_set<std::string> requestedFiles;
+  for (const auto& font : fonts) {
+    auto fileName = getFontFileName(font.family, font.weight, font.italic);
+    if (!fileName) {
+      std::cerr << "** Unable to match font name for preload: " << font.family << std::endl;
+      numFailedFontPreloads++;
+      continue;
+    }
+    // several variants can map to the same file
+    if (!requestedFiles.insert(*fileName).second) {
+      continue;
+    }
+    // already loaded by an earlier render or preload, so it's ready without a request
+    auto cachedIt = typefaceCache.find(*fileName);
+    if (cachedIt != typefaceCache.end() && cachedIt->second) {
+      numPreloadedFonts++;
+      continue;
+    }
+    fontRequests.push_back({*fileName, resDir / "fonts" / *fileName});
+  }
+  if (!fontRequests.empty()) {
+    fontPreloaders.push_back(std::make_unique<FontPreloader>(std::move(fontRequests), sharedCache));
+  }
+
+  for (const auto& image : images) {
+    PreloadedImage entry{image.type, image.name, GetImageAssetPath(resDir, image.type, image.name), image.drawSize};
+    if (image.type != SharedMemoryAsset) {
+      prefetchImage(resDir, image.type, image.name, image.drawSize);
+    }
+    preloadImages.push_back(std::move(entry));
+  }
+}
+
+void CanvexSkiaResourceContext::collectPreloadedFonts() {
+  for (auto it = fontPreloaders.begin(); it != fontPreloaders.end(); ) {
+    auto& preloader = **it;
+    const bool done = preloader.numPending() == 0;
+    for (auto& result : preloader.takeFinished()) {
+      if (!result.typeface) {
+        numFailedFontPreloads++;
+        continue;
+      }
+      mappedFiles.add(result.path, std::move(result.data));
+      typefaceCache[result.fileName] = std::move(result.typeface);
+      numPreloadedFonts++;
+    }
+    it = done ? fontPreloaders.erase(it) : it + 1;
+  }
+}
+
+PreloadStatus CanvexSkiaResourceContext::getPreloadStatus() {
+  collectPreloadedFonts();
+  collectDecodedImages();
+
+  PreloadStatus status;
+  for (const auto& preloader : fontPreloaders) {
+    status.numPending += preloader->numPending();
+  }
+  status.numReady = numPreloadedFonts;
+  status.numFailed = numFailedFontPreloads + numFailedImagePreloads;
+
+  for (const auto& image : preloadImages) {
+    if (image.type == SharedMemoryAsset) {
+      (getShmFrame(image.name) ? status.numReady : status.numFailed)++;
+      continue;
+    }
+    auto cached = getCachedImage(image.type, image.name, image.path);
+    if (cached && image.drawSize.scaleFor(cached->srcSize) <= cached->scale) {
+      status.numReady++;
+    } else if (imageDecodePool && imageDecodePool->isPending(image.type, image.name)) {
+      status.numPending++;
+    } else {
+      status.numFailed++;
+    }
+  }
+  return status;
+}
+
+bool CanvexSkiaResourceContext::watchLiveAssets(const std::filesystem::path& liveDir) {
+  if (liveAssetWatcher && liveAssetWatcher->isWatching()) {
+    return true;
+  }
+  const double tNow = getMonotonicTime();
+  if (liveAssetWatcherStartT >= 0 && tNow - liveAssetWatcherStartT < 1.0) {
+    return false;
+  }
+  liveAssetWatcherStartT = tNow;
+  liveAssetDir = liveDir;
+
+  liveAssetWatcher = std::make_unique<LiveAssetWatcher>(liveDir);
+  return liveAssetWatcher->isWatching();
+}
+
+void CanvexSkiaResourceContext::collectLiveAssetChanges() {
+  if (!liveAssetWatcher || !liveAssetWatcher->hasChanges()) return;
+
+  for (const auto& change : liveAssetWatcher->takeChanges()) {
+    if (change.removed) {
+      // the writer may be replacing the file, don't show the out of date image meanwhile
+      imageCache.erase(LiveAsset, change.name);
+      staleLiveImages.erase(change.name);
+    } else if (auto cached = imageCache.get(LiveAsset, change.name)) {
+      if (imageLoadPolicy == ImageLoadPolicy::Block || getImageDecodePool().isPending(LiveAsset, change.name)) {
+        // reloaded on the next draw
+        staleLiveImages.insert(change.name);
+      } else {
+        // the new decode replaces the cache entry when it's done, at the same resolution
+        getImageDecodePool().submit({LiveAsset, change.name, liveAssetDir / change.name, ImageDrawSize{}, cached->scale, nullptr});
+      }
+    }
+  }
+}
+
+sk_sp<SkImage> CanvexSkiaResourceContext::getShmFrame(const std::string& name) {
+  auto& entry = shmFrameSources[name];
+  entry.drawnInLastRender = true;
+
+  // opening and checking for a restarted producer need syscalls, so they're done at most once a second
+  const double tNow = getMonotonicTime();
+  if (entry.lastCheckT < 0 || tNow - entry.lastCheckT >= 1.0) {
+    entry.lastCheckT = tNow;
+    if (entry.source && entry.source->isStale()) {
+      entry.source = nullptr;
+    }
+    if (!entry.source) {
+      entry.source = ShmFrameSource::Open(name);
+    }
+  }
+  return entry.source ? entry.source->getLatestFrame() : nullptr;
+}
+
+void CanvexSkiaResourceContext::beginShmFrameRender() {
+  for (auto& kv : shmFrameSources) {
+    kv.second.drawnInLastRender = false;
+  }
+}
+
+bool CanvexSkiaResourceContext::hasNewShmFrames() const {
+  const double tNow = getMonotonicTime();
+  for (const auto& kv : shmFrameSources) {
+    const auto& entry = kv.second;
+    if (!entry.drawnInLastRender) continue;
+    if (entry.source && entry.source->hasNewFrame()) return true;
+    if (tNow - entry.lastCheckT >= 1.0) return true;
+  }
+  return false;
+}
+
+} // namespace canvex
@@ -1,6 +1,20 @@
 #pragma once
+#include "canvex_emoji_atlas.h"
+#include "canvex_font_preloader.h"
+#include "canvex_group_cache.h"
+#include "canvex_image_cache.h"
+#include "canvex_image_decode_pool.h"
+#include "canvex_live_asset_watcher.h"
+#include "canvex_mapped_files.h"
+#include "canvex_op_profiler.h"
+#include "canvex_raster_bands.h"
+#include "canvex_shared_resource_cache.h"
+#include "canvex_shm_frame_source.h"
+#include "hash_util.h"
+#include "lru_cache.h"
 #include "skia_includes.h"
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -40,7 +54,6 @@ class FontVariantMatcher {
 
 
 using TypefaceCache = std::unordered_map<std::string, sk_sp<SkTypeface>>;
-using ImageCache = std::unordered_map<std::string, sk_sp<SkImage>>;
 
 struct LiveImageTimestamp {
   double lastPollT; // last time we checked
@@ -53,6 +66,69 @@ struct LiveImageTimestamp {
     : lastPollT(), lastReadFst() {}
 };
 
+// a font variant as requested by the display list
+struct FontKey {
+  std::string family;
+  int weight;
+  bool italic;
+
+  bool operator==(const FontKey& o) const {
+    return weight == o.weight && italic == o.italic && family == o.family;
+  }
+};
+
+struct FontKeyHash {
+  size_t operator()(const FontKey& k) const {
+    return Hasher().add(k.family).add(k.weight).add(k.italic).value();
+  }
+};
+
+struct TextBlobKey {
+  std::string text;
+  uint32_t typefaceId;
+  float size;
+
+  bool operator==(const TextBlobKey& o) const {
+    return typefaceId == o.typefaceId && size == o.size && text == o.text;
+  }
+};
+
+struct TextBlobKeyHash {
+  size_t operator()(const TextBlobKey& k) const {
+    return Hasher().add(k.text).add(k.typefaceId).add(k.size).value();
+  }
+};
+
+// running totals, the executor reports the difference for each render call
+struct TextCacheCounters {
+  int64_t fontHits = 0;
+  int64_t fontMisses = 0;
+  int64_t textBlobHits = 0;
+  int64_t textBlobMisses = 0;
+};
+
+// running totals of loads done on the render thread because the resource wasn't preloaded or prefetched
+struct ColdLoadCounters {
+  int64_t fontLoads = 0;
+  int64_t imageLoads = 0;
+  double time_s = 0;
+};
+
+// an image to decode ahead of a session, at the largest size it will be drawn
+struct PreloadImageRequest {
+  ImageSourceType type;
+  std::string name;
+  ImageDrawSize drawSize;
+};
+
+struct PreloadStatus {
+  int numPending = 0;
+  int numReady = 0;
+  int numFailed = 0;
+};
+
+constexpr size_t kTextBlobCacheMaxEntries = 4096;
+
 struct CanvexSkiaResourceContext {
   CanvexSkiaResourceContext();
 
@@ -60,11 +136,150 @@ struct CanvexSkiaResourceContext {
 
    std::vector<FontVariantMatcher> fontVariantMatchers;
    TypefaceCache typefaceCache;
-   ImageCache imageCache_defaultNamespace;
-   ImageCache imageCache_compositionNamespace;
-   ImageCache imageCache_liveNamespace;
 
+   // typefaces by requested variant, so that drawing text doesn't need to build file names
+   std::unordered_map<FontKey, sk_sp<SkTypeface>, FontKeyHash> typefacesByFont;
+
+   // shaped text, so that identical strings aren't converted to glyphs on every render
+   LruCache<TextBlobKey, sk_sp<SkTextBlob>, TextBlobKeyHash> textBlobCache{kTextBlobCacheMaxEntries};
+
+   TextCacheCounters textCacheCounters;
+
+   ColdLoadCounters coldLoadCounters;
+
+   // starts loading the fonts and decoding the images in the background.
+   // fonts that don't match a known family and images of unknown type count as failed.
+   void preload(const std::vector<FontKey>& fonts, const std::vector<PreloadImageRequest>& images,
+                const std::filesystem::path& resDir);
+
+   // moves fonts loaded by preload() into the typeface cache
+   void collectPreloadedFonts();
+
+   // readiness of everything requested by preload() so far
+   PreloadStatus getPreloadStatus();
+
+   std::vector<std::unique_ptr<FontPreloader>> fontPreloaders;
+   int numPreloadedFonts = 0; // including requested fonts that were already in typefaceCache
+   int numFailedFontPreloads = 0;
+   int numFailedImagePreloads = 0; // requests that couldn't be queued at all, e.g. of an unknown type
+
+   struct PreloadedImage {
+     ImageSourceType type;
+     std::string name;
+     std::filesystem::path path;
+     ImageDrawSize drawSize;
+   };
+   std::vector<PreloadedImage> preloadImages;
+
+   EmojiAtlas emojiAtlas;
+   // decoded images for all asset namespaces, bounded by a byte budget.
+   // with a shared cache attached, only live assets are kept here.
+   ImageCache imageCache;
+
+   // fonts and non-live asset files mapped read-only, so their pages are shared with other processes.
+   // with a shared cache attached, files are mapped in the shared cache instead.
+   MappedFileSet mappedFiles;
+
+   // maps the files listed in the manifest (see ReadPreloadManifest) and asks the kernel to read them in.
+   // returns the number of files mapped.
+   int preloadMappedFiles(const std::filesystem::path& manifestPath, const std::filesystem::path& resDir);
+
+   // returns the file's mapping from the shared cache if one is attached, otherwise from mappedFiles,
+   // or null if the file hasn't been mapped
+   sk_sp<SkData> getMappedFile(const std::filesystem::path& path);
+
+   // typefaces and immutable images shared with other contexts, or null if this context keeps its own
+   std::shared_ptr<SharedResourceCache> sharedCache;
+
+   // attaches or detaches (with null) a shared cache. this drops the context's cached typefaces and images,
+   // so it's best done before the first render. the context's mapped files are handed over to the shared cache.
+   void setSharedCache(std::shared_ptr<SharedResourceCache> cache);
+
+   // looks up a decoded image in the shared cache if it's shareable and one is attached, otherwise in imageCache.
+   // path is the image's file, which is the key in the shared cache.
+   std::optional<CachedImage> getCachedImage(ImageSourceType type, const std::string& name,
+                                             const std::filesystem::path& path);
+
+   void putCachedImage(ImageSourceType type, const std::string& name, const std::filesystem::path& path,
+                       CachedImage entry);
+
+   // totals of this context's image cache and the shared one
+   size_t imageCacheBytes() const;
+   int64_t numImageCacheEvictions() const;
+
+   // images not in the cache are decoded in the background unless the policy is Block.
+   // the pool is started on first use.
+   ImageLoadPolicy imageLoadPolicy = ImageLoadPolicy::Block;
+   int numImageDecodeThreads = ImageDecodePool::kDefaultNumThreads;
+   std::unique_ptr<ImageDecodePool> imageDecodePool;
+
+   ImageDecodePool& getImageDecodePool();
+
+   // moves images decoded in the background into imageCache
+   void collectDecodedImages();
+
+   void addDecodedImage(ImageDecodeResult&& result);
+
+   // starts a background decode unless the image is already cached at the resolution needed for drawSize.
+   // returns false if the image can't be loaded (i.e. its last decode failed very recently).
+   bool prefetchImage(const std::filesystem::path& resDir, ImageSourceType type, const std::string& name,
+                      const ImageDrawSize& drawSize);
+
+   // write times for polling live images, used when the watcher isn't available
    std::unordered_map<std::string, LiveImageTimestamp> liveImageTimestampsByName;
+
+   // notifies about changes in the live assets directory
+   std::unique_ptr<LiveAssetWatcher> liveAssetWatcher;
+   std::filesystem::path liveAssetDir;
+   double liveAssetWatcherStartT = -1;
+
+   // cached live images whose file has changed since they were loaded
+   std::unordered_set<std::string> staleLiveImages;
+
+   // starts the watcher if it's not running, at most once a second.
+   // returns true if live images can rely on the watcher instead of polling.
+   bool watchLiveAssets(const std::filesystem::path& liveDir);
+
+   // live images written into shared memory, by shm object name
+   struct ShmFrameSourceEntry {
+     std::unique_ptr<ShmFrameSource> source;
+     double lastCheckT = -1; // last time the source was opened or checked for replacement
+     bool drawnInLastRender = false;
+   };
+   std::unordered_map<std::string, ShmFrameSourceEntry> shmFrameSources;
+
+   // returns the latest frame of the shared memory source, or null if it isn't available
+   sk_sp<SkImage> getShmFrame(const std::string& name);
+
+   // called when a render starts, so that hasNewShmFrames only considers the sources it draws
+   void beginShmFrameRender();
+
+   // true if a source drawn by the last render has published a newer frame, or is due to be
+   // opened or checked for a restarted producer. the display list should then be rendered again.
+   bool hasNewShmFrames() const;
+
+   // applies changes reported by the watcher to the image cache.
+   // unless the load policy is Block, changed images start reloading in the background right away.
+   void collectLiveAssetChanges();
+
+   GroupCache groupCache;
+
+   // paths made of rects and rounded rects are filled and clipped with Skia's shape primitives
+   // instead of as general paths. off by default, since antialiased edges can differ slightly
+   // from the path rendering that reference images were made with.
+   bool useAnalyticShapes = false;
+
+   // full renders into raw buffers are recorded once and rasterized in this many bands in parallel.
+   // 1 renders directly into the buffer on the calling thread.
+   int numRasterBands = 1;
+   std::unique_ptr<RasterBandPool> rasterBandPool;
+
+   // returns the pool for numRasterBands, restarting its threads if the count has changed
+   RasterBandPool& getRasterBandPool();
+
+   // when on, each render times its commands into opProfiler, replacing the previous render's profile
+   bool opProfilingEnabled = false;
+   OpProfiler opProfiler;
 };
 
 } // namespace canvex
@@ -0,0 +1,156 @@
+#include "canvex_yuv_output.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace canvex {
+
+// 32 rows of 4K RGBA is 480kB, small enough to still be in cache when it's converted
+constexpr int kYuvStripRows = 32;
+
+YuvCoefficients GetYuvCoefficients(CanvexYuvColorMatrix matrix) {
+  double kr, kb;
+  bool fullRange;
+  switch (matrix) {
+    default:
+    case CanvexYuv_BT601_Limited: kr = 0.299; kb = 0.114; fullRange = false; break;
+    case CanvexYuv_BT601_Full: kr = 0.299; kb = 0.114; fullRange = true; break;
+    case CanvexYuv_BT709_Limited: kr = 0.2126; kb = 0.0722; fullRange = false; break;
+    case CanvexYuv_BT709_Full: kr = 0.2126; kb = 0.0722; fullRange = true; break;
+  }
+  const double kg = 1.0 - kr - kb;
+  const double yScale = fullRange ? 1.0 : 219.0 / 255.0;
+  const double cScale = fullRange ? 1.0 : 224.0 / 255.0;
+
+  auto fx = [](double v) {
+    return (int32_t)std::lround(v * 65536.0);
+  };
+  YuvCoefficients c;
+  c.yR = fx(kr * yScale);
+  c.yG = fx(kg * yScale);
+  c.yB = fx(kb * yScale);
+  c.cbR = fx(-kr / (2.0 * (1.0 - kb)) * cScale);
+  c.cbG = fx(-kg / (2.0 * (1.0 - kb)) * cScale);
+  c.cbB = fx(0.5 * cScale);
+  c.crR = fx(0.5 * cScale);
+  c.crG = fx(-kg / (2.0 * (1.0 - kr)) * cScale);
+  c.crB = fx(-kb / (2.0 * (1.0 - kr)) * cScale);
+  c.yBlack = fullRange ? 0 : 16;
+  return c;
+}
+
+static inline uint8_t clampU8(int32_t v) {
+  return (uint8_t)std::clamp(v, 0, 255);
+}
+
+static inline uint8_t convertLuma(const uint8_t* px, const YuvCoefficients& c) {
+  return clampU8(c.yBlack + ((c.yR * px[0] + c.yG * px[1] + c.yB * px[2] + (1 << 15)) >> 16));
+}
+
+// chroma from the sum of four pixels' components
+static inline uint8_t convertChroma(int32_t r4, int32_t g4, int32_t b4, int32_t cR, int32_t cG, int32_t cB) {
+  return clampU8((cR * r4 + cG * g4 + cB * b4 + (128 << 18) + (1 << 17)) >> 18);
+}
+
+void ConvertRGBAToI420A(
+  const uint8_t* rgba,
+  size_t rgbaRowBytes,
+  const SkIRect& area,
+  const CanvexI420ABuffer& dst,
+  const YuvCoefficients& c
+) {
+  for (int y = area.top(); y < area.bottom(); y += 2) {
+    const bool hasRow1 = y + 1 < area.bottom();
+    const uint8_t* src0 = rgba + (size_t)(y - area.top()) * rgbaRowBytes;
+    const uint8_t* src1 = hasRow1 ? src0 + rgbaRowBytes : src0;
+
+    uint8_t* dstY0 = dst.y + (size_t)y * dst.row_bytes_y;
+    uint8_t* dstY1 = dstY0 + dst.row_bytes_y;
+    uint8_t* dstA0 = dst.a + (size_t)y * dst.row_bytes_a;
+    uint8_t* dstA1 = dstA0 + dst.row_bytes_a;
+    uint8_t* dstCb = dst.cb + (size_t)(y / 2) * dst.row_bytes_ch;
+    uint8_t* dstCr = dst.cr + (size_t)(y / 2) * dst.row_bytes_ch;
+
+    for (int x = area.left(); x < area.right(); x += 2) {
+      const bool hasCol1 = x + 1 < area.right();
+      const size_t i0 = (size_t)(x - area.left()) * 4;
+      const size_t i1 = hasCol1 ? i0 + 4 : i0;
+
+      // missing pixels at odd edges repeat their neighbor, so the sums are always of four
+      const uint8_t* p00 = src0 + i0;
+      const uint8_t* p01 = src0 + i1;
+      const uint8_t* p10 = src1 + i0;
+      const uint8_t* p11 = src1 + i1;
+
+      if ((p00[3] | p01[3] | p10[3] | p11[3]) == 0) {
+        // transparent, which is most of a typical overlay
+        dstY0[x] = c.yBlack;
+        dstA0[x] = 0;
+        if (hasCol1) {
+          dstY0[x + 1] = c.yBlack;
+          dstA0[x + 1] = 0;
+        }
+        if (hasRow1) {
+          dstY1[x] = c.yBlack;
+          dstA1[x] = 0;
+          if (hasCol1) {
+            dstY1[x + 1] = c.yBlack;
+            dstA1[x + 1] = 0;
+          }
+        }
+        dstCb[x / 2] = 128;
+        dstCr[x / 2] = 128;
+        continue;
+      }
+
+      dstY0[x] = convertLuma(p00, c);
+      dstA0[x] = p00[3];
+      if (hasCol1) {
+        dstY0[x + 1] = convertLuma(p01, c);
+        dstA0[x + 1] = p01[3];
+      }
+      if (hasRow1) {
+        dstY1[x] = convertLuma(p10, c);
+        dstA1[x] = p10[3];
+        if (hasCol1) {
+          dstY1[x + 1] = convertLuma(p11, c);
+          dstA1[x + 1] = p11[3];
+        }
+      }
+
+      const int32_t r4 = p00[0] + p01[0] + p10[0] + p11[0];
+      const int32_t g4 = p00[1] + p01[1] + p10[1] + p11[1];
+      const int32_t b4 = p00[2] + p01[2] + p10[2] + p11[2];
+      dstCb[x / 2] = convertChroma(r4, g4, b4, c.cbR, c.cbG, c.cbB);
+      dstCr[x / 2] = convertChroma(r4, g4, b4, c.crR, c.crG, c.crB);
+    }
+  }
+}
+
+void RasterizePictureToI420A(
+  const sk_sp<SkPicture>& picture,
+  const SkIRect& area,
+  const CanvexI420ABuffer& dst,
+  const YuvCoefficients& coeffs
+) {
+  if (area.isEmpty()) return;
+
+  const int w = area.width();
+  const size_t stripRowBytes = (size_t)w * 4;
+  std::vector<uint8_t> strip(stripRowBytes * kYuvStripRows);
+
+  for (int y = area.top(); y < area.bottom(); y += kYuvStripRows) {
+    const int rows = std::min(kYuvStripRows, area.bottom() - y);
+    auto info = SkImageInfo::Make(w, rows, kRGBA_8888_SkColorType, kPremul_SkAlphaType);
+    auto canvas = SkCanvas::MakeRasterDirect(info, strip.data(), stripRowBytes);
+
+    canvas->clear(SK_ColorTRANSPARENT);
+    canvas->translate(-area.left(), -y);
+    canvas->drawPicture(picture);
+
+    ConvertRGBAToI420A(strip.data(), stripRowBytes,
+                       SkIRect::MakeLTRB(area.left(), y, area.right(), y + rows), dst, coeffs);
+  }
+}
+
+} // namespace canvex
@@ -0,0 +1,52 @@
+#pragma once
+#include "../include/canvex_c_api.h"
+#include "skia_includes.h"
+
+namespace canvex {
+
+/*
+  Rasterization straight into planar YUV 4:2:0 with a full resolution alpha plane.
+
+  A recorded display list is played back into a small RGBA strip that stays in cache,
+  and each strip is converted as soon as it's drawn. So there's no full-size RGBA frame,
+  and only the requested area is touched.
+
+  Output is premultiplied like the RGBA it's converted from: the luma above the black level
+  and the chroma offset from 128 are scaled by alpha. A transparent pixel has black luma,
+  neutral chroma and zero alpha. Compositing over a base is then
+    Y = Yfg + (Ybase - black) * (1 - a)
+    C = Cfg + (Cbase - 128) * (1 - a)
+  Chroma samples are the average of their 2x2 block.
+*/
+
+// 16.16 fixed point coefficients for converting RGB to YCbCr
+struct YuvCoefficients {
+  int32_t yR, yG, yB;
+  int32_t cbR, cbG, cbB;
+  int32_t crR, crG, crB;
+  int32_t yBlack; // luma of black, 16 for limited range and 0 for full range
+};
+
+YuvCoefficients GetYuvCoefficients(CanvexYuvColorMatrix matrix);
+
+// Converts premultiplied RGBA to the destination planes within area, which must be aligned
+// to 2x2 blocks except where it ends at the right or bottom edge of an odd-sized image.
+// rgba points to the pixel at the area's top-left corner.
+void ConvertRGBAToI420A(
+  const uint8_t* rgba,
+  size_t rgbaRowBytes,
+  const SkIRect& area,
+  const CanvexI420ABuffer& dst,
+  const YuvCoefficients& coeffs
+);
+
+// Plays back the picture into the destination planes within area (aligned as above),
+// converting in strips of a few rows at a time.
+void RasterizePictureToI420A(
+  const sk_sp<SkPicture>& picture,
+  const SkIRect& area,
+  const CanvexI420ABuffer& dst,
+  const YuvCoefficients& coeffs
+);
+
+} // namespace canvex
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace canvex {
+
+// 64-bit FNV-1a. Used for content hashes of display list commands and render state,
+// so it only needs to be fast and stable within a process, not cryptographically strong.
+class Hasher {
+ public:
+  Hasher() = default;
+  explicit Hasher(uint64_t seed) : h_(seed) {}
+
+  Hasher& addBytes(const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+      h_ ^= p[i];
+      h_ *= kPrime;
+    }
+    return *this;
+  }
+
+  template <typename T>
+  Hasher& add(const T& v) {
+    static_assert(std::is_trivially_copyable<T>::value, "Hasher::add needs a plain value type");
+    return addBytes(&v, sizeof(T));
+  }
+
+  Hasher& add(const std::string& s) {
+    // include the length so that consecutive strings can't alias
+    add<uint64_t>(s.size());
+    return addBytes(s.data(), s.size());
+  }
+
+  uint64_t value() const {
+    return h_;
+  }
+
+ private:
+  static constexpr uint64_t kPrime = 0x100000001b3ULL;
+  uint64_t h_ = 0xcbf29ce484222325ULL;
+};
+
+} // namespace canvex
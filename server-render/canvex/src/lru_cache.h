@@ -0,0 +1,141 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace canvex {
+
+// Map bounded by a maximum number of entries and optionally a total cost (e.g. bytes),
+// evicting the least recently used entries when over either limit.
+// The most recently used entry is never evicted, so a single entry over the cost limit is still kept.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+ public:
+  using CostFn = std::function<size_t(const Value&)>;
+  using EvictFn = std::function<void(const Key&, Value&)>;
+
+  // without a cost function all entries cost nothing, and only maxEntries applies
+  explicit LruCache(size_t maxEntries, size_t maxCost = SIZE_MAX, CostFn costFn = nullptr)
+    : maxEntries_(maxEntries), maxCost_(maxCost), costFn_(std::move(costFn)) {}
+
+  // called with each entry that's evicted to stay within the limits, but not for erase() or clear()
+  void setEvictionHook(EvictFn fn) {
+    onEvict_ = std::move(fn);
+  }
+
+  // returns null if not found, otherwise marks the entry as most recently used.
+  // the pointer stays valid until the entry is evicted or erased.
+  Value* get(const Key& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->value;
+  }
+
+  Value& put(const Key& key, Value value) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      it->second->value = std::move(value);
+    } else {
+      entries_.push_front({key, std::move(value), 0});
+      index_[key] = entries_.begin();
+    }
+    updateFrontCost_();
+    return entries_.front().value;
+  }
+
+  // call after changing an entry in a way that changes its cost.
+  // marks it as most recently used, and evicts others if the cache is now over the limits.
+  void updateCost(const Key& key) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      updateFrontCost_();
+    }
+  }
+
+  void erase(const Key& key) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      totalCost_ -= it->second->cost;
+      entries_.erase(it->second);
+      index_.erase(it);
+    }
+  }
+
+  void clear() {
+    entries_.clear();
+    index_.clear();
+    totalCost_ = 0;
+  }
+
+  size_t size() const {
+    return entries_.size();
+  }
+
+  size_t totalCost() const {
+    return totalCost_;
+  }
+
+  size_t maxEntries() const {
+    return maxEntries_;
+  }
+
+  void setMaxEntries(size_t n) {
+    maxEntries_ = n;
+    evictOverLimit_();
+  }
+
+  size_t maxCost() const {
+    return maxCost_;
+  }
+
+  void setMaxCost(size_t cost) {
+    maxCost_ = cost;
+    evictOverLimit_();
+  }
+
+ private:
+  struct Entry {
+    Key key;
+    Value value;
+    size_t cost;
+  };
+
+  size_t maxEntries_;
+  size_t maxCost_;
+  size_t totalCost_ = 0;
+  CostFn costFn_;
+  EvictFn onEvict_;
+  std::list<Entry> entries_; // front is the most recently used
+  std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index_;
+
+  void updateFrontCost_() {
+    auto& entry = entries_.front();
+    const size_t cost = costFn_ ? costFn_(entry.value) : 0;
+    totalCost_ = totalCost_ - entry.cost + cost;
+    entry.cost = cost;
+    evictOverLimit_();
+  }
+
+  void evictOverLimit_() {
+    // never evicts the front entry, which was just used
+    while (entries_.size() > 1 && (entries_.size() > maxEntries_ || totalCost_ > maxCost_)) {
+      auto& victim = entries_.back();
+      if (onEvict_) {
+        onEvict_(victim.key, victim.value);
+      }
+      totalCost_ -= victim.cost;
+      index_.erase(victim.key);
+      entries_.pop_back();
+    }
+  }
+};
+
+} // namespace canvex
@@ -45,17 +45,34 @@ fn main() {
         .include("libyuv/include")
         .flag("-std=c++17")
         .file("subprojects/canvex/src/canvas_display_list.cpp")
+        .file("subprojects/canvex/src/canvas_display_list_binary.cpp")
         .file("subprojects/canvex/src/file_util.cpp")
         .file("subprojects/canvex/src/style_util.cpp")
+        .file("subprojects/canvex/src/canvex_analytic_shapes.cpp")
+        .file("subprojects/canvex/src/canvex_emoji_atlas.cpp")
+        .file("subprojects/canvex/src/canvex_font_preloader.cpp")
+        .file("subprojects/canvex/src/canvex_group_cache.cpp")
+        .file("subprojects/canvex/src/canvex_image_cache.cpp")
+        .file("subprojects/canvex/src/canvex_image_decode_pool.cpp")
+        .file("subprojects/canvex/src/canvex_live_asset_watcher.cpp")
+        .file("subprojects/canvex/src/canvex_mapped_files.cpp")
+        .file("subprojects/canvex/src/canvex_op_profiler.cpp")
+        .file("subprojects/canvex/src/canvex_raster_bands.cpp")
+        .file("subprojects/canvex/src/canvex_shared_resource_cache.cpp")
+        .file("subprojects/canvex/src/canvex_shm_frame_source.cpp")
+        .file("subprojects/canvex/src/canvex_skia_caches.cpp")
         .file("subprojects/canvex/src/canvex_skia_context.cpp")
         .file("subprojects/canvex/src/canvex_skia_executor.cpp")
         .file("subprojects/canvex/src/canvex_skia_resource_context.cpp")
+        .file("subprojects/canvex/src/canvex_yuv_output.cpp")
         .file("subprojects/canvex/src/canvex_c_api.cpp")
         .file("src/vcsrender_c_api.cpp")
         .file("src/parse/parse_scenedesc.cpp")
         .file("src/yuv_compositor.cpp")
         .file("src/thumbs.cpp")
         .file("src/mask.cpp")
+        .file("src/trace.cpp")
+        .file("src/frame_ring.cpp")
         .compile("vcsrender");
 
     if target.contains("macos") {
@@ -99,6 +116,7 @@ fn main() {
         println!("cargo:rustc-link-lib=static=skia");
         println!("cargo:rustc-link-lib=static=yuv_internal");
         println!("cargo:rustc-link-lib=dylib=freetype");
+        println!("cargo:rustc-link-lib=dylib=rt");
     } else {
         unimplemented!();
     }
@@ -20,9 +20,29 @@ typedef enum {
 
 typedef void *VcsRenderCtx;
 
+typedef void *VcsSharedResourceCache;
+
+// how foreground graphics handle images that aren't decoded yet, see CanvexImageLoadPolicy
+typedef enum {
+  VcsImageLoad_Block = 0, // decode during the frame render (default)
+  VcsImageLoad_Skip, // decode in the background, images appear on a later frame
+  VcsImageLoad_Placeholder // decode in the background, draw a placeholder meanwhile
+} VcsImageLoadPolicy;
+
+#define VCS_MAX_LAYER_STATS 16
+
+// per-layer timings in VcsRenderExecutionStats
+typedef struct {
+  uint32_t input_id;
+  int32_t masked; // nonzero if drawn with a corner radius mask
+  int32_t opacity_blend; // nonzero if blended with opacity
+  int64_t scale_us;
+  int64_t blend_us; // copy or blend into the composite
+} VcsLayerRenderStats;
+
 typedef struct VcsRenderExecutionStats {
   // -- high level operations --
-  int64_t render_total_us;
+  int64_t render_total_us; // the whole call, including the copy into the output buffer
 
   // -- debug output --
 
@@ -32,8 +52,76 @@ typedef struct VcsRenderExecutionStats {
   // the returned string is owned by the VcsRenderCtx and must not be freed.
   // it's valid until the next call to the render function.
   const char *thumb_capture_str;
+
+  // -- foreground graphics --
+
+  // time spent loading fonts and images during this frame because they weren't preloaded
+  // (see VcsRenderCtxPreload). zero on frames where the graphics didn't change.
+  int64_t fg_cold_load_us;
+
+  // the rest of the foreground timings are also zero on frames where the graphics didn't change.
+  int32_t fg_rendered; // nonzero if the display list was rendered on this frame
+  int64_t fg_parse_us;
+  int64_t fg_raster_us; // canvex render, broken down in the fg_detail fields
+  int64_t fg_detail_image_loading_us;
+  int64_t fg_detail_draw_image_us;
+  int64_t fg_detail_draw_shapes_us;
+  int64_t fg_detail_draw_text_us;
+  int32_t fg_num_cmds;
+  int32_t fg_num_damage_rects;
+  int64_t fg_convert_us; // damaged areas converted from RGBA to YUV
+  int64_t fg_convert_pixels;
+
+  // -- compositing --
+  int64_t fg_blend_us; // foreground blended over the video layers, on every frame
+  int64_t bg_copy_us;
+
+  // layers beyond VCS_MAX_LAYER_STATS are counted in num_layers but not listed
+  int32_t num_layers;
+  VcsLayerRenderStats layers[VCS_MAX_LAYER_STATS];
+
+  int32_t mask_cache_hits;
+  int32_t mask_cache_misses;
+
+  // -- totals --
+  int64_t frame_total_us; // compositor time, i.e. render_total_us without the output copy
+  int64_t bytes_touched; // estimate of pixel memory read and written, including the output copy
 } VcsRenderExecutionStats;
 
+// Skia's process-global caches used for foreground graphics, see VcsRenderGetSkiaCacheStats()
+typedef struct {
+  int64_t font_cache_bytes_used; // glyph strikes
+  int64_t font_cache_bytes_limit;
+  int64_t resource_cache_bytes_used; // decoded and scaled images
+  int64_t resource_cache_bytes_limit;
+
+  // text cache lookups by all contexts since the process started
+  int64_t text_blob_cache_hits;
+  int64_t text_blob_cache_misses;
+
+  int64_t num_purges;
+} VcsSkiaCacheStats;
+
+// fonts and images to load ahead of a session, see VcsRenderCtxPreload()
+typedef struct {
+  const char *family; // e.g. "Roboto"
+  int32_t weight; // e.g. 400 or 700
+  int32_t italic; // nonzero for the italic variant
+} VcsPreloadFont;
+
+typedef struct {
+  const char *asset_type; // "defaultAsset", "compositionAsset" or "liveAsset"
+  const char *name;
+  uint32_t draw_w; // largest size drawn in output pixels, or zero for full resolution
+  uint32_t draw_h;
+} VcsPreloadImage;
+
+typedef struct {
+  int32_t num_pending;
+  int32_t num_ready;
+  int32_t num_failed;
+} VcsPreloadStatus;
+
 
 /*
   A render context must be created for any render operations.
@@ -52,6 +140,84 @@ void VcsRenderCtxSetThumbCaptureIntervalFrames(
   int32_t frameIntv
 );
 
+/*
+  Live rendering should use a background policy, so that the first frame showing
+  a large image doesn't stall on decoding it.
+*/
+void VcsRenderCtxSetImageLoadPolicy(
+  VcsRenderCtx ctx,
+  VcsImageLoadPolicy policy
+);
+
+/*
+  Fonts and graphics images can be shared by all the render contexts in a process, so that
+  each session doesn't hold its own copy. Contexts that share the cache can render on different threads.
+  Live assets are still cached by each context separately.
+
+  maxImageBytes is the budget for decoded images, or 0 for the default.
+  Destroying the cache releases the caller's reference; attached contexts keep it alive.
+*/
+VcsSharedResourceCache VcsSharedResourceCacheCreate(
+  int64_t maxImageBytes
+);
+void VcsSharedResourceCacheDestroy(VcsSharedResourceCache);
+
+/*
+  Should be called right after creating the context, since fonts and images it has already loaded are dropped.
+  A null cache detaches the context.
+*/
+void VcsRenderCtxAttachSharedResourceCache(
+  VcsRenderCtx ctx,
+  VcsSharedResourceCache cache
+);
+
+/*
+  Starts loading fonts and decoding images in the background, so that the first frame
+  showing new graphics doesn't stall on them. Should be called when the session is set up,
+  with the fonts and assets its compositions use; readiness can then be polled with VcsRenderCtxGetPreloadStatus.
+*/
+VcsRenderResult VcsRenderCtxPreload(
+  VcsRenderCtx ctx,
+  const VcsPreloadFont *fonts,
+  size_t numFonts,
+  const VcsPreloadImage *images,
+  size_t numImages
+);
+
+// must not be called while the context is rendering on another thread
+VcsRenderResult VcsRenderCtxGetPreloadStatus(
+  VcsRenderCtx ctx,
+  VcsPreloadStatus *status
+);
+
+/*
+  Skia's glyph and resource caches are shared by all the contexts in the process.
+  Limits of zero are left unchanged. A purge drops everything that isn't in use,
+  e.g. when the process is idle or a session with many fonts has ended.
+*/
+void VcsRenderSetSkiaCacheLimits(
+  int64_t fontCacheBytes,
+  int64_t resourceCacheBytes
+);
+
+VcsRenderResult VcsRenderGetSkiaCacheStats(
+  VcsSkiaCacheStats *stats
+);
+
+void VcsRenderPurgeSkiaCaches(void);
+
+/*
+  Process-wide trace of render steps (foreground raster, each layer's scale and blend, etc.)
+  for all contexts, written as Chrome trace JSON that chrome://tracing and the Perfetto UI can open.
+  Recording is off by default and costs next to nothing then.
+
+  Start discards events from an earlier recording. Stop writes the events to the path and ends recording.
+  Thread names label the calling thread's events, e.g. "render" or "session 2".
+*/
+void VcsRenderTraceStart(void);
+VcsRenderResult VcsRenderTraceStop(const char *outputPath);
+void VcsRenderTraceSetThreadName(const char *name);
+
 /* 
   Background color string must be in canvex-compatible format.
   Examples:
@@ -105,6 +271,79 @@ VcsRenderResult VcsRenderYuv420Planar(
 );
 
 
+/*
+  Shared-memory ring of frames, for passing video between processes without copying
+  (e.g. a decoder process producing the inputs, or an encoder process consuming the output).
+  A ring has one producer and one consumer, and a fixed frame size given when it's created.
+
+  The creator passes the ring to the other process as a file descriptor, either inherited across
+  fork/exec (see VcsFrameRingGetFd) or sent over a Unix domain socket, and the other process opens it.
+
+  Acquired buffers can be passed straight to VcsRenderYuv420Planar: a consumer's buffer as
+  the VcsVideoInputData buffer, and a producer's buffer as dstBuf. Rows are 64-byte aligned.
+  A buffer stays valid until it's published or released, and only one can be acquired at a time per side.
+
+  Waits take a timeout in milliseconds, or -1 to wait indefinitely, and return 0 when a buffer was
+  acquired, 1 on timeout, and -1 when the ring was closed or an argument is invalid.
+*/
+typedef void *VcsFrameRing;
+
+typedef struct {
+  uint64_t frame_index;
+  uint32_t input_id;
+  int64_t publish_time_ns; // CLOCK_MONOTONIC
+} VcsFrameRingSlotInfo;
+
+// numSlots is 2-64. returns null on error
+VcsFrameRing VcsFrameRingCreate(
+  uint32_t w,
+  uint32_t h,
+  uint32_t numSlots
+);
+
+// fd is duplicated, so the caller can close its own copy. returns null if it's not a valid ring
+VcsFrameRing VcsFrameRingOpen(int fd);
+
+int VcsFrameRingGetFd(VcsFrameRing ring);
+
+void VcsFrameRingDestroy(VcsFrameRing ring);
+
+// -- producer --
+int VcsFrameRingAcquireWrite(
+  VcsFrameRing ring,
+  VcsBufferYuv420Planar *buf,
+  int timeoutMs
+);
+
+void VcsFrameRingPublish(
+  VcsFrameRing ring,
+  uint64_t frameIndex,
+  uint32_t inputId
+);
+
+// -- consumer --
+int VcsFrameRingAcquireRead(
+  VcsFrameRing ring,
+  VcsBufferYuv420Planar *buf,
+  VcsFrameRingSlotInfo *info, // optional
+  int timeoutMs
+);
+
+void VcsFrameRingRelease(VcsFrameRing ring);
+
+// ends the other side's waits. frames already published can still be read
+void VcsFrameRingClose(VcsFrameRing ring);
+
+// passes the ring's descriptor over a connected Unix domain socket; returns 0 on success
+int VcsFrameRingSendFd(
+  VcsFrameRing ring,
+  int socketFd
+);
+
+// returns the received descriptor to pass to VcsFrameRingOpen, or -1 on error
+int VcsFrameRingReceiveFd(int socketFd);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,247 @@
+#include "daemon_protocol.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// macOS doesn't have MSG_NOSIGNAL, so vcsrenderd and the client ignore SIGPIPE instead
+#ifndef MSG_NOSIGNAL
+ #define MSG_NOSIGNAL 0
+#endif
+
+namespace vcsrender {
+
+std::string DaemonMessage::getString(const std::string& key, const std::string& defaultValue) const {
+  auto it = params.find(key);
+  return it != params.end() ? it->second : defaultValue;
+}
+
+int64_t DaemonMessage::getInt(const std::string& key, int64_t defaultValue) const {
+  auto it = params.find(key);
+  if (it == params.end()) return defaultValue;
+  try {
+    size_t pos = 0;
+    const int64_t v = std::stoll(it->second, &pos);
+    if (pos == it->second.size()) return v;
+  } catch (std::exception&) {
+  }
+  throw std::runtime_error("Invalid integer for " + key + ": " + it->second);
+}
+
+double DaemonMessage::getDouble(const std::string& key, double defaultValue) const {
+  auto it = params.find(key);
+  if (it == params.end()) return defaultValue;
+  try {
+    size_t pos = 0;
+    const double v = std::stod(it->second, &pos);
+    if (pos == it->second.size()) return v;
+  } catch (std::exception&) {
+  }
+  throw std::runtime_error("Invalid number for " + key + ": " + it->second);
+}
+
+bool DaemonMessageReader::takeBuffered_(DaemonMessage& msg, bool& malformed) {
+  malformed = false;
+  const auto lineEnd = buf_.find('\n');
+  if (lineEnd == std::string::npos) {
+    if (buf_.size() > 64 * 1024) malformed = true; // a header line is never this long
+    return false;
+  }
+
+  DaemonMessage m;
+  std::stringstream ss(buf_.substr(0, lineEnd));
+  std::string token;
+  ss >> m.command;
+  while (ss >> token) {
+    const auto eq = token.find('=');
+    if (eq == std::string::npos) {
+      malformed = true;
+      return false;
+    }
+    m.params[token.substr(0, eq)] = token.substr(eq + 1);
+  }
+  if (m.command.empty()) {
+    malformed = true;
+    return false;
+  }
+
+  size_t payloadSize = 0;
+  try {
+    payloadSize = m.getInt("payload", 0);
+  } catch (std::exception&) {
+    malformed = true;
+    return false;
+  }
+  if (payloadSize > kMaxDaemonPayloadBytes) {
+    malformed = true;
+    return false;
+  }
+  if (buf_.size() < lineEnd + 1 + payloadSize) {
+    return false;
+  }
+  m.payload = buf_.substr(lineEnd + 1, payloadSize);
+  m.params.erase("payload");
+  buf_.erase(0, lineEnd + 1 + payloadSize);
+
+  msg = std::move(m);
+  return true;
+}
+
+bool DaemonMessageReader::read(DaemonMessage& msg) {
+  bool malformed = false;
+  while (!takeBuffered_(msg, malformed)) {
+    if (malformed) return false;
+
+    char chunk[16 * 1024];
+    const ssize_t n = ::read(fd_, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    buf_.append(chunk, n);
+  }
+  return true;
+}
+
+bool DaemonMessageReader::readAvailable(DaemonMessage& msg, bool& closed) {
+  closed = false;
+  bool malformed = false;
+  if (takeBuffered_(msg, malformed)) return true;
+
+  while (!malformed) {
+    char chunk[16 * 1024];
+    const ssize_t n = ::recv(fd_, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+    if (n <= 0) {
+      closed = true;
+      return false;
+    }
+    buf_.append(chunk, n);
+    if (takeBuffered_(msg, malformed)) return true;
+  }
+  closed = true;
+  return false;
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool WriteDaemonMessage(int fd, const DaemonMessage& msg) {
+  std::stringstream ss;
+  ss << msg.command;
+  for (const auto& kv : msg.params) {
+    ss << " " << kv.first << "=" << kv.second;
+  }
+  if (!msg.payload.empty()) {
+    ss << " payload=" << msg.payload.size();
+  }
+  ss << "\n";
+  const auto header = ss.str();
+  return writeAll(fd, header.data(), header.size()) && writeAll(fd, msg.payload.data(), msg.payload.size());
+}
+
+int ConnectDaemonSocket(const std::string& path) {
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) return -1;
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool GetDaemonPeerUid(int fd, uid_t& uid) {
+#if defined(__linux__)
+  ucred cred{};
+  socklen_t len = sizeof(cred);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || len != sizeof(cred)) {
+    return false;
+  }
+  uid = cred.uid;
+  return true;
+#else
+  gid_t gid;
+  return getpeereid(fd, &uid, &gid) == 0;
+#endif
+}
+
+// -- shared memory frames --
+
+static size_t denseI420Size(uint32_t w, uint32_t h) {
+  return (size_t)w * h + 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+}
+
+ShmYuvBuf::ShmYuvBuf(const std::string& name, uint8_t* data, size_t size, uint32_t w, uint32_t h, bool owner)
+  : name_(name), data_(data), size_(size), owner_(owner),
+    buf_(std::make_shared<Yuv420PlanarBuf>(w, h, data, w, (w + 1) / 2)) {}
+
+ShmYuvBuf::~ShmYuvBuf() {
+  munmap(data_, size_);
+  if (owner_) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+std::unique_ptr<ShmYuvBuf> ShmYuvBuf::Create(const std::string& name, uint32_t w, uint32_t h) {
+  if (w < 1 || h < 1) return nullptr;
+  const size_t size = denseI420Size(w, h);
+
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    std::cerr << "** Unable to create shared memory " << name << ": " << strerror(errno) << std::endl;
+    return nullptr;
+  }
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  return std::unique_ptr<ShmYuvBuf>(new ShmYuvBuf(name, (uint8_t*)data, size, w, h, true));
+}
+
+std::unique_ptr<ShmYuvBuf> ShmYuvBuf::Open(const std::string& name, uint32_t w, uint32_t h) {
+  if (w < 1 || h < 1) return nullptr;
+  const size_t size = denseI420Size(w, h);
+
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) return nullptr;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < size) {
+    close(fd);
+    return nullptr;
+  }
+  void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return nullptr;
+
+  return std::unique_ptr<ShmYuvBuf>(new ShmYuvBuf(name, (uint8_t*)data, size, w, h, false));
+}
+
+} // namespace vcsrender
@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include "yuvbuf.h"
+
+namespace vcsrender {
+
+/*
+  Message format used between vcsrenderd and its clients over a Unix domain stream socket.
+
+  Each message is a header line followed by an optional payload:
+
+    <command> [key=value ...]\n
+    <payload bytes>
+
+  If the payload isn't empty, the header includes its size as "payload=<bytes>".
+  Keys and values can't contain spaces or newlines; anything larger (scene JSON, error text)
+  goes in the payload.
+
+  Every request gets exactly one response, with the command "ok" or "error".
+  An error response carries the message as its payload.
+
+  Video frames don't pass through the socket. They're exchanged in POSIX shared memory objects
+  holding one dense I420 frame each, which the client creates and registers by name (see ShmYuvBuf).
+*/
+
+constexpr int kDaemonProtocolVersion = 1;
+
+// default socket path of vcsrenderd and vcsrender_client
+constexpr const char* kDefaultDaemonSocketPath = "/tmp/vcsrenderd.sock";
+
+// requests larger than this are rejected, so a bad client can't make the daemon allocate without bound
+constexpr size_t kMaxDaemonPayloadBytes = 64 * 1024 * 1024;
+
+struct DaemonMessage {
+  std::string command;
+  std::map<std::string, std::string> params;
+  std::string payload;
+
+  DaemonMessage() {}
+  explicit DaemonMessage(const std::string& cmd) : command(cmd) {}
+
+  DaemonMessage& set(const std::string& key, const std::string& value) {
+    params[key] = value;
+    return *this;
+  }
+
+  DaemonMessage& set(const std::string& key, const char* value) {
+    params[key] = value;
+    return *this;
+  }
+
+  template <typename T>
+  DaemonMessage& set(const std::string& key, T value) {
+    params[key] = std::to_string(value);
+    return *this;
+  }
+
+  bool has(const std::string& key) const {
+    return params.count(key) > 0;
+  }
+
+  std::string getString(const std::string& key, const std::string& defaultValue = "") const;
+
+  // throws if the value isn't a number
+  int64_t getInt(const std::string& key, int64_t defaultValue = 0) const;
+  double getDouble(const std::string& key, double defaultValue = 0.0) const;
+
+  static DaemonMessage error(const std::string& message) {
+    DaemonMessage m("error");
+    m.payload = message;
+    return m;
+  }
+};
+
+// buffers a connection's incoming bytes, which may contain partial or several messages
+class DaemonMessageReader {
+ public:
+  explicit DaemonMessageReader(int fd) : fd_(fd) {}
+
+  // blocks until a whole message has been read.
+  // returns false when the connection is closed or the message is malformed.
+  bool read(DaemonMessage& msg);
+
+  // reads whatever is available without blocking
+  // and returns true if a whole message is then buffered. sets closed if the peer has gone.
+  bool readAvailable(DaemonMessage& msg, bool& closed);
+
+ private:
+  int fd_;
+  std::string buf_;
+
+  // parses a message from the start of buf_ if it's complete
+  bool takeBuffered_(DaemonMessage& msg, bool& malformed);
+};
+
+// returns false if the connection is closed
+bool WriteDaemonMessage(int fd, const DaemonMessage& msg);
+
+// connects to a daemon socket, returns -1 on error
+int ConnectDaemonSocket(const std::string& path);
+
+// the user id of the process at the other end of a connected Unix domain socket.
+// returns false on error.
+bool GetDaemonPeerUid(int fd, uid_t& uid);
+
+/*
+  A dense I420 frame in a POSIX shared memory object.
+  The creator owns the name and unlinks it when destroyed; others open it by name.
+*/
+class ShmYuvBuf {
+ public:
+  // returns null on error
+  static std::unique_ptr<ShmYuvBuf> Create(const std::string& name, uint32_t w, uint32_t h);
+  static std::unique_ptr<ShmYuvBuf> Open(const std::string& name, uint32_t w, uint32_t h);
+
+  ~ShmYuvBuf();
+
+  ShmYuvBuf(const ShmYuvBuf&) = delete;
+  ShmYuvBuf& operator=(const ShmYuvBuf&) = delete;
+
+  // a buffer wrapping the mapping, valid while this object exists
+  std::shared_ptr<Yuv420PlanarBuf> buf() const {
+    return buf_;
+  }
+
+  const std::string& name() const {
+    return name_;
+  }
+
+ private:
+  ShmYuvBuf(const std::string& name, uint8_t* data, size_t size, uint32_t w, uint32_t h, bool owner);
+
+  std::string name_;
+  uint8_t* data_;
+  size_t size_;
+  bool owner_;
+  std::shared_ptr<Yuv420PlanarBuf> buf_;
+};
+
+} // namespace vcsrender
@@ -0,0 +1,112 @@
+#include "frame_hash.h"
+#include <algorithm>
+#include <cstring>
+
+namespace vcsrender {
+
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9e3779b185ebca87ULL;
+constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4fULL;
+constexpr uint64_t kPrime3 = 0x165667b19e3779f9ULL;
+
+inline uint64_t rotl(uint64_t v, int r) {
+  return (v << r) | (v >> (64 - r));
+}
+
+inline uint64_t load64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t mixLane(uint64_t lane, uint64_t v) {
+  return rotl(lane + v * kPrime2, 31) * kPrime1;
+}
+
+} // namespace
+
+FrameHasher::FrameHasher()
+  : lanes_{kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1} {}
+
+void FrameHasher::addBlock_(const uint8_t* p) {
+  lanes_[0] = mixLane(lanes_[0], load64(p));
+  lanes_[1] = mixLane(lanes_[1], load64(p + 8));
+  lanes_[2] = mixLane(lanes_[2], load64(p + 16));
+  lanes_[3] = mixLane(lanes_[3], load64(p + 24));
+}
+
+FrameHasher& FrameHasher::addBytes(const void* data, size_t len) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  totalLen_ += len;
+
+  if (numPending_ > 0) {
+    const size_t n = std::min(len, sizeof(pending_) - numPending_);
+    memcpy(pending_ + numPending_, p, n);
+    numPending_ += n;
+    p += n;
+    len -= n;
+    if (numPending_ < sizeof(pending_)) return *this;
+    addBlock_(pending_);
+    numPending_ = 0;
+  }
+
+  while (len >= 32) {
+    addBlock_(p);
+    p += 32;
+    len -= 32;
+  }
+
+  memcpy(pending_, p, len);
+  numPending_ = len;
+  return *this;
+}
+
+FrameHasher& FrameHasher::addYuv420(const Yuv420PlanarBuf& buf) {
+  add(((uint64_t)buf.w << 32) | buf.h);
+
+  for (uint32_t y = 0; y < buf.h; y++) {
+    addBytes(buf.data + (size_t)y * buf.rowBytes_y, buf.w);
+  }
+  const uint32_t chromaW = (buf.w + 1) / 2;
+  const uint8_t* planes[2] = {buf.getConstCbData(), buf.getConstCrData()};
+  for (auto plane : planes) {
+    for (uint32_t y = 0; y < buf.chromaH; y++) {
+      addBytes(plane + (size_t)y * buf.rowBytes_ch, chromaW);
+    }
+  }
+  return *this;
+}
+
+uint64_t FrameHasher::value() const {
+  uint64_t h = rotl(lanes_[0], 1) + rotl(lanes_[1], 7) + rotl(lanes_[2], 12) + rotl(lanes_[3], 18);
+  h ^= totalLen_ * kPrime3;
+
+  for (size_t i = 0; i < numPending_; i++) {
+    h = rotl(h ^ (pending_[i] * kPrime1), 11) * kPrime2;
+  }
+
+  // final avalanche, so that nearby inputs spread over all the bits
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t HashYuv420Frame(const Yuv420PlanarBuf& buf) {
+  return FrameHasher().addYuv420(buf).value();
+}
+
+std::string FormatFrameHash(uint64_t hash) {
+  static const char* kDigits = "0123456789abcdef";
+  std::string s(16, '0');
+  for (int i = 15; i >= 0; i--) {
+    s[i] = kDigits[hash & 0xf];
+    hash >>= 4;
+  }
+  return s;
+}
+
+} // namespace vcsrender
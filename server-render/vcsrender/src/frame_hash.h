@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "yuvbuf.h"
+
+namespace vcsrender {
+
+/*
+  Content hashes of frames and render inputs, for detecting repeated frames
+  and for comparing renders without comparing the pixels.
+
+  The hash processes 8 bytes at a time in four independent lanes, so it runs near memory speed
+  on whole frames. It's stable across runs and machines of the same byte order,
+  so hashes written in a manifest can be compared between builds,
+  but it's not cryptographically strong.
+*/
+
+class FrameHasher {
+ public:
+  FrameHasher();
+
+  FrameHasher& addBytes(const void* data, size_t len);
+
+  FrameHasher& add(uint64_t v) {
+    return addBytes(&v, sizeof(v));
+  }
+
+  FrameHasher& add(double v) {
+    return addBytes(&v, sizeof(v));
+  }
+
+  FrameHasher& add(const std::string& s) {
+    // include the length so that consecutive strings can't alias
+    add((uint64_t)s.size());
+    return addBytes(s.data(), s.size());
+  }
+
+  // the rows of each plane without their padding, so the same image hashes the same at any rowBytes
+  FrameHasher& addYuv420(const Yuv420PlanarBuf& buf);
+
+  uint64_t value() const;
+
+ private:
+  uint64_t lanes_[4];
+  uint64_t totalLen_ = 0;
+
+  // bytes carried over between addBytes calls, until there's a full 32-byte block
+  uint8_t pending_[32];
+  size_t numPending_ = 0;
+
+  void addBlock_(const uint8_t* p);
+};
+
+uint64_t HashYuv420Frame(const Yuv420PlanarBuf& buf);
+
+// 16 lowercase hex digits
+std::string FormatFrameHash(uint64_t hash);
+
+} // namespace vcsrender
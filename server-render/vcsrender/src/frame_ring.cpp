@@ -0,0 +1,345 @@
+#include "frame_ring.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+#endif
+
+namespace vcsrender {
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+size_t alignUp(size_t v, size_t align) {
+  return (v + align - 1) / align * align;
+}
+
+// waits until the word no longer holds the expected value, or about timeoutNs passes (if >= 0).
+// may also return early without a change, so callers check their condition again.
+void waitOnWord(std::atomic<uint32_t>& word, uint32_t expected, int64_t timeoutNs) {
+#if defined(__linux__)
+  timespec ts;
+  timespec* tsPtr = nullptr;
+  if (timeoutNs >= 0) {
+    ts.tv_sec = timeoutNs / 1000000000;
+    ts.tv_nsec = timeoutNs % 1000000000;
+    tsPtr = &ts;
+  }
+  // not FUTEX_PRIVATE_FLAG, since the word is shared with another process
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, tsPtr, nullptr, 0);
+#else
+  int64_t sleepNs = 50000;
+  if (timeoutNs >= 0 && timeoutNs < sleepNs) sleepNs = timeoutNs;
+  if (word.load() == expected) {
+    std::this_thread::sleep_for(std::chrono::nanoseconds(sleepNs));
+  }
+#endif
+}
+
+void wakeWord(std::atomic<uint32_t>& word) {
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+  (void)word;
+#endif
+}
+
+int createSharedMemoryFd() {
+#if defined(__linux__)
+  return memfd_create("vcsrender-frame-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+  // an shm object that's unlinked right away is as anonymous as a memfd
+  const std::string name = "/vcsrender-ring-" + std::to_string(getpid()) + "-"
+                           + std::to_string(FrameRing::NowNs());
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd >= 0) {
+    shm_unlink(name.c_str());
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+  return fd;
+#endif
+}
+
+} // namespace
+
+int64_t FrameRing::NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+FrameRing::FrameRing(int fd, uint8_t* base, size_t size, const Geometry& geometry)
+  : fd_(fd), base_(base), size_(size), header_(reinterpret_cast<FrameRingHeader*>(base)), geometry_(geometry) {}
+
+FrameRing::~FrameRing() {
+  munmap(base_, size_);
+  ::close(fd_);
+}
+
+std::unique_ptr<FrameRing> FrameRing::Create(uint32_t w, uint32_t h, uint32_t numSlots) {
+  if (w < 2 || h < 2 || w > 16384 || h > 16384 || numSlots < 2 || numSlots > kFrameRingMaxSlots) {
+    std::cerr << "** Invalid frame ring size: " << w << "x" << h << ", " << numSlots << " slots" << std::endl;
+    return nullptr;
+  }
+
+  const uint32_t rowBytesY = alignUp(w, kFrameRingRowAlign);
+  const uint32_t rowBytesCh = alignUp((w + 1) / 2, kFrameRingRowAlign);
+  const size_t frameSize = (size_t)rowBytesY * h + 2 * (size_t)rowBytesCh * ((h + 1) / 2);
+  const size_t slotOffset = alignUp(sizeof(FrameRingHeader), kPageSize);
+  const size_t slotStride = alignUp(frameSize, kPageSize);
+  const size_t totalSize = slotOffset + slotStride * numSlots;
+
+  int fd = createSharedMemoryFd();
+  if (fd < 0) {
+    std::cerr << "** Unable to create frame ring memory: " << strerror(errno) << std::endl;
+    return nullptr;
+  }
+  if (ftruncate(fd, totalSize) != 0) {
+    std::cerr << "** Unable to size frame ring memory: " << strerror(errno) << std::endl;
+    ::close(fd);
+    return nullptr;
+  }
+#if defined(__linux__)
+  // a peer that shrank the memory would make the other side's accesses fault with SIGBUS
+  if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    std::cerr << "** Unable to seal frame ring memory: " << strerror(errno) << std::endl;
+    ::close(fd);
+    return nullptr;
+  }
+#endif
+  void* base = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  // new memory is zeroed, which is also the initial state of the counters
+  auto header = reinterpret_cast<FrameRingHeader*>(base);
+  header->width = w;
+  header->height = h;
+  header->rowBytesY = rowBytesY;
+  header->rowBytesCh = rowBytesCh;
+  header->numSlots = numSlots;
+  header->slotOffset = slotOffset;
+  header->slotStride = slotStride;
+  header->totalSize = totalSize;
+  header->version = kFrameRingVersion;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kFrameRingMagic;
+
+  const Geometry geometry{w, h, rowBytesY, rowBytesCh, numSlots, slotOffset, slotStride};
+  return std::unique_ptr<FrameRing>(new FrameRing(fd, (uint8_t*)base, totalSize, geometry));
+}
+
+bool FrameRing::isValidGeometry_(const FrameRingHeader& hdr, uint64_t fileSize) {
+  if (hdr.magic != kFrameRingMagic || hdr.version != kFrameRingVersion || hdr.totalSize != fileSize) {
+    return false;
+  }
+  if (hdr.width < 2 || hdr.height < 2 || hdr.width > 16384 || hdr.height > 16384
+      || hdr.numSlots < 2 || hdr.numSlots > kFrameRingMaxSlots) {
+    return false;
+  }
+  if (hdr.rowBytesY < hdr.width || hdr.rowBytesCh < (hdr.width + 1) / 2
+      || hdr.rowBytesY > 4 * 16384 || hdr.rowBytesCh > 4 * 16384) {
+    return false;
+  }
+  const uint64_t frameSize = (uint64_t)hdr.rowBytesY * hdr.height
+                             + 2 * (uint64_t)hdr.rowBytesCh * ((hdr.height + 1) / 2);
+  if (hdr.slotStride < frameSize || hdr.slotOffset < sizeof(FrameRingHeader) || hdr.slotOffset > fileSize) {
+    return false;
+  }
+  // written as a division, so a huge stride can't overflow the check
+  return hdr.slotStride <= (fileSize - hdr.slotOffset) / hdr.numSlots;
+}
+
+std::unique_ptr<FrameRing> FrameRing::Open(int srcFd) {
+  int fd = fcntl(srcFd, F_DUPFD_CLOEXEC, 0);
+  if (fd < 0) return nullptr;
+
+  struct stat st;
+  FrameRingHeader hdr;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FrameRingHeader)
+      || pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)
+      || !isValidGeometry_(hdr, st.st_size)) {
+    std::cerr << "** Invalid frame ring" << std::endl;
+    ::close(fd);
+    return nullptr;
+  }
+#if defined(__linux__)
+  // the size checked above only holds if the creator can't change it afterwards
+  const int seals = fcntl(fd, F_GET_SEALS);
+  if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW)) {
+    std::cerr << "** Frame ring memory isn't sealed against resizing" << std::endl;
+    ::close(fd);
+    return nullptr;
+  }
+#endif
+
+  void* base = mmap(nullptr, hdr.totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    ::close(fd);
+    return nullptr;
+  }
+  // the peer can still rewrite the header, so only this copy of the geometry is used from now on
+  const Geometry geometry{hdr.width, hdr.height, hdr.rowBytesY, hdr.rowBytesCh, hdr.numSlots,
+                          hdr.slotOffset, hdr.slotStride};
+  return std::unique_ptr<FrameRing>(new FrameRing(fd, (uint8_t*)base, hdr.totalSize, geometry));
+}
+
+FrameRingPlanes FrameRing::slotPlanes_(uint32_t slot) const {
+  return {
+    base_ + geometry_.slotOffset + geometry_.slotStride * slot,
+    geometry_.w,
+    geometry_.h,
+    geometry_.rowBytesY,
+    geometry_.rowBytesCh,
+  };
+}
+
+// shared wait loop: checks ready(), and otherwise announces the wait in waitingFlag
+// and sleeps on the futex word until the other side bumps it
+template <typename ReadyFn>
+static FrameRingWait waitUntil(FrameRingHeader& hdr, std::atomic<uint32_t>& futexWord,
+                               std::atomic<uint32_t>& waitingFlag, int timeoutMs, ReadyFn ready) {
+  const int64_t deadline = timeoutMs >= 0 ? FrameRing::NowNs() + (int64_t)timeoutMs * 1000000 : -1;
+  for (;;) {
+    if (ready()) return FrameRingWait::Ok;
+    if (hdr.closed.load()) return FrameRingWait::Closed;
+
+    int64_t remainingNs = -1;
+    if (deadline >= 0) {
+      remainingNs = deadline - FrameRing::NowNs();
+      if (remainingNs <= 0) return FrameRingWait::Timeout;
+    }
+
+    // announce the wait before checking again, so a change made after the check is sure to wake us
+    waitingFlag.store(1);
+    const uint32_t observed = futexWord.load();
+    if (!ready() && !hdr.closed.load()) {
+      waitOnWord(futexWord, observed, remainingNs);
+    }
+    waitingFlag.store(0);
+  }
+}
+
+FrameRingWait FrameRing::acquireWrite(FrameRingPlanes& planes, int timeoutMs) {
+  auto& hdr = *header_;
+  const uint64_t w = hdr.writeSeq.load(std::memory_order_relaxed); // only the producer writes it
+  const uint32_t numSlots = geometry_.numSlots;
+  auto res = waitUntil(hdr, hdr.readFutex, hdr.producerWaiting, timeoutMs, [&hdr, w, numSlots] {
+    return w - hdr.readSeq.load() < numSlots;
+  });
+  if (res == FrameRingWait::Ok) {
+    planes = slotPlanes_(w % numSlots);
+  }
+  return res;
+}
+
+void FrameRing::publish(uint64_t frameIndex, uint32_t inputId) {
+  auto& hdr = *header_;
+  const uint64_t w = hdr.writeSeq.load(std::memory_order_relaxed);
+  auto& meta = hdr.slotMeta[w % geometry_.numSlots];
+  meta.frameIndex = frameIndex;
+  meta.inputId = inputId;
+  meta.publishTimeNs = NowNs();
+
+  hdr.writeSeq.store(w + 1);
+  hdr.writeFutex.fetch_add(1);
+  if (hdr.consumerWaiting.load()) {
+    wakeWord(hdr.writeFutex);
+  }
+}
+
+FrameRingWait FrameRing::acquireRead(FrameRingPlanes& planes, FrameRingSlotMeta& meta, int timeoutMs) {
+  auto& hdr = *header_;
+  const uint64_t r = hdr.readSeq.load(std::memory_order_relaxed); // only the consumer writes it
+  auto res = waitUntil(hdr, hdr.writeFutex, hdr.consumerWaiting, timeoutMs, [&hdr, r] {
+    return r < hdr.writeSeq.load();
+  });
+  if (res == FrameRingWait::Closed && r < hdr.writeSeq.load()) {
+    res = FrameRingWait::Ok; // published before the close
+  }
+  if (res == FrameRingWait::Ok) {
+    planes = slotPlanes_(r % geometry_.numSlots);
+    meta = hdr.slotMeta[r % geometry_.numSlots];
+  }
+  return res;
+}
+
+void FrameRing::release() {
+  auto& hdr = *header_;
+  const uint64_t r = hdr.readSeq.load(std::memory_order_relaxed);
+  hdr.readSeq.store(r + 1);
+  hdr.readFutex.fetch_add(1);
+  if (hdr.producerWaiting.load()) {
+    wakeWord(hdr.readFutex);
+  }
+}
+
+void FrameRing::close() {
+  auto& hdr = *header_;
+  hdr.closed.store(1);
+  hdr.writeFutex.fetch_add(1);
+  hdr.readFutex.fetch_add(1);
+  wakeWord(hdr.writeFutex);
+  wakeWord(hdr.readFutex);
+}
+
+bool FrameRing::sendFd(int socketFd) const {
+  char dummy = 'R';
+  iovec iov{&dummy, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd_, sizeof(int));
+
+  return sendmsg(socketFd, &msg, 0) == 1;
+}
+
+int FrameRing::ReceiveFd(int socketFd) {
+  char dummy;
+  iovec iov{&dummy, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  if (recvmsg(socketFd, &msg, 0) != 1) return -1;
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+      || cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+    return -1;
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  return fd;
+}
+
+} // namespace vcsrender
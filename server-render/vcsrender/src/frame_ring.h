@@ -0,0 +1,157 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace vcsrender {
+
+/*
+  Ring of I420 frames in shared memory, for passing frames between processes without copying
+  (e.g. decoder -> vcsrender -> encoder). Each ring has a single producer and a single consumer.
+
+  The memory is a memfd (an anonymous, unlinked shm object on systems without memfd_create),
+  which the creator passes to the other process as a file descriptor, either inherited
+  across fork/exec or sent over a Unix domain socket. The memfd is sealed against resizing,
+  so neither side can make the other's accesses fault by truncating it.
+
+  The other side is only trusted as far as the shared memory goes: Open validates the header's
+  geometry and keeps its own copy of it, so a corrupt or hostile peer can't direct reads or writes
+  outside the mapping.
+
+  Layout: a header page followed by numSlots slots. Slots start on page boundaries
+  and rows are padded to 64 bytes, so every plane row is aligned for SIMD loads.
+
+  The producer writes into slot (writeSeq % numSlots) while writeSeq - readSeq < numSlots,
+  then publishes it by incrementing writeSeq. The consumer reads slot (readSeq % numSlots)
+  while readSeq < writeSeq, then releases it by incrementing readSeq. A side that has to wait
+  sleeps on a futex in the shared header (or polls on systems without futexes),
+  and the other side only makes the wake system call if someone is waiting.
+*/
+
+constexpr uint32_t kFrameRingMagic = 0x52465356; // "VSFR" in little-endian byte order
+constexpr uint32_t kFrameRingVersion = 1;
+constexpr uint32_t kFrameRingMaxSlots = 64;
+constexpr size_t kFrameRingRowAlign = 64;
+
+struct FrameRingSlotMeta {
+  uint64_t frameIndex;
+  uint32_t inputId;
+  uint32_t _reserved;
+  int64_t publishTimeNs; // CLOCK_MONOTONIC, comparable between processes on the same machine
+};
+
+struct FrameRingHeader {
+  // -- written once by the creator --
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t rowBytesY;
+  uint32_t rowBytesCh;
+  uint32_t numSlots;
+  uint32_t _reserved;
+  uint64_t slotOffset;
+  uint64_t slotStride;
+  uint64_t totalSize;
+
+  // each side's counters are on their own cache line, so they don't bounce between the processes' cores
+  alignas(64) std::atomic<uint64_t> writeSeq;
+  std::atomic<uint32_t> writeFutex; // bumped on each publish and on close, waited on by the consumer
+  std::atomic<uint32_t> consumerWaiting;
+
+  alignas(64) std::atomic<uint64_t> readSeq;
+  std::atomic<uint32_t> readFutex; // bumped on each release and on close, waited on by the producer
+  std::atomic<uint32_t> producerWaiting;
+
+  alignas(64) std::atomic<uint32_t> closed; // set by either side; the other side's waits return
+
+  alignas(64) FrameRingSlotMeta slotMeta[kFrameRingMaxSlots];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "frame ring counters must be lock-free to be shared between processes");
+
+// a slot's frame as returned by acquireWrite/acquireRead.
+// the chroma planes follow the luma plane, as in Yuv420PlanarBuf and VcsBufferYuv420Planar.
+struct FrameRingPlanes {
+  uint8_t* data;
+  uint32_t w;
+  uint32_t h;
+  uint32_t rowBytesY;
+  uint32_t rowBytesCh;
+};
+
+enum class FrameRingWait {
+  Ok = 0,
+  Timeout,
+  Closed,
+};
+
+class FrameRing {
+ public:
+  // returns null on error
+  static std::unique_ptr<FrameRing> Create(uint32_t w, uint32_t h, uint32_t numSlots);
+
+  // maps a ring from a descriptor received from its creator. the descriptor is duplicated,
+  // so the caller can close its own copy. returns null if it's not a valid ring.
+  static std::unique_ptr<FrameRing> Open(int fd);
+
+  ~FrameRing();
+
+  FrameRing(const FrameRing&) = delete;
+  FrameRing& operator=(const FrameRing&) = delete;
+
+  int fd() const {
+    return fd_;
+  }
+
+  const FrameRingHeader& header() const {
+    return *header_;
+  }
+
+  // -- producer --
+  // waits for a free slot, with timeoutMs < 0 waiting indefinitely
+  FrameRingWait acquireWrite(FrameRingPlanes& planes, int timeoutMs);
+  void publish(uint64_t frameIndex, uint32_t inputId);
+
+  // -- consumer --
+  FrameRingWait acquireRead(FrameRingPlanes& planes, FrameRingSlotMeta& meta, int timeoutMs);
+  void release();
+
+  // wakes and ends the other side's waits; frames already published can still be read
+  void close();
+
+  // passes the descriptor over a connected Unix domain socket.
+  // ReceiveFd returns the received descriptor, or -1 on error.
+  bool sendFd(int socketFd) const;
+  static int ReceiveFd(int socketFd);
+
+  static int64_t NowNs();
+
+ private:
+  // the header's geometry, validated when the ring is opened
+  struct Geometry {
+    uint32_t w;
+    uint32_t h;
+    uint32_t rowBytesY;
+    uint32_t rowBytesCh;
+    uint32_t numSlots;
+    uint64_t slotOffset;
+    uint64_t slotStride;
+  };
+
+  FrameRing(int fd, uint8_t* base, size_t size, const Geometry& geometry);
+
+  int fd_;
+  uint8_t* base_;
+  size_t size_;
+  FrameRingHeader* header_;
+  const Geometry geometry_;
+
+  static bool isValidGeometry_(const FrameRingHeader& hdr, uint64_t fileSize);
+
+  FrameRingPlanes slotPlanes_(uint32_t slot) const;
+};
+
+} // namespace vcsrender
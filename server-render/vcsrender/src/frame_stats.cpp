@@ -0,0 +1,77 @@
+#include "frame_stats.h"
+
+namespace vcsrender {
+
+void WriteFrameStatsCsvHeader(std::ostream& os) {
+  os << "frame,elided,total_us,"
+     << "fg_rendered,fg_parse_us,fg_raster_us,fg_image_loading_us,fg_draw_image_us,fg_draw_shapes_us,"
+     << "fg_draw_text_us,fg_cold_load_us,fg_num_cmds,fg_num_damage_rects,fg_convert_us,fg_convert_pixels,"
+     << "fg_blend_us,bg_copy_us,num_layers,layers_scale_us,layers_blend_us,"
+     << "mask_cache_hits,mask_cache_misses,bytes_touched\n";
+}
+
+void WriteFrameStatsCsvRow(std::ostream& os, uint64_t frameIdx, const FrameRenderStats& stats) {
+  int64_t scaleUs = 0, blendUs = 0;
+  for (const auto& layer : stats.layers) {
+    scaleUs += layer.scaleUs;
+    blendUs += layer.blendUs;
+  }
+  const auto& fg = stats.fgCanvex;
+
+  os << frameIdx << "," << (stats.elided ? 1 : 0) << "," << stats.totalUs << ","
+     << (stats.fgRendered ? 1 : 0) << "," << fg.json_parse_us << "," << fg.render_total_us << ","
+     << fg.render_detail_image_loading_us << "," << fg.render_detail_draw_image_us << ","
+     << fg.render_detail_draw_shapes_us << "," << fg.render_detail_draw_text_us << ","
+     << fg.cold_load_us << "," << fg.num_cmds << "," << fg.num_damage_rects << ","
+     << stats.fgConvertUs << "," << stats.fgConvertPixels << ","
+     << stats.fgBlendUs << "," << stats.bgCopyUs << ","
+     << stats.layers.size() << "," << scaleUs << "," << blendUs << ","
+     << stats.numMaskCacheHits << "," << stats.numMaskCacheMisses << "," << stats.bytesTouched << "\n";
+}
+
+void WriteFrameStatsJsonLine(std::ostream& os, uint64_t frameIdx, const FrameRenderStats& stats) {
+  const auto& fg = stats.fgCanvex;
+
+  os << "{\"frame\":" << frameIdx << ",\"elided\":" << (stats.elided ? "true" : "false")
+     << ",\"total_us\":" << stats.totalUs;
+
+  os << ",\"fg\":{\"rendered\":" << (stats.fgRendered ? "true" : "false");
+  if (stats.fgRendered) {
+    os << ",\"parse_us\":" << fg.json_parse_us
+       << ",\"raster_us\":" << fg.render_total_us
+       << ",\"image_loading_us\":" << fg.render_detail_image_loading_us
+       << ",\"draw_image_us\":" << fg.render_detail_draw_image_us
+       << ",\"draw_shapes_us\":" << fg.render_detail_draw_shapes_us
+       << ",\"draw_text_us\":" << fg.render_detail_draw_text_us
+       << ",\"damage_detect_us\":" << fg.damage_detect_us
+       << ",\"cold_load_us\":" << fg.cold_load_us
+       << ",\"num_cmds\":" << fg.num_cmds
+       << ",\"num_damage_rects\":" << fg.num_damage_rects
+       << ",\"num_images_pending\":" << fg.num_images_pending
+       << ",\"num_shm_images\":" << fg.num_shm_images
+       << ",\"group_cache_hits\":" << fg.num_group_cache_hits
+       << ",\"group_cache_misses\":" << fg.num_group_cache_misses
+       << ",\"convert_us\":" << stats.fgConvertUs
+       << ",\"convert_pixels\":" << stats.fgConvertPixels;
+  }
+  os << ",\"blend_us\":" << stats.fgBlendUs << "}";
+
+  os << ",\"bg_copy_us\":" << stats.bgCopyUs;
+
+  os << ",\"layers\":[";
+  for (size_t i = 0; i < stats.layers.size(); i++) {
+    const auto& layer = stats.layers[i];
+    os << (i > 0 ? "," : "") << "{\"input_id\":" << layer.inputId
+       << ",\"scale_us\":" << layer.scaleUs
+       << ",\"blend_us\":" << layer.blendUs
+       << ",\"masked\":" << (layer.masked ? "true" : "false")
+       << ",\"opacity_blend\":" << (layer.opacityBlend ? "true" : "false") << "}";
+  }
+  os << "]";
+
+  os << ",\"mask_cache_hits\":" << stats.numMaskCacheHits
+     << ",\"mask_cache_misses\":" << stats.numMaskCacheMisses
+     << ",\"bytes_touched\":" << stats.bytesTouched << "}\n";
+}
+
+} // namespace vcsrender
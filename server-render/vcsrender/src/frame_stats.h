@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "canvex_c_api.h"
+
+namespace vcsrender {
+
+/*
+  Timings and counters for one frame rendered by YuvCompositor.
+
+  Times are wall-clock microseconds on the render thread. Byte counts are estimates
+  of the pixel memory read and written by each step (buffers touched, not cache traffic),
+  meant for telling memory-bound steps apart from compute-bound ones between frames.
+*/
+
+struct LayerRenderStats {
+  uint32_t inputId = 0;
+  int64_t scaleUs = 0; // includes clearing the scaled buffer
+  int64_t blendUs = 0; // copy or blend into the composite
+  bool masked = false; // corner radius mask
+  bool opacityBlend = false;
+};
+
+struct FrameRenderStats {
+  // the output repeats the previous frame's (vcsrender --elide_repeats), so nothing was rendered
+  // and the other fields are zero
+  bool elided = false;
+
+  int64_t totalUs = 0;
+
+  // foreground graphics are only rendered on frames where the display list changed.
+  // fgCanvex has canvex's parse and raster timings with their breakdown.
+  bool fgRendered = false;
+  CanvexExecutionStats fgCanvex{};
+  int64_t fgConvertUs = 0; // damaged areas converted from RGBA to I420
+  int64_t fgConvertPixels = 0;
+
+  int64_t fgBlendUs = 0; // foreground blended over the video layers, every frame
+
+  int64_t bgCopyUs = 0;
+
+  std::vector<LayerRenderStats> layers;
+
+  int32_t numMaskCacheHits = 0;
+  int32_t numMaskCacheMisses = 0;
+
+  int64_t bytesTouched = 0;
+};
+
+// CSV has one row per frame, so layers are summed.
+// JSON lines have one object per frame, with the layers as an array.
+void WriteFrameStatsCsvHeader(std::ostream& os);
+void WriteFrameStatsCsvRow(std::ostream& os, uint64_t frameIdx, const FrameRenderStats& stats);
+void WriteFrameStatsJsonLine(std::ostream& os, uint64_t frameIdx, const FrameRenderStats& stats);
+
+} // namespace vcsrender
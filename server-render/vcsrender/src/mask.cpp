@@ -20,8 +20,10 @@ std::shared_ptr<AlphaBuf> MaskCache::getCachedMask(uint32_t w, uint32_t h, uint3
   if (it != std::end(maskBufs_)) {  // already in cache
     //std::cout << "Found cached mask for " << w << " / " << h << " / " << cornerRadius << std::endl;
     auto& el = *it;
+    numHits_++;
     return el.second;
   }
+  numMisses_++;
 
   std::cout << "creating roundrect mask for " << w << " / " << h << " / " << cornerRadius << std::endl;
 
@@ -34,8 +34,14 @@ class MaskCache {
 
   std::shared_ptr<AlphaBuf> getCachedMask(uint32_t w, uint32_t h, uint32_t cornerRadius);
 
+  // lookups since the cache was created
+  int64_t numHits() const { return numHits_; }
+  int64_t numMisses() const { return numMisses_; }
+
 private:
   size_t capacity_;
+  int64_t numHits_ = 0;
+  int64_t numMisses_ = 0;
 
   using MaskCacheKey = std::tuple<uint32_t, uint32_t, uint32_t>;  // width, height, cornerRadius
   using CachedMaskBuf = std::pair<MaskCacheKey, std::shared_ptr<AlphaBuf>>;
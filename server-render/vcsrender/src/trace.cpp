@@ -0,0 +1,113 @@
+#include "trace.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+
+namespace vcsrender {
+
+namespace {
+
+void writeJsonString(std::ostream& os, const std::string& s) {
+  os << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    } else if ((unsigned char)c >= 0x20) {
+      os << c;
+    }
+  }
+  os << '"';
+}
+
+} // namespace
+
+Tracer::State& Tracer::getState_() {
+  static State state;
+  return state;
+}
+
+Tracer::ThreadBuffer& Tracer::getThreadBuffer_() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<ThreadBuffer>();
+    auto& state = getState_();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    buffer->tid = state.nextTid++;
+    state.threads.push_back(buffer);
+  }
+  return *buffer;
+}
+
+void Tracer::start() {
+  auto& state = getState_();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (auto& buffer : state.threads) {
+      std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+      buffer->events.clear();
+    }
+    state.startNs = nowNs();
+  }
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::setThreadName(const std::string& name) {
+  auto& buffer = getThreadBuffer_();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.name = name;
+}
+
+void Tracer::addEvent(const TraceEvent& event) {
+  auto& buffer = getThreadBuffer_();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  if (buffer.events.size() < kMaxEventsPerThread) {
+    buffer.events.push_back(event);
+  }
+}
+
+bool Tracer::stopAndWrite(const std::filesystem::path& path) {
+  enabled_.store(false, std::memory_order_relaxed);
+
+  std::ofstream os(path);
+  if (!os) {
+    std::cerr << "** Unable to open trace file for writing: " << path << std::endl;
+    return false;
+  }
+
+  const auto pid = getpid();
+  auto& state = getState_();
+  std::lock_guard<std::mutex> lock(state.mutex);
+
+  os << std::fixed << std::setprecision(3);
+  os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  for (auto& bufferPtr : state.threads) {
+    auto& buffer = *bufferPtr;
+    std::lock_guard<std::mutex> bufferLock(buffer.mutex);
+
+    if (!buffer.name.empty()) {
+      os << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+         << ",\"tid\":" << buffer.tid << ",\"args\":{\"name\":";
+      writeJsonString(os, buffer.name);
+      os << "}}";
+      first = false;
+    }
+    for (const auto& ev : buffer.events) {
+      os << (first ? "" : ",\n") << "{\"name\":\"" << ev.name << "\",\"cat\":\"vcsrender\",\"ph\":\"X\""
+         << ",\"ts\":" << (ev.startNs - state.startNs) / 1000.0 << ",\"dur\":" << ev.durNs / 1000.0
+         << ",\"pid\":" << pid << ",\"tid\":" << buffer.tid;
+      if (ev.argName) {
+        os << ",\"args\":{\"" << ev.argName << "\":" << ev.argValue << "}";
+      }
+      os << "}";
+      first = false;
+    }
+    buffer.events.clear();
+  }
+  os << "\n]}\n";
+
+  return os.good();
+}
+
+} // namespace vcsrender
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vcsrender {
+
+/*
+  Scoped trace events, written out in the Chrome trace event format
+  (which chrome://tracing and the Perfetto UI both open).
+
+  Recording is process-wide and off by default. Each VCS_TRACE_SCOPE only checks
+  a relaxed atomic flag when it's off. When it's on, the scope appends one complete event
+  to a buffer owned by its thread, so threads don't contend with each other.
+
+  Event and argument names must be string literals (or otherwise outlive the recording),
+  because only the pointers are stored.
+*/
+
+struct TraceEvent {
+  const char* name;
+  const char* argName; // optional integer argument
+  int64_t argValue;
+  int64_t startNs;
+  int64_t durNs;
+};
+
+class Tracer {
+ public:
+  // events beyond this per thread are dropped, so a forgotten trace doesn't grow without bound
+  static constexpr size_t kMaxEventsPerThread = 1 << 20;
+
+  static bool isEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // discards any earlier events and starts recording
+  static void start();
+
+  // stops recording and writes the events as Chrome trace JSON.
+  // returns false if the file can't be written.
+  static bool stopAndWrite(const std::filesystem::path& path);
+
+  // names the calling thread in the trace, e.g. "render" or "input"
+  static void setThreadName(const std::string& name);
+
+  static void addEvent(const TraceEvent& event);
+
+ private:
+  struct ThreadBuffer {
+    uint32_t tid = 0;
+    std::string name;
+    std::vector<TraceEvent> events;
+    std::mutex mutex; // only contended while the trace is written
+  };
+
+  struct State {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> threads; // including threads that have exited
+    uint32_t nextTid = 1;
+    int64_t startNs = 0;
+  };
+
+  static inline std::atomic<bool> enabled_{false};
+
+  static State& getState_();
+  static ThreadBuffer& getThreadBuffer_();
+};
+
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name, const char* argName = nullptr, int64_t argValue = 0) {
+    if (Tracer::isEnabled()) {
+      event_ = {name, argName, argValue, Tracer::nowNs(), 0};
+      active_ = true;
+    }
+  }
+
+  ~TraceScope() {
+    end();
+  }
+
+  // ends the event before the end of the C++ scope
+  void end() {
+    if (!active_) return;
+    active_ = false;
+    event_.durNs = Tracer::nowNs() - event_.startNs;
+    Tracer::addEvent(event_);
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+ private:
+  TraceEvent event_;
+  bool active_ = false;
+};
+
+} // namespace vcsrender
+
+#define VCS_TRACE_CONCAT_INNER_(a, b) a##b
+#define VCS_TRACE_CONCAT_(a, b) VCS_TRACE_CONCAT_INNER_(a, b)
+
+// records the enclosing scope as a trace event: VCS_TRACE_SCOPE("name") or VCS_TRACE_SCOPE("name", "arg", value)
+#define VCS_TRACE_SCOPE(...) vcsrender::TraceScope VCS_TRACE_CONCAT_(vcsTraceScope_, __LINE__)(__VA_ARGS__)
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "frame_stats.h"
+#include "time_util.h"
+#include "yuv_compositor.h"
+#include "yuvbuf.h"
+
+/*
+  Self-contained compositor benchmark.
+
+  Video inputs are generated in memory (a gradient, noise, a moving bar pattern and a checkerboard,
+  shared round-robin by the layers), so no input sequences need to be downloaded.
+  Each scenario sets up a grid of video layers and a foreground display list covering
+  a given share of the frame, which is updated every frame like animated graphics would be.
+
+  Every scenario is rendered for a number of warm-up frames and then measured over the
+  repetitions. Per-stage times come from the compositor's frame stats; the medians are reported
+  in microseconds, ns per output pixel and frames per second.
+
+  Usage:
+    vcsrender_bench [-n repetitions] [-w warmup_frames] [-r 1080p,4k] [--full] [-o results.json]
+
+  By default a reduced matrix is run: layer count, layer style and foreground coverage are each swept
+  with the other dimensions at a baseline. --full runs the full cross product.
+  Results are written as JSON to the -o path (default vcsrender_bench_results.json).
+*/
+
+using namespace vcsrender;
+
+namespace {
+
+constexpr uint32_t kInputW = 1280;
+constexpr uint32_t kInputH = 720;
+
+enum class LayerStyle { Fill, Fit, Mask, Opacity };
+
+const char* layerStyleName(LayerStyle style) {
+  switch (style) {
+    case LayerStyle::Fill: return "fill";
+    case LayerStyle::Fit: return "fit";
+    case LayerStyle::Mask: return "mask";
+    case LayerStyle::Opacity: return "opacity";
+  }
+  return "";
+}
+
+struct Resolution {
+  std::string name;
+  uint32_t w;
+  uint32_t h;
+};
+
+struct Scenario {
+  Resolution res;
+  int numLayers;
+  LayerStyle style;
+  int fgCoveragePct;
+
+  std::string name() const {
+    std::stringstream ss;
+    ss << res.name << "_" << numLayers << "layers_" << layerStyleName(style) << "_fg" << fgCoveragePct;
+    return ss.str();
+  }
+};
+
+struct SynthInputs {
+  std::vector<std::shared_ptr<Yuv420PlanarBuf>> bufs;
+
+  SynthInputs() {
+    for (int i = 0; i < 4; i++) {
+      bufs.push_back(std::make_shared<Yuv420PlanarBuf>(kInputW, kInputH));
+    }
+    auto& gradient = *bufs[0];
+    auto& noise = *bufs[1];
+    auto& checker = *bufs[3];
+
+    uint32_t seed = 12345;
+    for (uint32_t y = 0; y < kInputH; y++) {
+      for (uint32_t x = 0; x < kInputW; x++) {
+        gradient.data[y * gradient.rowBytes_y + x] = 16 + (x + y) * 219 / (kInputW + kInputH);
+        seed = seed * 1664525 + 1013904223;
+        noise.data[y * noise.rowBytes_y + x] = 16 + (seed >> 24) % 220;
+        checker.data[y * checker.rowBytes_y + x] = ((x / 32 + y / 32) % 2) ? 235 : 16;
+      }
+    }
+    for (uint32_t y = 0; y < gradient.chromaH; y++) {
+      for (uint32_t x = 0; x < gradient.rowBytes_ch; x++) {
+        gradient.getCbData()[y * gradient.rowBytes_ch + x] = 16 + x * 224 / gradient.rowBytes_ch;
+        gradient.getCrData()[y * gradient.rowBytes_ch + x] = 16 + y * 224 / gradient.chromaH;
+        seed = seed * 1664525 + 1013904223;
+        noise.getCbData()[y * noise.rowBytes_ch + x] = 16 + (seed >> 24) % 225;
+        noise.getCrData()[y * noise.rowBytes_ch + x] = 16 + (seed >> 16) % 225;
+        checker.getCbData()[y * checker.rowBytes_ch + x] = 128;
+        checker.getCrData()[y * checker.rowBytes_ch + x] = 128;
+      }
+    }
+    updateMovingPattern(0);
+  }
+
+  // vertical bars that shift every frame, so the input changes like video does
+  void updateMovingPattern(uint64_t frameIdx) {
+    auto& moving = *bufs[2];
+    for (uint32_t y = 0; y < kInputH; y++) {
+      for (uint32_t x = 0; x < kInputW; x++) {
+        moving.data[y * moving.rowBytes_y + x] = ((x + frameIdx * 8) / 64) % 2 ? 200 : 40;
+      }
+    }
+    memset(moving.getCbData(), 100, moving.rowBytes_ch * moving.chromaH);
+    memset(moving.getCrData(), 160, moving.rowBytes_ch * moving.chromaH);
+  }
+};
+
+std::string makeVideoLayersJSON(const Scenario& sc) {
+  const int cols = std::ceil(std::sqrt((double)sc.numLayers));
+  const int rows = (sc.numLayers + cols - 1) / cols;
+  const double tileW = (double)sc.res.w / cols;
+  const double tileH = (double)sc.res.h / rows;
+
+  std::stringstream ss;
+  ss << "[";
+  for (int i = 0; i < sc.numLayers; i++) {
+    const int col = i % cols, row = i / cols;
+    ss << (i > 0 ? "," : "") << "{\"type\":\"video\",\"id\":" << i
+       << ",\"frame\":{\"x\":" << col * tileW << ",\"y\":" << row * tileH
+       << ",\"w\":" << tileW << ",\"h\":" << tileH << "},\"attrs\":{\"scaleMode\":\""
+       << (sc.style == LayerStyle::Fit ? "fit" : "fill") << "\"";
+    if (sc.style == LayerStyle::Mask) {
+      ss << ",\"cornerRadiusPx\":" << std::max(4.0, std::min(tileW, tileH) / 10);
+    } else if (sc.style == LayerStyle::Opacity) {
+      ss << ",\"opacity\":0.7";
+    }
+    ss << "}}";
+  }
+  ss << "]";
+  return ss.str();
+}
+
+// translucent bands covering the given share of the frame, with a label that changes every frame
+std::string makeFgDisplayListJSON(const Scenario& sc, uint64_t frameIdx) {
+  std::stringstream ss;
+  ss << "{\"width\":" << sc.res.w << ",\"height\":" << sc.res.h << ",\"commands\":[";
+  if (sc.fgCoveragePct > 0) {
+    const double bandH = sc.res.h * sc.fgCoveragePct / 100.0;
+    ss << "[\"fillStyle\",\"rgba(20, 40, 200, 0.6)\"],"
+       << "[\"fillRect\",[0," << sc.res.h - bandH << "," << sc.res.w << "," << bandH << "]],"
+       << "[\"fillStyle\",\"rgba(255, 255, 255, 0.9)\"],"
+       << "[\"fillRect\",[" << (frameIdx % 100) * sc.res.w / 200.0 << "," << sc.res.h - bandH
+       << "," << sc.res.w / 10.0 << "," << std::min(bandH, sc.res.h / 20.0) << "]]";
+  }
+  ss << "]}";
+  return ss.str();
+}
+
+struct StageSamples {
+  const char* name;
+  std::vector<double> us;
+};
+
+double median(std::vector<double> v) {
+  std::sort(v.begin(), v.end());
+  return v.empty() ? 0.0 : v[v.size() / 2];
+}
+
+double minimum(const std::vector<double>& v) {
+  return v.empty() ? 0.0 : *std::min_element(v.begin(), v.end());
+}
+
+void runScenario(const Scenario& sc, SynthInputs& inputs, int numWarmup, int numReps,
+                 std::ostream& json, bool firstScenario) {
+  YuvCompositor comp(sc.res.w, sc.res.h, "");
+  comp.setVideoLayersJSON(makeVideoLayersJSON(sc));
+
+  VideoInputBufsById inputBufs;
+  for (int i = 0; i < sc.numLayers; i++) {
+    inputBufs[i] = inputs.bufs[i % inputs.bufs.size()];
+  }
+
+  std::vector<StageSamples> stages = {
+    {"total", {}}, {"fg_parse", {}}, {"fg_raster", {}}, {"fg_convert", {}},
+    {"bg_copy", {}}, {"layer_scale", {}}, {"layer_blend", {}}, {"overlay_blend", {}},
+  };
+  std::vector<double> bytesTouched;
+
+  for (int i = 0; i < numWarmup + numReps; i++) {
+    inputs.updateMovingPattern(i);
+    comp.setFgDisplayListJSON(makeFgDisplayListJSON(sc, i));
+    comp.renderFrame(i, inputBufs);
+    if (i < numWarmup) continue;
+
+    const auto& fs = comp.lastFrameStats();
+    double scaleUs = 0, blendUs = 0;
+    for (const auto& layer : fs.layers) {
+      scaleUs += layer.scaleUs;
+      blendUs += layer.blendUs;
+    }
+    const double values[] = {
+      (double)fs.totalUs, (double)fs.fgCanvex.json_parse_us, (double)fs.fgCanvex.render_total_us,
+      (double)fs.fgConvertUs, (double)fs.bgCopyUs, scaleUs, blendUs, (double)fs.fgBlendUs,
+    };
+    for (size_t s = 0; s < stages.size(); s++) {
+      stages[s].us.push_back(values[s]);
+    }
+    bytesTouched.push_back(fs.bytesTouched);
+  }
+
+  const double numPixels = (double)sc.res.w * sc.res.h;
+  const double totalMedianUs = median(stages[0].us);
+  const double fps = totalMedianUs > 0 ? 1.0e6 / totalMedianUs : 0.0;
+
+  std::cout << std::left << std::setw(34) << sc.name() << std::right << std::fixed << std::setprecision(2)
+            << std::setw(9) << totalMedianUs / 1000.0 << " ms  " << std::setw(8) << fps << " fps  "
+            << std::setw(6) << totalMedianUs * 1000.0 / numPixels << " ns/px" << std::endl;
+
+  json << (firstScenario ? "" : ",\n") << "    {\"name\":\"" << sc.name() << "\""
+       << ",\"width\":" << sc.res.w << ",\"height\":" << sc.res.h
+       << ",\"layers\":" << sc.numLayers << ",\"layer_style\":\"" << layerStyleName(sc.style) << "\""
+       << ",\"fg_coverage_pct\":" << sc.fgCoveragePct
+       << ",\"repetitions\":" << numReps
+       << ",\"fps\":" << fps
+       << ",\"bytes_touched_median\":" << (int64_t)median(bytesTouched)
+       << ",\"stages\":{";
+  for (size_t s = 0; s < stages.size(); s++) {
+    const double med = median(stages[s].us);
+    json << (s > 0 ? "," : "") << "\"" << stages[s].name << "\":{\"median_us\":" << med
+         << ",\"min_us\":" << minimum(stages[s].us)
+         << ",\"ns_per_pixel\":" << med * 1000.0 / numPixels
+         << ",\"fps\":" << (med > 0 ? 1.0e6 / med : 0.0) << "}";
+  }
+  json << "}}";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  int numReps = 30;
+  int numWarmup = 5;
+  bool full = false;
+  std::string outputPath = "vcsrender_bench_results.json";
+  std::vector<Resolution> resolutions = {{"1080p", 1920, 1080}, {"4k", 3840, 2160}};
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-n" && i + 1 < argc) {
+      numReps = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-w" && i + 1 < argc) {
+      numWarmup = std::max(0, atoi(argv[++i]));
+    } else if (arg == "-o" && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (arg == "--full") {
+      full = true;
+    } else if (arg == "-r" && i + 1 < argc) {
+      std::string list = argv[++i];
+      resolutions.clear();
+      if (list.find("1080p") != std::string::npos) resolutions.push_back({"1080p", 1920, 1080});
+      if (list.find("4k") != std::string::npos) resolutions.push_back({"4k", 3840, 2160});
+      if (resolutions.empty()) {
+        std::cerr << "Unknown resolutions: " << list << " (expected 1080p and/or 4k)" << std::endl;
+        return 1;
+      }
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  const std::vector<int> layerCounts = {1, 4, 16, 49, 100};
+  const std::vector<LayerStyle> styles = {LayerStyle::Fill, LayerStyle::Fit, LayerStyle::Mask, LayerStyle::Opacity};
+  const std::vector<int> fgCoverages = {0, 25, 50, 100};
+
+  std::vector<Scenario> scenarios;
+  for (const auto& res : resolutions) {
+    if (full) {
+      for (int n : layerCounts) {
+        for (auto style : styles) {
+          for (int cov : fgCoverages) {
+            scenarios.push_back({res, n, style, cov});
+          }
+        }
+      }
+      continue;
+    }
+    for (int n : layerCounts) {
+      scenarios.push_back({res, n, LayerStyle::Fill, 25});
+    }
+    for (auto style : styles) {
+      if (style != LayerStyle::Fill) scenarios.push_back({res, 16, style, 25});
+    }
+    for (int cov : fgCoverages) {
+      if (cov != 25) scenarios.push_back({res, 16, LayerStyle::Fill, cov});
+    }
+  }
+
+  std::cout << "vcsrender benchmark, " << scenarios.size() << " scenarios, "
+            << numWarmup << " warm-up frames and " << numReps << " repetitions each" << std::endl;
+
+  SynthInputs inputs;
+
+  std::ofstream json(outputPath);
+  if (!json) {
+    std::cerr << "** Unable to open output file: " << outputPath << std::endl;
+    return 1;
+  }
+  json << std::fixed << std::setprecision(3);
+  json << "{\n  \"benchmark\":\"vcsrender_bench\",\n  \"input_size\":[" << kInputW << "," << kInputH << "],\n"
+       << "  \"warmup_frames\":" << numWarmup << ",\n  \"scenarios\":[\n";
+
+  const double t0 = getMonotonicTime();
+  for (size_t i = 0; i < scenarios.size(); i++) {
+    runScenario(scenarios[i], inputs, numWarmup, numReps, json, i == 0);
+  }
+  json << "\n  ]\n}\n";
+
+  std::cout << "Finished in " << std::setprecision(1) << getMonotonicTime() - t0 << " s, results written to "
+            << outputPath << std::endl;
+  return json.good() ? 0 : 1;
+}
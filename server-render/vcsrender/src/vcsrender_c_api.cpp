@@ -2,11 +2,15 @@
 
 // internal C++ API
 #include "yuv_compositor.h"
+#include "frame_ring.h"
 #include "thumbs.h"
+#include "time_util.h"
+#include "trace.h"
 
 #include "libyuv.h"
 
 #include <algorithm>
+#include <cmath>
 #include <filesystem>
 #include <iostream>
 #include <string>
@@ -64,6 +68,136 @@ void VcsRenderCtxSetThumbCaptureIntervalFrames(
   ctx->thumbSettings.captureIntervalInFrames = frameIntv;
 }
 
+void VcsRenderCtxSetImageLoadPolicy(
+  VcsRenderCtx ctx_c,
+  VcsImageLoadPolicy policy
+) {
+  auto ctx = static_cast<vcsrender::c_api_internal::RenderCtx*>(ctx_c);
+  if (!ctx) return;
+
+  switch (policy) {
+    case VcsImageLoad_Block:
+      ctx->compositor.setImageLoadPolicy(CanvexImageLoad_Block);
+      break;
+    case VcsImageLoad_Skip:
+      ctx->compositor.setImageLoadPolicy(CanvexImageLoad_Skip);
+      break;
+    case VcsImageLoad_Placeholder:
+      ctx->compositor.setImageLoadPolicy(CanvexImageLoad_Placeholder);
+      break;
+  }
+}
+
+VcsSharedResourceCache VcsSharedResourceCacheCreate(
+  int64_t maxImageBytes
+) {
+  return CanvexSharedResourceCacheCreate(maxImageBytes);
+}
+
+void VcsSharedResourceCacheDestroy(VcsSharedResourceCache cache) {
+  CanvexSharedResourceCacheDestroy(cache);
+}
+
+void VcsRenderCtxAttachSharedResourceCache(
+  VcsRenderCtx ctx_c,
+  VcsSharedResourceCache cache
+) {
+  auto ctx = static_cast<vcsrender::c_api_internal::RenderCtx*>(ctx_c);
+  if (!ctx) return;
+
+  ctx->compositor.setSharedResourceCache(cache);
+}
+
+VcsRenderResult VcsRenderCtxPreload(
+  VcsRenderCtx ctx_c,
+  const VcsPreloadFont *fonts,
+  size_t numFonts,
+  const VcsPreloadImage *images,
+  size_t numImages
+) {
+  auto ctx = static_cast<vcsrender::c_api_internal::RenderCtx*>(ctx_c);
+  if (!ctx || (numFonts > 0 && !fonts) || (numImages > 0 && !images)) {
+    return VcsRenderError_InvalidArgument_Render;
+  }
+
+  std::vector<CanvexPreloadFont> canvexFonts;
+  for (size_t i = 0; i < numFonts; i++) {
+    canvexFonts.push_back({fonts[i].family, fonts[i].weight, fonts[i].italic});
+  }
+  std::vector<CanvexPreloadImage> canvexImages;
+  for (size_t i = 0; i < numImages; i++) {
+    canvexImages.push_back({images[i].asset_type, images[i].name, images[i].draw_w, images[i].draw_h});
+  }
+
+  if (!ctx->compositor.preload(canvexFonts, canvexImages)) {
+    return VcsRenderError_InvalidArgument_Render;
+  }
+  return VcsRenderSuccess;
+}
+
+VcsRenderResult VcsRenderCtxGetPreloadStatus(
+  VcsRenderCtx ctx_c,
+  VcsPreloadStatus *status
+) {
+  auto ctx = static_cast<vcsrender::c_api_internal::RenderCtx*>(ctx_c);
+  if (!ctx || !status) {
+    return VcsRenderError_InvalidArgument_Render;
+  }
+
+  const auto s = ctx->compositor.getPreloadStatus();
+  status->num_pending = s.num_pending;
+  status->num_ready = s.num_ready;
+  status->num_failed = s.num_failed;
+  return VcsRenderSuccess;
+}
+
+void VcsRenderSetSkiaCacheLimits(
+  int64_t fontCacheBytes,
+  int64_t resourceCacheBytes
+) {
+  CanvexSetSkiaCacheLimits(fontCacheBytes, 0, resourceCacheBytes);
+}
+
+VcsRenderResult VcsRenderGetSkiaCacheStats(
+  VcsSkiaCacheStats *stats
+) {
+  if (!stats) {
+    return VcsRenderError_InvalidArgument_Render;
+  }
+  CanvexSkiaCacheStats canvexStats{};
+  CanvexGetSkiaCacheStats(&canvexStats);
+
+  stats->font_cache_bytes_used = canvexStats.font_cache_bytes_used;
+  stats->font_cache_bytes_limit = canvexStats.font_cache_bytes_limit;
+  stats->resource_cache_bytes_used = canvexStats.resource_cache_bytes_used;
+  stats->resource_cache_bytes_limit = canvexStats.resource_cache_bytes_limit;
+  stats->text_blob_cache_hits = canvexStats.text_blob_cache_hits;
+  stats->text_blob_cache_misses = canvexStats.text_blob_cache_misses;
+  stats->num_purges = canvexStats.num_purges;
+  return VcsRenderSuccess;
+}
+
+void VcsRenderPurgeSkiaCaches(void) {
+  CanvexPurgeSkiaCaches();
+}
+
+void VcsRenderTraceStart(void) {
+  vcsrender::Tracer::start();
+}
+
+VcsRenderResult VcsRenderTraceStop(const char *outputPath) {
+  if (!outputPath) {
+    return VcsRenderError_InvalidArgument_ImageOutput;
+  }
+  return vcsrender::Tracer::stopAndWrite(outputPath) ? VcsRenderSuccess : VcsRenderError_InvalidArgument_ImageOutput;
+}
+
+void VcsRenderTraceSetThreadName(const char *name) {
+  if (name) {
+    vcsrender::Tracer::setThreadName(name);
+  }
+}
+
 VcsRenderResult VcsRenderCtxSetBackgroundColorFromString(VcsRenderCtx ctx_c, const char *colorStr_c) {
   if (!ctx_c || !colorStr_c) {
     return VcsRenderError_GraphicsUnspecifiedError;
@@ -206,6 +340,8 @@ VcsRenderResult VcsRenderYuv420Planar(
 
   ctx->thumbCaptureOutputStr.clear();
 
+  const double tStart = getMonotonicTime();
+
   auto resultBuf = ctx->compositor.renderFrame(frameIndex, inputBufs, ctx->thumbSettings, &ctx->thumbCaptureOutputStr);
 
   if (resultBuf->w != dstBuf->w ||
@@ -236,8 +372,156 @@ VcsRenderResult VcsRenderYuv420Planar(
   );
 
   if (stats) {
+    const auto& frameStats = ctx->compositor.lastFrameStats();
+    const auto& fg = frameStats.fgCanvex;
+
+    stats->render_total_us = llround((getMonotonicTime() - tStart) * 1.0e6);
     stats->thumb_capture_str = ctx->thumbCaptureOutputStr.length() ? ctx->thumbCaptureOutputStr.c_str() : nullptr;
+
+    stats->fg_cold_load_us = fg.cold_load_us;
+    stats->fg_rendered = frameStats.fgRendered ? 1 : 0;
+    stats->fg_parse_us = fg.json_parse_us;
+    stats->fg_raster_us = fg.render_total_us;
+    stats->fg_detail_image_loading_us = fg.render_detail_image_loading_us;
+    stats->fg_detail_draw_image_us = fg.render_detail_draw_image_us;
+    stats->fg_detail_draw_shapes_us = fg.render_detail_draw_shapes_us;
+    stats->fg_detail_draw_text_us = fg.render_detail_draw_text_us;
+    stats->fg_num_cmds = fg.num_cmds;
+    stats->fg_num_damage_rects = fg.num_damage_rects;
+    stats->fg_convert_us = frameStats.fgConvertUs;
+    stats->fg_convert_pixels = frameStats.fgConvertPixels;
+
+    stats->fg_blend_us = frameStats.fgBlendUs;
+    stats->bg_copy_us = frameStats.bgCopyUs;
+
+    stats->num_layers = frameStats.layers.size();
+    const size_t numListed = std::min<size_t>(frameStats.layers.size(), VCS_MAX_LAYER_STATS);
+    for (size_t i = 0; i < numListed; i++) {
+      const auto& layer = frameStats.layers[i];
+      stats->layers[i] = {layer.inputId, layer.masked ? 1 : 0, layer.opacityBlend ? 1 : 0,
+                          layer.scaleUs, layer.blendUs};
+    }
+
+    stats->mask_cache_hits = frameStats.numMaskCacheHits;
+    stats->mask_cache_misses = frameStats.numMaskCacheMisses;
+
+    stats->frame_total_us = frameStats.totalUs;
+    stats->bytes_touched = frameStats.bytesTouched + resultBuf->dataSize * 2;
   }
 
   return VcsRenderSuccess;
 }
+
+
+static int frameRingWaitResult(FrameRingWait res) {
+  switch (res) {
+    case FrameRingWait::Ok: return 0;
+    case FrameRingWait::Timeout: return 1;
+    case FrameRingWait::Closed: return -1;
+  }
+  return -1;
+}
+
+static void setBufferFromFrameRingPlanes(VcsBufferYuv420Planar *buf, const FrameRingPlanes& planes) {
+  buf->w = planes.w;
+  buf->h = planes.h;
+  buf->data = planes.data;
+  buf->rowbytes_y = planes.rowBytesY;
+  buf->rowbytes_ch = planes.rowBytesCh;
+}
+
+VcsFrameRing VcsFrameRingCreate(
+  uint32_t w,
+  uint32_t h,
+  uint32_t numSlots
+) {
+  return static_cast<void*>(FrameRing::Create(w, h, numSlots).release());
+}
+
+VcsFrameRing VcsFrameRingOpen(int fd) {
+  return static_cast<void*>(FrameRing::Open(fd).release());
+}
+
+int VcsFrameRingGetFd(VcsFrameRing ring_c) {
+  auto ring = static_cast<FrameRing*>(ring_c);
+  return ring ? ring->fd() : -1;
+}
+
+void VcsFrameRingDestroy(VcsFrameRing ring_c) {
+  auto ring = static_cast<FrameRing*>(ring_c);
+  delete ring;
+}
+
+int VcsFrameRingAcquireWrite(
+  VcsFrameRing ring_c,
+  VcsBufferYuv420Planar *buf,
+  int timeoutMs
+) {
+  auto ring = static_cast<FrameRing*>(ring_c);
+  if (!ring || !buf) return -1;
+
+  FrameRingPlanes planes;
+  auto res = ring->acquireWrite(planes, timeoutMs);
+  if (res == FrameRingWait::Ok) {
+    setBufferFromFrameRingPlanes(buf, planes);
+  }
+  return frameRingWaitResult(res);
+}
+
+void VcsFrameRingPublish(
+  VcsFrameRing ring_c,
+  uint64_t frameIndex,
+  uint32_t inputId
+) {
+  auto ring = static_cast<FrameRing*>(ring_c);
+  if (!ring) return;
+  ring->publish(frameIndex, inputId);
+}
+
+int VcsFrameRingAcquireRead(
+  VcsFrameRing ring_c,
+  VcsBufferYuv420Planar *buf,
+  VcsFrameRingSlotInfo *info,
+  int timeoutMs
+) {
+  auto ring = static_cast<FrameRing*>(ring_c);
+  if (!ring || !buf) return -1;
+
+  FrameRingPlanes planes;
+  FrameRingSlotMeta meta;
+  auto res = ring->acquireRead(planes, meta, timeoutMs);
+  if (res == FrameRingWait::Ok) {
+    setBufferFromFrameRingPlanes(buf, planes);
+    if (info) {
+      info->frame_index = meta.frameIndex;
+      info->input_id = meta.inputId;
+      info->publish_time_ns = meta.publishTimeNs;
+    }
+  }
+  return frameRingWaitResult(res);
+}
+
+void VcsFrameRingRelease(VcsFrameRing ring_c) {
+  auto ring = static_cast<FrameRing*>(ring_c);
+  if (!ring) return;
+  ring->release();
+}
+
+void VcsFrameRingClose(VcsFrameRing ring_c) {
+  auto ring = static_cast<FrameRing*>(ring_c);
+  if (!ring) return;
+  ring->close();
+}
+
+int VcsFrameRingSendFd(
+  VcsFrameRing ring_c,
+  int socketFd
+) {
+  auto ring = static_cast<FrameRing*>(ring_c);
+  if (!ring) return -1;
+  return ring->sendFd(socketFd) ? 0 : -1;
+}
+
+int VcsFrameRingReceiveFd(int socketFd) {
+  return FrameRing::ReceiveFd(socketFd);
+}
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
+
+#include "daemon_protocol.h"
+#include "file_util.h"
+#include "time_util.h"
+
+/*
+  Local client for vcsrenderd.
+
+  Usage:
+    vcsrender_client [--socket path] send <command> [key=value ...] [--payload file]
+        sends one request and prints the response
+
+    vcsrender_client [--socket path] job -w W -h H --oseq dir [--jsonseq dir] [--input_timings path] [--frames n]
+        renders a frame range from files in a new context, like the vcsrender CLI
+
+    vcsrender_client [--socket path] demo [-w W] [-h H] [--vl file] [--fg file] [--frames n] [--out dir]
+        renders frames through shared memory: a generated moving pattern is written into an input frame
+        before each render, and the output frame is read back (and written into out as a YUV sequence)
+
+  Contexts created by job and demo are destroyed when they finish or fail.
+*/
+
+using namespace vcsrender;
+
+namespace {
+
+struct Client {
+  int fd = -1;
+  std::unique_ptr<DaemonMessageReader> reader;
+
+  ~Client() {
+    if (fd >= 0) close(fd);
+  }
+
+  bool connect(const std::string& socketPath) {
+    fd = ConnectDaemonSocket(socketPath);
+    if (fd < 0) {
+      std::cerr << "** Unable to connect to vcsrenderd at " << socketPath << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+    reader = std::make_unique<DaemonMessageReader>(fd);
+    return true;
+  }
+
+  // throws on a connection failure or an error response
+  DaemonMessage request(const DaemonMessage& req) {
+    DaemonMessage resp;
+    if (!WriteDaemonMessage(fd, req) || !reader->read(resp)) {
+      throw std::runtime_error("Connection to vcsrenderd lost");
+    }
+    if (resp.command != "ok") {
+      throw std::runtime_error(req.command + " failed: " + resp.payload);
+    }
+    return resp;
+  }
+};
+
+// a context created for one mode, destroyed when it goes out of scope, including when a request throws
+struct ScopedContext {
+  Client& client;
+  std::string id;
+
+  ScopedContext(Client& c, const DaemonMessage& createReq)
+    : client(c), id(c.request(createReq).getString("ctx")) {}
+
+  ~ScopedContext() {
+    try {
+      client.request(DaemonMessage("destroy_context").set("ctx", id));
+    } catch (std::exception&) {
+      // the daemon also destroys it when the connection closes
+    }
+  }
+};
+
+std::string getOptionValue(const std::vector<std::string>& args, const std::string& name,
+                           const std::string& defaultValue = "") {
+  auto it = std::find(args.begin(), args.end(), name);
+  return (it != args.end() && it + 1 != args.end()) ? *(it + 1) : defaultValue;
+}
+
+int runSend(Client& client, const std::vector<std::string>& args) {
+  if (args.empty()) {
+    std::cerr << "send requires a command" << std::endl;
+    return 1;
+  }
+  DaemonMessage req(args[0]);
+  for (size_t i = 1; i < args.size(); i++) {
+    if (args[i] == "--payload" && i + 1 < args.size()) {
+      req.payload = readTextFile(args[++i]);
+      continue;
+    }
+    const auto eq = args[i].find('=');
+    if (eq == std::string::npos) {
+      std::cerr << "Expected key=value: " << args[i] << std::endl;
+      return 1;
+    }
+    req.set(args[i].substr(0, eq), args[i].substr(eq + 1));
+  }
+
+  DaemonMessage resp;
+  if (!WriteDaemonMessage(client.fd, req) || !client.reader->read(resp)) {
+    std::cerr << "** Connection to vcsrenderd lost" << std::endl;
+    return 2;
+  }
+  std::cout << resp.command;
+  for (const auto& kv : resp.params) {
+    std::cout << " " << kv.first << "=" << kv.second;
+  }
+  std::cout << std::endl;
+  if (!resp.payload.empty()) {
+    std::cout << resp.payload << std::endl;
+  }
+  return resp.command == "ok" ? 0 : 2;
+}
+
+int runJob(Client& client, const std::vector<std::string>& args) {
+  const auto oseq = getOptionValue(args, "--oseq");
+  if (oseq.empty()) {
+    std::cerr << "job requires --oseq" << std::endl;
+    return 1;
+  }
+  ScopedContext ctx(client, DaemonMessage("create_context")
+                             .set("w", getOptionValue(args, "-w", "1920"))
+                             .set("h", getOptionValue(args, "-h", "1080")));
+  const auto& ctxId = ctx.id;
+
+  DaemonMessage job("job");
+  job.set("ctx", ctxId).set("oseq", std::filesystem::absolute(oseq).string());
+  if (!getOptionValue(args, "--jsonseq").empty()) {
+    job.set("jsonseq", std::filesystem::absolute(getOptionValue(args, "--jsonseq")).string());
+  }
+  if (!getOptionValue(args, "--input_timings").empty()) {
+    job.set("input_timings", std::filesystem::absolute(getOptionValue(args, "--input_timings")).string());
+  }
+  job.set("frames", getOptionValue(args, "--frames", "1"));
+
+  const double t0 = getMonotonicTime();
+  auto resp = client.request(job);
+  const double t1 = getMonotonicTime();
+
+  std::cout << "Rendered " << resp.getString("frames") << " frames into " << oseq << " in "
+            << std::fixed << std::setprecision(1) << (t1 - t0) * 1000 << " ms (avg composite "
+            << resp.getInt("avg_render_us") / 1000.0 << " ms)" << std::endl;
+  return 0;
+}
+
+void writeMovingPattern(Yuv420PlanarBuf& buf, int frameIdx) {
+  for (uint32_t y = 0; y < buf.h; y++) {
+    for (uint32_t x = 0; x < buf.w; x++) {
+      buf.data[y * buf.rowBytes_y + x] = ((x + frameIdx * 8) / 64 + y / 64) % 2 ? 200 : 40;
+    }
+  }
+  memset(buf.getCbData(), 100 + frameIdx % 50, buf.calcChromaPlaneSize());
+  memset(buf.getCrData(), 160, buf.calcChromaPlaneSize());
+}
+
+int runDemo(Client& client, const std::vector<std::string>& args) {
+  const uint32_t w = std::atoi(getOptionValue(args, "-w", "1280").c_str());
+  const uint32_t h = std::atoi(getOptionValue(args, "-h", "720").c_str());
+  const int numFrames = std::max(1, std::atoi(getOptionValue(args, "--frames", "30").c_str()));
+  const std::filesystem::path outDir = getOptionValue(args, "--out");
+  const uint32_t inputW = 1280, inputH = 720;
+
+  const auto shmPrefix = "/vcsrender-client-" + std::to_string(getpid());
+  auto input = ShmYuvBuf::Create(shmPrefix + "-in0", inputW, inputH);
+  auto output = ShmYuvBuf::Create(shmPrefix + "-out", w, h);
+  if (!input || !output) {
+    return 1;
+  }
+
+  ScopedContext ctx(client, DaemonMessage("create_context").set("w", w).set("h", h));
+  const auto& ctxId = ctx.id;
+
+  DaemonMessage vl("set_video_layers");
+  vl.set("ctx", ctxId);
+  vl.payload = getOptionValue(args, "--vl").empty()
+    ? "[{\"type\":\"video\",\"id\":0,\"frame\":{\"x\":0,\"y\":0,\"w\":" + std::to_string(w)
+      + ",\"h\":" + std::to_string(h) + "},\"attrs\":{\"scaleMode\":\"fill\"}}]"
+    : readTextFile(getOptionValue(args, "--vl"));
+  client.request(vl);
+
+  if (!getOptionValue(args, "--fg").empty()) {
+    DaemonMessage fg("set_fg");
+    fg.set("ctx", ctxId);
+    fg.payload = readTextFile(getOptionValue(args, "--fg"));
+    client.request(fg);
+  }
+
+  client.request(DaemonMessage("set_input").set("ctx", ctxId).set("id", 0)
+                   .set("shm", input->name()).set("w", inputW).set("h", inputH));
+  client.request(DaemonMessage("set_output").set("ctx", ctxId).set("shm", output->name()));
+
+  if (!outDir.empty()) {
+    std::filesystem::create_directories(outDir);
+  }
+
+  std::vector<double> roundTrips;
+  int64_t renderUsAcc = 0;
+  for (int i = 0; i < numFrames; i++) {
+    writeMovingPattern(*input->buf(), i);
+
+    const double t0 = getMonotonicTime();
+    auto resp = client.request(DaemonMessage("render").set("ctx", ctxId).set("frame", i));
+    roundTrips.push_back(getMonotonicTime() - t0);
+    renderUsAcc += resp.getInt("render_us");
+
+    if (!outDir.empty()) {
+      std::stringstream fileName;
+      fileName << "vcsrenderout_" << std::setfill('0') << std::setw(4) << i << ".yuv";
+      std::ofstream os(outDir / fileName.str(), std::ios::binary);
+      auto buf = output->buf();
+      os.write((const char*)buf->data, buf->dataSize);
+    }
+  }
+
+  std::sort(roundTrips.begin(), roundTrips.end());
+  std::cout << "Rendered " << numFrames << " frames at " << w << "x" << h << " through shared memory: "
+            << std::fixed << std::setprecision(2) << "avg composite " << renderUsAcc / 1000.0 / numFrames
+            << " ms, median round trip " << roundTrips[roundTrips.size() / 2] * 1000 << " ms" << std::endl;
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  std::string socketPath = kDefaultDaemonSocketPath;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--socket" && i + 1 < argc) {
+      socketPath = argv[++i];
+    } else {
+      args.push_back(arg);
+    }
+  }
+  if (args.empty()) {
+    std::cerr << "Usage: vcsrender_client [--socket path] send|job|demo ..." << std::endl;
+    return 1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+
+  Client client;
+  if (!client.connect(socketPath)) {
+    return 1;
+  }
+
+  const std::string mode = args[0];
+  const std::vector<std::string> modeArgs(args.begin() + 1, args.end());
+  try {
+    if (mode == "send") return runSend(client, modeArgs);
+    if (mode == "job") return runJob(client, modeArgs);
+    if (mode == "demo") return runDemo(client, modeArgs);
+  } catch (std::exception& e) {
+    std::cerr << "** " << e.what() << std::endl;
+    return 2;
+  }
+  std::cerr << "Unknown mode: " << mode << std::endl;
+  return 1;
+}
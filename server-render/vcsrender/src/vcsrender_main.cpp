@@ -1,4 +1,6 @@
 #include <cxx_argp/cxx_argp_application.h>
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <optional>
 #include <mutex>
@@ -6,6 +8,9 @@
 #include "imageseq.h"
 #include "sceneseq.h"
 #include "yuv_compositor.h"
+#include "frame_stats.h"
+#include "frame_hash.h"
+#include "trace.h"
 #include "yuvbuf.h"
 #include "file_util.h"
 #include "time_util.h"
@@ -52,6 +57,16 @@ vcsrender --oseq [output_seq] \
           --input_timings [path_to_input_timings_json]
 
     (in this mode duration isn't needed because the input_timings data is expected to include this value)
+
+Static stretches (title cards, paused screenshares, slides) can be rendered once with --elide_repeats.
+Each frame then gets a fingerprint of its inputs before rendering: the scene JSON in effect and
+the content of each video input frame. A frame whose fingerprint matches the previous frame's
+isn't composited, and its output file is a hard link to the previous output.
+Frames where the compositor still has a foreground update to draw (images that were decoding,
+new shared memory frames) are always rendered.
+
+--manifest writes the content hash of each output frame, in the "<hash>  <file name>" layout
+of sha256sum, so renders can be compared by diffing manifests.
 */
 
 
@@ -80,6 +95,23 @@ class VcsRenderApp : public cxx_argp::application
     
     std::vector<SceneDescAtFrame> sceneDescs;
     std::unique_ptr<SceneJsonSequence> batchJsonSeq;
+
+    // Skia cache settings, zero keeps the defaults
+    uint32_t skiaFontCacheMB = 0;
+    uint32_t skiaResourceCacheMB = 0;
+    uint32_t purgeSkiaCachesIntervalFrames = 0;
+
+    // per-frame stats output, CSV if the name ends in .csv and JSON lines otherwise
+    std::string frameStatsPath;
+
+    // Chrome trace JSON output
+    std::string tracePath;
+
+    // skip rendering frames whose inputs are the same as the previous frame's
+    bool elideRepeats = false;
+
+    // per-frame output hashes
+    std::string manifestPath;
   } args_;
 
   // state during arg parsing
@@ -97,6 +129,10 @@ class VcsRenderApp : public cxx_argp::application
 
   size_t sceneDescCursor_ = 0;
 
+  // hashes of the scene JSON applied to the compositor, part of each frame's fingerprint
+  uint64_t vlSceneHash_ = 0;
+  uint64_t fgSceneHash_ = 0;
+
   bool check_arguments() override
   {
     if (args_.outputSeqPath.empty()) {
@@ -124,6 +160,9 @@ class VcsRenderApp : public cxx_argp::application
     const std::string canvexResDir = "";
     comp_ = std::make_unique<YuvCompositor>(args_.outputW, args_.outputH, canvexResDir);
 
+    CanvexSetSkiaCacheLimits((int64_t)args_.skiaFontCacheMB * 1024 * 1024, 0,
+                             (int64_t)args_.skiaResourceCacheMB * 1024 * 1024);
+
     // -- set up video inputs
     /*if (0) {
       // DEBUG: add a bunch of Big Buck Bunnies as test inputs
@@ -206,15 +245,61 @@ class VcsRenderApp : public cxx_argp::application
   }
 
   int renderLoop() {
+    std::ofstream frameStatsFile;
+    bool frameStatsCsv = false;
+    if (!args_.frameStatsPath.empty()) {
+      frameStatsFile.open(args_.frameStatsPath);
+      if (!frameStatsFile) {
+        std::cerr << "** Unable to open frame stats file for writing: " << args_.frameStatsPath << std::endl;
+        return 1;
+      }
+      frameStatsCsv = std::filesystem::path(args_.frameStatsPath).extension() == ".csv";
+      if (frameStatsCsv) {
+        WriteFrameStatsCsvHeader(frameStatsFile);
+      }
+    }
+
+    std::ofstream manifestFile;
+    if (!args_.manifestPath.empty()) {
+      manifestFile.open(args_.manifestPath);
+      if (!manifestFile) {
+        std::cerr << "** Unable to open manifest file for writing: " << args_.manifestPath << std::endl;
+        return 1;
+      }
+    }
+
+    if (!args_.tracePath.empty()) {
+      Tracer::start();
+      Tracer::setThreadName("render");
+    }
+
     double tStart = getMonotonicTime();
     double renderTimeAcc_s = 0.0;
+    size_t numTimedRenders = 0; // renders in renderTimeAcc_s
+
+    // the previous output frame, for repeats
+    std::optional<uint64_t> prevFingerprint;
+    std::filesystem::path prevOutputPath;
+    uint64_t prevOutputHash = 0;
+    size_t numRepeats = 0;
 
     const auto numFrames = inputTimings_->durationInFrames;
     const auto startFrame = inputTimings_->startFrame;
 
+    auto writeFrameStats = [&](uint64_t frameIdx, const FrameRenderStats& stats) {
+      if (!frameStatsFile.is_open()) return;
+      if (frameStatsCsv) {
+        WriteFrameStatsCsvRow(frameStatsFile, frameIdx, stats);
+      } else {
+        WriteFrameStatsJsonLine(frameStatsFile, frameIdx, stats);
+      }
+    };
+
     // we start at 0 so we can load the JSON batch state that needs to be in place
     // when we actually render output from startFrame onwards
     for (size_t frameIdx = 0; frameIdx < startFrame + numFrames; frameIdx++) {
+      VCS_TRACE_SCOPE("frame", "frame", frameIdx);
+
       SceneDescAtFrame readSd;
       SceneDescAtFrame* sd = nullptr;
       if (args_.batchJsonSeq) {
@@ -235,14 +320,17 @@ class VcsRenderApp : public cxx_argp::application
 
       if (sd && (sd->json_vl || sd->json_fg)) {
         std::cout << "applying scene desc at frame " << frameIdx << std::endl;
+        VCS_TRACE_SCOPE("scene apply");
 
         //const double t0 = getMonotonicTime();
 
         if (sd->json_vl) {
           comp_->setVideoLayersJSON(*sd->json_vl, sd->layerScale);
+          vlSceneHash_ = FrameHasher().add(*sd->json_vl).add(sd->layerScale).value();
         }
         if (sd->json_fg) {
           comp_->setFgDisplayListJSON(*sd->json_fg);
+          fgSceneHash_ = FrameHasher().add(*sd->json_fg).value();
         }
 
         //const double timeSpent_sceneDescJson = getMonotonicTime() - t0;
@@ -267,7 +355,46 @@ class VcsRenderApp : public cxx_argp::application
         // generated by the VCS batch runner.
         inputBufs[i] = args_.inputSeqs[i]->readYuv420ForFrame(frameIdx);
       }*/
+      TraceScope inputTrace("input read");
       auto inputBufs = inputLoader_->readInputBufsAtFrame(frameIdxInSegment);
+      inputTrace.end();
+
+      const auto dstPath = makeOutputFilePath(frameIdxInSegment);
+
+      // an earlier render may have hard-linked this file with others, so it's replaced rather than overwritten
+      std::error_code removeErr;
+      std::filesystem::remove(dstPath, removeErr);
+
+      if (args_.elideRepeats) {
+        TraceScope fingerprintTrace("fingerprint");
+        const uint64_t fingerprint = frameFingerprint(inputBufs);
+        fingerprintTrace.end();
+
+        // the compositor may also draw something new with the same inputs, e.g. an image that finished decoding
+        const bool isRepeat = prevFingerprint && *prevFingerprint == fingerprint && !comp_->hasPendingFgUpdate();
+        prevFingerprint = fingerprint;
+
+        if (isRepeat) {
+          std::cout << "-- repeating frame " << frameIdx
+                    << (frameIdx < numFrames - 1 ? "        \r" : "\r\n") << std::flush;
+
+          if (!linkRepeatedOutput(prevOutputPath, dstPath)) {
+            writeTraceFile();
+            return 2;
+          }
+          numRepeats++;
+
+          FrameRenderStats elidedStats;
+          elidedStats.elided = true;
+          writeFrameStats(frameIdx, elidedStats);
+
+          if (manifestFile.is_open()) {
+            manifestFile << FormatFrameHash(prevOutputHash) << "  " << dstPath.filename().string() << "\n";
+          }
+          if (interrupted()) break;
+          continue;
+        }
+      }
 
       std::cout << "-- rendering frame " << frameIdx << "...";
 
@@ -277,42 +404,129 @@ class VcsRenderApp : public cxx_argp::application
 
       const double timeSpent_render = getMonotonicTime() - t0;
 
+      // the first frame is left out of the average, since it includes one-time setup
       if (frameIdx > 0) {
         renderTimeAcc_s += timeSpent_render;
+        numTimedRenders++;
       }
 
       std::cout << " " << (timeSpent_render * 1000) << " ms";
 
+      writeFrameStats(frameIdx, comp_->lastFrameStats());
+
       // rewind console output if not last frame
       std::cout << (frameIdx < numFrames - 1 ? "        \r" : "\r\n") << std::flush;
 
-      const auto dstPath = makeOutputFilePath(frameIdxInSegment);
+      TraceScope outputWriteTrace("output write");
       auto dstFile = fopen(dstPath.c_str(), "wb");
       auto writeResult = fwrite(renderResult->data, renderResult->dataSize, 1, dstFile);
       fclose(dstFile);
+      outputWriteTrace.end();
 
       if (1 != writeResult) {
         std::cerr << "Write failed to: " << dstPath << std::endl;
+        writeTraceFile();
         return 2;
       }
+      prevOutputPath = dstPath;
+
+      if (manifestFile.is_open()) {
+        TraceScope hashTrace("output hash");
+        prevOutputHash = HashYuv420Frame(*renderResult);
+        manifestFile << FormatFrameHash(prevOutputHash) << "  " << dstPath.filename().string() << "\n";
+      }
+
+      if (args_.purgeSkiaCachesIntervalFrames > 0 && (frameIdxInSegment + 1) % args_.purgeSkiaCachesIntervalFrames == 0) {
+        CanvexPurgeSkiaCaches();
+      }
 
       if (interrupted()) break;
     }
 
     double tEnd = getMonotonicTime();
 
+    writeTraceFile();
+
     if (interrupted()) {
       std::cerr << "Interrupted." << std::endl;
       return 1;
     }
 
-    std::cout << "\nAvg composite per frame: " << (renderTimeAcc_s / (numFrames - 1) * 1000) << " ms" << std::endl;
+    // repeated frames aren't rendered, so they're not in the composite average
+    std::cout << std::endl;
+    if (numTimedRenders > 0) {
+      std::cout << "Avg composite per frame: " << (renderTimeAcc_s / numTimedRenders * 1000) << " ms" << std::endl;
+    }
 
     std::cout << "Avg total per frame: " << ((tEnd - tStart) / numFrames * 1000) << " ms" << std::endl;
 
+    if (args_.elideRepeats) {
+      std::cout << "Repeated frames not rendered: " << numRepeats << " of " << numFrames << std::endl;
+    }
+    if (manifestFile.is_open()) {
+      std::cout << "Wrote manifest to " << args_.manifestPath << std::endl;
+    }
+
+    CanvexSkiaCacheStats skiaStats{};
+    CanvexGetSkiaCacheStats(&skiaStats);
+    std::cout << "Skia font cache: " << skiaStats.font_cache_bytes_used / 1024 << " / "
+              << skiaStats.font_cache_bytes_limit / 1024 << " kB, "
+              << skiaStats.font_cache_count_used << " strikes; resource cache: "
+              << skiaStats.resource_cache_bytes_used / 1024 << " / "
+              << skiaStats.resource_cache_bytes_limit / 1024 << " kB; text blob hits "
+              << skiaStats.text_blob_cache_hits << ", misses " << skiaStats.text_blob_cache_misses
+              << "; purges " << skiaStats.num_purges << std::endl;
+
     return 0;
   }
 
+  // identifies everything the rendered frame depends on, so equal fingerprints mean equal output.
+  // inputs are hashed by content, since a still image arrives as a new file on each frame.
+  uint64_t frameFingerprint(const VideoInputBufsById& inputBufs) {
+    FrameHasher hasher;
+    hasher.add(vlSceneHash_).add(fgSceneHash_);
+
+    std::vector<uint32_t> inputIds;
+    for (const auto& kv : inputBufs) {
+      inputIds.push_back(kv.first);
+    }
+    std::sort(inputIds.begin(), inputIds.end());
+
+    for (auto id : inputIds) {
+      hasher.add((uint64_t)id);
+      const auto& buf = inputBufs.at(id);
+      if (buf) {
+        hasher.addYuv420(*buf);
+      } else {
+        hasher.add((uint64_t)0);
+      }
+    }
+    return hasher.value();
+  }
+
+  bool linkRepeatedOutput(const std::filesystem::path& srcPath, const std::filesystem::path& dstPath) {
+    std::error_code ec;
+    std::filesystem::create_hard_link(srcPath, dstPath, ec);
+    if (ec) {
+      // e.g. a filesystem without hard links
+      std::filesystem::copy_file(srcPath, dstPath, std::filesystem::copy_options::overwrite_existing, ec);
+    }
+    if (ec) {
+      std::cerr << "Write failed to: " << dstPath << " (" << ec.message() << ")" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  void writeTraceFile() {
+    if (args_.tracePath.empty()) return;
+
+    // the frame scope still open when a write fails isn't included
+    if (Tracer::stopAndWrite(args_.tracePath)) {
+      std::cout << "Wrote trace to " << args_.tracePath << std::endl;
+    }
+  }
+
   std::filesystem::path makeOutputFilePath(size_t frameIdx) {
     const int numDigits = 4;
     const std::string fileExt = "yuv";
@@ -357,6 +571,41 @@ public:
                            "Output duration in frames", 0},
                           args_.durationInFrames);
 
+    arg_parser.add_option({"skia_font_cache_mb",
+                           1002, "megabytes", 0,
+                           "Byte limit of Skia's glyph cache, shared by all graphics", 0},
+                          args_.skiaFontCacheMB);
+
+    arg_parser.add_option({"skia_resource_cache_mb",
+                           1003, "megabytes", 0,
+                           "Byte limit of Skia's resource cache", 0},
+                          args_.skiaResourceCacheMB);
+
+    arg_parser.add_option({"purge_skia_caches_every",
+                           1004, "frames", 0,
+                           "Purge Skia's caches at this interval (e.g. to test recovery from a purge)", 0},
+                          args_.purgeSkiaCachesIntervalFrames);
+
+    arg_parser.add_option({"frame_stats",
+                           1005, "path", 0,
+                           "Write render stats for each frame to this file, as CSV if it ends in .csv and otherwise as JSON lines", 0},
+                          args_.frameStatsPath);
+
+    arg_parser.add_option({"trace",
+                           1006, "path", 0,
+                           "Record trace events of the render and write them as Chrome trace JSON (for chrome://tracing or Perfetto)", 0},
+                          args_.tracePath);
+
+    arg_parser.add_option({"elide_repeats",
+                           1007, nullptr, 0,
+                           "Don't render frames whose inputs are the same as the previous frame's, and hard-link their output to the previous frame's instead (these frames have no frame stats)", 0},
+                          args_.elideRepeats);
+
+    arg_parser.add_option({"manifest",
+                           1008, "path", 0,
+                           "Write the content hash of each output frame to this file, for comparing renders", 0},
+                          args_.manifestPath);
+
     arg_parser.add_option({"iw",
                            1000, "input-w", 0,
                            "Input width applied to next --iseq argument", 0},
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "frame_ring.h"
+
+/*
+  Latency benchmark for passing frames between processes.
+
+  A forked producer process writes frames and the parent consumes them, through:
+    - ring: the shared-memory frame ring. The producer writes into the slot in place,
+      and the consumer reads the slot in place.
+    - pipe: a pipe carrying whole frames, i.e. what a transport that copies frames through the kernel costs.
+
+  Latency is measured from the producer's publish (or the start of its write, for the pipe)
+  to the consumer having the frame, on CLOCK_MONOTONIC which both processes share.
+  The consumer touches one byte per cache line of each frame, as a renderer reading it would.
+  The producer runs flat out, so with more slots the latency also includes the time frames
+  queue in a full ring; the 2-slot figures are closest to the transport's own cost.
+
+  Usage:
+    vcsrender_ring_bench [-n frames] [-s slots,...] [--sizes WxH,...]
+*/
+
+using namespace vcsrender;
+
+namespace {
+
+struct BenchResult {
+  std::string transport;
+  uint32_t w, h;
+  uint32_t slots;
+  int numFrames;
+  double seconds;
+  std::vector<int64_t> latenciesNs;
+  uint64_t checksum;
+};
+
+void fillFrame(uint8_t* data, uint32_t rowBytesY, uint32_t w, uint32_t h, uint64_t frameIdx) {
+  // only the luma rows need to be written to make the frame's pages dirty on each pass
+  for (uint32_t y = 0; y < h; y++) {
+    memset(data + (size_t)y * rowBytesY, (frameIdx + y) & 0xff, w);
+  }
+}
+
+uint64_t touchFrame(const uint8_t* data, size_t size) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < size; i += 64) {
+    sum += data[i];
+  }
+  return sum;
+}
+
+int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t idx = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+  return sorted[idx];
+}
+
+bool runRing(uint32_t w, uint32_t h, uint32_t slots, int numFrames, BenchResult& result) {
+  auto ring = FrameRing::Create(w, h, slots);
+  if (!ring) return false;
+
+  const auto& hdr = ring->header();
+  const size_t frameSize = (size_t)hdr.rowBytesY * h + 2 * (size_t)hdr.rowBytesCh * ((h + 1) / 2);
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    std::cerr << "** fork failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  if (pid == 0) {
+    // the child maps the ring through the inherited descriptor, as a separate producer process would
+    auto producer = FrameRing::Open(ring->fd());
+    if (!producer) _exit(1);
+    for (int i = 0; i < numFrames; i++) {
+      FrameRingPlanes planes;
+      if (producer->acquireWrite(planes, 5000) != FrameRingWait::Ok) _exit(2);
+      fillFrame(planes.data, planes.rowBytesY, planes.w, planes.h, i);
+      producer->publish(i, 1);
+    }
+    producer->close();
+    _exit(0);
+  }
+
+  result.latenciesNs.reserve(numFrames);
+  result.checksum = 0;
+  const int64_t t0 = FrameRing::NowNs();
+  int received = 0;
+  for (;;) {
+    FrameRingPlanes planes;
+    FrameRingSlotMeta meta;
+    auto res = ring->acquireRead(planes, meta, 5000);
+    if (res != FrameRingWait::Ok) break;
+    result.latenciesNs.push_back(FrameRing::NowNs() - meta.publishTimeNs);
+    result.checksum += touchFrame(planes.data, frameSize);
+    ring->release();
+    received++;
+  }
+  result.seconds = (FrameRing::NowNs() - t0) / 1e9;
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (received != numFrames || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::cerr << "** Ring producer failed after " << received << " frames" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool writeAll(int fd, const uint8_t* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool readAll(int fd, uint8_t* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = read(fd, data, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool runPipe(uint32_t w, uint32_t h, int numFrames, BenchResult& result) {
+  const uint32_t rowBytesY = w;
+  const size_t frameSize = (size_t)w * h + 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    std::cerr << "** fork failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    std::vector<uint8_t> frame(sizeof(int64_t) + frameSize);
+    for (int i = 0; i < numFrames; i++) {
+      uint8_t* data = frame.data() + sizeof(int64_t);
+      fillFrame(data, rowBytesY, w, h, i);
+      // the timestamp is taken after filling, to match the ring's publish
+      const int64_t t = FrameRing::NowNs();
+      memcpy(frame.data(), &t, sizeof(t));
+      if (!writeAll(fds[1], frame.data(), frame.size())) _exit(2);
+    }
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+
+  std::vector<uint8_t> frame(sizeof(int64_t) + frameSize);
+  result.latenciesNs.reserve(numFrames);
+  result.checksum = 0;
+  const int64_t t0 = FrameRing::NowNs();
+  int received = 0;
+  while (readAll(fds[0], frame.data(), frame.size())) {
+    int64_t t;
+    memcpy(&t, frame.data(), sizeof(t));
+    result.latenciesNs.push_back(FrameRing::NowNs() - t);
+    result.checksum += touchFrame(frame.data() + sizeof(int64_t), frameSize);
+    received++;
+  }
+  result.seconds = (FrameRing::NowNs() - t0) / 1e9;
+  close(fds[0]);
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (received != numFrames || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::cerr << "** Pipe producer failed after " << received << " frames" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void printResult(BenchResult& r) {
+  std::sort(r.latenciesNs.begin(), r.latenciesNs.end());
+  std::cout << std::left << std::setw(6) << r.transport
+            << std::setw(11) << (std::to_string(r.w) + "x" + std::to_string(r.h))
+            << std::right << std::setw(6) << (r.slots ? std::to_string(r.slots) : "-")
+            << std::fixed << std::setprecision(1)
+            << std::setw(10) << r.numFrames / r.seconds
+            << std::setw(10) << percentile(r.latenciesNs, 0.5) / 1000.0
+            << std::setw(10) << percentile(r.latenciesNs, 0.99) / 1000.0
+            << std::setw(10) << r.latenciesNs.back() / 1000.0
+            << std::endl;
+}
+
+std::vector<std::string> splitList(const std::string& s) {
+  std::vector<std::string> items;
+  size_t start = 0;
+  while (start <= s.size()) {
+    size_t end = s.find(',', start);
+    if (end == std::string::npos) end = s.size();
+    if (end > start) items.push_back(s.substr(start, end - start));
+    start = end + 1;
+  }
+  return items;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  int numFrames = 300;
+  std::vector<uint32_t> slotCounts = {2, 4, 8};
+  std::vector<std::pair<uint32_t, uint32_t>> sizes = {{1920, 1080}, {3840, 2160}};
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-n" && i + 1 < argc) {
+      numFrames = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "-s" && i + 1 < argc) {
+      slotCounts.clear();
+      for (const auto& item : splitList(argv[++i])) {
+        slotCounts.push_back(std::atoi(item.c_str()));
+      }
+    } else if (arg == "--sizes" && i + 1 < argc) {
+      sizes.clear();
+      for (const auto& item : splitList(argv[++i])) {
+        uint32_t w = 0, h = 0;
+        if (sscanf(item.c_str(), "%ux%u", &w, &h) != 2) {
+          std::cerr << "Invalid size: " << item << std::endl;
+          return 1;
+        }
+        sizes.push_back({w, h});
+      }
+    } else {
+      std::cerr << "Usage: vcsrender_ring_bench [-n frames] [-s slots,...] [--sizes WxH,...]" << std::endl;
+      return 1;
+    }
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+
+  std::cout << std::left << std::setw(6) << "mode" << std::setw(11) << "size"
+            << std::right << std::setw(6) << "slots" << std::setw(10) << "fps"
+            << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us"
+            << std::endl;
+
+  for (const auto& size : sizes) {
+    for (uint32_t slots : slotCounts) {
+      BenchResult r{"ring", size.first, size.second, slots, numFrames, 0, {}, 0};
+      if (!runRing(size.first, size.second, slots, numFrames, r)) return 2;
+      printResult(r);
+    }
+    BenchResult r{"pipe", size.first, size.second, 0, numFrames, 0, {}, 0};
+    if (!runPipe(size.first, size.second, numFrames, r)) return 2;
+    printResult(r);
+  }
+  return 0;
+}
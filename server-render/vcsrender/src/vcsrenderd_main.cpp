@@ -0,0 +1,469 @@
+#include <cxx_argp/cxx_argp_application.h>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "daemon_protocol.h"
+#include "frame_stats.h"
+#include "inputloader.h"
+#include "sceneseq.h"
+#include "yuv_compositor.h"
+#include "file_util.h"
+#include "time_util.h"
+#include "parse/parse_inputtimings.h"
+
+/*
+
+`vcsrenderd` is a long-running render daemon for the many short renders of previews,
+so that each one doesn't pay for creating a compositor, loading fonts and warming caches.
+
+It listens on a Unix domain socket (see daemon_protocol.h for the message format).
+The socket is only accessible to the user running the daemon, and connections from
+other users are rejected, since requests can read and write files with the daemon's permissions.
+
+Clients create render contexts, each of which keeps its compositor and caches until it's destroyed
+or the connection that created it closes. A context can only be used on its own connection.
+Requests are handled one at a time in arrival order.
+
+Requests:
+
+  hello                                 -> ok version=<n>
+  create_context w=<px> h=<px>          -> ok ctx=<id>
+  destroy_context ctx=<id>
+  set_video_layers ctx=<id> [scale=<f>] + video layers JSON payload
+  set_fg ctx=<id>                       + foreground display list JSON payload
+  set_input ctx=<id> id=<input id> shm=<name> w=<px> h=<px>
+      registers a shared memory I420 frame as a video input; the client rewrites it between renders
+  remove_input ctx=<id> id=<input id>
+  set_output ctx=<id> shm=<name>        shared memory I420 frame that renders are copied into
+  render ctx=<id> frame=<n>             -> ok render_us=<us> total_us=<us>
+      composites the registered inputs into the output frame
+  job ctx=<id> oseq=<dir> [jsonseq=<dir>] [input_timings=<path>] [frames=<n>]
+      renders a frame range from files like the vcsrender CLI, writing a YUV sequence into oseq
+      -> ok frames=<n> avg_render_us=<us>
+  stats ctx=<id>                        -> ok + the last frame's stats as a JSON line
+  shutdown
+
+Usage example:
+
+vcsrenderd --socket /tmp/vcsrenderd.sock
+vcsrender_client --socket /tmp/vcsrenderd.sock demo -w 1280 -h 720 --fg graphics.json --frames 30
+
+*/
+
+
+CXX_ARGP_APPLICATION_BOILERPLATE;
+
+
+using namespace vcsrender;
+
+
+class VcsRenderDaemon : public cxx_argp::application
+{
+  struct {
+    std::string socketPath = kDefaultDaemonSocketPath;
+    uint32_t maxContexts = 16;
+  } args_;
+
+  struct RenderContext {
+    uint32_t w;
+    uint32_t h;
+    std::unique_ptr<YuvCompositor> comp;
+    std::map<uint32_t, std::unique_ptr<ShmYuvBuf>> inputs;
+    std::unique_ptr<ShmYuvBuf> output;
+    int connFd; // the connection that created the context, which owns it
+  };
+
+  struct Connection {
+    int fd;
+    std::unique_ptr<DaemonMessageReader> reader;
+  };
+
+  int listenFd_ = -1;
+  std::vector<Connection> connections_;
+  std::map<uint32_t, std::unique_ptr<RenderContext>> contexts_;
+  uint32_t nextContextId_ = 1;
+  bool shutdownRequested_ = false;
+
+  bool check_arguments() override
+  {
+    if (args_.socketPath.empty()) {
+      std::cerr << "Must provide socket path" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  int main() override {
+    // a client that disconnects mid-response shouldn't end the daemon
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!listen()) {
+      return 1;
+    }
+    std::cout << "vcsrenderd listening on " << args_.socketPath << std::endl;
+
+    const int ret = serveLoop();
+
+    for (auto& conn : connections_) {
+      close(conn.fd);
+    }
+    close(listenFd_);
+    unlink(args_.socketPath.c_str());
+    contexts_.clear();
+
+    std::cout << "vcsrenderd exiting" << std::endl;
+    return ret;
+  }
+
+  bool listen() {
+    sockaddr_un addr{};
+    if (args_.socketPath.size() >= sizeof(addr.sun_path)) {
+      std::cerr << "** Socket path is too long: " << args_.socketPath << std::endl;
+      return false;
+    }
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, args_.socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd_ < 0) {
+      std::cerr << "** Unable to create socket: " << strerror(errno) << std::endl;
+      return false;
+    }
+    fcntl(listenFd_, F_SETFD, FD_CLOEXEC);
+
+    // a socket file left behind by a daemon that didn't exit cleanly would make bind() fail
+    if (std::filesystem::is_socket(args_.socketPath)) {
+      int probeFd = ConnectDaemonSocket(args_.socketPath);
+      if (probeFd >= 0) {
+        close(probeFd);
+        std::cerr << "** Another daemon is already listening on " << args_.socketPath << std::endl;
+        return false;
+      }
+      unlink(args_.socketPath.c_str());
+    }
+
+    // the socket file is created with permissions for the owner only
+    const mode_t oldMask = umask(0177);
+    const bool bound = bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) == 0;
+    umask(oldMask);
+
+    if (!bound || ::listen(listenFd_, 16) != 0) {
+      std::cerr << "** Unable to listen on " << args_.socketPath << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  int serveLoop() {
+    while (!shutdownRequested_ && !interrupted()) {
+      std::vector<pollfd> fds;
+      fds.push_back({listenFd_, POLLIN, 0});
+      for (const auto& conn : connections_) {
+        fds.push_back({conn.fd, POLLIN, 0});
+      }
+
+      if (poll(fds.data(), fds.size(), -1) < 0) {
+        if (errno == EINTR) continue;
+        std::cerr << "** poll failed: " << strerror(errno) << std::endl;
+        return 1;
+      }
+
+      // handle requests from existing connections first, as accepting may reallocate connections_
+      std::vector<int> closedFds;
+      for (size_t i = 1; i < fds.size(); i++) {
+        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+        auto& conn = connections_[i - 1];
+        DaemonMessage request;
+        bool closed = false;
+        while (conn.reader->readAvailable(request, closed)) {
+          if (!WriteDaemonMessage(conn.fd, handleRequest(request, conn.fd))) {
+            closed = true;
+            break;
+          }
+          if (shutdownRequested_) break;
+        }
+        if (closed) {
+          closedFds.push_back(conn.fd);
+        }
+      }
+      for (int fd : closedFds) {
+        destroyConnectionContexts(fd);
+        close(fd);
+        connections_.erase(std::remove_if(connections_.begin(), connections_.end(),
+                                          [fd](const Connection& c) { return c.fd == fd; }),
+                           connections_.end());
+      }
+
+      if (fds[0].revents & POLLIN) {
+        int fd = accept(listenFd_, nullptr, nullptr);
+        if (fd >= 0) {
+          // some systems don't enforce the socket file's permissions, so check who's connecting too
+          uid_t peerUid;
+          if (!GetDaemonPeerUid(fd, peerUid) || peerUid != geteuid()) {
+            std::cerr << "** Rejected connection from another user" << std::endl;
+            close(fd);
+          } else {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            connections_.push_back({fd, std::make_unique<DaemonMessageReader>(fd)});
+          }
+        }
+      }
+    }
+    return 0;
+  }
+
+  void destroyConnectionContexts(int connFd) {
+    for (auto it = contexts_.begin(); it != contexts_.end();) {
+      if (it->second->connFd == connFd) {
+        std::cout << "Destroyed context " << it->first << " of closed connection" << std::endl;
+        it = contexts_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  DaemonMessage handleRequest(const DaemonMessage& req, int connFd) {
+    try {
+      if (req.command == "hello") {
+        return DaemonMessage("ok").set("version", kDaemonProtocolVersion);
+      }
+      if (req.command == "create_context") {
+        return createContext(req, connFd);
+      }
+      if (req.command == "shutdown") {
+        shutdownRequested_ = true;
+        return DaemonMessage("ok");
+      }
+
+      auto& ctx = getContext(req, connFd);
+      if (req.command == "destroy_context") {
+        contexts_.erase(req.getInt("ctx"));
+        return DaemonMessage("ok");
+      }
+      if (req.command == "set_video_layers") {
+        if (!ctx.comp->setVideoLayersJSON(req.payload, req.getDouble("scale", 1.0))) {
+          return DaemonMessage::error("Invalid video layers JSON");
+        }
+        return DaemonMessage("ok");
+      }
+      if (req.command == "set_fg") {
+        if (!ctx.comp->setFgDisplayListJSON(req.payload)) {
+          return DaemonMessage::error("Invalid foreground display list JSON");
+        }
+        return DaemonMessage("ok");
+      }
+      if (req.command == "set_input") {
+        return setInput(ctx, req);
+      }
+      if (req.command == "remove_input") {
+        ctx.inputs.erase(req.getInt("id"));
+        return DaemonMessage("ok");
+      }
+      if (req.command == "set_output") {
+        auto output = ShmYuvBuf::Open(req.getString("shm"), ctx.w, ctx.h);
+        if (!output) {
+          return DaemonMessage::error("Unable to open output shared memory " + req.getString("shm")
+                                      + " as a " + std::to_string(ctx.w) + "x" + std::to_string(ctx.h) + " frame");
+        }
+        ctx.output = std::move(output);
+        return DaemonMessage("ok");
+      }
+      if (req.command == "render") {
+        return renderFrame(ctx, req);
+      }
+      if (req.command == "job") {
+        return runJob(ctx, req);
+      }
+      if (req.command == "stats") {
+        std::stringstream ss;
+        WriteFrameStatsJsonLine(ss, req.getInt("frame", 0), ctx.comp->lastFrameStats());
+        DaemonMessage resp("ok");
+        resp.payload = ss.str();
+        return resp;
+      }
+      return DaemonMessage::error("Unknown command: " + req.command);
+    } catch (std::exception& e) {
+      return DaemonMessage::error(e.what());
+    }
+  }
+
+  RenderContext& getContext(const DaemonMessage& req, int connFd) {
+    if (!req.has("ctx")) {
+      throw std::runtime_error("Missing ctx for " + req.command);
+    }
+    auto it = contexts_.find(req.getInt("ctx"));
+    if (it == contexts_.end() || it->second->connFd != connFd) {
+      throw std::runtime_error("No such context: " + req.getString("ctx"));
+    }
+    return *it->second;
+  }
+
+  DaemonMessage createContext(const DaemonMessage& req, int connFd) {
+    const auto w = req.getInt("w", 1920);
+    const auto h = req.getInt("h", 1080);
+    if (w < 2 || h < 2 || w > 8192 || h > 8192) {
+      return DaemonMessage::error("Invalid context size");
+    }
+    if (contexts_.size() >= args_.maxContexts) {
+      return DaemonMessage::error("Too many render contexts (destroy unused ones first)");
+    }
+
+    auto ctx = std::make_unique<RenderContext>();
+    ctx->w = w;
+    ctx->h = h;
+    ctx->connFd = connFd;
+    ctx->comp = std::make_unique<YuvCompositor>(w, h, req.getString("res_dir"));
+
+    const uint32_t id = nextContextId_++;
+    contexts_[id] = std::move(ctx);
+    std::cout << "Created context " << id << " (" << w << "x" << h << ")" << std::endl;
+    return DaemonMessage("ok").set("ctx", id);
+  }
+
+  DaemonMessage setInput(RenderContext& ctx, const DaemonMessage& req) {
+    const auto inputId = req.getInt("id", -1);
+    const auto w = req.getInt("w");
+    const auto h = req.getInt("h");
+    if (inputId < 0 || w < 2 || h < 2 || w > 8192 || h > 8192) {
+      return DaemonMessage::error("Invalid input id or size");
+    }
+    auto input = ShmYuvBuf::Open(req.getString("shm"), w, h);
+    if (!input) {
+      return DaemonMessage::error("Unable to open input shared memory " + req.getString("shm"));
+    }
+    ctx.inputs[inputId] = std::move(input);
+    return DaemonMessage("ok");
+  }
+
+  VideoInputBufsById registeredInputBufs(const RenderContext& ctx) {
+    VideoInputBufsById bufs;
+    for (const auto& kv : ctx.inputs) {
+      bufs[kv.first] = kv.second->buf();
+    }
+    return bufs;
+  }
+
+  DaemonMessage renderFrame(RenderContext& ctx, const DaemonMessage& req) {
+    if (!ctx.output) {
+      return DaemonMessage::error("No output set for context");
+    }
+    const double t0 = getMonotonicTime();
+
+    auto result = ctx.comp->renderFrame(req.getInt("frame", 0), registeredInputBufs(ctx));
+    const double t1 = getMonotonicTime();
+
+    ctx.output->buf()->copyFrom(*result);
+    const double t2 = getMonotonicTime();
+
+    return DaemonMessage("ok")
+      .set("render_us", (int64_t)((t1 - t0) * 1.0e6))
+      .set("total_us", (int64_t)((t2 - t0) * 1.0e6));
+  }
+
+  // same frame loop as the vcsrender CLI, with the context's retained compositor
+  DaemonMessage runJob(RenderContext& ctx, const DaemonMessage& req) {
+    const std::filesystem::path outputSeqDir = req.getString("oseq");
+    if (outputSeqDir.empty()) {
+      return DaemonMessage::error("Missing oseq for job");
+    }
+
+    std::unique_ptr<VCSVideoInputTimingsDesc> inputTimings;
+    if (req.has("input_timings")) {
+      inputTimings = ParseVCSVideoInputTimingsDescJSON(readTextFile(req.getString("input_timings")));
+    } else {
+      inputTimings = std::make_unique<VCSVideoInputTimingsDesc>();
+      inputTimings->durationInFrames = req.getInt("frames", 1);
+    }
+    if (inputTimings->durationInFrames < 1) {
+      return DaemonMessage::error("Job duration must be >0");
+    }
+
+    VideoInputLoader inputLoader(*inputTimings);
+    if (!inputLoader.start()) {
+      return DaemonMessage::error("Unable to start video input loader");
+    }
+
+    std::unique_ptr<SceneJsonSequence> sceneSeq;
+    if (req.has("jsonseq")) {
+      sceneSeq = SceneJsonSequence::createFromDir(req.getString("jsonseq"));
+    }
+
+    std::filesystem::create_directories(outputSeqDir);
+
+    const auto startFrame = inputTimings->startFrame;
+    const auto numFrames = inputTimings->durationInFrames;
+    double renderTimeAcc_s = 0.0;
+
+    for (size_t frameIdx = 0; frameIdx < startFrame + numFrames; frameIdx++) {
+      if (sceneSeq) {
+        auto sd = sceneSeq->readJsonForFrame(frameIdx);
+        if (sd.json_vl) {
+          ctx.comp->setVideoLayersJSON(*sd.json_vl, sd.layerScale);
+        }
+        if (sd.json_fg) {
+          ctx.comp->setFgDisplayListJSON(*sd.json_fg);
+        }
+      }
+      if (frameIdx < startFrame) continue;
+
+      const auto frameIdxInSegment = frameIdx - startFrame;
+
+      // registered shared memory inputs are used too, unless the timings play a file sequence with the same id
+      auto inputBufs = registeredInputBufs(ctx);
+      for (auto& kv : inputLoader.readInputBufsAtFrame(frameIdxInSegment)) {
+        inputBufs[kv.first] = kv.second;
+      }
+
+      const double t0 = getMonotonicTime();
+      auto result = ctx.comp->renderFrame(frameIdx, inputBufs);
+      renderTimeAcc_s += getMonotonicTime() - t0;
+
+      std::stringstream fileName;
+      fileName << "vcsrenderout_" << std::setfill('0') << std::setw(4) << frameIdxInSegment << ".yuv";
+      const auto dstPath = outputSeqDir / fileName.str();
+
+      auto dstFile = fopen(dstPath.c_str(), "wb");
+      const bool written = dstFile && fwrite(result->data, result->dataSize, 1, dstFile) == 1;
+      if (dstFile) fclose(dstFile);
+      if (!written) {
+        return DaemonMessage::error("Write failed to: " + dstPath.string());
+      }
+    }
+
+    return DaemonMessage("ok")
+      .set("frames", numFrames)
+      .set("avg_render_us", (int64_t)(renderTimeAcc_s / numFrames * 1.0e6));
+  }
+
+public:
+  VcsRenderDaemon() {
+    arg_parser.add_option({"socket",
+                           's', "path", 0,
+                           "Unix domain socket path to listen on", 0},
+                          args_.socketPath);
+
+    arg_parser.add_option({"max_contexts",
+                           1000, "count", 0,
+                           "Maximum number of render contexts kept at once", 0},
+                          args_.maxContexts);
+  }
+};
+
+int main(int argc, char *argv[])
+{
+  return VcsRenderDaemon()(argc, argv);
+}
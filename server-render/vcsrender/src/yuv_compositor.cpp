@@ -6,50 +6,39 @@
 #include "libyuv.h"
 #include "thumbs.h"
 #include "time_util.h"
+#include "trace.h"
 
 
 namespace vcsrender {
 
+static int64_t elapsedUs(double t0) {
+  return llround((getMonotonicTime() - t0) * 1.0e6);
+}
 
 static void blendRGBAOverI420_inPlace(
   Yuv420PlanarBuf& dstBuf,
-  uint8_t* rgbaBuf, // size must be same as dstBuf
+  const uint8_t* rgbaBuf, // size must be same as dstBuf
   size_t rgbaRowBytes,
-  Yuv420PlanarBuf& tempBuf
+  const Yuv420PlanarBuf& fgYuvBuf, // rgbaBuf converted to I420
+  const std::vector<AlphaSpan>& alphaSpans // for each row of rgbaBuf
 ) {
   const int w = dstBuf.w;
   const int h = dstBuf.h;
-  const int chromaW = (w + 1) / 2;
-
-  // DEBUG: write a gradient into the input.
-  // this helps detect whether rendering issues are before or after this step.
-  /*if (0) {
-    for (int y = 0; y < h; y++) {
-      memset(rgbaBuf + y * rgbaRowBytes, 200 + y, rgbaRowBytes);
-    }
-  }*/
 
-  libyuv::ARGBToI420(
-    rgbaBuf, // source
-    rgbaRowBytes,
-    tempBuf.data, // destination
-    tempBuf.rowBytes_y,
-    tempBuf.getCbData(),
-    tempBuf.rowBytes_ch,
-    tempBuf.getCrData(),
-    tempBuf.rowBytes_ch,
-    w,
-    h);
-
-  // we now have the RGB data as I420 in tempBuf;
-  // blend it to the destination using the original alpha
+  // blend the converted foreground to the destination using the original alpha.
+  // outside each row's alpha span the foreground is fully transparent (premultiplied black, luma 16),
+  // where the blend below reduces to clamping the base luma and leaving chroma unchanged.
 
   for (int y = 0; y < h; y ++) {
-    const uint32_t* overBufBGRA = reinterpret_cast<uint32_t*>(rgbaBuf + y * rgbaRowBytes);
-    const uint8_t* srcBuf_y = tempBuf.data + y * tempBuf.rowBytes_y; //tempY->data + y * rowBytes_tempY;
-    uint8_t* dstBuf_y = dstBuf.data + y * dstBuf.rowBytes_y;  // dstY->data + y * rowBytes_dstY;
+    const uint32_t* overBufBGRA = reinterpret_cast<const uint32_t*>(rgbaBuf + y * rgbaRowBytes);
+    const uint8_t* srcBuf_y = fgYuvBuf.data + y * fgYuvBuf.rowBytes_y;
+    uint8_t* dstBuf_y = dstBuf.data + y * dstBuf.rowBytes_y;
+    const auto span = alphaSpans[y];
 
-    for (int x = 0; x < w; x++) {
+    for (int x = 0; x < span.x0; x++) {
+      dstBuf_y[x] = std::max<uint8_t>(dstBuf_y[x], 16);
+    }
+    for (int x = span.x0; x < span.x1; x++) {
       // fixed-point blend
       const int yOver = srcBuf_y[x];
       const int yBase = dstBuf_y[x];
@@ -70,16 +59,20 @@ static void blendRGBAOverI420_inPlace(
       // 60945 is the maximum luma value for the fixed point result; anything above is white
       dstBuf_y[x] = (yComp_fx >= 60945) ? 255 : yComp_fx / 255 + 16;
     }
+    for (int x = span.x1; x < w; x++) {
+      dstBuf_y[x] = std::max<uint8_t>(dstBuf_y[x], 16);
+    }
 
     if (y % 2 == 0) { // do chroma row too
-      const size_t srcChOffset = (y / 2) * tempBuf.rowBytes_ch;
-      const uint8_t* srcBuf_Cb = tempBuf.getCbData() + srcChOffset;
-      const uint8_t* srcBuf_Cr = tempBuf.getCrData() + srcChOffset;
+      const size_t srcChOffset = (y / 2) * fgYuvBuf.rowBytes_ch;
+      const uint8_t* srcBuf_Cb = fgYuvBuf.getConstCbData() + srcChOffset;
+      const uint8_t* srcBuf_Cr = fgYuvBuf.getConstCrData() + srcChOffset;
       const size_t dstChOffset = (y / 2) * dstBuf.rowBytes_ch;
       uint8_t* dstBuf_Cb = dstBuf.getCbData() + dstChOffset;
       uint8_t* dstBuf_Cr = dstBuf.getCrData() + dstChOffset;
 
-      for (int x = 0; x < chromaW; x++) {
+      // chroma samples take alpha from the pixel at x * 2
+      for (int x = span.x0 / 2; x < (span.x1 + 1) / 2; x++) {
         // fixed-point blend
         const uint32_t cbOver = srcBuf_Cb[x];
         const uint32_t crOver = srcBuf_Cr[x];
@@ -104,13 +97,11 @@ YuvCompositor::YuvCompositor(int32_t w, int32_t h, const std::string& canvexResD
   : w_(w), h_(h)
 {
   canvexCtx_ = CanvexResourceCtxCreate(canvexResDir.c_str());
+  canvexDamageTracker_ = CanvexDamageTrackerCreate();
 
   // retained buffer for the final 4:2:0 composite
   compBuf_ = std::make_shared<Yuv420PlanarBuf>(w_, h_);
 
-  // retained temp buffer used for final composite
-  compTempBuf_ = std::make_shared<Yuv420PlanarBuf>(w_, h_);
-
   // retained buffer for background
   bgBuf_ = std::make_shared<Yuv420PlanarBuf>(w_, h_);
   bgBuf_->clearWithBlack();
@@ -120,6 +111,11 @@ YuvCompositor::YuvCompositor(int32_t w, int32_t h, const std::string& canvexResD
   fgRGBABuf_ = (uint8_t *) malloc(fgRGBABufRowBytes_ * h_);
   memset(fgRGBABuf_, 0, fgRGBABufRowBytes_ * h_);
 
+  // retained I420 version of the overlay graphics
+  fgYuvBuf_ = std::make_shared<Yuv420PlanarBuf>(w_, h_);
+  fgAlphaSpans_.resize(h_);
+  updateFgRegion_(0, 0, w_, h_);
+
   // retained buffer used as intermediate during layer rendering;
   // will be resized if needed, so initial capacity is a guess of what's usually enough
   layerTempBufSize_ = lround(1.2 * compBuf_->dataSize);
@@ -128,10 +124,29 @@ YuvCompositor::YuvCompositor(int32_t w, int32_t h, const std::string& canvexResD
 
 YuvCompositor::~YuvCompositor() {
   if (canvexCtx_) CanvexResourceCtxDestroy(canvexCtx_);
+  if (canvexDamageTracker_) CanvexDamageTrackerDestroy(canvexDamageTracker_);
   if (fgRGBABuf_) free(fgRGBABuf_);
   if (layerTempBuf_) free(layerTempBuf_);
 }
 
+void YuvCompositor::setImageLoadPolicy(CanvexImageLoadPolicy policy) {
+  CanvexResourceCtxSetImageLoadPolicy(canvexCtx_, policy, 0);
+}
+
+void YuvCompositor::setSharedResourceCache(CanvexSharedResourceCache cache) {
+  CanvexResourceCtxAttachSharedCache(canvexCtx_, cache);
+}
+
+bool YuvCompositor::preload(const std::vector<CanvexPreloadFont>& fonts, const std::vector<CanvexPreloadImage>& images) {
+  return CanvexResourceCtxPreload(canvexCtx_, fonts.data(), fonts.size(), images.data(), images.size()) == 0;
+}
+
+CanvexPreloadStatus YuvCompositor::getPreloadStatus() {
+  CanvexPreloadStatus status{};
+  CanvexResourceCtxGetPreloadStatus(canvexCtx_, &status);
+  return status;
+}
+
 void YuvCompositor::renderBackground(const std::string& colorStr) {
   if (colorStr.length() < 1) {
     bgBuf_->clearWithBlack();
@@ -155,13 +170,17 @@ void YuvCompositor::renderBackground(const std::string& colorStr) {
 
   //std::cout << "doing canvex update for bg: " << json << std::endl;
 
+  // rendered into a temp buffer because fgRGBABuf_ holds the retained foreground
+  const uint32_t rowBytes = w_ * 4;
+  std::vector<uint8_t> rgbaBuf(rowBytes * h_);
+
   CanvexRenderResult err = CanvexRenderJSON_RGBA(
     canvexCtx_,
     json.c_str(),
-    fgRGBABuf_,
+    rgbaBuf.data(),
     w_,
     h_,
-    fgRGBABufRowBytes_,
+    rowBytes,
     CanvexAlphaMode::CANVEX_PREMULTIPLIED,
     nullptr /* execution stats */);
   if (err != CanvexRenderSuccess) {
@@ -169,8 +188,8 @@ void YuvCompositor::renderBackground(const std::string& colorStr) {
   }
 
   libyuv::ARGBToI420(
-    fgRGBABuf_, // source
-    fgRGBABufRowBytes_,
+    rgbaBuf.data(), // source
+    rowBytes,
     bgBuf_->data, // destination
     bgBuf_->rowBytes_y,
     bgBuf_->getCbData(),
@@ -179,9 +198,42 @@ void YuvCompositor::renderBackground(const std::string& colorStr) {
     bgBuf_->rowBytes_ch,
     w_,
     h_);
+}
 
-  // clear the tempbuf
-  memset(fgRGBABuf_, 0, fgRGBABufRowBytes_ * h_);
+// Converts a region of the RGBA foreground into fgYuvBuf_ and refreshes the alpha spans of its rows.
+void YuvCompositor::updateFgRegion_(int x, int y, int w, int h) {
+  // align to the 2x2 chroma blocks so the result is identical to converting the whole image
+  int x0 = std::max(0, x) & ~1;
+  int y0 = std::max(0, y) & ~1;
+  int x1 = std::min(w_, (x + w + 1) & ~1);
+  int y1 = std::min(h_, (y + h + 1) & ~1);
+  if (x1 <= x0 || y1 <= y0) return;
+
+  libyuv::ARGBToI420(
+    fgRGBABuf_ + y0 * fgRGBABufRowBytes_ + x0 * 4, // source
+    fgRGBABufRowBytes_,
+    fgYuvBuf_->data + y0 * fgYuvBuf_->rowBytes_y + x0, // destination
+    fgYuvBuf_->rowBytes_y,
+    fgYuvBuf_->getCbData() + (y0 / 2) * fgYuvBuf_->rowBytes_ch + x0 / 2,
+    fgYuvBuf_->rowBytes_ch,
+    fgYuvBuf_->getCrData() + (y0 / 2) * fgYuvBuf_->rowBytes_ch + x0 / 2,
+    fgYuvBuf_->rowBytes_ch,
+    x1 - x0,
+    y1 - y0);
+
+  const int64_t numPixels = (int64_t)(x1 - x0) * (y1 - y0);
+  lastFrameStats_.fgConvertPixels += numPixels;
+  lastFrameStats_.bytesTouched += numPixels * 4 + numPixels * 3 / 2 + (int64_t)(y1 - y0) * w_ * 4;
+
+  // spans cover the whole row, so rescan the full width of each damaged row
+  for (int row = y0; row < y1; row++) {
+    const uint32_t* px = reinterpret_cast<const uint32_t*>(fgRGBABuf_ + row * fgRGBABufRowBytes_);
+    int first = 0;
+    while (first < w_ && (px[first] >> 24) == 0) first++;
+    int last = w_;
+    while (last > first && (px[last - 1] >> 24) == 0) last--;
+    fgAlphaSpans_[row] = {first, last};
+  }
 }
 
 bool YuvCompositor::setVideoLayersJSON(const std::string& jsonStr) {
@@ -203,9 +255,15 @@ bool YuvCompositor::setFgDisplayListJSON(const std::string& jsonStr) {
   // the canvex C API only provides a render method that does
   // parse + RGBA render in one shot, so just retain the string here.
   pendingCanvexJSONUpdate_ = jsonStr;
+  liveCanvexJSON_ = std::nullopt;
   return true;
 }
 
+bool YuvCompositor::hasPendingFgUpdate() const {
+  return pendingCanvexJSONUpdate_ || fgImagesPending_
+         || (liveCanvexJSON_ && CanvexResourceCtxHasNewShmFrames(canvexCtx_));
+}
+
 std::shared_ptr<Yuv420PlanarBuf> YuvCompositor::renderFrame(
   uint64_t frameIdx,
   const VideoInputBufsById& inputBufsById)
@@ -216,33 +274,78 @@ std::shared_ptr<Yuv420PlanarBuf> YuvCompositor::renderFrame(
 }
 
  std::shared_ptr<Yuv420PlanarBuf> YuvCompositor::renderFrame(
-  __attribute__((unused)) uint64_t frameIdx,
+  uint64_t frameIdx,
   const VideoInputBufsById& inputBufsById,
   ThumbCaptureSettings& thumbSettings,
   std::string* outThumbCaptureStr)
 {
   //std::cout << "rendering frame " << frameIdx << " ... " << std::endl;
 
+  VCS_TRACE_SCOPE("composite frame", "frame", frameIdx);
+
+  lastFrameStats_ = {};
+  const double tFrameStart = getMonotonicTime();
+  const int64_t maskHitsBefore = maskCache_.numHits();
+  const int64_t maskMissesBefore = maskCache_.numMisses();
+
+  if (!pendingCanvexJSONUpdate_ && liveCanvexJSON_ && CanvexResourceCtxHasNewShmFrames(canvexCtx_)) {
+    // damage tracking limits the redraw to the shared memory images
+    pendingCanvexJSONUpdate_ = std::move(liveCanvexJSON_);
+    liveCanvexJSON_ = std::nullopt;
+  }
+
   if (pendingCanvexJSONUpdate_) {
     //std::cout << "doing canvex update" << std::endl;
-    CanvexRenderResult err = CanvexRenderJSON_RGBA(
+    // canvex only redraws what changed since the last update,
+    // and tells us which rects need to be converted again.
+    CanvexDamageRegion damage{};
+    CanvexExecutionStats canvexStats{};
+    TraceScope rasterTrace("fg raster");
+    CanvexRenderResult err = CanvexRenderDisplayListIncremental_RGBA(
       canvexCtx_,
-      pendingCanvexJSONUpdate_->c_str(),
+      canvexDamageTracker_,
+      reinterpret_cast<const uint8_t*>(pendingCanvexJSONUpdate_->data()),
+      pendingCanvexJSONUpdate_->size(),
       fgRGBABuf_,
       w_,
       h_,
       fgRGBABufRowBytes_,
       CanvexAlphaMode::CANVEX_PREMULTIPLIED,
-      nullptr /* execution stats */);
+      &damage,
+      &canvexStats);
+    rasterTrace.end();
     if (err != CanvexRenderSuccess) {
       std::cerr << "** VCSRender canvex render failed, err code = " << err << std::endl;
+    } else {
+      VCS_TRACE_SCOPE("fg convert", "num_rects", damage.num_rects);
+      const double t0 = getMonotonicTime();
+      for (int i = 0; i < damage.num_rects; i++) {
+        const auto& r = damage.rects[i];
+        updateFgRegion_(r.x, r.y, r.w, r.h);
+      }
+      lastFrameStats_.fgConvertUs = elapsedUs(t0);
+    }
+    // keep the display list if images were still decoding, so they get drawn once ready.
+    // only the areas of those images are redrawn then.
+    if (err != CanvexRenderSuccess || canvexStats.num_images_pending < 1) {
+      if (err == CanvexRenderSuccess && canvexStats.num_shm_images > 0) {
+        liveCanvexJSON_ = std::move(pendingCanvexJSONUpdate_);
+      }
+      pendingCanvexJSONUpdate_ = std::nullopt;
     }
-    pendingCanvexJSONUpdate_ = std::nullopt;
+    fgImagesPending_ = err == CanvexRenderSuccess && canvexStats.num_images_pending > 0;
+    lastFrameStats_.fgRendered = true;
+    lastFrameStats_.fgCanvex = canvexStats;
   }
 
   // TODO: background clear/copy could be skipped if video layer frames cover entire viewport.
   // in practice the common case would be layer #0 at full screen, and checking for that is easy.
+  TraceScope bgCopyTrace("bg copy");
+  double t0 = getMonotonicTime();
   compBuf_->copyFrom(*bgBuf_);
+  lastFrameStats_.bgCopyUs = elapsedUs(t0);
+  bgCopyTrace.end();
+  lastFrameStats_.bytesTouched += bgBuf_->dataSize * 2;
 
   if (!videoLayers_ || videoLayers_->size() < 1) {
     //std::cout << " .. videoLayers is empty" << std::endl;
@@ -262,14 +365,32 @@ std::shared_ptr<Yuv420PlanarBuf> YuvCompositor::renderFrame(
       }
       const auto srcBuf = inputHit->second;
 
-      renderLayerInPlace_(*compBuf_, *srcBuf, layerDesc);
+      LayerRenderStats layerStats;
+      layerStats.inputId = inputId;
+      renderLayerInPlace_(*compBuf_, *srcBuf, layerDesc, layerStats);
+      lastFrameStats_.layers.push_back(layerStats);
     }
   }
 
+  lastFrameStats_.numMaskCacheHits = maskCache_.numHits() - maskHitsBefore;
+  lastFrameStats_.numMaskCacheMisses = maskCache_.numMisses() - maskMissesBefore;
+
   auto thumbBeforeComp = renderThumbAtFrame(thumbSettings, frameIdx, *compBuf_);
 
   // composite RGBA foreground
-  blendRGBAOverI420_inPlace(*compBuf_, fgRGBABuf_, fgRGBABufRowBytes_, *compTempBuf_);
+  TraceScope fgBlendTrace("overlay blend");
+  t0 = getMonotonicTime();
+  blendRGBAOverI420_inPlace(*compBuf_, fgRGBABuf_, fgRGBABufRowBytes_, *fgYuvBuf_, fgAlphaSpans_);
+  lastFrameStats_.fgBlendUs = elapsedUs(t0);
+  fgBlendTrace.end();
+
+  // every luma value is read and written, and within the alpha spans
+  // the RGBA and converted pixels are read too, with half as many chroma samples on half the rows
+  int64_t numSpanPixels = 0;
+  for (const auto& span : fgAlphaSpans_) {
+    numSpanPixels += span.x1 - span.x0;
+  }
+  lastFrameStats_.bytesTouched += (int64_t)w_ * h_ * 2 + numSpanPixels * 5 + numSpanPixels / 4 * 6;
 
   //std::cout << "frame finished." << std::endl;
 
@@ -291,6 +412,8 @@ std::shared_ptr<Yuv420PlanarBuf> YuvCompositor::renderFrame(
     }
   }
 
+  lastFrameStats_.totalUs = elapsedUs(tFrameStart);
+
   return compBuf_;
 }
 
@@ -345,8 +468,12 @@ static void blendI420LayerWithOpacity_(
 void YuvCompositor::renderLayerInPlace_(
   Yuv420PlanarBuf& dstBuf,
   const Yuv420PlanarBuf& srcBuf,
-  const VideoLayerDesc& layerDesc)
+  const VideoLayerDesc& layerDesc,
+  LayerRenderStats& stats)
 {
+  TraceScope scaleTrace("layer scale", "input_id", stats.inputId);
+  const double tScaleStart = getMonotonicTime();
+
   // not const because cropping may change these
   int srcW = srcBuf.w;
   int srcH = srcBuf.h;
@@ -473,6 +600,12 @@ void YuvCompositor::renderLayerInPlace_(
         scaleH,
         libyuv::kFilterBilinear);
 
+  stats.scaleUs = elapsedUs(tScaleStart);
+  scaleTrace.end();
+
+  VCS_TRACE_SCOPE("layer blend", "input_id", stats.inputId);
+  const double tBlendStart = getMonotonicTime();
+
   // copy into destination with mask if needed
   const uint32_t cornerRadius = lround(layerDesc.attrs.cornerRadiusPx);
   bool useMask = cornerRadius > 0;
@@ -582,6 +715,19 @@ void YuvCompositor::renderLayerInPlace_(
       }
     }
   }
+
+  stats.blendUs = elapsedUs(tBlendStart);
+  stats.masked = useMask;
+  stats.opacityBlend = useBlend && !useMask;
+
+  // the scale reads the cropped source and writes the scaled buffer twice (clear and scale).
+  // the copy reads that and writes the destination, also reading it when blending.
+  const int64_t numSrcPixels = (int64_t)srcW * srcH;
+  const int64_t numScaledPixels = (int64_t)scaleBufW * scaleBufH;
+  const int64_t numDstPixels = (int64_t)srcCopyLen_y * std::max(0, maxDstY - minDstY + 1);
+  lastFrameStats_.bytesTouched += (numSrcPixels + numScaledPixels * 2) * 3 / 2
+                                + numDstPixels * 3 / 2 * (stats.opacityBlend ? 3 : 2)
+                                + (useMask ? numDstPixels * 2 : 0);
 }
 
 } // namespace vcsrender
@@ -1,7 +1,9 @@
 #pragma once
 #include <optional>
 #include <unordered_map>
+#include <vector>
 #include "canvex_c_api.h"
+#include "frame_stats.h"
 #include "mask.h"
 #include "thumbs.h"
 #include "yuvbuf.h"
@@ -9,6 +11,12 @@
 
 namespace vcsrender {
 
+// range [x0, x1) of a row that contains non-transparent pixels; x0 == x1 means the row is empty
+struct AlphaSpan {
+  int x0;
+  int x1;
+};
+
 /*
   A compositor instance should be retained between frames.
   
@@ -37,6 +45,28 @@ class YuvCompositor {
             ThumbCaptureSettings& thumbSettings,
             std::string* outThumbCaptureStr);
 
+ // with a background policy, a display list drawn before its images are decoded
+ // is rendered again on later frames until they're all in.
+ void setImageLoadPolicy(CanvexImageLoadPolicy policy);
+
+ // fonts and graphics images are looked up in a cache shared with other compositors, or null for this one's own
+ void setSharedResourceCache(CanvexSharedResourceCache cache);
+
+ // starts loading fonts and images for the foreground graphics in the background
+ bool preload(const std::vector<CanvexPreloadFont>& fonts, const std::vector<CanvexPreloadImage>& images);
+
+ CanvexPreloadStatus getPreloadStatus();
+
+ // true if the next frame renders the foreground again even though the display list hasn't changed:
+ // a new display list hasn't been drawn yet, the last render left out images that were still decoding,
+ // or shared memory images have new frames. the output can then differ from the last frame's with the same inputs.
+ bool hasPendingFgUpdate() const;
+
+ // timings of the last frame, including canvex stats of the foreground render if the graphics changed
+ const FrameRenderStats& lastFrameStats() const {
+   return lastFrameStats_;
+ }
+
  // background color string must be in canvex-compatible format.
  // accepted formats include #fff, #f0f0f0, and rgba(240, 240, 240, 0.7)
  // empty string clears to black.
@@ -48,27 +78,45 @@ class YuvCompositor {
   int32_t h_;
 
   CanvexResourceCtx canvexCtx_;
+  CanvexDamageTracker canvexDamageTracker_;
 
   std::shared_ptr<Yuv420PlanarBuf> compBuf_;
-  std::shared_ptr<Yuv420PlanarBuf> compTempBuf_;
 
   std::shared_ptr<Yuv420PlanarBuf> bgBuf_;
 
   uint8_t* fgRGBABuf_;
   uint32_t fgRGBABufRowBytes_;
 
+  // foreground converted to I420, updated only where canvex reports damage
+  std::shared_ptr<Yuv420PlanarBuf> fgYuvBuf_;
+
+  // per-row range of foreground pixels with non-zero alpha
+  std::vector<AlphaSpan> fgAlphaSpans_;
+
   uint8_t* layerTempBuf_;
   size_t layerTempBufSize_;
 
   MaskCache maskCache_;
 
+  FrameRenderStats lastFrameStats_;
+
   std::optional<std::string> pendingCanvexJSONUpdate_ = std::nullopt;
+
+  // the display list last rendered, kept while it draws shared memory images
+  // so that it can be rendered again when their producers publish new frames
+  std::optional<std::string> liveCanvexJSON_ = std::nullopt;
+
+  // the last foreground render had to leave out images that were still decoding
+  bool fgImagesPending_ = false;
   std::unique_ptr<VCSVideoLayerList> videoLayers_ = nullptr;
 
+  void updateFgRegion_(int x, int y, int w, int h);
+
   void renderLayerInPlace_(
     Yuv420PlanarBuf& dstBuf,
     const Yuv420PlanarBuf& srcBuf,
-    const VideoLayerDesc& layerDesc
+    const VideoLayerDesc& layerDesc,
+    LayerRenderStats& stats
   );
 };
 